@@ -0,0 +1,294 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.hpp"
+#include <cmp/cmp.h>
+#include <fmc++/error.hpp>
+#include <fmc++/logger.hpp>
+#include <fmc++/mpl.hpp>
+#include <fmc++/serialization.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc++/time.hpp>
+#include <fmc/cmdline.h>
+#include <fmc/files.h>
+#include <fmc/time.h>
+#include <tuple>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+using namespace fmc;
+
+struct binance_parse_ctx {
+  // copies of the last quote, the message may be gone by the next one,
+  // as when it was read from a ring
+  string bidqt = "null";
+  string askqt = "null";
+  string bidpx = "null";
+  string askpx = "null";
+  string_view symbol;
+  bool announced = false;
+};
+
+pair<string_view, parser_t> get_binance_channel_in(string_view sv,
+                                                   fmc_error_t **error) {
+  auto pos = sv.find_last_of('@');
+  auto none = make_pair<string_view, parser_t>(string_view(), nullptr);
+  RETURN_ERROR_UNLESS(pos != sv.npos, error, none,
+                      "missing @ in the Binance stream name", sv);
+
+  auto feedtype = sv.substr(pos + 1);
+  auto outsv = sv.substr(0, pos);
+  if (feedtype == "bookTicker") {
+    // This section here is binance parsing code
+    auto parse_binance_bookTicker =
+        [ctx = binance_parse_ctx{}](string_view in, ore_writer_t *out,
+                                    int64_t tm, uint64_t *last, bool skip,
+                                    fmc_error_t **error) mutable {
+          auto [val, rem] = simple_json_parse(in, "\"u\":");
+          RETURN_ERROR_UNLESS(val.size(), error, false,
+                              "could not parse message", in);
+          auto [seqno, parsed] = fmc::from_string_view<uint64_t>(val);
+          RETURN_ERROR_UNLESS(val.size() == parsed.size(), error, false,
+                              "could not parse message", in);
+          if (seqno <= *last)
+            return false;
+          *last = seqno;
+          // event time in milliseconds, only some endpoints send it
+          int64_t offset = 0;
+          if (auto evt = simple_json_parse(in, "\"E\":").first; evt.size()) {
+            auto [vend_ms, parsed_ms] = fmc::from_string_view<int64_t>(evt);
+            RETURN_ERROR_UNLESS(evt.size() == parsed_ms.size(), error, false,
+                                "could not parse message", in);
+            offset = tm - vend_ms * 1000000LL;
+          }
+          string_view bidqt;
+          string_view askqt;
+          string_view bidpx;
+          string_view askpx;
+          tie(bidpx, rem) = simple_json_parse(rem, "\"b\":\"", "\",");
+          RETURN_ERROR_UNLESS(bidpx.size(), error, false,
+                              "could not parse message", in);
+          tie(bidqt, rem) = simple_json_parse(rem, "\"B\":\"", "\",");
+          RETURN_ERROR_UNLESS(bidqt.size(), error, false,
+                              "could not parse message", in);
+          tie(askpx, rem) = simple_json_parse(rem, "\"a\":\"", "\",");
+          RETURN_ERROR_UNLESS(askpx.size(), error, false,
+                              "could not parse message", in);
+          tie(askqt, rem) = simple_json_parse(rem, "\"A\":\"", "\"}");
+          RETURN_ERROR_UNLESS(askqt.size(), error, false,
+                              "could not parse message", in);
+
+          // TODO: need to fix this
+          bool has_bid = bidpx != "null";
+          bool has_ask = askpx != "null";
+          bool had_bid = ctx.bidpx != "null";
+          bool had_ask = ctx.askpx != "null";
+          bool bid_mod = had_bid & has_bid & (bidpx == ctx.bidpx);
+          bool ask_mod = had_ask & has_ask & (askpx == ctx.askpx);
+          bool bid_add = !had_bid & has_bid;
+          bool ask_add = !had_ask & has_ask;
+          bool bid_del = had_bid & !has_bid;
+          bool ask_del = had_ask & !has_ask;
+
+          bool batch = ask_mod | ask_add | ask_del;
+          bool announce = (!ctx.announced) & (bid_add | ask_add);
+          ctx.announced |= announce;
+
+          ctx.bidpx = bidpx;
+          ctx.bidqt = bidqt;
+          ctx.askpx = askpx;
+          ctx.askqt = askqt;
+
+          if (skip)
+            return true;
+
+          if (announce) {
+            // ORE Book Control Message
+            // [13, receive, vendor offset, vendor seqno, batch, imnt id,
+            // uncross, command]
+            ore_write(out, error,
+                      (uint8_t)13,     // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)0,     // vendor_seqno
+                      (uint8_t)1,      // batch
+                      (int32_t)chanid, // imnt id
+                      (uint8_t)0,      // uncross
+                      'C'              // command
+            );
+            if (*error)
+              return false;
+          }
+
+          if (bid_mod) {
+            // ORE Order Modify Message
+            // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
+            // id, new price, new qty]
+            ore_write(out, error,
+                      (uint8_t)6,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)seqno,
+                      (uint8_t)batch,  // batch (firts message)
+                      (int32_t)chanid, // imnt_id
+                      (int32_t)chanid, // order_id
+                      (int32_t)chanid, // new_order_id
+                      bidpx,           // price
+                      bidqt,           // qty
+                      (uint8_t) true   // is_bid
+            );
+          } else if (bid_add) {
+            // ORE Order Add Message
+            // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
+            // price, qty, is bid]
+            ore_write(out, error,
+                      (uint8_t)1,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)seqno,
+                      (uint8_t)batch,  // batch (firts message)
+                      (int32_t)chanid, // imnt_id
+                      (int32_t)chanid, // order_id
+                      bidpx,           // price
+                      bidqt,           // qty
+                      true             // is_bid
+            );
+          } else if (bid_del) {
+            // ORE Order Delete Message
+            // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
+            ore_write(out, error,
+                      (uint8_t)5,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)seqno,
+                      (uint8_t)batch,  // batch (firts message)
+                      (int32_t)chanid, // imnt_id
+                      (int32_t)chanid  // order_id
+            );
+          }
+          if (*error)
+            return false;
+
+          if (ask_mod) {
+            // ORE Order Modify Message
+            // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
+            // id, new price, new qty]
+            ore_write(out, error,
+                      (uint8_t)6,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)seqno,
+                      (uint8_t)0,            // batch (last batch message)
+                      (int32_t)chanid,       // imnt_id
+                      (int32_t)(chanid + 1), // order_id
+                      (int32_t)(chanid + 1), // new_order_id
+                      askpx,                 // price
+                      askqt                  // qty
+            );
+          } else if (ask_add) {
+            // ORE Order Add Message
+            // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
+            // price, qty, is bid]
+            ore_write(out, error,
+                      (uint8_t)1,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)seqno,
+                      (uint8_t)0,            // batch (last batch message)
+                      (int32_t)chanid,       // imnt_id
+                      (int32_t)(chanid + 1), // order_id
+                      askpx,                 // price
+                      askqt,                 // qty
+                      false                  // is_bid
+            );
+          } else if (ask_del) {
+            // ORE Order Delete Message
+            // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
+            ore_write(out, error,
+                      (uint8_t)5,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)seqno,
+                      (uint8_t)0,           // batch (last batch message)
+                      (int32_t)chanid,      // imnt_id
+                      (int32_t)(chanid + 1) // order_id
+            );
+          }
+
+          return *error == nullptr;
+        };
+    return {outsv, parse_binance_bookTicker};
+  } else if (feedtype == "trade") {
+    auto parse_binance_trade = [](string_view in, ore_writer_t *out,
+                                  int64_t tm, uint64_t *last, bool skip,
+                                  fmc_error_t **error) {
+      auto [val, rem] = simple_json_parse(in, "\"E\":");
+      RETURN_ERROR_UNLESS(val.size(), error, false, "could not parse message",
+                          in);
+      auto [vend_ms, parsed] = fmc::from_string_view<int64_t>(val);
+      RETURN_ERROR_UNLESS(val.size() == parsed.size(), error, false,
+                          "could not parse message", in);
+
+      tie(val, rem) = simple_json_parse(rem, "\"t\":");
+      RETURN_ERROR_UNLESS(val.size(), error, false, "could not parse message",
+                          in);
+      auto [seqno, parsed2] = fmc::from_string_view<uint64_t>(val);
+      RETURN_ERROR_UNLESS(val.size() == parsed2.size(), error, false,
+                          "could not parse message", in);
+
+      if (seqno <= *last)
+        return false;
+      *last = seqno;
+      string_view trdpx;
+      string_view trdqt;
+      string_view isbid;
+      tie(trdpx, rem) = simple_json_parse(rem, "\"p\":\"", "\",");
+      RETURN_ERROR_UNLESS(trdpx.size(), error, false, "could not parse message",
+                          in);
+      tie(trdqt, rem) = simple_json_parse(rem, "\"q\":\"", "\",");
+      RETURN_ERROR_UNLESS(trdqt.size(), error, false, "could not parse message",
+                          in);
+
+      tie(isbid, rem) = simple_json_parse(rem, "\"m\":");
+      RETURN_ERROR_UNLESS(isbid.size(), error, false, "could not parse message",
+                          in);
+
+      // ORE Off Book Trade Message
+      // [11, receive, vendor offset, vendor seqno, batch, imnt id, trade
+      // price, qty, decorator]
+      ore_write(out, error,
+                (uint8_t)11,                         // Message Type ID
+                (int64_t)tm,                         // receive
+                (int64_t)(tm - vend_ms * 1000000LL), // vendor offset in ns
+                (uint64_t)seqno,                     // vendor seqno
+                (uint8_t)0,                          // batch
+                (uint64_t)chanid,                    // imnt_id
+                trdpx,                               // trade price
+                trdqt,                               // qty
+                string_view(isbid == "true" ? "b" : "a"));
+
+      return *error == nullptr;
+    };
+    return {outsv, parse_binance_trade};
+  }
+  RETURN_ERROR(error, none, "unknown Binance stream type", feedtype);
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <libwebsockets.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "binance-parser.hpp"
+#include "feed-engine.hpp"
+
+/*
+ * Binance combined streams, each stream is named SEC@TYPE and its messages
+ * are wrapped as {"stream":"SEC@TYPE","data":{...}}
+ */
+
+static const char *const binance_types[] = {"bookTicker", "trade"};
+
+static std::string binance_path(const std::set<std::string> &secs) {
+  std::string path = "/stream";
+  char sep = '?';
+  for (auto &sec : secs) {
+    for (auto *tp : binance_types) {
+      path.push_back(sep);
+      if (sep == '?')
+        path.append("streams=");
+      path.append(sec);
+      path.push_back('@');
+      path.append(tp);
+      sep = '/';
+    }
+  }
+  return path;
+}
+
+static void binance_request(bool subscribe,
+                            const std::vector<std::string> &secs,
+                            unsigned *id, std::vector<std::string> &out) {
+  std::string msg = "{\"method\":\"";
+  msg.append(subscribe ? "SUBSCRIBE" : "UNSUBSCRIBE");
+  msg.append("\",\"params\":[");
+  char sep = ' ';
+  for (auto &sec : secs) {
+    for (auto *tp : binance_types) {
+      msg.push_back(sep);
+      msg.push_back('"');
+      msg.append(sec);
+      msg.push_back('@');
+      msg.append(tp);
+      msg.push_back('"');
+      sep = ',';
+    }
+  }
+  msg.append("],\"id\":");
+  msg.append(std::to_string(++*id));
+  msg.push_back('}');
+  out.push_back(std::move(msg));
+}
+
+static venue_msg_t binance_route(std::string_view msg, venue_route_t *out) {
+  const char *in = msg.data();
+  size_t len = msg.size();
+  size_t alen = 0;
+  auto *p = lws_json_simple_find(in, len, "\"stream\"", &alen);
+  if (!p && lws_json_simple_find(in, len, "\"id\"", &alen)) {
+    /* response to a SUBSCRIBE or UNSUBSCRIBE request */
+    if (lws_json_simple_find(in, len, "\"result\":null", &alen))
+      lwsl_user("%s: %.*s\n", __func__, (int)len, in);
+    else
+      lwsl_err("%s: request failed %.*s\n", __func__, (int)len, in);
+    return venue_msg_t::CONTROL;
+  }
+  if (!p) {
+    lwsl_err("%s, message does not contain \"stream\":\n", __func__);
+    return venue_msg_t::INVALID;
+  }
+  auto stream = std::string_view(p + 2, alen - 3);
+  auto pos = stream.find_last_of('@');
+  if (pos == std::string_view::npos) {
+    lwsl_err("%s, invalid stream name %.*s:\n", __func__, (int)stream.size(),
+             stream.data());
+    return venue_msg_t::INVALID;
+  }
+  out->sec = stream.substr(0, pos);
+  out->type = stream.substr(pos + 1);
+  p = lws_json_simple_find(in, len, "\"data\"", &alen);
+  if (!p) {
+    lwsl_err("%s, message does not contain \"data\":\n", __func__);
+    return venue_msg_t::INVALID;
+  }
+  out->data = std::string_view(p + 1, len - (p - in) - 2);
+  return venue_msg_t::DATA;
+}
+
+// event time in milliseconds, bookTicker messages do not carry it
+static int64_t binance_vendor_time(std::string_view data) {
+  auto event = simple_json_parse(data, "\"E\":").first;
+  if (auto [ms, parsed] = fmc::from_string_view<int64_t>(event);
+      event.size() && parsed.size() == event.size())
+    return ms * 1000000LL;
+  return 0;
+}
+
+static const std::string_view binance_samples[] = {
+    R"({"stream":"btcusdt@bookTicker","data":{"u":36742613650,)"
+    R"("s":"BTCUSDT","b":"27341.12000000","B":"1.25000000",)"
+    R"("a":"27341.13000000","A":"0.37500000"}})",
+    R"({"stream":"btcusdt@trade","data":{"e":"trade","E":1680000000123,)"
+    R"("s":"BTCUSDT","t":3052133981,"p":"27341.13000000",)"
+    R"("q":"0.00100000","b":20011862155,"a":20011862190,)"
+    R"("T":1680000000122,"m":false,"M":true}})",
+    R"({"stream":"ethusdt@bookTicker","data":{"u":25461880651,)"
+    R"("s":"ETHUSDT","b":"1787.06000000","B":"41.52520000",)"
+    R"("a":"1787.07000000","A":"12.50000000"}})",
+    R"({"stream":"ethusdt@trade","data":{"e":"trade","E":1680000000125,)"
+    R"("s":"ETHUSDT","t":1133651473,"p":"1787.07000000",)"
+    R"("q":"0.37500000","b":13375081961,"a":13375082001,)"
+    R"("T":1680000000124,"m":true,"M":true}})"};
+
+constinit const venue_t binance_venue = {
+    .name = "binance",
+    .component = "binance-feed-handler",
+    .descr = "Binance feed handler component",
+    .encoding = "Content-Type application/json\n"
+                "Content-Schema Binance",
+    .address = "stream.binance.com",
+    .port = 443,
+    .us_address = "stream.binance.us",
+    .us_port = 9443,
+    .types = binance_types,
+    // trade ids are the only vendor sequence numbers without holes
+    .contiguous = "trade",
+    .path_subscribes = true,
+    .path = binance_path,
+    .request = binance_request,
+    .route = binance_route,
+    .vendor_time = binance_vendor_time,
+    .resolver = get_binance_channel_in,
+    .samples = binance_samples,
+};
@@ -0,0 +1,139 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.hpp"
+#include <cmp/cmp.h>
+#include <fmc++/error.hpp>
+#include <fmc++/logger.hpp>
+#include <fmc++/mpl.hpp>
+#include <fmc++/serialization.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc++/time.hpp>
+#include <fmc/cmdline.h>
+#include <fmc/files.h>
+#include <fmc/time.h>
+#include <tuple>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+
+// Finds the string value of key, scanning from rem first since the fields
+// usually come in the documented order, then the whole message since
+// Coinbase does not guarantee it.
+inline string_view coinbase_find(string_view in, string_view &rem,
+                                 string_view key) {
+  auto [val, next] = simple_json_parse(rem, key, "\"");
+  if (!val.size())
+    return simple_json_parse(in, key, "\"").first;
+  rem = next;
+  return val;
+}
+
+// Coinbase Exchange full messages, the ticker channel carries the best bid
+// and offer and the matches channel the trades.
+pair<string_view, parser_t> get_coinbase_channel_in(string_view sv,
+                                                    fmc_error_t **error) {
+  auto pos = sv.find_last_of('@');
+  auto none = make_pair<string_view, parser_t>(string_view(), nullptr);
+  RETURN_ERROR_UNLESS(pos != sv.npos, error, none,
+                      "missing @ in the Coinbase stream name", sv);
+
+  auto feedtype = sv.substr(pos + 1);
+  auto outsv = sv.substr(0, pos);
+  if (feedtype == "ticker") {
+    auto parse_coinbase_ticker =
+        [st = bbo_state_t{}](string_view in, ore_writer_t *out, int64_t tm,
+                             uint64_t *last, bool skip,
+                             fmc_error_t **error) mutable {
+          auto val = simple_json_parse(in, "\"sequence\":", ",}").first;
+          auto [seqno, parsed] = fmc::from_string_view<uint64_t>(val);
+          RETURN_ERROR_UNLESS(val.size() && val.size() == parsed.size(), error,
+                              false, "could not parse message", in);
+          if (seqno <= *last)
+            return false;
+          *last = seqno;
+          auto rem = in;
+          auto bidpx = coinbase_find(in, rem, "\"best_bid\":\"");
+          auto bidqt = coinbase_find(in, rem, "\"best_bid_size\":\"");
+          auto askpx = coinbase_find(in, rem, "\"best_ask\":\"");
+          auto askqt = coinbase_find(in, rem, "\"best_ask_size\":\"");
+          int64_t offset = 0;
+          if (auto ts = coinbase_find(in, rem, "\"time\":\""); ts.size()) {
+            auto vendor_ns = iso8601_time_ns(ts);
+            RETURN_ERROR_UNLESS(vendor_ns, error, false,
+                                "could not parse vendor time in message", in);
+            offset = tm - vendor_ns;
+          }
+          RETURN_ERROR_UNLESS(bidpx.size() == 0 || bidqt.size(), error, false,
+                              "could not parse message", in);
+          RETURN_ERROR_UNLESS(askpx.size() == 0 || askqt.size(), error, false,
+                              "could not parse message", in);
+          return ore_write_bbo(st, out, tm, offset, seqno, bidpx, bidqt, askpx,
+                               askqt, skip, error);
+        };
+    return {outsv, parse_coinbase_ticker};
+  } else if (feedtype == "matches") {
+    auto parse_coinbase_match = [](string_view in, ore_writer_t *out,
+                                   int64_t tm, uint64_t *last, bool skip,
+                                   fmc_error_t **error) {
+      auto val = simple_json_parse(in, "\"trade_id\":", ",}").first;
+      auto [seqno, parsed] = fmc::from_string_view<uint64_t>(val);
+      RETURN_ERROR_UNLESS(val.size() && val.size() == parsed.size(), error,
+                          false, "could not parse message", in);
+      if (seqno <= *last)
+        return false;
+      *last = seqno;
+      auto rem = in;
+      // side of the maker order
+      auto side = coinbase_find(in, rem, "\"side\":\"");
+      RETURN_ERROR_UNLESS(side.size(), error, false,
+                          "could not parse side in message", in);
+      auto trdqt = coinbase_find(in, rem, "\"size\":\"");
+      RETURN_ERROR_UNLESS(trdqt.size(), error, false, "could not parse message",
+                          in);
+      auto trdpx = coinbase_find(in, rem, "\"price\":\"");
+      RETURN_ERROR_UNLESS(trdpx.size(), error, false, "could not parse message",
+                          in);
+      auto vendor_ns = iso8601_time_ns(coinbase_find(in, rem, "\"time\":\""));
+      RETURN_ERROR_UNLESS(vendor_ns, error, false,
+                          "could not parse vendor time in message", in);
+
+      // ORE Off Book Trade Message
+      // [11, receive, vendor offset, vendor seqno, batch, imnt id, trade
+      // price, qty, decorator]
+      ore_write(out, error,
+                (uint8_t)11,               // Message Type ID
+                (int64_t)tm,               // receive
+                (int64_t)(tm - vendor_ns), // vendor offset in ns
+                (uint64_t)seqno,           // vendor seqno
+                (uint8_t)0,                // batch
+                (uint64_t)chanid,          // imnt_id
+                trdpx,                     // trade price
+                trdqt,                     // qty
+                string_view(side == "buy" ? "b" : "a"));
+
+      return *error == nullptr;
+    };
+    return {outsv, parse_coinbase_match};
+  }
+  RETURN_ERROR(error, none, "unknown Coinbase stream type", feedtype);
+}
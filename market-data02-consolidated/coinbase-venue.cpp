@@ -0,0 +1,137 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <libwebsockets.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "coinbase-parser.hpp"
+#include "feed-engine.hpp"
+
+/*
+ * Coinbase Exchange websocket feed, messages are objects with a "type"
+ * field and the product in "product_id". The ticker channel sends ticker
+ * messages and the matches channel match messages, preceded by a
+ * last_match on subscription.
+ */
+
+static const char *const coinbase_types[] = {"ticker", "matches"};
+
+static std::string coinbase_path(const std::set<std::string> &secs) {
+  return "/";
+}
+
+static void coinbase_request(bool subscribe,
+                             const std::vector<std::string> &secs,
+                             unsigned *id, std::vector<std::string> &out) {
+  std::string msg = "{\"type\":\"";
+  msg.append(subscribe ? "subscribe" : "unsubscribe");
+  msg.append("\",\"product_ids\":[");
+  char sep = ' ';
+  for (auto &sec : secs) {
+    msg.push_back(sep);
+    msg.push_back('"');
+    msg.append(sec);
+    msg.push_back('"');
+    sep = ',';
+  }
+  msg.append("],\"channels\":[");
+  sep = ' ';
+  for (auto *tp : coinbase_types) {
+    msg.push_back(sep);
+    msg.push_back('"');
+    msg.append(tp);
+    msg.push_back('"');
+    sep = ',';
+  }
+  msg.append("]}");
+  out.push_back(std::move(msg));
+}
+
+static venue_msg_t coinbase_route(std::string_view msg, venue_route_t *out) {
+  auto type = simple_json_parse(msg, "\"type\":\"", "\"").first;
+  if (type == "ticker") {
+    out->type = "ticker";
+  } else if (type == "match" || type == "last_match") {
+    out->type = "matches";
+  } else if (type == "subscriptions") {
+    lwsl_user("%s: %.*s\n", __func__, (int)msg.size(), msg.data());
+    return venue_msg_t::CONTROL;
+  } else if (type == "heartbeat") {
+    return venue_msg_t::CONTROL;
+  } else if (type == "error") {
+    lwsl_err("%s, received error message: %.*s:\n", __func__, (int)msg.size(),
+             msg.data());
+    return venue_msg_t::FATAL;
+  } else {
+    lwsl_err("%s, unexpected message %.*s:\n", __func__, (int)msg.size(),
+             msg.data());
+    return venue_msg_t::INVALID;
+  }
+  out->sec = simple_json_parse(msg, "\"product_id\":\"", "\"").first;
+  if (!out->sec.size()) {
+    lwsl_err("%s, message does not contain \"product_id\":\n", __func__);
+    return venue_msg_t::INVALID;
+  }
+  out->data = msg;
+  return venue_msg_t::DATA;
+}
+
+static int64_t coinbase_vendor_time(std::string_view data) {
+  return iso8601_time_ns(simple_json_parse(data, "\"time\":\"", "\"").first);
+}
+
+static const std::string_view coinbase_samples[] = {
+    R"({"type":"ticker","sequence":59830185621,"product_id":"BTC-USD",)"
+    R"("price":"27341.13","open_24h":"27102.55","volume_24h":"12455.6",)"
+    R"("low_24h":"26950.01","high_24h":"27510.00","volume_30d":"401231.9",)"
+    R"("best_bid":"27341.12","best_bid_size":"1.25000000",)"
+    R"("best_ask":"27341.13","best_ask_size":"0.37500000","side":"buy",)"
+    R"("time":"2023-03-28T10:40:00.123456Z","trade_id":517320141,)"
+    R"("last_size":"0.001"})",
+    R"({"type":"match","trade_id":517320142,)"
+    R"("maker_order_id":"ac928c66-ca53-498f-9c13-a110027a60e8",)"
+    R"("taker_order_id":"132fb6ae-456b-4654-b4e0-d681ac05cea1",)"
+    R"("side":"sell","size":"0.00100000","price":"27341.13",)"
+    R"("product_id":"BTC-USD","sequence":59830185622,)"
+    R"("time":"2023-03-28T10:40:00.124567Z"})",
+    R"({"type":"ticker","sequence":42189334751,"product_id":"ETH-USD",)"
+    R"("price":"1787.07","open_24h":"1771.20","volume_24h":"98711.2",)"
+    R"("low_24h":"1760.55","high_24h":"1799.99","volume_30d":"3210456.7",)"
+    R"("best_bid":"1787.06","best_bid_size":"41.52520000",)"
+    R"("best_ask":"1787.07","best_ask_size":"12.50000000","side":"sell",)"
+    R"("time":"2023-03-28T10:40:00.125678Z","trade_id":401893341,)"
+    R"("last_size":"0.375"})",
+    R"({"type":"match","trade_id":401893342,)"
+    R"("maker_order_id":"5b1c3f0e-9a52-4cc2-8e52-bc3a0bf42d0e",)"
+    R"("taker_order_id":"d0f2e9b6-1f43-4d3b-9d2c-6fa8c3f81e27",)"
+    R"("side":"buy","size":"0.37500000","price":"1787.07",)"
+    R"("product_id":"ETH-USD","sequence":42189334752,)"
+    R"("time":"2023-03-28T10:40:00.126789Z"})"};
+
+constinit const venue_t coinbase_venue = {
+    .name = "coinbase",
+    .component = "coinbase-feed-handler",
+    .descr = "Coinbase feed handler component",
+    .encoding = "Content-Type application/json\n"
+                "Content-Schema Coinbase",
+    .address = "ws-feed.exchange.coinbase.com",
+    .port = 443,
+    .us_address = nullptr,
+    .us_port = 0,
+    .types = coinbase_types,
+    // trade ids of a product are consecutive
+    .contiguous = "matches",
+    .path_subscribes = false,
+    .path = coinbase_path,
+    .request = coinbase_request,
+    .route = coinbase_route,
+    .vendor_time = coinbase_vendor_time,
+    .resolver = get_coinbase_channel_in,
+    .samples = coinbase_samples,
+};
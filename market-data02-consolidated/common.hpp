@@ -14,6 +14,8 @@
 #include <fmc++/strings.hpp>
 #include <fmc/error.h>
 
+#include "ore-writer.hpp"
+
 using namespace std;
 
 // passing json string and json key
@@ -30,6 +32,66 @@ simple_json_parse(string_view a, string_view key, string_view sep = ","sv) {
   return {a.substr(0, pos), a.substr(pos + sep.size())};
 }
 
+// parsing vendor time in seconds with a decimal fraction, e.g.
+// "1534614057.321597", returns time in nanoseconds or 0 if invalid
+inline int64_t decimal_time_ns(string_view sv) {
+  auto [secsv, sep, fracsv] = fmc::split(sv, ".");
+  auto [secs, parsed] = fmc::from_string_view<int64_t>(secsv);
+  if (!secsv.size() || parsed.size() != secsv.size())
+    return 0;
+  int64_t frac = 0;
+  int64_t scale = 1000000000LL;
+  for (size_t i = 0; i < fracsv.size(); ++i) {
+    if (fracsv[i] < '0' || fracsv[i] > '9')
+      return 0;
+    if (i < 9) {
+      frac = frac * 10 + (fracsv[i] - '0');
+      scale /= 10;
+    }
+  }
+  return secs * 1000000000LL + frac * scale;
+}
+
+// parsing UTC vendor time in ISO 8601 format, e.g.
+// "2022-10-19T23:28:22.061769Z", returns time in nanoseconds or 0 if invalid
+inline int64_t iso8601_time_ns(string_view sv) {
+  if (sv.size() < 20 || sv[4] != '-' || sv[7] != '-' || sv[10] != 'T' ||
+      sv[13] != ':' || sv[16] != ':' || sv.back() != 'Z')
+    return 0;
+  auto num = [sv](size_t pos, size_t len) -> int64_t {
+    auto digits = sv.substr(pos, len);
+    auto [val, parsed] = fmc::from_string_view<int64_t>(digits);
+    return parsed.size() == len && digits[0] != '-' ? val : -1;
+  };
+  int64_t y = num(0, 4), m = num(5, 2), d = num(8, 2);
+  int64_t hh = num(11, 2), mm = num(14, 2), ss = num(17, 2);
+  if (y < 1970 || m < 1 || m > 12 || d < 1 || d > 31 || hh < 0 || mm < 0 ||
+      ss < 0)
+    return 0;
+  // days since the epoch of a proleptic Gregorian date
+  y -= m <= 2;
+  int64_t era = y / 400;
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int64_t days = era * 146097 + doe - 719468;
+  int64_t secs = ((days * 24 + hh) * 60 + mm) * 60 + ss;
+  auto fracsv = sv.substr(19, sv.size() - 20);
+  if (fracsv.size() && fracsv[0] != '.')
+    return 0;
+  int64_t frac = 0;
+  int64_t scale = 1000000000LL;
+  for (size_t i = 1; i < fracsv.size(); ++i) {
+    if (fracsv[i] < '0' || fracsv[i] > '9')
+      return 0;
+    if (i < 10) {
+      frac = frac * 10 + (fracsv[i] - '0');
+      scale /= 10;
+    }
+  }
+  return secs * 1000000000LL + frac * scale;
+}
+
 template <class... Args>
 static void cmp_ore_write(cmp_str_t *cmp, fmc_error_t **error, Args &&...args) {
   uint32_t left = sizeof...(Args);
@@ -43,12 +105,78 @@ static void cmp_ore_write(cmp_str_t *cmp, fmc_error_t **error, Args &&...args) {
   RETURN_ERROR_UNLESS(ret, error, , "could not parse:", cmp_strerror(ctx));
 }
 
-// Parser gets the original data, string to write data to
+// records ORE message with the given fields to be encoded into the output
+template <class... Args>
+static void ore_write(ore_writer_t *out, fmc_error_t **error, Args &&...args) {
+  fmc_error_clear(error);
+  out->write(std::forward<Args>(args)...);
+}
+
+// Parser gets the original data, writer to record output messages to
 // sequence number processed and error.
 // Sets error if could not parse.
 // Returns true is processed, false if duplicated.
 using parser_t = function<bool(
-    (string_view, cmp_str_t *, int64_t, uint64_t *, bool, fmc_error_t **))>;
+    (string_view, ore_writer_t *, int64_t, uint64_t *, bool, fmc_error_t **))>;
 typedef pair<string_view, parser_t> (*resolver_t)(string_view, fmc_error_t **);
 
 constexpr int32_t chanid = 100;
+
+// sides of the top of the book present in the last update
+struct bbo_state_t {
+  bool bid = false;
+  bool ask = false;
+  bool announced = false;
+};
+
+// Records the ORE messages of a top of the book update as one batch, the
+// book control message for the first quote, then an order add, modify or
+// delete on each side with the bid at chanid and the ask at chanid + 1.
+// An empty price means the side is empty.
+inline bool ore_write_bbo(bbo_state_t &st, ore_writer_t *out, int64_t tm,
+                          int64_t offset, uint64_t seqno, string_view bidpx,
+                          string_view bidqt, string_view askpx,
+                          string_view askqt, bool skip, fmc_error_t **error) {
+  fmc_error_clear(error);
+  bool sides[2] = {bidpx.size() > 0, askpx.size() > 0};
+  bool had[2] = {st.bid, st.ask};
+  bool announce = !st.announced && (sides[0] || sides[1]);
+  st.announced |= announce;
+  st.bid = sides[0];
+  st.ask = sides[1];
+  if (skip)
+    return true;
+
+  int count = announce + (sides[0] || had[0]) + (sides[1] || had[1]);
+  if (announce) {
+    // ORE Book Control Message
+    // [13, receive, vendor offset, vendor seqno, batch, imnt id, uncross,
+    // command]
+    out->write((uint8_t)13, tm, offset, (uint64_t)0, (uint8_t)(--count > 0),
+               chanid, (uint8_t)0, 'C');
+  }
+  string_view pxs[2] = {bidpx, askpx};
+  string_view qts[2] = {bidqt, askqt};
+  for (int side = 0; side < 2; ++side) {
+    int32_t id = chanid + side;
+    if (sides[side] && had[side]) {
+      // ORE Order Modify Message
+      // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new id,
+      // new price, new qty]
+      out->write((uint8_t)6, tm, offset, seqno, (uint8_t)(--count > 0), chanid,
+                 id, id, pxs[side], qts[side]);
+    } else if (sides[side]) {
+      // ORE Order Add Message
+      // [1, receive, vendor offset, vendor seqno, batch, imnt id, id, price,
+      // qty, is bid]
+      out->write((uint8_t)1, tm, offset, seqno, (uint8_t)(--count > 0), chanid,
+                 id, pxs[side], qts[side], side == 0);
+    } else if (had[side]) {
+      // ORE Order Delete Message
+      // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
+      out->write((uint8_t)5, tm, offset, seqno, (uint8_t)(--count > 0), chanid,
+                 id);
+    }
+  }
+  return true;
+}
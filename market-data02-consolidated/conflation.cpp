@@ -0,0 +1,196 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/time.h>
+#include <ytp/data.h>
+
+#include "conflation.hpp"
+
+using namespace std;
+
+static constexpr string_view encoding = "Content-Type application/msgpack\n"
+                                        "Content-Schema ore1.1.3";
+
+conflation_t::conflation_t(ytp_yamal_t *in, ytp_yamal_t *out,
+                           conflation_cfg_t c, fmc_error_t **error)
+    : in(in), out(out), cfg(move(c)) {
+  fmc_error_clear(error);
+  RETURN_ERROR_UNLESS((cfg.interval > 0) != (cfg.min_interval > 0), error, ,
+                      "either the interval or the minimum interval must be "
+                      "set");
+  // conflated channels read back would be conflated again
+  RETURN_ERROR_UNLESS(in != out || !fmc::starts_with(cfg.prefix_out,
+                                                     cfg.prefix),
+                      error, , "output prefix", cfg.prefix_out,
+                      "is conflated again with prefix", cfg.prefix);
+  ore_filter_t filter;
+  filter.prefix = cfg.prefix;
+  books = make_unique<ore_books_t>(in, move(filter), error);
+  RETURN_ON_ERROR(error, , "could not create books");
+  streams = ytp_streams_new(out, error);
+  RETURN_ON_ERROR(error, , "could not create streams");
+}
+
+conflation_t::~conflation_t() {
+  fmc_error_t *error = nullptr;
+  if (streams)
+    ytp_streams_del(streams, &error);
+}
+
+size_t conflation_t::poll(fmc_error_t **error) {
+  auto count = books->poll(
+      [this, error](const ore_book_event_t &ev, const ore_book_t &book) {
+        on_bbo(ev, book, error);
+      },
+      [](const ore_book_event_t &, const ore_trade_t &) {}, error,
+      cfg.batch);
+  RETURN_ON_ERROR(error, count, "could not conflate ORE messages");
+  if (!count)
+    advance(fmc_cur_time_ns(), error);
+  return count;
+}
+
+void conflation_t::advance(int64_t now, fmc_error_t **error) {
+  fmc_error_clear(error);
+  clock = max(clock, now);
+  if (cfg.interval) {
+    if (clock < next_tick)
+      return;
+    next_tick = (clock / cfg.interval + 1) * cfg.interval;
+    for (auto idx : dirty) {
+      // entries changed back to what was written are not dirty anymore
+      if (entries[idx].dirty)
+        write(idx, error);
+      if (*error)
+        return;
+    }
+    dirty.clear();
+    return;
+  }
+  while (!pending.empty() && pending.top().first <= clock) {
+    auto idx = pending.top().second;
+    pending.pop();
+    if (entries[idx].dirty)
+      write(idx, error);
+    if (*error)
+      return;
+  }
+}
+
+void conflation_t::flush(fmc_error_t **error) {
+  fmc_error_clear(error);
+  for (uint32_t idx = 0; idx < entries.size() && !*error; ++idx) {
+    if (entries[idx].dirty)
+      write(idx, error);
+  }
+  dirty.clear();
+  pending = decltype(pending)();
+}
+
+conflation_t::entry_t *conflation_t::entry(const ore_book_event_t &ev,
+                                           fmc_error_t **error) {
+  auto [where, added] = index.try_emplace(ev.channel.data(), entries.size());
+  if (!added)
+    return &entries[where->second];
+  string channel = cfg.prefix_out;
+  channel.append(ev.channel.substr(cfg.prefix.size()));
+  auto stream = ytp_streams_announce(
+      streams, cfg.peer.size(), cfg.peer.data(), channel.size(),
+      channel.data(), encoding.size(), encoding.data(), error);
+  if (*error) {
+    index.erase(where);
+    RETURN_ON_ERROR(error, nullptr, "could not announce stream", channel);
+  }
+  auto &e = entries.emplace_back();
+  e.stream = stream;
+  return &e;
+}
+
+void conflation_t::on_bbo(const ore_book_event_t &ev, const ore_book_t &book,
+                          fmc_error_t **error) {
+  // changes due before this update are written with the state they had
+  advance(ev.receive, error);
+  if (*error)
+    return;
+  auto *e = entry(ev, error);
+  if (*error)
+    return;
+  ++updates;
+  e->bid = book.bid();
+  e->ask = book.ask();
+  e->receive = ev.receive;
+  e->vendor_offset = ev.vendor_offset;
+  e->vendor_seqno = ev.vendor_seqno;
+  if (e->bid == e->sent_bid && e->ask == e->sent_ask) {
+    e->dirty = false;
+    return;
+  }
+  if (e->dirty)
+    return;
+  e->dirty = true;
+  uint32_t idx = e - entries.data();
+  if (cfg.interval) {
+    dirty.push_back(idx);
+    return;
+  }
+  auto due = e->written ? e->written + cfg.min_interval : clock;
+  if (due <= clock)
+    write(idx, error);
+  else
+    pending.emplace(due, idx);
+}
+
+/*
+ * decimal string of a price or quantity, without exponent, with the fewest
+ * decimals that read back as the same value
+ */
+static string_view decimal(char (&buf)[64], double val) {
+  for (int prec = 0; prec <= 17; ++prec) {
+    auto sz = snprintf(buf, sizeof buf, "%.*f", prec, val);
+    if (sz > 0 && (size_t)sz < sizeof buf && strtod(buf, nullptr) == val)
+      return string_view(buf, sz);
+  }
+  auto sz = snprintf(buf, sizeof buf, "%.17g", val);
+  return string_view(buf, min<size_t>(sz, sizeof buf - 1));
+}
+
+void conflation_t::write(uint32_t idx, fmc_error_t **error) {
+  auto &e = entries[idx];
+  char bufs[4][64];
+  string_view bidpx, bidqt, askpx, askqt;
+  // a level without orders is an empty side
+  if (e.bid.orders) {
+    bidpx = decimal(bufs[0], e.bid.px);
+    bidqt = decimal(bufs[1], e.bid.qty);
+  }
+  if (e.ask.orders) {
+    askpx = decimal(bufs[2], e.ask.px);
+    askqt = decimal(bufs[3], e.ask.qty);
+  }
+  writer.reset();
+  ore_write_bbo(e.st, &writer, e.receive, e.vendor_offset, e.vendor_seqno,
+                bidpx, bidqt, askpx, askqt, false, error);
+  RETURN_ON_ERROR(error, , "could not encode conflated update");
+  e.dirty = false;
+  e.sent_bid = e.bid;
+  e.sent_ask = e.ask;
+  e.written = clock;
+  if (!writer.size())
+    return;
+  auto dst = ytp_data_reserve(out, writer.size(), error);
+  RETURN_ON_ERROR(error, , "could not reserve message");
+  writer.encode(dst);
+  ytp_data_commit(out, fmc_cur_time_ns(), e.stream, dst, error);
+  RETURN_ON_ERROR(error, , "could not commit message");
+  ++writes;
+}
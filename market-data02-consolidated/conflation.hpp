@@ -0,0 +1,107 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmc/error.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+#include "common.hpp"
+#include "ore-book.hpp"
+#include "ore-writer.hpp"
+
+struct conflation_cfg_t {
+  std::string peer = "conflation";
+  std::string prefix = "ore/";           /* ORE channels conflated */
+  std::string prefix_out = "conflated/"; /* replaces prefix on output */
+  int64_t interval = 100000000LL; /* timer period, 0 to use min_interval */
+  int64_t min_interval = 0;       /* per instrument period */
+  size_t batch = 4096;            /* yamal messages read per poll */
+};
+
+/*
+ * Conflates the top of the book of the ORE channels of a yamal file into
+ * ORE channels of an output yamal, which may be the same file, with
+ * conflated/VENUE/SECURITY for ore/VENUE/SECURITY. The output is written
+ * like the bookTicker updates of the feed parser, the book control message
+ * first, then an order on each side of the book, so any ORE reader builds
+ * the conflated top of the book. Trades are not conflated, and channels
+ * are expected to carry one instrument each, as the feed parser writes.
+ *
+ * The latest top of the book of every instrument is kept in a dense array,
+ * and only the instruments whose top changed since they were last written
+ * are written again:
+ *  - with an interval, the changes are written at every multiple of the
+ *    interval,
+ *  - with a minimum interval, a change is written at once if the previous
+ *    write of the instrument is older than the minimum interval, or when
+ *    it gets that old otherwise.
+ * The clock is the receive time of the ORE messages, so catching up with
+ * a file gives the same output as following it live, and the current time
+ * while there are no new messages, so the last changes are written.
+ */
+struct conflation_t {
+  conflation_t(ytp_yamal_t *in, ytp_yamal_t *out, conflation_cfg_t cfg,
+               fmc_error_t **error);
+  ~conflation_t();
+
+  /* applies new ORE messages, returns the number of yamal messages read */
+  size_t poll(fmc_error_t **error);
+  /* moves the clock to now, writing the changes due */
+  void advance(int64_t now, fmc_error_t **error);
+  /* writes every pending change */
+  void flush(fmc_error_t **error);
+
+  struct entry_t {
+    ytp_mmnode_offs stream = 0;
+    bbo_state_t st;
+    ore_level_t bid; /* latest */
+    ore_level_t ask;
+    ore_level_t sent_bid; /* last written */
+    ore_level_t sent_ask;
+    int64_t receive = 0;
+    int64_t vendor_offset = 0;
+    uint64_t vendor_seqno = 0;
+    int64_t written = 0; /* clock of the last write, 0 if never */
+    bool dirty = false;
+  };
+
+  void on_bbo(const ore_book_event_t &ev, const ore_book_t &book,
+              fmc_error_t **error);
+  entry_t *entry(const ore_book_event_t &ev, fmc_error_t **error);
+  void write(uint32_t idx, fmc_error_t **error);
+
+  ytp_yamal_t *in = nullptr;
+  ytp_yamal_t *out = nullptr;
+  ytp_streams_t *streams = nullptr;
+  conflation_cfg_t cfg;
+  std::unique_ptr<ore_books_t> books;
+  std::vector<entry_t> entries;
+  /* entry of a channel view, the views of ore_books_t are stable */
+  std::unordered_map<const char *, uint32_t> index;
+  int64_t clock = 0;
+  /* interval mode, entries changed and the next multiple of interval */
+  std::vector<uint32_t> dirty;
+  int64_t next_tick = 0;
+  /* minimum interval mode, entries by the time they are due */
+  using due_t = std::pair<int64_t, uint32_t>;
+  std::priority_queue<due_t, std::vector<due_t>, std::greater<due_t>> pending;
+  ore_writer_t writer;
+
+  uint64_t updates = 0; /* top of the book changes read */
+  uint64_t writes = 0;  /* top of the book updates written */
+};
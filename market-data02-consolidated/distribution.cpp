@@ -0,0 +1,953 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <memory>
+#include <string>
+
+#include "conflation.hpp"
+#include "kafka-sink.hpp"
+#include "mcast-publisher.hpp"
+#include "splitter.hpp"
+#include "tcp-distributor.hpp"
+#include "ws-server.hpp"
+#include <fmc++/error.hpp>
+#include <fmc/component.h>
+#include <fmc/files.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+
+extern struct fmc_reactor_api_v1 *_reactor;
+
+// Yamal file of a distribution component
+struct distribution_file_t {
+  fmc_fd fd = -1;
+  ytp_yamal_t *yamal = nullptr;
+
+  ~distribution_file_t() {
+    fmc_error_t *error = nullptr;
+    if (yamal)
+      ytp_yamal_del(yamal, &error);
+    if (fd != -1)
+      fmc_fclose(fd, &error);
+  }
+  void open(struct fmc_cfg_sect_item *cfg, fmc_error_t **error,
+            const char *key = "ytp-file") {
+    auto *name = fmc_cfg_sect_item_get(cfg, key)->node.value.str;
+    fd = fmc_fopen(name, fmc_fmode::READWRITE, error);
+    RETURN_ON_ERROR(error, , "could not open yamal file", name);
+    yamal = ytp_yamal_new(fd, error);
+    RETURN_ON_ERROR(error, , "could not create yamal");
+  }
+};
+
+struct tcp_distributor_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  unique_ptr<tcp_distributor_t> dist;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    tcp_distributor_cfg_t dcfg;
+    dcfg.port = fmc_cfg_sect_item_get(cfg, "port")->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "address"); item)
+      dcfg.address = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "max-lag"); item) {
+      RETURN_ERROR_UNLESS(item->node.value.int64 > 0, error, ,
+                          "max-lag must be positive");
+      dcfg.max_lag = item->node.value.int64;
+    }
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "batch"); item) {
+      RETURN_ERROR_UNLESS(item->node.value.int64 > 0, error, ,
+                          "batch must be positive");
+      dcfg.batch = item->node.value.int64;
+    }
+    dist = make_unique<tcp_distributor_t>(file.yamal, move(dcfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    dist->poll(error);
+    return !*error;
+  }
+};
+
+struct tcp_receiver_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  unique_ptr<tcp_receiver_t> recv;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    tcp_receiver_cfg_t rcfg;
+    rcfg.address = fmc_cfg_sect_item_get(cfg, "address")->node.value.str;
+    rcfg.port = fmc_cfg_sect_item_get(cfg, "port")->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "from"); item)
+      rcfg.from = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "channels"); item) {
+      for (auto *ch = item->node.value.arr; ch; ch = ch->next)
+        rcfg.prefixes.push_back(ch->item.value.str);
+    }
+    recv = make_unique<tcp_receiver_t>(file.yamal, move(rcfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    recv->poll(error);
+    return !*error;
+  }
+};
+
+struct mcast_publisher_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  unique_ptr<mcast_publisher_t> pub;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    mcast_publisher_cfg_t pcfg;
+    pcfg.address = fmc_cfg_sect_item_get(cfg, "address")->node.value.str;
+    pcfg.port = fmc_cfg_sect_item_get(cfg, "port")->node.value.int64;
+    pcfg.gap_port = fmc_cfg_sect_item_get(cfg, "gap-port")->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "interface"); item)
+      pcfg.interface = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "gap-address"); item)
+      pcfg.gap_address = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "ttl"); item)
+      pcfg.ttl = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "packet"); item)
+      pcfg.packet = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "history"); item) {
+      RETURN_ERROR_UNLESS(item->node.value.int64 > 0, error, ,
+                          "history must be positive");
+      pcfg.history = item->node.value.int64;
+    }
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "from"); item)
+      pcfg.from = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "channels"); item) {
+      for (auto *ch = item->node.value.arr; ch; ch = ch->next)
+        pcfg.prefixes.push_back(ch->item.value.str);
+    }
+    pub = make_unique<mcast_publisher_t>(file.yamal, move(pcfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    pub->poll(error);
+    return !*error;
+  }
+};
+
+struct mcast_receiver_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  unique_ptr<mcast_receiver_t> recv;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    mcast_receiver_cfg_t rcfg;
+    rcfg.address = fmc_cfg_sect_item_get(cfg, "address")->node.value.str;
+    rcfg.port = fmc_cfg_sect_item_get(cfg, "port")->node.value.int64;
+    rcfg.gap_address =
+        fmc_cfg_sect_item_get(cfg, "gap-address")->node.value.str;
+    rcfg.gap_port = fmc_cfg_sect_item_get(cfg, "gap-port")->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "interface"); item)
+      rcfg.interface = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "rcvbuf"); item)
+      rcfg.rcvbuf = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "retry"); item)
+      rcfg.retry = item->node.value.int64 * 1000000LL;
+    recv = make_unique<mcast_receiver_t>(file.yamal, move(rcfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    recv->poll(error);
+    return !*error;
+  }
+};
+
+struct kafka_sink_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  unique_ptr<kafka_sink_t> sink;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    kafka_sink_cfg_t kcfg;
+    kcfg.peer = fmc_cfg_sect_item_get(cfg, "peer")->node.value.str;
+    kcfg.address = fmc_cfg_sect_item_get(cfg, "address")->node.value.str;
+    kcfg.port = fmc_cfg_sect_item_get(cfg, "port")->node.value.int64;
+    kcfg.topic = fmc_cfg_sect_item_get(cfg, "topic")->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "partitions"); item)
+      kcfg.partitions = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "acks"); item)
+      kcfg.acks = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "compression"); item) {
+      RETURN_ERROR_UNLESS(
+          kafka_compression_parse(item->node.value.str, &kcfg.compression),
+          error, , "compression must be none or gzip");
+    }
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "batch"); item)
+      kcfg.batch = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "linger"); item)
+      kcfg.linger = item->node.value.int64 * 1000000LL;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "buffer"); item)
+      kcfg.buffer = item->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "from"); item)
+      kcfg.from = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "channels"); item) {
+      for (auto *ch = item->node.value.arr; ch; ch = ch->next)
+        kcfg.prefixes.push_back(ch->item.value.str);
+    }
+    sink = make_unique<kafka_sink_t>(file.yamal, move(kcfg), error);
+    if (*error)
+      return;
+    sink->start();
+  }
+  bool process_one(fmc_error_t **error) {
+    // the sink runs on its own thread, only its failure is reported here
+    string msg;
+    RETURN_ERROR_UNLESS(!sink->failed(&msg), error, false, msg);
+    return true;
+  }
+};
+
+struct ws_server_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  unique_ptr<ws_server_t> server;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    ws_server_cfg_t wcfg;
+    wcfg.port = fmc_cfg_sect_item_get(cfg, "port")->node.value.int64;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "address"); item)
+      wcfg.address = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "prefix"); item)
+      wcfg.prefix = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "interval"); item)
+      wcfg.interval = item->node.value.int64 * 1000000LL;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "min-interval"); item)
+      wcfg.min_interval = item->node.value.int64 * 1000000LL;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "max-queued"); item)
+      wcfg.max_queued = item->node.value.int64;
+    server = make_unique<ws_server_t>(file.yamal, move(wcfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    server->poll(error);
+    return !*error;
+  }
+};
+
+struct conflation_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  distribution_file_t output; /* not opened if written to file */
+  unique_ptr<conflation_t> conflation;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    auto *out = file.yamal;
+    if (fmc_cfg_sect_item_get(cfg, "output-ytp-file")) {
+      output.open(cfg, error, "output-ytp-file");
+      if (*error)
+        return;
+      out = output.yamal;
+    }
+    conflation_cfg_t ccfg;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "peer"); item)
+      ccfg.peer = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "prefix"); item)
+      ccfg.prefix = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "output-prefix"); item)
+      ccfg.prefix_out = item->node.value.str;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "min-interval"); item) {
+      ccfg.min_interval = item->node.value.int64 * 1000000LL;
+      ccfg.interval = 0;
+    }
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "interval"); item)
+      ccfg.interval = item->node.value.int64 * 1000000LL;
+    conflation = make_unique<conflation_t>(file.yamal, out, move(ccfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    conflation->poll(error);
+    return !*error;
+  }
+};
+
+struct splitter_comp_t {
+  fmc_component_HEAD;
+  distribution_file_t file;
+  vector<unique_ptr<distribution_file_t>> outputs;
+  unique_ptr<splitter_t> splitter;
+
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
+    file.open(cfg, error);
+    if (*error)
+      return;
+    splitter_cfg_t scfg;
+    if (auto *item = fmc_cfg_sect_item_get(cfg, "from"); item)
+      scfg.from = item->node.value.str;
+    auto *outs = fmc_cfg_sect_item_get(cfg, "outputs")->node.value.arr;
+    for (auto *out = outs; out; out = out->next) {
+      auto *sect = out->item.value.sect;
+      auto &f = outputs.emplace_back(make_unique<distribution_file_t>());
+      f->open(sect, error);
+      if (*error)
+        return;
+      auto &ocfg = scfg.outputs.emplace_back();
+      ocfg.yamal = f->yamal;
+      if (auto *item = fmc_cfg_sect_item_get(sect, "channels"); item) {
+        for (auto *ch = item->node.value.arr; ch; ch = ch->next)
+          ocfg.channels.push_back(ch->item.value.str);
+      }
+    }
+    splitter = make_unique<splitter_t>(file.yamal, move(scfg), error);
+  }
+  bool process_one(fmc_error_t **error) {
+    splitter->poll(error);
+    return !*error;
+  }
+};
+
+template <class Comp>
+static void distribution_process_one(struct fmc_component *self,
+                                     struct fmc_reactor_ctx *ctx,
+                                     fmc_time64_t now) noexcept {
+  auto *comp = (Comp *)self;
+  try {
+    fmc_error_t *error = nullptr;
+    if (comp->process_one(&error)) {
+      _reactor->queue(ctx);
+    } else {
+      _reactor->set_error(ctx, "%s", fmc_error_msg(error));
+    }
+  } catch (std::exception &e) {
+    _reactor->set_error(ctx, "%s", e.what());
+  }
+}
+
+template <class Comp>
+static Comp *distribution_new(struct fmc_cfg_sect_item *cfg,
+                              struct fmc_reactor_ctx *ctx) noexcept {
+  fmc_error_t *error = nullptr;
+  auto *comp = new Comp();
+  comp->init(cfg, &error);
+  if (error) {
+    _reactor->set_error(ctx, "%s", fmc_error_msg(error));
+    delete comp;
+    return nullptr;
+  }
+  _reactor->on_exec(ctx, distribution_process_one<Comp>);
+  _reactor->queue(ctx);
+  return comp;
+}
+
+struct tcp_distributor_comp_t *
+tcp_distributor_component_new(struct fmc_cfg_sect_item *cfg,
+                              struct fmc_reactor_ctx *ctx,
+                              char **inp_tps) noexcept {
+  return distribution_new<tcp_distributor_comp_t>(cfg, ctx);
+}
+
+void tcp_distributor_component_del(
+    struct tcp_distributor_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct tcp_receiver_comp_t *
+tcp_receiver_component_new(struct fmc_cfg_sect_item *cfg,
+                           struct fmc_reactor_ctx *ctx,
+                           char **inp_tps) noexcept {
+  return distribution_new<tcp_receiver_comp_t>(cfg, ctx);
+}
+
+void tcp_receiver_component_del(struct tcp_receiver_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct mcast_publisher_comp_t *
+mcast_publisher_component_new(struct fmc_cfg_sect_item *cfg,
+                              struct fmc_reactor_ctx *ctx,
+                              char **inp_tps) noexcept {
+  return distribution_new<mcast_publisher_comp_t>(cfg, ctx);
+}
+
+void mcast_publisher_component_del(
+    struct mcast_publisher_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct mcast_receiver_comp_t *
+mcast_receiver_component_new(struct fmc_cfg_sect_item *cfg,
+                             struct fmc_reactor_ctx *ctx,
+                             char **inp_tps) noexcept {
+  return distribution_new<mcast_receiver_comp_t>(cfg, ctx);
+}
+
+void mcast_receiver_component_del(
+    struct mcast_receiver_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct kafka_sink_comp_t *
+kafka_sink_component_new(struct fmc_cfg_sect_item *cfg,
+                         struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept {
+  return distribution_new<kafka_sink_comp_t>(cfg, ctx);
+}
+
+void kafka_sink_component_del(struct kafka_sink_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct ws_server_comp_t *
+ws_server_component_new(struct fmc_cfg_sect_item *cfg,
+                        struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept {
+  return distribution_new<ws_server_comp_t>(cfg, ctx);
+}
+
+void ws_server_component_del(struct ws_server_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct conflation_comp_t *
+conflation_component_new(struct fmc_cfg_sect_item *cfg,
+                         struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept {
+  return distribution_new<conflation_comp_t>(cfg, ctx);
+}
+
+void conflation_component_del(struct conflation_comp_t *comp) noexcept {
+  delete comp;
+}
+
+struct splitter_comp_t *
+splitter_component_new(struct fmc_cfg_sect_item *cfg,
+                       struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept {
+  return distribution_new<splitter_comp_t>(cfg, ctx);
+}
+
+void splitter_component_del(struct splitter_comp_t *comp) noexcept {
+  delete comp;
+}
+
+static struct fmc_cfg_type distribution_channel_spec = {
+    .type = FMC_CFG_STR,
+};
+
+struct fmc_cfg_node_spec tcp_distributor_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file to distribute",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "port",
+     .descr = "TCP port to listen on for subscribers",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "address",
+     .descr = "Address to listen on, 0.0.0.0 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "max-lag",
+     .descr = "Bytes of the file a subscriber may be behind while falling "
+              "further behind before it is disconnected, 64MB by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "batch",
+     .descr = "Bytes of the file sent to a subscriber at most at a time, "
+              "256KB by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec tcp_receiver_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file written with the data received",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "address",
+     .descr = "Address of the distributor",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "port",
+     .descr = "Port of the distributor",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "from",
+     .descr = "start to receive the whole file, end for new data only, "
+              "start by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "channels",
+     .descr = "Prefixes of the channels to receive, all by default",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &distribution_channel_spec,
+              }}},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec mcast_publisher_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file to publish",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "address",
+     .descr = "Multicast group to publish on",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "port",
+     .descr = "UDP port of the multicast group",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "gap-port",
+     .descr = "UDP port to serve gap fill requests on",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "gap-address",
+     .descr = "Address to serve gap fill requests on, 0.0.0.0 by "
+              "default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "interface",
+     .descr = "Address of the interface to publish on, the default "
+              "route by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "ttl",
+     .descr = "Multicast TTL, 1 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "packet",
+     .descr = "Largest datagram in bytes, 1472 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "history",
+     .descr = "Packets kept for gap fill, 1048576 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "from",
+     .descr = "start to publish the whole file, end for new data only, "
+              "end by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "channels",
+     .descr = "Prefixes of the channels to publish, all by default",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &distribution_channel_spec,
+              }}},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec mcast_receiver_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file written with the data received",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "address",
+     .descr = "Multicast group to join",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "port",
+     .descr = "UDP port of the multicast group",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "gap-address",
+     .descr = "Address of the gap fill server of the publisher",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "gap-port",
+     .descr = "Port of the gap fill server of the publisher",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "interface",
+     .descr = "Address of the interface to join on, the default "
+              "route by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "rcvbuf",
+     .descr = "SO_RCVBUF of the sockets in bytes",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "retry",
+     .descr = "Milliseconds before a gap fill request is sent again, 20 "
+              "by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec kafka_sink_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file to produce, also where the metrics are "
+              "published",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "peer",
+     .descr = "Peer of the metrics stream",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "address",
+     .descr = "Address of the broker, leader of every partition",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "port",
+     .descr = "Port of the broker",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "topic",
+     .descr = "Topic to produce to",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "partitions",
+     .descr = "Partitions of the topic, 1 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "acks",
+     .descr = "1 for the leader acknowledgement, -1 for all replicas, 1 "
+              "by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "compression",
+     .descr = "none or gzip, gzip by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "batch",
+     .descr = "Record bytes of a batch, 262144 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "linger",
+     .descr = "Milliseconds a batch waits to fill, 5 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "buffer",
+     .descr = "Record bytes read and not acknowledged at most, 64MB by "
+              "default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "from",
+     .descr = "start to produce the whole file, end for new data only, "
+              "start by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "channels",
+     .descr = "Prefixes of the channels to produce, all by default",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &distribution_channel_spec,
+              }}},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec ws_server_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file with the ORE channels to serve",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "port",
+     .descr = "Port to listen on for websocket clients",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "address",
+     .descr = "Interface name or address to listen on, all by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "prefix",
+     .descr = "Prefix of the ORE channels served, ore/ by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "interval",
+     .descr = "Milliseconds between the updates of a client, 100 by "
+              "default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "min-interval",
+     .descr = "Shortest interval a client may ask for in milliseconds, 10 "
+              "by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "max-queued",
+     .descr = "Bytes the socket of a client may hold for a new update to "
+              "be sent, 65536 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec conflation_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file with the ORE channels to conflate",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "output-ytp-file",
+     .descr = "Yamal file written with the conflated channels, ytp-file by "
+              "default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "peer",
+     .descr = "Peer of the conflated streams, conflation by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "prefix",
+     .descr = "Prefix of the ORE channels conflated, ore/ by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "output-prefix",
+     .descr = "Prefix replacing prefix in the conflated channels, "
+              "conflated/ by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "interval",
+     .descr = "Milliseconds between the writes of the changed instruments, "
+              "100 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "min-interval",
+     .descr = "Milliseconds between the writes of an instrument, written "
+              "as soon as it changes otherwise, instead of interval",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {NULL},
+};
+
+static struct fmc_cfg_node_spec splitter_output_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file written with the channels of the output",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "channels",
+     .descr = "Channel prefixes or glob patterns written, all by default",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &distribution_channel_spec,
+              }}},
+    {NULL},
+};
+
+static struct fmc_cfg_type splitter_output_spec = {
+    .type = FMC_CFG_SECT,
+    .spec{
+        .node = splitter_output_cfgspec,
+    },
+};
+
+struct fmc_cfg_node_spec splitter_cfgspec[] = {
+    {.key = "ytp-file",
+     .descr = "Yamal file to split",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "from",
+     .descr = "start to split the whole file, end for new data only, start "
+              "by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "outputs",
+     .descr = "Files written, each with the channels it selects",
+     .required = true,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &splitter_output_spec,
+              }}},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec *tcp_distributor_cfg = tcp_distributor_cfgspec;
+struct fmc_cfg_node_spec *tcp_receiver_cfg = tcp_receiver_cfgspec;
+struct fmc_cfg_node_spec *mcast_publisher_cfg = mcast_publisher_cfgspec;
+struct fmc_cfg_node_spec *mcast_receiver_cfg = mcast_receiver_cfgspec;
+struct fmc_cfg_node_spec *kafka_sink_cfg = kafka_sink_cfgspec;
+struct fmc_cfg_node_spec *ws_server_cfg = ws_server_cfgspec;
+struct fmc_cfg_node_spec *conflation_cfg = conflation_cfgspec;
+struct fmc_cfg_node_spec *splitter_cfg = splitter_cfgspec;
+
+size_t tcp_distributor_struct_sz = sizeof(struct tcp_distributor_comp_t);
+size_t tcp_receiver_struct_sz = sizeof(struct tcp_receiver_comp_t);
+size_t mcast_publisher_struct_sz = sizeof(struct mcast_publisher_comp_t);
+size_t mcast_receiver_struct_sz = sizeof(struct mcast_receiver_comp_t);
+size_t kafka_sink_struct_sz = sizeof(struct kafka_sink_comp_t);
+size_t ws_server_struct_sz = sizeof(struct ws_server_comp_t);
+size_t conflation_struct_sz = sizeof(struct conflation_comp_t);
+size_t splitter_struct_sz = sizeof(struct splitter_comp_t);
@@ -0,0 +1,867 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/time.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+
+#include "feed-engine.hpp"
+
+/*
+ * Venues limit the rate of client messages, Binance to 5 per second, the
+ * subscription changes are sent at most twice per check
+ */
+static const lws_usec_t subscription_period = 500 * LWS_US_PER_MS;
+
+#if defined(LWS_WITH_MBEDTLS) || defined(USE_WOLFSSL)
+/*
+ * OpenSSL uses the system trust store.  mbedTLS / WolfSSL have to be told which
+ * CA to trust explicitly.
+ */
+static const char *const ca_pem_digicert_global_root =
+    "-----BEGIN CERTIFICATE-----\n"
+    "MIIDrzCCApegAwIBAgIQCDvgVpBCRrGhdWrJWZHHSjANBgkqhkiG9w0BAQUFADBh\n"
+    "MQswCQYDVQQGEwJVUzEVMBMGA1UEChMMRGlnaUNlcnQgSW5jMRkwFwYDVQQLExB3\n"
+    "d3cuZGlnaWNlcnQuY29tMSAwHgYDVQQDExdEaWdpQ2VydCBHbG9iYWwgUm9vdCBD\n"
+    "QTAeFw0wNjExMTAwMDAwMDBaFw0zMTExMTAwMDAwMDBaMGExCzAJBgNVBAYTAlVT\n"
+    "MRUwEwYDVQQKEwxEaWdpQ2VydCBJbmMxGTAXBgNVBAsTEHd3dy5kaWdpY2VydC5j\n"
+    "b20xIDAeBgNVBAMTF0RpZ2lDZXJ0IEdsb2JhbCBSb290IENBMIIBIjANBgkqhkiG\n"
+    "9w0BAQEFAAOCAQ8AMIIBCgKCAQEA4jvhEXLeqKTTo1eqUKKPC3eQyaKl7hLOllsB\n"
+    "CSDMAZOnTjC3U/dDxGkAV53ijSLdhwZAAIEJzs4bg7/fzTtxRuLWZscFs3YnFo97\n"
+    "nh6Vfe63SKMI2tavegw5BmV/Sl0fvBf4q77uKNd0f3p4mVmFaG5cIzJLv07A6Fpt\n"
+    "43C/dxC//AH2hdmoRBBYMql1GNXRor5H4idq9Joz+EkIYIvUX7Q6hL+hqkpMfT7P\n"
+    "T19sdl6gSzeRntwi5m3OFBqOasv+zbMUZBfHWymeMr/y7vrTC0LUq7dBMtoM1O/4\n"
+    "gdW7jVg/tRvoSSiicNoxBN33shbyTApOB6jtSj1etX+jkMOvJwIDAQABo2MwYTAO\n"
+    "BgNVHQ8BAf8EBAMCAYYwDwYDVR0TAQH/BAUwAwEB/zAdBgNVHQ4EFgQUA95QNVbR\n"
+    "TLtm8KPiGxvDl7I90VUwHwYDVR0jBBgwFoAUA95QNVbRTLtm8KPiGxvDl7I90VUw\n"
+    "DQYJKoZIhvcNAQEFBQADggEBAMucN6pIExIK+t1EnE9SsPTfrgT1eXkIoyQY/Esr\n"
+    "hMAtudXH/vTBH1jLuG2cenTnmCmrEbXjcKChzUyImZOMkXDiqw8cvpOp/2PV5Adg\n"
+    "06O/nVsJ8dWO41P0jmP6P6fbtGbfYmbW0W5BjfIttep3Sp+dWOIrWcBAI+0tKIJF\n"
+    "PnlUkiaY4IBIqDfv8NZ5YBberOgOzW6sRBc4L0na4UU+Krk2U886UAb3LujEV0ls\n"
+    "YSEY1QSteDwsOoBrp+uvFRTp2InBuThs4pFsiv9kuXclVzDAGySj4dzp30d8tbQk\n"
+    "CAUw7C29C79Fv1C5qfPrmAESrciIxpg0X40KPMbp1ZWVbd4=\n"
+    "-----END CERTIFICATE-----\n";
+#endif
+
+/*
+ * The retry and backoff policy we want to use for our client connections
+ */
+
+static const uint32_t backoff_ms[] = {1000, 2000, 3000, 4000, 5000};
+
+static const lws_retry_bo_t retry = {
+    .retry_ms_table = backoff_ms,
+    .retry_ms_table_count = LWS_ARRAY_SIZE(backoff_ms),
+    .conceal_count = LWS_ARRAY_SIZE(backoff_ms),
+
+    .secs_since_valid_ping = 400,   /* force PINGs after secs idle */
+    .secs_since_valid_hangup = 400, /* hangup after secs idle */
+
+    .jitter_percent = 0,
+};
+
+/*
+ * If we don't enable permessage-deflate ws extension, during times when there
+ * are many ws messages per second the server coalesces them inside a smaller
+ * number of larger ssl records, for >100 mps typically >2048 records.
+ *
+ * This is a problem, because the coalesced record cannot be send nor decrypted
+ * until the last part of the record is received, meaning additional latency
+ * for the earlier members of the coalesced record that have just been sitting
+ * there waiting for the last one to go out and be decrypted.
+ *
+ * permessage-deflate reduces the data size before the tls layer, for >100mps
+ * reducing the colesced records to ~1.2KB.
+ *
+ * The price is inflating every message. When the server keeps its
+ * compression context across messages, later messages refer to earlier
+ * ones and compress better, without it each message starts from an empty
+ * dictionary. A smaller server window lowers the inflate memory and cache
+ * footprint at some compression cost. feed-perf --bench deflate measures
+ * both sides of the tradeoff on recorded messages, the offer is built from
+ * the engine configuration.
+ */
+static std::string deflate_offer(const feed_engine_cfg_t &cfg) {
+  std::string offer = "permessage-deflate";
+  if (!cfg.client_context_takeover)
+    offer.append("; client_no_context_takeover");
+  if (!cfg.server_context_takeover)
+    offer.append("; server_no_context_takeover");
+  offer.append("; client_max_window_bits");
+  if (cfg.server_window_bits) {
+    offer.append("; server_max_window_bits=");
+    offer.append(std::to_string(cfg.server_window_bits));
+  }
+  return offer;
+}
+
+/*
+ * Announces the streams of a security. Announcing an existing stream
+ * returns the original announcement, so this is safe to repeat.
+ */
+static void announce(feed_engine_t *eng, const std::string &sec,
+                     fmc_error_t **error) {
+  std::string_view encoding = eng->venue.encoding;
+  auto &prefix = eng->cfg.prefix;
+  auto &vpeer = eng->cfg.peer;
+  for (auto *tp : eng->venue.types) {
+    std::string chstr = prefix + sec + "@" + tp;
+    auto stream = ytp_streams_announce(
+        eng->ystreams, vpeer.size(), vpeer.data(), chstr.size(), chstr.data(),
+        encoding.size(), encoding.data(), error);
+    RETURN_ON_ERROR(error, , "could not announce stream", chstr);
+    uint64_t seqno;
+    size_t psz;
+    const char *peer;
+    size_t csz;
+    const char *channel;
+    size_t esz;
+    const char *encoding;
+    ytp_mmnode_offs *original;
+    ytp_mmnode_offs *subscribed;
+
+    ytp_announcement_lookup(eng->yamal, stream, &seqno, &psz, &peer, &csz,
+                            &channel, &esz, &encoding, &original, &subscribed,
+                            error);
+    RETURN_ON_ERROR(error, , "could not look up stream", chstr);
+    // the key views the announcement, it is valid while the file is mapped
+    auto sv = std::string_view(channel, csz).substr(prefix.size());
+    eng->streams.emplace(
+        std::make_pair(sv.substr(0, sec.size()), sv.substr(sec.size() + 1)),
+        stream);
+  }
+}
+
+/*
+ * Modification time of a file, the field is named differently on macOS
+ */
+static struct timespec stat_mtime(const struct stat &st) {
+#ifdef __APPLE__
+  return st.st_mtimespec;
+#else
+  return st.st_mtim;
+#endif
+}
+
+/*
+ * Reloads the securities file when its modification time changes
+ */
+static void check_securities(feed_engine_t *eng) {
+  struct stat st;
+  if (eng->cfg.securities.empty() || stat(eng->cfg.securities.c_str(), &st))
+    return;
+  auto mtime = stat_mtime(st);
+  if (mtime.tv_sec == eng->secmtime.tv_sec &&
+      mtime.tv_nsec == eng->secmtime.tv_nsec)
+    return;
+  eng->secmtime = mtime;
+  lwsl_user("%s: reloading %s\n", __func__, eng->cfg.securities.c_str());
+  fmc_error_t *error = nullptr;
+  eng->load_securities(&error);
+  if (error)
+    lwsl_err("%s: %s\n", __func__, fmc_error_msg(error));
+}
+
+/*
+ * Applies the commands published on the control channel of the control
+ * file, one command per message:
+ *   subscribe SEC [SEC...]
+ *   unsubscribe SEC [SEC...]
+ *   reload
+ */
+static void check_control(feed_engine_t *eng, fmc_error_t **error) {
+  using namespace std;
+  fmc_error_clear(error);
+  if (eng->cfg.control.empty())
+    return;
+  for (; !ytp_yamal_term(eng->ctlit);
+       eng->ctlit = ytp_yamal_next(eng->ctl_yamal, eng->ctlit, error)) {
+    RETURN_ON_ERROR(error, , "could not obtain next iterator");
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(eng->ctl_yamal, eng->ctlit, &seqno, &ts, &stream, &sz,
+                  &data, error);
+    RETURN_ON_ERROR(error, , "could not read control channel");
+    auto where = eng->ctlstreams.find(stream);
+    if (where == eng->ctlstreams.end()) {
+      size_t psz, csz, esz;
+      const char *peer, *channel, *encoding;
+      ytp_mmnode_offs *original, *subscribed;
+      ytp_announcement_lookup(eng->ctl_yamal, stream, &seqno, &psz, &peer,
+                              &csz, &channel, &esz, &encoding, &original,
+                              &subscribed, error);
+      RETURN_ON_ERROR(error, , "could not look up stream announcement");
+      where =
+          eng->ctlstreams
+              .emplace(stream, string_view(channel, csz) == eng->cfg.control)
+              .first;
+    }
+    if (!where->second)
+      continue;
+    istringstream cmd{string(data, sz)};
+    string op;
+    cmd >> op;
+    lwsl_user("%s: %.*s\n", __func__, (int)sz, data);
+    fmc_error_t *cmderr = nullptr;
+    if (op == "subscribe") {
+      for (string sec; !cmderr && cmd >> sec;)
+        eng->subscribe(sec, &cmderr);
+    } else if (op == "unsubscribe") {
+      for (string sec; cmd >> sec;)
+        eng->unsubscribe(sec);
+    } else if (op == "reload") {
+      eng->load_securities(&cmderr);
+    } else {
+      lwsl_err("%s: unknown command %s\n", __func__, op.c_str());
+    }
+    if (cmderr)
+      lwsl_err("%s: %s\n", __func__, fmc_error_msg(cmderr));
+  }
+}
+
+/*
+ * Queues the requests that bring the connection subscriptions in line with
+ * the desired securities, they are sent once the connection is writable
+ */
+static void sync_subscriptions(feed_engine_t *eng) {
+  using namespace std;
+  if (!eng->established || eng->desired == eng->subscribed)
+    return;
+  vector<string> added;
+  vector<string> removed;
+  set_difference(eng->desired.begin(), eng->desired.end(),
+                 eng->subscribed.begin(), eng->subscribed.end(),
+                 back_inserter(added));
+  set_difference(eng->subscribed.begin(), eng->subscribed.end(),
+                 eng->desired.begin(), eng->desired.end(),
+                 back_inserter(removed));
+  if (!removed.empty())
+    eng->venue.request(false, removed, &eng->request_id, eng->requests);
+  if (!added.empty())
+    eng->venue.request(true, added, &eng->request_id, eng->requests);
+  eng->subscribed = eng->desired;
+  lws_callback_on_writable(eng->wsi);
+}
+
+static void sul_sub_cb(lws_sorted_usec_list_t *sul) {
+  feed_engine_t *eng = lws_container_of(sul, feed_engine_t, sul_sub);
+
+  lws_sul_schedule(eng->context, 0, &eng->sul_sub, sul_sub_cb,
+                   subscription_period);
+
+  check_securities(eng);
+  fmc_error_t *error = nullptr;
+  check_control(eng, &error);
+  if (error)
+    lwsl_err("%s: %s\n", __func__, fmc_error_msg(error));
+  sync_subscriptions(eng);
+}
+
+/*
+ * Scheduled sul callback that starts the connection attempt
+ */
+
+static void connect_client(lws_sorted_usec_list_t *sul) {
+  feed_engine_t *eng = lws_container_of(sul, feed_engine_t, sul);
+  struct lws_client_connect_info i;
+
+  /*
+   * A new connection subscribes to every desired stream in the path or
+   * with requests once established, requests queued for the previous
+   * connection are obsolete
+   */
+  eng->path = eng->streams_path();
+  eng->subscribed.clear();
+  if (eng->venue.path_subscribes)
+    eng->subscribed = eng->desired;
+  eng->requests.clear();
+
+  memset(&i, 0, sizeof(i));
+
+  i.context = eng->context;
+  i.port = eng->port;
+  i.address = eng->address;
+  i.path = eng->path.c_str();
+  i.host = i.address;
+  i.origin = i.address;
+  i.ssl_connection =
+      (eng->tls ? LCCSCF_USE_SSL : 0) | LCCSCF_PRIORITIZE_READS;
+  i.protocol = NULL;
+  i.local_protocol_name = "lws-minimal-client";
+  i.pwsi = &eng->wsi;
+  i.retry_and_idle_policy = &retry;
+  i.userdata = eng;
+
+  if (!lws_client_connect_via_info(&i))
+    /*
+     * Failed... schedule a retry... we can't use the _retry_wsi()
+     * convenience wrapper api here because no valid wsi at this
+     * point.
+     */
+    if (lws_retry_sul_schedule(eng->context, 0, sul, &retry, connect_client,
+                               &eng->retry_count)) {
+      lwsl_err("%s: connection attempts exhausted\n", __func__);
+      eng->interrupted = 1;
+    }
+}
+
+static void sul_hz_cb(lws_sorted_usec_list_t *sul) {
+  feed_engine_t *eng = lws_container_of(sul, feed_engine_t, sul_hz);
+
+  /*
+   * We are called once a second to dump statistics on the connection
+   */
+
+  lws_sul_schedule(eng->context, 0, &eng->sul_hz, sul_hz_cb, LWS_US_PER_SEC);
+
+  if (eng->ring)
+    eng->metrics.cur.ring_drops = eng->ring->dropped;
+
+  fmc_error_t *err = nullptr;
+  auto now = fmc_cur_time_ns();
+  auto interval = eng->stats_last ? now - eng->stats_last : 0;
+  eng->stats_last = now;
+  latency_publish(eng->yamal, eng->stats_stream, "event-receive", interval,
+                  eng->event_lat, &err);
+  if (!err)
+    latency_publish(eng->yamal, eng->stats_stream, "receive-commit", interval,
+                    eng->commit_lat, &err);
+  if (!err && eng->cfg.timestamping != rx_timestamps_t::NONE)
+    latency_publish(eng->yamal, eng->stats_stream, "kernel-receive", interval,
+                    eng->kernel_lat, &err);
+  if (!err)
+    eng->publish_kernel_times(&err);
+  if (err)
+    lwsl_err("%s, could not publish latency stats with error %s:\n", __func__,
+             fmc_error_msg(err));
+  eng->metrics.publish(eng->yamal, eng->metrics_stream, &err);
+  if (err)
+    lwsl_err("%s, could not publish metrics with error %s:\n", __func__,
+             fmc_error_msg(err));
+}
+
+static int callback_minimal(struct lws *wsi, enum lws_callback_reasons reason,
+                            void *user, void *in, size_t len) {
+  feed_engine_t *eng = (feed_engine_t *)user;
+
+  switch (reason) {
+
+  case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+    lwsl_err("CLIENT_CONNECTION_ERROR: %s\n", in ? (char *)in : "(null)");
+    eng->established = false;
+    goto do_retry;
+    break;
+
+  case LWS_CALLBACK_CLIENT_RECEIVE:
+#ifdef __linux__
+    if (eng->cfg.quickack && !eng->quickack_armed) {
+      /* the kernel clears quickack after sending an ack, once per pass */
+      int on = 1;
+      setsockopt(eng->fd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof on);
+      eng->quickack_armed = true;
+    }
+#endif
+    eng->receive((const char *)in, len, fmc_cur_time_ns());
+    break;
+
+  case LWS_CALLBACK_CLIENT_ESTABLISHED:
+    lwsl_user("%s: established\n", __func__);
+    lws_sul_schedule(lws_get_context(wsi), 0, &eng->sul_hz, sul_hz_cb,
+                     LWS_US_PER_SEC);
+    eng->wsi = wsi;
+    eng->established = true;
+    eng->fd = lws_get_socket_fd(wsi);
+    eng->kernel_ns = 0;
+    eng->tune_socket();
+    sync_subscriptions(eng);
+    break;
+
+  case LWS_CALLBACK_CLIENT_WRITEABLE: {
+    if (eng->requests.empty())
+      break;
+    auto &msg = eng->requests.front();
+    std::vector<unsigned char> buf(LWS_PRE + msg.size());
+    memcpy(buf.data() + LWS_PRE, msg.data(), msg.size());
+    if (lws_write(wsi, buf.data() + LWS_PRE, msg.size(), LWS_WRITE_TEXT) <
+        (int)msg.size()) {
+      lwsl_err("%s: could not send %s\n", __func__, msg.c_str());
+      return -1;
+    }
+    lwsl_user("%s: sent %s\n", __func__, msg.c_str());
+    eng->requests.erase(eng->requests.begin());
+    if (!eng->requests.empty())
+      lws_callback_on_writable(wsi);
+  } break;
+
+  case LWS_CALLBACK_CLIENT_CLOSED:
+    lws_sul_cancel(&eng->sul_hz);
+    eng->established = false;
+    eng->fd = -1;
+    goto do_retry;
+
+  default:
+    break;
+  }
+
+  return lws_callback_http_dummy(wsi, reason, user, in, len);
+
+do_retry:
+  eng->metrics.cur.reconnects++;
+  /*
+   * retry the connection to keep it nailed up
+   *
+   * For this example, we try to conceal any problem for one set of
+   * backoff retries and then exit the app.
+   *
+   * If you set retry.conceal_count to be LWS_RETRY_CONCEAL_ALWAYS,
+   * it will never give up and keep retrying at the last backoff
+   * delay plus the random jitter amount.
+   */
+  if (lws_retry_sul_schedule_retry_wsi(wsi, &eng->sul, connect_client,
+                                       &eng->retry_count)) {
+    lwsl_err("%s: connection attempts exhausted\n", __func__);
+    eng->interrupted = 1;
+  }
+
+  return 0;
+}
+
+static const struct lws_protocols protocols[] = {
+    {"lws-minimal-client", callback_minimal, 0, 0, 0, NULL, 0},
+    LWS_PROTOCOL_LIST_TERM};
+
+feed_engine_t::feed_engine_t(const venue_t &venue, ytp_yamal_t *yamal,
+                             feed_engine_cfg_t c, fmc_error_t **error)
+    : venue(venue), cfg(std::move(c)), address(venue.address),
+      port(venue.port), yamal(yamal) {
+  fmc_error_clear(error);
+  memset(&sul, 0, sizeof sul);
+  memset(&sul_hz, 0, sizeof sul_hz);
+  memset(&sul_sub, 0, sizeof sul_sub);
+
+  if (cfg.us_region) {
+    RETURN_ERROR_UNLESS(venue.us_address, error, , "venue", venue.name,
+                        "does not have a US region");
+    address = venue.us_address;
+    port = venue.us_port;
+  }
+  RETURN_ERROR_UNLESS(cfg.busy_poll_us >= 0 && cfg.rcvbuf >= 0, error, ,
+                      "busy poll and receive buffer sizes must not be "
+                      "negative");
+#ifndef __linux__
+  /* busy polling, quick acks and kernel timestamps are Linux socket options */
+  RETURN_ERROR_UNLESS(!cfg.busy_poll_us && !cfg.quickack &&
+                          cfg.timestamping == rx_timestamps_t::NONE,
+                      error, , "busy-poll, quickack and timestamping are "
+                      "only supported on Linux");
+#endif
+  RETURN_ERROR_UNLESS(!cfg.server_window_bits ||
+                          (cfg.server_window_bits >= 8 &&
+                           cfg.server_window_bits <= 15),
+                      error, , "deflate window bits must be between 8 and 15");
+  if (!cfg.endpoint.empty()) {
+    std::string_view ep = cfg.endpoint;
+    tls = ep.starts_with("wss://");
+    RETURN_ERROR_UNLESS(tls || ep.starts_with("ws://"), error, , "endpoint",
+                        ep, "must start with ws:// or wss://");
+    ep.remove_prefix(tls ? 6 : 5);
+    auto colon = ep.find_last_of(':');
+    auto portsv = colon == ep.npos ? std::string_view() : ep.substr(colon + 1);
+    auto [p, parsed] = fmc::from_string_view<int>(portsv);
+    RETURN_ERROR_UNLESS(portsv.size() && parsed.size() == portsv.size(), error,
+                        , "endpoint", cfg.endpoint, "must end with the port");
+    host = ep.substr(0, colon);
+    address = host.c_str();
+    port = p;
+  }
+
+  ystreams = ytp_streams_new(yamal, error);
+  RETURN_ON_ERROR(error, , "could not create streams");
+  stats_stream = latency_stream_announce(ystreams, cfg.peer, error);
+  RETURN_ON_ERROR(error, , "could not announce stats stream");
+  metrics_stream = metrics_stream_announce(ystreams, cfg.peer, error);
+  RETURN_ON_ERROR(error, , "could not announce metrics stream");
+  if (cfg.timestamping != rx_timestamps_t::NONE) {
+    std::string chstr = "stats/" + cfg.peer + "/kernel-time";
+    kernel_stream = ytp_streams_announce(
+        ystreams, cfg.peer.size(), cfg.peer.data(), chstr.size(),
+        chstr.data(), kernel_time_encoding.size(),
+        kernel_time_encoding.data(), error);
+    RETURN_ON_ERROR(error, , "could not announce kernel time stream");
+    kernel_times.reserve(kernel_batch);
+  }
+
+  if (!cfg.index.empty()) {
+    index_fd = fmc_fopen(cfg.index.c_str(), fmc_fmode::READWRITE, error);
+    RETURN_ON_ERROR(error, , "could not open index file", cfg.index);
+    index = std::make_unique<ytp_index_writer_t>(index_fd, error);
+    RETURN_ON_ERROR(error, , "could not open index", cfg.index);
+  }
+
+  if (!cfg.ring.empty()) {
+    ring_fd = fmc_fopen(cfg.ring.c_str(), fmc_fmode::READWRITE, error);
+    RETURN_ON_ERROR(error, , "could not open ring file", cfg.ring);
+    ring = std::make_unique<spsc_ring_t>(ring_fd, cfg.ring_size, error);
+    RETURN_ON_ERROR(error, , "could not open ring", cfg.ring);
+    // ordinals count the messages of a stream from the start of the file
+    auto it = ytp_data_begin(yamal, error);
+    RETURN_ON_ERROR(error, , "could not obtain iterator");
+    for (; !ytp_yamal_term(it); it = ytp_yamal_next(yamal, it, error)) {
+      RETURN_ON_ERROR(error, , "could not obtain next iterator");
+      uint64_t seqno;
+      int64_t ts;
+      ytp_mmnode_offs stream;
+      size_t sz;
+      const char *data;
+      ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+      RETURN_ON_ERROR(error, , "could not read data");
+      ++ordinals[stream];
+    }
+  }
+
+  if (!cfg.securities.empty()) {
+    struct stat st;
+    if (stat(cfg.securities.c_str(), &st) == 0)
+      secmtime = stat_mtime(st);
+    load_securities(error);
+    if (*error)
+      return;
+  }
+
+  if (!cfg.control.empty()) {
+    RETURN_ERROR_UNLESS(!cfg.control_file.empty(), error, ,
+                        "the control channel needs a control file");
+    ctl_fd = fmc_fopen(cfg.control_file.c_str(), fmc_fmode::READWRITE, error);
+    RETURN_ON_ERROR(error, , "could not open control file", cfg.control_file);
+    ctl_yamal = ytp_yamal_new(ctl_fd, error);
+    RETURN_ON_ERROR(error, , "could not open control yamal", cfg.control_file);
+    /*
+     * Replaying the control channel from the start restores the
+     * subscriptions of a restarted feed handler
+     */
+    ctlit = ytp_data_begin(ctl_yamal, error);
+    RETURN_ON_ERROR(error, , "could not obtain iterator");
+    check_control(this, error);
+    if (*error)
+      return;
+  }
+
+  // calibrate the tsc clock outside of the hot path
+  tsc_clock::ns_per_tick();
+}
+
+feed_engine_t::~feed_engine_t() {
+  if (context)
+    lws_context_destroy(context);
+  fmc_error_t *error = nullptr;
+  if (ystreams)
+    ytp_streams_del(ystreams, &error);
+  index.reset();
+  if (index_fd != -1)
+    fmc_fclose(index_fd, &error);
+  ring.reset();
+  if (ring_fd != -1)
+    fmc_fclose(ring_fd, &error);
+  if (ctl_yamal)
+    ytp_yamal_del(ctl_yamal, &error);
+  if (ctl_fd != -1)
+    fmc_fclose(ctl_fd, &error);
+}
+
+void feed_engine_t::subscribe(const std::string &sec,
+                                 fmc_error_t **error) {
+  announce(this, sec, error);
+  if (!*error)
+    desired.insert(sec);
+}
+
+void feed_engine_t::unsubscribe(const std::string &sec) {
+  desired.erase(sec);
+}
+
+void feed_engine_t::load_securities(fmc_error_t **error) {
+  using namespace std;
+  fmc_error_clear(error);
+  ifstream secfile{cfg.securities};
+  RETURN_ERROR_UNLESS(secfile, error, , "failed to open securities file",
+                      cfg.securities);
+  // load securities from the file, the set sorts and removes duplicates
+  set<string> secs{istream_iterator<string>(secfile),
+                   istream_iterator<string>()};
+  for (auto &sec : secs) {
+    announce(this, sec, error);
+    if (*error)
+      return;
+  }
+  desired = move(secs);
+}
+
+void feed_engine_t::start(struct lws_context_creation_info &info,
+                             fmc_error_t **error) {
+  fmc_error_clear(error);
+  info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+  info.port = CONTEXT_PORT_NO_LISTEN; /* we do not run any server */
+  info.protocols = protocols;
+  info.fd_limit_per_thread = 1 + 1 + 1;
+  if (cfg.deflate) {
+    deflate_offer = ::deflate_offer(cfg);
+    extensions[0] = {"permessage-deflate", lws_extension_callback_pm_deflate,
+                     deflate_offer.c_str()};
+    info.extensions = extensions;
+  }
+
+#if defined(LWS_WITH_MBEDTLS) || defined(USE_WOLFSSL)
+  /*
+   * OpenSSL uses the system trust store.  mbedTLS / WolfSSL have to be
+   * told which CA to trust explicitly.
+   */
+  info.client_ssl_ca_mem = ca_pem_digicert_global_root;
+  info.client_ssl_ca_mem_len =
+      (unsigned int)strlen(ca_pem_digicert_global_root);
+#endif
+
+  context = lws_create_context(&info);
+  RETURN_ERROR_UNLESS(context, error, , "lws init failed");
+
+  /* schedule the first client connection attempt to happen immediately */
+  lws_sul_schedule(context, 0, &sul, connect_client, 1);
+  lws_sul_schedule(context, 0, &sul_sub, sul_sub_cb, subscription_period);
+}
+
+/*
+ * Returns the kernel receive time in ns of the first segment queued on the
+ * socket, peeking so lws still reads it, or 0 if nothing is queued
+ */
+static int64_t peek_rx_time(int fd) {
+#ifdef __linux__
+  char byte;
+  struct iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  if (recvmsg(fd, &msg, MSG_PEEK | MSG_DONTWAIT) <= 0)
+    return 0;
+  for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING)
+      continue;
+    struct scm_timestamping tss;
+    memcpy(&tss, CMSG_DATA(cmsg), sizeof tss);
+    /* software timestamp first, raw hardware timestamp third */
+    auto &ts = tss.ts[2].tv_sec || tss.ts[2].tv_nsec ? tss.ts[2] : tss.ts[0];
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
+#endif
+  return 0;
+}
+
+void feed_engine_t::tune_socket() {
+  auto set = [this](int level, int name, int val, const char *descr) {
+    if (setsockopt(fd, level, name, &val, sizeof val) != 0)
+      lwsl_warn("%s: could not set %s to %d: %s\n", __func__, descr, val,
+                strerror(errno));
+  };
+  if (cfg.rcvbuf)
+    set(SOL_SOCKET, SO_RCVBUF, cfg.rcvbuf, "SO_RCVBUF");
+  if (cfg.nodelay)
+    set(IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+#ifdef __linux__
+  /* other platforms are rejected at construction */
+  if (cfg.busy_poll_us)
+    set(SOL_SOCKET, SO_BUSY_POLL, cfg.busy_poll_us, "SO_BUSY_POLL");
+  if (cfg.quickack)
+    set(IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+  switch (cfg.timestamping) {
+  case rx_timestamps_t::NONE:
+    break;
+  case rx_timestamps_t::SOFTWARE:
+    set(SOL_SOCKET, SO_TIMESTAMPING,
+        SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE,
+        "SO_TIMESTAMPING");
+    break;
+  case rx_timestamps_t::HARDWARE:
+    /* the NIC has to be set to timestamp all packets, e.g. hwstamp_ctl */
+    set(SOL_SOCKET, SO_TIMESTAMPING,
+        SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+            SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE,
+        "SO_TIMESTAMPING");
+    break;
+  }
+#endif
+}
+
+bool feed_engine_t::service(int timeout_ms) {
+  if (interrupted)
+    return false;
+  quickack_armed = false;
+  if (cfg.timestamping != rx_timestamps_t::NONE && fd != -1) {
+    /*
+     * lws reads the socket through TLS, which hides the control messages,
+     * so the timestamp of the pending data is peeked before servicing. With
+     * nothing queued the time is unknown, messages lws decodes from data it
+     * has buffered already are not timestamped rather than given the time
+     * of an earlier segment, which may be long gone after an idle period.
+     */
+    if (timeout_ms >= 0) {
+      /* blocking service, wait for data a millisecond at a time */
+      struct pollfd pfd = {fd, POLLIN, 0};
+      poll(&pfd, 1, 1);
+    }
+    kernel_ns = peek_rx_time(fd);
+    timeout_ms = -1;
+  }
+  return lws_service(context, timeout_ms) >= 0;
+}
+
+bool feed_engine_t::receive(const char *in, size_t len, int64_t recv_ns) {
+  uint64_t recv_tsc = tsc_clock::now();
+  fmc_error_t *err = nullptr;
+  venue_route_t route;
+  switch (venue.route(std::string_view(in, len), &route)) {
+  case venue_msg_t::DATA:
+    break;
+  case venue_msg_t::CONTROL:
+    return false;
+  case venue_msg_t::INVALID:
+    metrics.cur.parse_errors++;
+    return false;
+  case venue_msg_t::FATAL:
+    interrupted = 1;
+    return false;
+  }
+  auto where = streams.find(std::make_pair(route.sec, route.type));
+  if (where == streams.end()) {
+    lwsl_err("%s, stream map does not contain %.*s@%.*s:\n", __func__,
+             (int)route.sec.size(), route.sec.data(), (int)route.type.size(),
+             route.type.data());
+    metrics.cur.parse_errors++;
+    return false;
+  }
+  auto &data = route.data;
+  auto dst = ytp_data_reserve(yamal, data.size(), &err);
+  if (err) {
+    lwsl_err("%s, could not reserve yamal message with error %s:\n", __func__,
+             fmc_error_msg(err));
+    return false;
+  }
+  auto ts = fmc_cur_time_ns();
+  auto stream = where->second;
+  // the message is written to the ring ahead of the commit and published
+  // after it, so a failed commit, or a crash before publishing, leaves the
+  // message to the file. A full ring drops it, the parser reads it from the
+  // file too.
+  bool ringed = ring && ring->write(stream, ordinals[stream], ts, data);
+  memcpy(dst, data.data(), data.size());
+  auto it = ytp_data_commit(yamal, ts, stream, dst, &err);
+  if (err) {
+    lwsl_err("%s, could not commit with error %s:\n", __func__,
+             fmc_error_msg(err));
+    return false;
+  }
+  if (ring) {
+    ++ordinals[stream];
+    if (ringed)
+      ring->publish();
+  }
+  if (index || cfg.pager || kernel_ns) {
+    auto offset = ytp_data_tell(yamal, it, &err);
+    if (index && !err)
+      index->append(where->second, offset, &err);
+    if (err) {
+      lwsl_err("%s, could not index with error %s:\n", __func__,
+               fmc_error_msg(err));
+      return false;
+    }
+    if (cfg.pager)
+      cfg.pager->advance(offset);
+    if (kernel_ns)
+      kernel_times.push_back({offset, kernel_ns});
+  }
+  commit_lat.record(tsc_clock::ns(tsc_clock::now() - recv_tsc));
+  if (kernel_ns)
+    kernel_lat.record_signed(recv_ns - kernel_ns);
+  if (auto vendor_ns = venue.vendor_time(data); vendor_ns)
+    event_lat.record_signed(recv_ns - vendor_ns);
+  /* full batches of kernel times go out here, the rest once a second */
+  if (kernel_times.size() >= kernel_batch) {
+    publish_kernel_times(&err);
+    if (err)
+      lwsl_err("%s, could not publish kernel times with error %s:\n",
+               __func__, fmc_error_msg(err));
+  }
+  metrics.cur.messages++;
+  metrics.cur.bytes += len;
+  return true;
+}
+
+std::string feed_engine_t::streams_path() const { return venue.path(desired); }
+
+void feed_engine_t::publish_kernel_times(fmc_error_t **error) {
+  fmc_error_clear(error);
+  if (kernel_times.empty())
+    return;
+  auto sz = kernel_times.size() * sizeof(kernel_time_record_t);
+  auto *dst = ytp_data_reserve(yamal, sz, error);
+  RETURN_ON_ERROR(error, , "could not reserve kernel times");
+  memcpy(dst, kernel_times.data(), sz);
+  ytp_data_commit(yamal, fmc_cur_time_ns(), kernel_stream, dst, error);
+  RETURN_ON_ERROR(error, , "could not commit kernel times");
+  kernel_times.clear();
+}
+
+/*
+ * Every venue is listed here, the feed parser registers their parsers
+ * and feed-perf benchmarks them
+ */
+const venue_t *const venues[] = {&binance_venue, &coinbase_venue,
+                                 &kraken_venue, &okx_venue, nullptr};
+
+bool rx_timestamps_parse(std::string_view name, rx_timestamps_t *out) {
+  if (name == "none")
+    *out = rx_timestamps_t::NONE;
+  else if (name == "software")
+    *out = rx_timestamps_t::SOFTWARE;
+  else if (name == "hardware")
+    *out = rx_timestamps_t::HARDWARE;
+  else
+    return false;
+  return true;
+}
+
+const venue_t *venue_find(std::string_view name) {
+  for (auto *const *v = venues; *v; ++v) {
+    if ((*v)->name == name)
+      return *v;
+  }
+  return nullptr;
+}
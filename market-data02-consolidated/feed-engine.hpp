@@ -0,0 +1,307 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <libwebsockets.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <memory>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmc/alignment.h>
+#include <fmc/error.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+#include "common.hpp"
+#include "latency.hpp"
+#include "metrics.hpp"
+#include "spsc-ring.hpp"
+#include "yamal-pager.hpp"
+#include "ytp-index.hpp"
+
+/*
+ * Outcome of routing a message received from a venue
+ */
+enum class venue_msg_t {
+  DATA,    /* stream data, published on the channel of the stream */
+  CONTROL, /* venue control message, not published */
+  INVALID, /* could not be routed, counted as a parse error */
+  FATAL,   /* the venue rejected the session, the engine stops */
+};
+
+/*
+ * Stream of a DATA message and the part of the message published
+ */
+struct venue_route_t {
+  std::string_view sec;
+  std::string_view type;
+  std::string_view data;
+};
+
+/*
+ * Describes a websocket venue to the feed handler engine. A venue has a
+ * stream for every security and type, published on the channel
+ * SEC@TYPE under the prefix of the feed handler, raw/NAME/ for the feed
+ * components. Adding a venue is a matter of defining one of these and
+ * listing it in venues, the engine provides the websocket session,
+ * subscriptions, yamal writing and stats, the feed module the component
+ * and the parser, and feed-perf the benchmarks.
+ *
+ * Venues are constant initialized, so the static tables of the feed
+ * module may refer to them.
+ */
+struct venue_t {
+  const char *name;      /* feed name, e.g. binance */
+  const char *component; /* feed module component name */
+  const char *descr;     /* feed module component description */
+  const char *encoding;  /* encoding of the raw channels */
+  const char *address;
+  int port;
+  const char *us_address; /* us-region endpoint, nullptr if none */
+  int us_port;
+  std::span<const char *const> types; /* stream types of each security */
+  /* type with vendor sequence numbers without holes, nullptr if none */
+  const char *contiguous;
+  /*
+   * The connection path subscribes to the securities, otherwise the
+   * engine requests them once the connection is established
+   */
+  bool path_subscribes;
+
+  /* connection path for the securities */
+  std::string (*path)(const std::set<std::string> &secs);
+  /* appends the frames that subscribe or unsubscribe securities */
+  void (*request)(bool subscribe, const std::vector<std::string> &secs,
+                  unsigned *id, std::vector<std::string> &out);
+  /* extracts the stream and payload from a received message */
+  venue_msg_t (*route)(std::string_view msg, venue_route_t *out);
+  /* vendor event time of a payload in ns, 0 if it does not carry one */
+  int64_t (*vendor_time)(std::string_view data);
+  /* parser of the raw channels, registered with the feed parser */
+  resolver_t resolver;
+  /* recorded messages used by the feed-perf benchmarks */
+  std::span<const std::string_view> samples;
+};
+
+extern const venue_t binance_venue;
+extern const venue_t coinbase_venue;
+extern const venue_t kraken_venue;
+extern const venue_t okx_venue;
+
+/* all venues, terminated by nullptr */
+extern const venue_t *const venues[];
+
+/* returns nullptr if there is no venue with that name */
+const venue_t *venue_find(std::string_view name);
+
+/*
+ * Source of the kernel receive timestamps, hardware timestamps are in the
+ * clock of the NIC and need it synchronized to the system clock
+ */
+enum class rx_timestamps_t {
+  NONE,
+  SOFTWARE,
+  HARDWARE,
+};
+
+/* returns false if the name is not none, software or hardware */
+bool rx_timestamps_parse(std::string_view name, rx_timestamps_t *out);
+
+/*
+ * Kernel receive time of a raw message, identified by its yamal offset.
+ * Published in batches on stats/PEER/kernel-time, python can read a batch
+ * with struct.iter_unpack('<Qq', msg).
+ */
+struct kernel_time_record_t {
+  uint64_t offset;
+  int64_t kernel_ns;
+};
+
+constexpr std::string_view kernel_time_encoding =
+    "Content-Type application/octet-stream\n"
+    "Content-Schema kernel-time1";
+
+struct feed_engine_cfg_t {
+  std::string peer;
+  std::string prefix; /* channel prefix, the channel is prefix + stream */
+  bool us_region = false;
+  std::string securities; /* securities file, reloaded on change if set */
+  std::string control;    /* control channel, empty if disabled */
+  /*
+   * yamal file of the control channel, kept apart from the data so that
+   * following the commands does not walk the raw traffic
+   */
+  std::string control_file;
+  /*
+   * ws://HOST:PORT or wss://HOST:PORT replacing the endpoint of the venue,
+   * e.g. a local server replaying recorded frames
+   */
+  std::string endpoint;
+  /*
+   * permessage-deflate negotiation, the server compresses the data we
+   * receive, so server_context_takeover and server_window_bits decide our
+   * inflate cost, the client options only apply to the requests we send
+   */
+  bool deflate = true;
+  bool server_context_takeover = true;
+  bool client_context_takeover = false;
+  int server_window_bits = 0; /* 8 to 15, 0 leaves it to the server */
+  /*
+   * options of the TCP socket, applied once the connection is established,
+   * zero or false leaves the system default
+   */
+  int busy_poll_us = 0;  /* SO_BUSY_POLL, busy poll the device queue */
+  int rcvbuf = 0;        /* SO_RCVBUF in bytes, disables autotuning */
+  bool nodelay = false;  /* TCP_NODELAY, send requests without delay */
+  bool quickack = false; /* TCP_QUICKACK, rearmed on every receive pass */
+  /*
+   * SO_TIMESTAMPING of the received segments, NONE, SOFTWARE or HARDWARE.
+   * The raw messages keep the commit time, their kernel receive times are
+   * published on a stream of their own.
+   */
+  rx_timestamps_t timestamping = rx_timestamps_t::NONE;
+  /*
+   * sidecar index of the raw channels, kept as they are committed so that
+   * readers of a few channels skip the others, none if empty
+   */
+  std::string index;
+  /*
+   * shared memory ring the raw messages are also passed through, for the
+   * feed parser to parse them without waiting for the file, none if empty.
+   * A message is written to the ring before it is committed and published
+   * to the parser only once the commit succeeds
+   */
+  std::string ring;
+  size_t ring_size = spsc_ring_capacity;
+  /* pager of the yamal, told the offset of each commit, not owned */
+  yamal_pager_t *pager = nullptr;
+};
+
+struct venue_key_hash {
+  size_t operator()(
+      const std::pair<std::string_view, std::string_view> &key) const {
+    return fmc_hash_combine(std::hash<std::string_view>{}(key.first),
+                            std::hash<std::string_view>{}(key.second));
+  }
+};
+
+/*
+ * Feed handler engine shared by the binance-feed-handler binary and the
+ * feed handler components. Keeps a websocket session to a venue nailed
+ * up, publishes the payload of each stream onto its own yamal channel,
+ * applies subscription changes on the live connection and publishes
+ * latency and metrics stats streams.
+ *
+ * The engine does not own the yamal, it creates its own lws context in
+ * start() and is driven by calling service().
+ */
+struct feed_engine_t {
+  feed_engine_t(const venue_t &venue, ytp_yamal_t *yamal,
+                feed_engine_cfg_t cfg, fmc_error_t **error);
+  ~feed_engine_t();
+
+  /* adds or removes a security on the live connection */
+  void subscribe(const std::string &sec, fmc_error_t **error);
+  void unsubscribe(const std::string &sec);
+  /* replaces the subscriptions with the securities file */
+  void load_securities(fmc_error_t **error);
+
+  /*
+   * Creates the lws context from info, after filling in the protocols,
+   * extensions and TLS options, and schedules the first connection
+   */
+  void start(struct lws_context_creation_info &info, fmc_error_t **error);
+  /*
+   * Returns false when the session has stopped. With timestamping the
+   * socket is polled for at most a millisecond before servicing lws, so the
+   * receive timestamp is read before lws reads the data.
+   */
+  bool service(int timeout_ms);
+
+  /*
+   * Routes a message received at recv_ns onto the channel of its stream.
+   * Returns false if the message was not published.
+   */
+  bool receive(const char *in, size_t len, int64_t recv_ns);
+
+  /* applies the socket options in cfg to the connected socket */
+  void tune_socket();
+
+  /* commits the pending kernel receive times as one message */
+  void publish_kernel_times(fmc_error_t **error);
+
+  /* connection path for the desired securities */
+  std::string streams_path() const;
+
+  const venue_t &venue;
+
+  lws_sorted_usec_list_t sul;     /* schedule connection retry */
+  lws_sorted_usec_list_t sul_hz;  /* 1hz summary */
+  lws_sorted_usec_list_t sul_sub; /* subscription changes */
+
+  struct lws_context *context = nullptr;
+  struct lws *wsi = nullptr; /* related wsi if any */
+  uint16_t retry_count = 0;  /* count of consequetive retries */
+  bool established = false;
+  int interrupted = 0;
+
+  feed_engine_cfg_t cfg;
+  const char *address = nullptr;
+  int port = 0;
+  bool tls = true;
+  std::string host; /* host of the endpoint in cfg */
+  std::string path; /* storing the path for stream subscription */
+  std::string deflate_offer;
+  struct lws_extension extensions[2] = {};
+  int fd = -1;           /* socket of the established connection */
+  int64_t kernel_ns = 0; /* kernel receive time of the pending data */
+  bool quickack_armed = false;
+
+  /* stream of each security and type, keys view the announcements */
+  std::unordered_map<std::pair<std::string_view, std::string_view>,
+                     ytp_mmnode_offs, venue_key_hash>
+      streams;
+  ytp_yamal_t *yamal = nullptr;
+  ytp_streams_t *ystreams = nullptr;
+  fmc_fd index_fd = -1;
+  std::unique_ptr<ytp_index_writer_t> index;
+  fmc_fd ring_fd = -1;
+  std::unique_ptr<spsc_ring_t> ring;
+  /* messages of each stream in the file, the ordinal of the next one */
+  std::unordered_map<ytp_mmnode_offs, uint64_t> ordinals;
+
+  std::set<std::string> desired;     /* securities we want */
+  std::set<std::string> subscribed;  /* securities on the connection */
+  std::vector<std::string> requests; /* pending subscription changes */
+  unsigned request_id = 0;
+
+  struct timespec secmtime = {};
+  fmc_fd ctl_fd = -1;
+  ytp_yamal_t *ctl_yamal = nullptr;
+  ytp_iterator_t ctlit = nullptr;
+  std::unordered_map<ytp_mmnode_offs, bool> ctlstreams;
+
+  ytp_mmnode_offs stats_stream = 0;
+  /* kernel receive times not published yet, none without timestamping */
+  ytp_mmnode_offs kernel_stream = 0;
+  std::vector<kernel_time_record_t> kernel_times;
+  static constexpr size_t kernel_batch = 4096;
+  latency_histogram_t event_lat;  /* exchange event time to receive */
+  latency_histogram_t commit_lat; /* receive to yamal commit */
+  latency_histogram_t kernel_lat; /* kernel receive to receive */
+  int64_t stats_last = 0;
+  ytp_mmnode_offs metrics_stream = 0;
+  metrics_t metrics;
+};
@@ -0,0 +1,2282 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "conflation.hpp"
+#include "feed-engine.hpp"
+#include "ore-book.hpp"
+#include "ore-reader.hpp"
+#include "ore-schema.hpp"
+#include "kafka-sink.hpp"
+#include "latency.hpp"
+#include "mcast-publisher.hpp"
+#include "ore-writer.hpp"
+#include "spsc-ring.hpp"
+#include "splitter.hpp"
+#include "tcp-distributor.hpp"
+#include "ws-server.hpp"
+#include "yamal-pager.hpp"
+#include "ytp-index.hpp"
+#include "ytp-merge.hpp"
+#include <cmp/cmp.h>
+#include <fmc++/serialization.hpp>
+#include <fmc/cmdline.h>
+#include <fmc/files.h>
+#include <fmc/time.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/yamal.h>
+#include <zlib.h>
+
+using namespace std;
+
+// Output of the parser for a typical bookTicker update, an order modify
+// on each side of the book.
+template <class Out, class Write>
+static void encode_quote(Out *out, Write &&write, uint64_t i,
+                         fmc_error_t **error) {
+  static const string_view pxs[] = {"27341.12000000", "27341.13000000",
+                                    "27341.14000000", "27341.15000000"};
+  static const string_view qts[] = {"0.00100000", "1.25000000", "12.50000000",
+                                    "0.37500000"};
+  int64_t tm = 1680000000000000000LL + i * 1000;
+  write(out, error, (uint8_t)6, tm, (int64_t)0, (uint64_t)(30000000 + i),
+        (uint8_t)1, (int32_t)chanid, (int32_t)chanid, (int32_t)chanid,
+        pxs[i % 4], qts[i % 4], (uint8_t) true);
+  write(out, error, (uint8_t)6, tm, (int64_t)0, (uint64_t)(30000000 + i),
+        (uint8_t)0, (int32_t)chanid, (int32_t)(chanid + 1),
+        (int32_t)(chanid + 1), pxs[(i + 1) % 4], qts[(i + 3) % 4]);
+}
+
+static auto cmp_write = [](cmp_str_t *c, fmc_error_t **e, auto &&...args) {
+  cmp_ore_write(c, e, args...);
+};
+
+static auto writer_write = [](ore_writer_t *o, fmc_error_t **e,
+                              auto &&...args) { ore_write(o, e, args...); };
+
+// Compares encoding through cmp into a growable string and copying into
+// the output, with recording the fields and encoding once straight into
+// the output.
+static int bench_encode(uint64_t count) {
+  fmc_error_t *error = nullptr;
+  vector<char> dst(4096);
+  uint64_t cmp_bytes = 0;
+  uint64_t writer_bytes = 0;
+
+  cmp_str_t cmp;
+  cmp_str_init(&cmp);
+  auto before = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    cmp_str_reset(&cmp);
+    encode_quote(&cmp, cmp_write, i, &error);
+    auto sz = cmp_str_size(&cmp);
+    memcpy(dst.data(), cmp_str_data(&cmp), sz);
+    cmp_bytes += 2 * sz;
+  }
+  auto cmp_ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                               before)
+                    .count();
+  if (error) {
+    fprintf(stderr, "could not encode with error %s\n", fmc_error_msg(error));
+    return 1;
+  }
+
+  ore_writer_t out;
+  before = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    out.reset();
+    encode_quote(&out, writer_write, i, &error);
+    out.encode(dst.data());
+    writer_bytes += out.size();
+  }
+  auto writer_ns = chrono::duration<double, nano>(
+                       chrono::steady_clock::now() - before)
+                       .count();
+
+  // both encoders must produce the same bytes
+  uint64_t mismatches = 0;
+  vector<char> check(4096);
+  for (uint64_t i = 0; i < 1000 && i < count; ++i) {
+    cmp_str_reset(&cmp);
+    encode_quote(&cmp, cmp_write, i, &error);
+    out.reset();
+    encode_quote(&out, writer_write, i, &error);
+    out.encode(check.data());
+    mismatches += cmp_str_size(&cmp) != out.size() ||
+                  memcmp(cmp_str_data(&cmp), check.data(), out.size()) != 0;
+  }
+
+  printf("%-10s %12s %14s\n", "encoder", "ns/msg", "bytes written");
+  printf("%-10s %12.1f %14.1f\n", "cmp", cmp_ns / count,
+         (double)cmp_bytes / count);
+  printf("%-10s %12.1f %14.1f\n", "writer", writer_ns / count,
+         (double)writer_bytes / count);
+  if (mismatches) {
+    fprintf(stderr, "%" PRIu64 " messages encoded differently\n", mismatches);
+    return 1;
+  }
+  return 0;
+}
+
+// Same bookTicker update as encode_quote using the typed ORE messages
+static char *encode_quote_schema(char *dst, uint64_t i) {
+  static const string_view pxs[] = {"27341.12000000", "27341.13000000",
+                                    "27341.14000000", "27341.15000000"};
+  static const string_view qts[] = {"0.00100000", "1.25000000", "12.50000000",
+                                    "0.37500000"};
+  ore_order_modify_t msg;
+  msg.receive = 1680000000000000000LL + i * 1000;
+  msg.vendor_seqno = 30000000 + i;
+  msg.batch = 1;
+  msg.imnt_id = chanid;
+  msg.id = chanid;
+  msg.new_id = chanid;
+  msg.price = pxs[i % 4];
+  msg.qty = qts[i % 4];
+  dst = ore_schema_encode(dst, msg);
+  msg.batch = 0;
+  msg.id = chanid + 1;
+  msg.new_id = chanid + 1;
+  msg.price = pxs[(i + 1) % 4];
+  msg.qty = qts[(i + 3) % 4];
+  return ore_schema_encode(dst, msg);
+}
+
+// Compares the typed fixed width encoder with the recording writer, and
+// decoding the respective outputs with the generic ORE decoder and with
+// the typed decoder.
+static int bench_schema(uint64_t count) {
+  fmc_error_t *error = nullptr;
+  vector<char> dst(4096);
+
+  ore_writer_t out;
+  uint64_t writer_bytes = 0;
+  auto before = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    out.reset();
+    encode_quote(&out, writer_write, i, &error);
+    writer_bytes += out.encode(dst.data()) - dst.data();
+  }
+  auto writer_ns = chrono::duration<double, nano>(
+                       chrono::steady_clock::now() - before)
+                       .count();
+
+  uint64_t schema_bytes = 0;
+  before = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    schema_bytes += encode_quote_schema(dst.data(), i) - dst.data();
+  }
+  auto schema_ns = chrono::duration<double, nano>(
+                       chrono::steady_clock::now() - before)
+                       .count();
+
+  // decode a batch of encoded quotes repeatedly
+  constexpr uint64_t batch = 1024;
+  string compact;
+  string fixed;
+  for (uint64_t i = 0; i < batch; ++i) {
+    out.reset();
+    encode_quote(&out, writer_write, i, &error);
+    auto sz = compact.size();
+    compact.resize(sz + out.size());
+    out.encode(compact.data() + sz);
+    auto *end = encode_quote_schema(dst.data(), i);
+    fixed.append(dst.data(), end - dst.data());
+  }
+  uint64_t rounds = count / batch + 1;
+  uint64_t decoded = 0;
+  double checksum = 0.0;
+  before = chrono::steady_clock::now();
+  for (uint64_t r = 0; r < rounds; ++r) {
+    msgpack_reader_t rd(compact);
+    ore_msg_t msg;
+    while (!rd.empty() && ore_decode(rd, &msg)) {
+      checksum += msg.price;
+      ++decoded;
+    }
+  }
+  auto generic_ns = chrono::duration<double, nano>(
+                        chrono::steady_clock::now() - before)
+                        .count();
+  uint64_t generic_decoded = decoded;
+  decoded = 0;
+  before = chrono::steady_clock::now();
+  for (uint64_t r = 0; r < rounds; ++r) {
+    msgpack_reader_t rd(fixed);
+    while (!rd.empty() && ore_schema_decode(rd, [&](auto &msg) {
+      if constexpr (is_same_v<decay_t<decltype(msg)>, ore_order_modify_t>)
+        checksum += msg.price.size();
+      ++decoded;
+    }))
+      ;
+  }
+  auto typed_ns = chrono::duration<double, nano>(
+                      chrono::steady_clock::now() - before)
+                      .count();
+  if (generic_decoded != rounds * batch * 2 || decoded != rounds * batch * 2) {
+    fprintf(stderr, "could not decode all messages\n");
+    return 1;
+  }
+
+  // encode_quote produces two ORE messages per iteration
+  printf("%-16s %12s %14s\n", "benchmark", "ns/msg", "bytes/msg");
+  printf("%-16s %12.1f %14.1f\n", "encode writer", writer_ns / count / 2,
+         (double)writer_bytes / count / 2);
+  printf("%-16s %12.1f %14.1f\n", "encode typed", schema_ns / count / 2,
+         (double)schema_bytes / count / 2);
+  printf("%-16s %12.1f %14s\n", "decode generic", generic_ns / generic_decoded,
+         "");
+  printf("%-16s %12.1f %14s\n", "decode typed", typed_ns / decoded, "");
+  printf("checksum %f\n", checksum);
+  return 0;
+}
+
+// Decodes the ORE data of a captured file and builds the books of every
+// instrument, passes times over the whole file.
+static int bench_book(const char *ytpfile, uint64_t passes) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "book benchmark requires --ytp-file\n");
+    return 1;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READ, &error);
+  if (error) {
+    fprintf(stderr, "could not open file %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  auto *yamal = ytp_yamal_new(fd, &error);
+  if (error) {
+    fprintf(stderr, "could not create yamal with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  uint64_t read = 0;
+  uint64_t decoded = 0;
+  uint64_t bbos = 0;
+  uint64_t trades = 0;
+  double checksum = 0.0;
+  auto on_bbo = [&](const ore_book_event_t &ev, const ore_book_t &book) {
+    checksum += book.bid().px + book.ask().px;
+    ++bbos;
+  };
+  auto on_trade = [&](const ore_book_event_t &ev, const ore_trade_t &trd) {
+    checksum += trd.px;
+    ++trades;
+  };
+  auto before = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < passes; ++i) {
+    ore_books_t books(yamal, ore_filter_t{}, &error);
+    while (!error) {
+      auto n = books.poll(on_bbo, on_trade, &error);
+      read += n;
+      if (!n)
+        break;
+    }
+    decoded += books.messages();
+  }
+  auto ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                           before)
+                .count();
+  if (error) {
+    fprintf(stderr, "could not build books with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  printf("%-16s %14s %14s\n", "benchmark", "count", "msgs/s");
+  printf("%-16s %14" PRIu64 " %14.0f\n", "yamal messages", read,
+         read * 1e9 / ns);
+  printf("%-16s %14" PRIu64 " %14.0f\n", "ore messages", decoded,
+         decoded * 1e9 / ns);
+  printf("%-16s %14" PRIu64 "\n", "bbo updates", bbos);
+  printf("%-16s %14" PRIu64 "\n", "trades", trades);
+  printf("checksum %f\n", checksum);
+
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
+
+// Routes the recorded messages of a venue through the feed handler engine
+// into the file FILE, count messages cycling over the samples, then runs
+// the parser of each sample count times. Measures the receive and parse
+// paths without the websocket.
+static int bench_venue(const venue_t &venue, const char *ytpfile,
+                       uint64_t count) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "%s benchmark requires --ytp-file\n", venue.name);
+    return 1;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+  if (error) {
+    fprintf(stderr, "could not open file %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  auto *yamal = ytp_yamal_new(fd, &error);
+  if (error) {
+    fprintf(stderr, "could not create yamal with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  auto &msgs = venue.samples;
+  vector<venue_route_t> routes(msgs.size());
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    if (venue.route(msgs[i], &routes[i]) != venue_msg_t::DATA) {
+      fprintf(stderr, "could not route sample %zu\n", i);
+      return 1;
+    }
+  }
+
+  uint64_t routed = 0;
+  uint64_t bytes = 0;
+  double ns = 0.0;
+  {
+    feed_engine_cfg_t cfg;
+    cfg.peer = "feed-perf";
+    cfg.prefix = string("raw/") + venue.name + "/";
+    feed_engine_t engine(venue, yamal, move(cfg), &error);
+    for (auto &route : routes) {
+      if (!error)
+        engine.subscribe(string(route.sec), &error);
+    }
+    if (error) {
+      fprintf(stderr, "could not create engine with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    auto before = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+      auto msg = msgs[i % msgs.size()];
+      routed += engine.receive(msg.data(), msg.size(), fmc_cur_time_ns());
+      bytes += msg.size();
+    }
+    ns = chrono::duration<double, nano>(chrono::steady_clock::now() - before)
+             .count();
+  }
+
+  // the parsers are resolved as for the raw channels of the feed parser
+  vector<parser_t> parsers;
+  for (auto &route : routes) {
+    string sv = string(venue.name) + "/" + string(route.sec) + "@" +
+                string(route.type);
+    parsers.push_back(venue.resolver(sv, &error).second);
+    if (error) {
+      fprintf(stderr, "could not find a parser for %s with error %s\n",
+              sv.c_str(), fmc_error_msg(error));
+      return 1;
+    }
+  }
+  ore_writer_t out;
+  uint64_t parsed = 0;
+  uint64_t written = 0;
+  auto before = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    auto j = i % routes.size();
+    uint64_t last = 0;
+    out.reset();
+    parsed += parsers[j](routes[j].data, &out, fmc_cur_time_ns(), &last, false,
+                         &error);
+    if (error) {
+      fprintf(stderr, "could not parse sample %" PRIu64 " with error %s\n",
+              j, fmc_error_msg(error));
+      return 1;
+    }
+    written += out.size();
+  }
+  auto parse_ns =
+      chrono::duration<double, nano>(chrono::steady_clock::now() - before)
+          .count();
+
+  printf("%-16s %12s %14s %14s\n", "benchmark", "ns/msg", "msgs/s",
+         "bytes/msg");
+  printf("%-16s %12.1f %14.0f %14.1f\n", "route", ns / count,
+         count * 1e9 / ns, (double)bytes / count);
+  printf("%-16s %12.1f %14.0f %14.1f\n", "parse", parse_ns / count,
+         count * 1e9 / parse_ns, (double)written / count);
+  printf("routed %" PRIu64 " parsed %" PRIu64 "\n", routed, parsed);
+
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return routed == count && parsed == count ? 0 : 1;
+}
+
+// Raw channel messages of each venue for the deflate benchmark, up to
+// count per venue from the raw/ channels of FILE, or the samples of every
+// venue repeated count times without a file.
+static map<string, vector<string>> deflate_messages(const char *ytpfile,
+                                                   uint64_t count,
+                                                   fmc_error_t **error) {
+  map<string, vector<string>> msgs;
+  if (!ytpfile) {
+    for (auto venue = venues; *venue; ++venue) {
+      auto &out = msgs[(*venue)->name];
+      auto &samples = (*venue)->samples;
+      for (uint64_t i = 0; i < count; ++i)
+        out.emplace_back(samples[i % samples.size()]);
+    }
+    return msgs;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READ, error);
+  if (*error)
+    return msgs;
+  auto *yamal = ytp_yamal_new(fd, error);
+  if (*error) {
+    fmc_fclose(fd, error);
+    return msgs;
+  }
+  unordered_map<ytp_mmnode_offs, vector<string> *> streams;
+  for (auto it = ytp_data_begin(yamal, error); !*error && !ytp_yamal_term(it);
+       it = ytp_yamal_next(yamal, it, error)) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+    if (*error)
+      break;
+    auto where = streams.find(stream);
+    if (where == streams.end()) {
+      size_t psz, csz, esz;
+      const char *peer, *channel, *encoding;
+      ytp_mmnode_offs *original, *subscribed;
+      ytp_announcement_lookup(yamal, stream, &seqno, &psz, &peer, &csz,
+                              &channel, &esz, &encoding, &original,
+                              &subscribed, error);
+      if (*error)
+        break;
+      // raw/VENUE/STREAM
+      string_view sv{channel, csz};
+      vector<string> *out = nullptr;
+      if (sv.starts_with("raw/") && sv.find('/', 4) != sv.npos)
+        out = &msgs[string(sv.substr(4, sv.find('/', 4) - 4))];
+      where = streams.emplace(stream, out).first;
+    }
+    if (where->second && where->second->size() < count)
+      where->second->emplace_back(data, sz);
+  }
+  fmc_error_t *err = nullptr;
+  ytp_yamal_del(yamal, &err);
+  fmc_fclose(fd, &err);
+  return msgs;
+}
+
+// Compresses the messages as a permessage-deflate server would, then
+// measures inflating them as the feed handler does for the context
+// takeover and window options. The size of the compressed messages sets
+// how long the server takes to fill a TLS record at the message rate,
+// the extra latency of the first messages of a coalesced record.
+static int bench_deflate(const char *ytpfile, uint64_t count, double rate) {
+  fmc_error_t *error = nullptr;
+  auto msgs = deflate_messages(ytpfile, count, &error);
+  if (error) {
+    fprintf(stderr, "could not read file %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  struct option_t {
+    const char *name;
+    bool deflate;
+    bool takeover;
+    int bits;
+  };
+  static const option_t options[] = {{"off", false, false, 15},
+                                     {"takeover/15", true, true, 15},
+                                     {"reset/15", true, false, 15},
+                                     {"takeover/10", true, true, 10},
+                                     {"reset/10", true, false, 10}};
+  static const uint8_t tail[] = {0x00, 0x00, 0xff, 0xff};
+  constexpr double record = 16384.0;
+  vector<uint8_t> buf(1 << 20);
+
+  printf("%-10s %-12s %10s %8s %14s %14s\n", "venue", "deflate", "bytes/msg",
+         "ratio", "inflate ns/msg", "record fill us");
+  double checksum = 0.0;
+  for (auto &[venue, vmsgs] : msgs) {
+    if (vmsgs.empty())
+      continue;
+    uint64_t raw = 0;
+    for (auto &msg : vmsgs)
+      raw += msg.size();
+    for (auto &opt : options) {
+      uint64_t bytes = raw;
+      double ns = 0.0;
+      if (opt.deflate) {
+        z_stream def = {};
+        deflateInit2(&def, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -opt.bits, 8,
+                     Z_DEFAULT_STRATEGY);
+        vector<string> frames;
+        frames.reserve(vmsgs.size());
+        bytes = 0;
+        for (auto &msg : vmsgs) {
+          if (!opt.takeover)
+            deflateReset(&def);
+          def.next_in = (Bytef *)msg.data();
+          def.avail_in = msg.size();
+          def.next_out = buf.data();
+          def.avail_out = buf.size();
+          deflate(&def, Z_SYNC_FLUSH);
+          // the empty block of the flush is not sent
+          size_t sz = buf.size() - def.avail_out - sizeof(tail);
+          frames.emplace_back((char *)buf.data(), sz);
+          bytes += sz;
+        }
+        deflateEnd(&def);
+
+        z_stream inf = {};
+        inflateInit2(&inf, -opt.bits);
+        uint64_t inflated = 0;
+        auto before = chrono::steady_clock::now();
+        for (auto &frame : frames) {
+          if (!opt.takeover)
+            inflateReset(&inf);
+          inf.next_out = buf.data();
+          inf.avail_out = buf.size();
+          inf.next_in = (Bytef *)frame.data();
+          inf.avail_in = frame.size();
+          inflate(&inf, Z_SYNC_FLUSH);
+          inf.next_in = (Bytef *)tail;
+          inf.avail_in = sizeof(tail);
+          inflate(&inf, Z_SYNC_FLUSH);
+          inflated += buf.size() - inf.avail_out;
+          checksum += buf[0];
+        }
+        ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                            before)
+                 .count();
+        inflateEnd(&inf);
+        if (inflated != raw) {
+          fprintf(stderr, "could not inflate the %s messages\n",
+                  venue.c_str());
+          return 1;
+        }
+      }
+      double per_msg = (double)bytes / vmsgs.size();
+      printf("%-10s %-12s %10.1f %8.2f %14.1f %14.1f\n", venue.c_str(),
+             opt.name, per_msg, (double)raw / bytes, ns / vmsgs.size(),
+             record / (per_msg * rate) * 1e6);
+    }
+  }
+  printf("checksum %f\n", checksum);
+  return 0;
+}
+
+// Writers of the contention benchmark, as many as the handlers of feed.json
+static constexpr unsigned contention_writers = 4;
+
+// Yamal file of one writer of the contention benchmark
+struct contention_file_t {
+  fmc_fd fd = -1;
+  ytp_yamal_t *yamal = nullptr;
+
+  contention_file_t(const string &name, fmc_error_t **error) {
+    fd = fmc_fopen(name.c_str(), fmc_fmode::READWRITE, error);
+    if (*error)
+      return;
+    yamal = ytp_yamal_new(fd, error);
+  }
+  ~contention_file_t() {
+    fmc_error_t *error = nullptr;
+    if (yamal)
+      ytp_yamal_del(yamal, &error);
+    if (fd != -1)
+      fmc_fclose(fd, &error);
+  }
+};
+
+// Routes count Binance samples through each of the writer engines at the
+// same time, each writer with its own yamal on its own file or on the
+// same file. Returns the mean time per message of a writer in ns.
+static double contention_write(const vector<string> &names, uint64_t count,
+                               fmc_error_t **error) {
+  vector<unique_ptr<contention_file_t>> files;
+  vector<unique_ptr<feed_engine_t>> engines;
+  for (unsigned i = 0; i < contention_writers; ++i) {
+    files.push_back(make_unique<contention_file_t>(names[i], error));
+    if (*error)
+      return 0.0;
+    feed_engine_cfg_t cfg;
+    cfg.peer = "feed-perf-" + to_string(i);
+    cfg.prefix = "raw/binance/";
+    engines.push_back(make_unique<feed_engine_t>(
+        binance_venue, files.back()->yamal, move(cfg), error));
+    for (auto msg : binance_venue.samples) {
+      venue_route_t route;
+      if (!*error && binance_venue.route(msg, &route) == venue_msg_t::DATA)
+        engines.back()->subscribe(string(route.sec), error);
+    }
+    if (*error)
+      return 0.0;
+  }
+
+  atomic<unsigned> ready = 0;
+  vector<double> ns(contention_writers);
+  vector<thread> threads;
+  for (unsigned i = 0; i < contention_writers; ++i) {
+    threads.emplace_back([&, i]() {
+      auto &engine = *engines[i];
+      auto &msgs = binance_venue.samples;
+      // start together so that the writers contend for the whole run
+      ++ready;
+      while (ready < contention_writers)
+        ;
+      auto before = chrono::steady_clock::now();
+      for (uint64_t j = 0; j < count; ++j) {
+        auto msg = msgs[j % msgs.size()];
+        engine.receive(msg.data(), msg.size(), fmc_cur_time_ns());
+      }
+      ns[i] = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                             before)
+                  .count();
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  double total = 0.0;
+  for (auto n : ns)
+    total += n;
+  return total / contention_writers / count;
+}
+
+// Reads every data message of the files through the merge of the feed
+// parser. Returns the time per message in ns and the number of messages.
+static pair<double, uint64_t> contention_read(const vector<string> &names,
+                                               fmc_error_t **error) {
+  vector<unique_ptr<contention_file_t>> files;
+  ytp_merge_t merge;
+  for (auto &name : names) {
+    files.push_back(make_unique<contention_file_t>(name, error));
+    if (*error)
+      return {0.0, 0};
+    merge.add(files.back()->yamal, error);
+    if (*error)
+      return {0.0, 0};
+  }
+  uint64_t read = 0;
+  auto before = chrono::steady_clock::now();
+  while (merge.next(error))
+    ++read;
+  auto ns =
+      chrono::duration<double, nano>(chrono::steady_clock::now() - before)
+          .count();
+  if (!read)
+    return {0.0, 0};
+  return {ns / read, read};
+}
+
+// Compares the feed handlers writing their raw channels to one file with
+// each writing its own file, for the write path of the handlers and for
+// the read path of the feed parser, sequential over one file or merged
+// over the files of the writers.
+static int bench_contention(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "contention benchmark requires --ytp-file\n");
+    return 1;
+  }
+  vector<string> shared(contention_writers, ytpfile);
+  vector<string> own;
+  for (unsigned i = 0; i < contention_writers; ++i)
+    own.push_back(string(ytpfile) + "." + to_string(i));
+
+  struct {
+    const char *name;
+    const vector<string> &write;
+    vector<string> read;
+  } layouts[] = {{"1-file", shared, {ytpfile}}, {"N-files", own, own}};
+
+  printf("%-10s %8s %14s %14s %12s %12s\n", "layout", "writers",
+         "write ns/msg", "msgs/s", "read ns/msg", "read msgs");
+  for (auto &layout : layouts) {
+    auto write_ns = contention_write(layout.write, count, &error);
+    if (error) {
+      fprintf(stderr, "could not write %s with error %s\n", layout.name,
+              fmc_error_msg(error));
+      return 1;
+    }
+    auto [read_ns, read] = contention_read(layout.read, &error);
+    if (error) {
+      fprintf(stderr, "could not read %s with error %s\n", layout.name,
+              fmc_error_msg(error));
+      return 1;
+    }
+    printf("%-10s %8u %14.1f %14.0f %12.1f %12" PRIu64 "\n", layout.name,
+           contention_writers, write_ns,
+           contention_writers * 1e9 / write_ns, read_ns, read);
+  }
+  return 0;
+}
+
+// Subscriber of the fanout benchmark, counts the data frames received
+// from the distributor on port until it has count of them.
+static bool fanout_subscribe(int port, uint64_t count) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+      send(fd, "start\n", 6, 0) != 6) {
+    if (fd != -1)
+      close(fd);
+    return false;
+  }
+  vector<char> buf(1 << 20);
+  size_t used = 0;
+  uint64_t received = 0;
+  while (received < count) {
+    auto n = recv(fd, buf.data() + used, buf.size() - used, 0);
+    if (n <= 0)
+      break;
+    used += n;
+    size_t pos = 0;
+    dist_frame_hdr_t hdr;
+    while (used - pos >= sizeof hdr) {
+      memcpy(&hdr, buf.data() + pos, sizeof hdr);
+      if (used - pos - sizeof hdr < hdr.size)
+        break;
+      received += hdr.type == (uint8_t)dist_frame_t::DATA;
+      pos += sizeof hdr + hdr.size;
+    }
+    memmove(buf.data(), buf.data() + pos, used - pos);
+    used -= pos;
+  }
+  close(fd);
+  return received == count;
+}
+
+// Writes count messages of typical ORE sizes over a few channels into
+// ytpfile and returns the number of messages and frame bytes of the whole
+// file, which includes those of earlier runs.
+static bool distribution_write(const char *ytpfile, uint64_t count,
+                               ytp_yamal_t **yamal, uint64_t *total,
+                               uint64_t *bytes) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "distribution benchmarks require --ytp-file\n");
+    return false;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+  if (error) {
+    fprintf(stderr, "could not open file %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return false;
+  }
+  *yamal = ytp_yamal_new(fd, &error);
+  auto *streams = error ? nullptr : ytp_streams_new(*yamal, &error);
+  if (error) {
+    fprintf(stderr, "could not create yamal with error %s\n",
+            fmc_error_msg(error));
+    return false;
+  }
+  constexpr size_t channels = 16;
+  vector<ytp_mmnode_offs> chans;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  for (size_t i = 0; i < channels && !error; ++i) {
+    string ch = "ore/perf/" + to_string(i);
+    chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                         ch.size(), ch.data(),
+                                         encoding.size(), encoding.data(),
+                                         &error));
+  }
+  for (uint64_t i = 0; i < count && !error; ++i) {
+    size_t sz = 48 + i % 64;
+    auto *dst = ytp_data_reserve(*yamal, sz, &error);
+    if (error)
+      break;
+    memset(dst, (int)i, sz);
+    ytp_data_commit(*yamal, fmc_cur_time_ns(), chans[i % channels], dst,
+                    &error);
+  }
+  if (streams)
+    ytp_streams_del(streams, &error);
+  if (error) {
+    fprintf(stderr, "could not write messages with error %s\n",
+            fmc_error_msg(error));
+    return false;
+  }
+  *total = 0;
+  *bytes = 0;
+  for (auto it = ytp_data_begin(*yamal, &error);
+       !error && !ytp_yamal_term(it); it = ytp_yamal_next(*yamal, it, &error)) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(*yamal, it, &seqno, &ts, &stream, &sz, &data, &error);
+    *bytes += sz + sizeof(dist_frame_hdr_t);
+    ++*total;
+  }
+  return !error;
+}
+
+// Writes count messages into FILE and distributes the whole file over
+// loopback to a growing number of subscribers, each receiving every
+// message. Measures the time until the last subscriber has them all.
+static int bench_fanout(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  ytp_yamal_t *yamal = nullptr;
+  uint64_t total = 0;
+  uint64_t bytes = 0;
+  if (!distribution_write(ytpfile, count, &yamal, &total, &bytes))
+    return 1;
+
+  printf("%-12s %12s %16s %16s %12s\n", "subscribers", "ms",
+         "msgs/s/sub", "msgs/s", "MB/s");
+  for (unsigned subs : {1, 4, 16, 64}) {
+    tcp_distributor_cfg_t cfg;
+    cfg.address = "127.0.0.1";
+    tcp_distributor_t dist(yamal, cfg, &error);
+    if (error) {
+      fprintf(stderr, "could not create distributor with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    atomic<unsigned> done = 0;
+    atomic<unsigned> failed = 0;
+    vector<thread> threads;
+    auto before = chrono::steady_clock::now();
+    for (unsigned i = 0; i < subs; ++i) {
+      threads.emplace_back([&]() {
+        failed += !fanout_subscribe(dist.port, total);
+        ++done;
+      });
+    }
+    while (done < subs && !error)
+      dist.poll(&error);
+    auto ns =
+        chrono::duration<double, nano>(chrono::steady_clock::now() - before)
+            .count();
+    for (auto &t : threads)
+      t.join();
+    if (error || failed) {
+      fprintf(stderr, "distribution to %u subscribers failed %s\n", subs,
+              error ? fmc_error_msg(error) : "");
+      return 1;
+    }
+    printf("%-12u %12.1f %16.0f %16.0f %12.1f\n", subs, ns / 1e6,
+           total * 1e9 / ns, subs * total * 1e9 / ns,
+           subs * bytes * 1e3 / ns);
+  }
+  return 0;
+}
+
+// Publishes FILE, after writing count messages into it, on a loopback
+// multicast group with packets of a few sizes, to a receiver on another
+// thread that writes FILE.mcast.SIZE. Measures the time until the receiver
+// has every message, gaps included, and the packets sent again.
+static int bench_multicast(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  ytp_yamal_t *yamal = nullptr;
+  uint64_t total = 0;
+  uint64_t bytes = 0;
+  if (!distribution_write(ytpfile, count, &yamal, &total, &bytes))
+    return 1;
+
+  printf("%-8s %10s %14s %14s %12s %10s %8s\n", "packet", "ms", "packets/s",
+         "msgs/s", "MB/s", "resent", "lost");
+  for (size_t packet : {512, 1472, 8972}) {
+    mcast_publisher_cfg_t pcfg;
+    pcfg.port = 30001;
+    pcfg.interface = "127.0.0.1";
+    pcfg.gap_address = "127.0.0.1";
+    pcfg.packet = packet;
+    pcfg.from = "start";
+    mcast_publisher_t pub(yamal, move(pcfg), &error);
+    if (error) {
+      fprintf(stderr, "could not create publisher with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    string name = string(ytpfile) + ".mcast." + to_string(packet);
+    auto fd = fmc_fopen(name.c_str(), fmc_fmode::READWRITE, &error);
+    auto *ryamal = error ? nullptr : ytp_yamal_new(fd, &error);
+    mcast_receiver_cfg_t rcfg;
+    rcfg.port = pub.cfg.port;
+    rcfg.interface = "127.0.0.1";
+    rcfg.gap_port = pub.gap_port;
+    rcfg.rcvbuf = 4 << 20;
+    optional<mcast_receiver_t> recv;
+    if (!error)
+      recv.emplace(ryamal, move(rcfg), &error);
+    if (error) {
+      fprintf(stderr, "could not create receiver with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    atomic<bool> done = false;
+    atomic<bool> stop = false;
+    fmc_error_t *rerror = nullptr;
+    auto before = chrono::steady_clock::now();
+    thread receiver([&]() {
+      while (!stop && !rerror && recv->messages < total)
+        recv->poll(&rerror);
+      done = true;
+    });
+    // gives up once nothing has been received for a few seconds
+    uint64_t progress = 0;
+    auto last = before;
+    while (!done && !error) {
+      pub.poll(&error);
+      auto now = chrono::steady_clock::now();
+      if (uint64_t m = recv->packets; m != progress) {
+        progress = m;
+        last = now;
+      } else if (now - last > chrono::seconds(5)) {
+        break;
+      }
+    }
+    stop = true;
+    receiver.join();
+    auto ns =
+        chrono::duration<double, nano>(chrono::steady_clock::now() - before)
+            .count();
+    if (error || rerror) {
+      fprintf(stderr, "multicast failed with error %s\n",
+              fmc_error_msg(error ? error : rerror));
+      return 1;
+    }
+    if (recv->messages != total)
+      fprintf(stderr, "receiver has %" PRIu64 " of %" PRIu64 " messages\n",
+              recv->messages, total);
+    printf("%-8zu %10.1f %14.0f %14.0f %12.1f %10" PRIu64 " %8" PRIu64 "\n",
+           packet, ns / 1e6, pub.packets * 1e9 / ns, total * 1e9 / ns,
+           bytes * 1e3 / ns, pub.retransmitted, recv->lost);
+    recv.reset();
+    ytp_yamal_del(ryamal, &error);
+    fmc_fclose(fd, &error);
+  }
+  return 0;
+}
+
+// Kafka broker stand-in of the kafka benchmark, acknowledges every
+// Produce request of one connection after delay ms.
+static void kafka_broker(int lfd, int delay, atomic<bool> &stop) {
+  int fd = -1;
+  while (!stop && (fd = accept(lfd, nullptr, nullptr)) == -1)
+    this_thread::sleep_for(chrono::milliseconds(1));
+  if (fd == -1)
+    return;
+  // accepted sockets inherit the non blocking listener on some platforms
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof on);
+#endif
+  auto be32 = [](const char *p) {
+    return (int32_t)((uint8_t)p[0] << 24 | (uint8_t)p[1] << 16 |
+                     (uint8_t)p[2] << 8 | (uint8_t)p[3]);
+  };
+  auto put32 = [](string &s, int32_t v) {
+    for (int i = 3; i >= 0; --i)
+      s.push_back((char)(v >> (8 * i)));
+  };
+  string buf;
+  vector<char> chunk(1 << 20);
+  while (!stop) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 10) <= 0)
+      continue;
+    auto n = recv(fd, chunk.data(), chunk.size(), 0);
+    if (n <= 0)
+      break;
+    buf.append(chunk.data(), n);
+    size_t pos = 0;
+    while (buf.size() - pos >= 4) {
+      size_t sz = be32(buf.data() + pos);
+      if (buf.size() - pos - 4 < sz)
+        break;
+      const char *req = buf.data() + pos + 4;
+      // correlation id, client id, transactional id, acks, timeout, count
+      size_t off = 8 + 2 + (uint16_t)(req[8] << 8 | (uint8_t)req[9]);
+      off += 2 + 2 + 4 + 4;
+      size_t tsz = (uint8_t)req[off] << 8 | (uint8_t)req[off + 1];
+      string topic(req + off + 2, tsz);
+      int32_t partition = be32(req + off + 2 + tsz + 4);
+      string resp;
+      put32(resp, 0);
+      resp.append(req + 4, 4);
+      put32(resp, 1);
+      resp.push_back(0);
+      resp.push_back((char)tsz);
+      resp.append(topic);
+      put32(resp, 1);
+      put32(resp, partition);
+      resp.append(2 + 8 + 8, '\0'); // no error, base offset, append time
+      put32(resp, 0);
+      string size;
+      put32(size, resp.size() - 4);
+      resp.replace(0, 4, size);
+      pos += 4 + sz;
+      if (delay)
+        this_thread::sleep_for(chrono::milliseconds(delay));
+      auto sent = send(fd, resp.data(), resp.size(), dist_send_flags);
+      if (sent != (ssize_t)resp.size())
+        stop = true;
+    }
+    buf.erase(0, pos);
+  }
+  close(fd);
+}
+
+// Writes count messages into FILE while a kafka sink produces them to a
+// broker stand-in on loopback, without compression, with gzip, and with
+// gzip to a broker that takes 20ms per response. Measures the writer
+// cost per message, which a slow broker should not change, the rate of
+// the sink, and how many records it had produced when the writer ended.
+static int bench_kafka(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "kafka benchmark requires --ytp-file\n");
+    return 1;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+  auto *yamal = error ? nullptr : ytp_yamal_new(fd, &error);
+  auto *streams = error ? nullptr : ytp_streams_new(yamal, &error);
+  if (error) {
+    fprintf(stderr, "could not open %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  constexpr size_t channels = 16;
+  vector<ytp_mmnode_offs> chans;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  for (size_t i = 0; i < channels && !error; ++i) {
+    string ch = "ore/perf/" + to_string(i);
+    chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                         ch.size(), ch.data(),
+                                         encoding.size(), encoding.data(),
+                                         &error));
+  }
+  if (error) {
+    fprintf(stderr, "could not announce streams with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  struct {
+    const char *name;
+    kafka_compression_t compression;
+    int delay;
+  } cases[] = {{"none", kafka_compression_t::NONE, 0},
+               {"gzip", kafka_compression_t::GZIP, 0},
+               {"gzip-slow", kafka_compression_t::GZIP, 20}};
+  printf("%-10s %12s %14s %12s %14s %8s\n", "case", "write ns", "records/s",
+         "wire ratio", "at write end", "drained");
+  for (auto &c : cases) {
+    int lfd = dist_socket(SOCK_STREAM);
+    struct sockaddr_in addr;
+    dist_sockaddr_parse("127.0.0.1", 0, &addr);
+    socklen_t len = sizeof addr;
+    if (lfd == -1 || bind(lfd, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+        listen(lfd, 1) != 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &len) != 0) {
+      fprintf(stderr, "could not listen: %s\n", strerror(errno));
+      return 1;
+    }
+    atomic<bool> stop = false;
+    thread broker(kafka_broker, lfd, c.delay, ref(stop));
+
+    kafka_sink_cfg_t kcfg;
+    kcfg.port = ntohs(addr.sin_port);
+    kcfg.topic = "ore";
+    kcfg.partitions = 4;
+    kcfg.compression = c.compression;
+    kcfg.from = "end";
+    kcfg.prefixes = {"ore/perf/"};
+    kafka_sink_t sink(yamal, kcfg, &error);
+    if (error) {
+      fprintf(stderr, "could not create sink with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    sink.start();
+
+    auto before = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count && !error; ++i) {
+      size_t sz = 48 + i % 64;
+      auto *dst = ytp_data_reserve(yamal, sz, &error);
+      if (error)
+        break;
+      // compressible like ORE messages, mostly repeated fields
+      memset(dst, (int)(i % 7), sz);
+      memcpy(dst, &i, sizeof i);
+      ytp_data_commit(yamal, fmc_cur_time_ns(), chans[i % channels], dst,
+                      &error);
+    }
+    auto written = chrono::steady_clock::now();
+    uint64_t at_end = sink.acked;
+    // waits for the sink to drain, at most 10s
+    while (sink.acked < count && !sink.stopped &&
+           chrono::steady_clock::now() - written < chrono::seconds(10))
+      this_thread::sleep_for(chrono::milliseconds(1));
+    auto drained = chrono::steady_clock::now();
+    sink.stop();
+    stop = true;
+    broker.join();
+    close(lfd);
+    string msg;
+    if (error || sink.failed(&msg)) {
+      fprintf(stderr, "kafka benchmark failed with error %s\n",
+              error ? fmc_error_msg(error) : msg.c_str());
+      return 1;
+    }
+    auto write_ns = chrono::duration<double, nano>(written - before).count();
+    auto total_ns = chrono::duration<double, nano>(drained - before).count();
+    double raw = sink.metrics.cur.bytes;
+    printf("%-10s %12.1f %14.0f %12.3f %14" PRIu64 " %8s\n", c.name,
+           write_ns / count, sink.acked * 1e9 / total_ns,
+           raw ? sink.wire_bytes / raw : 0.0, at_end,
+           sink.acked == count ? "yes" : "no");
+  }
+  ytp_streams_del(streams, &error);
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
+
+// Writes ORE updates of the instruments of chans into the yamal at rate
+// messages per second: a quote change on one side of an instrument, or
+// every 16th message a trade. Unless paced, the messages are written at
+// once with receive times as if they came at rate.
+static void ore_bench_write(ytp_yamal_t *yamal,
+                            const vector<ytp_mmnode_offs> &chans,
+                            uint64_t count, double rate, bool paced,
+                            fmc_error_t **error) {
+  static const string_view pxs[] = {"27341.12", "27341.13", "27341.14",
+                                    "27341.15", "27341.16", "27341.17"};
+  char buf[256];
+  auto commit = [&](size_t chan, char *end) {
+    auto *dst = ytp_data_reserve(yamal, end - buf, error);
+    if (*error)
+      return;
+    memcpy(dst, buf, end - buf);
+    ytp_data_commit(yamal, fmc_cur_time_ns(), chans[chan], dst, error);
+  };
+  // bid at order 1 and ask at order 2 of every instrument
+  for (size_t i = 0; i < chans.size() && !*error; ++i) {
+    ore_order_add_t add;
+    add.receive = fmc_cur_time_ns();
+    add.imnt_id = i;
+    add.batch = 1;
+    add.id = 1;
+    add.price = pxs[0];
+    add.qty = "1.5";
+    add.is_bid = true;
+    char *end = ore_schema_encode(buf, add);
+    add.batch = 0;
+    add.id = 2;
+    add.price = pxs[5];
+    add.is_bid = false;
+    commit(i, ore_schema_encode(end, add));
+  }
+  auto start = chrono::steady_clock::now();
+  auto start_ns = fmc_cur_time_ns();
+  auto receive = [&](uint64_t i) {
+    return paced ? fmc_cur_time_ns() : start_ns + (int64_t)(i * 1e9 / rate);
+  };
+  for (uint64_t i = 0; i < count && !*error; ++i) {
+    if (paced && i % 1024 == 0) {
+      auto due = start + chrono::nanoseconds((int64_t)(i * 1e9 / rate));
+      this_thread::sleep_until(due);
+    }
+    size_t chan = (i * 7) % chans.size();
+    char *end;
+    if (i % 16 == 0) {
+      ore_off_book_trade_t trd;
+      trd.receive = receive(i);
+      trd.imnt_id = chan;
+      trd.price = pxs[2 + i % 2];
+      trd.qty = "0.25";
+      trd.decorator = i % 32 ? "b" : "a";
+      end = ore_schema_encode(buf, trd);
+    } else {
+      ore_order_modify_t mod;
+      mod.receive = receive(i);
+      mod.imnt_id = chan;
+      mod.id = mod.new_id = 1 + i % 2;
+      mod.price = pxs[(i % 2) * 3 + i % 3];
+      mod.qty = "1.5";
+      end = ore_schema_encode(buf, mod);
+    }
+    commit(chan, end);
+  }
+}
+
+// Websocket client of the benchmark on a non blocking socket. Slow
+// clients have a small receive buffer and read at most 16KB every 100ms.
+struct ws_bench_client_t {
+  int fd = -1;
+  bool slow = false;
+  bool upgraded = false;
+  int64_t next_read = 0;
+  string buf;
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+
+  bool connect(int port) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (slow) {
+      int sz = 16384;
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof sz);
+    }
+    struct sockaddr_in addr;
+    dist_sockaddr_parse("127.0.0.1", port, &addr);
+    if (fd == -1 || ::connect(fd, (struct sockaddr *)&addr, sizeof addr))
+      return false;
+    const char req[] = "GET / HTTP/1.1\r\n"
+                       "Host: 127.0.0.1\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n\r\n";
+    return send(fd, req, sizeof req - 1, 0) == sizeof req - 1;
+  }
+
+  // reads what is available, counting the messages if measure is set,
+  // returns false if the connection failed
+  bool read(int64_t now, bool measure, latency_histogram_t &ages) {
+    if (now < next_read)
+      return true;
+    char data[65536];
+    size_t max = slow ? 16384 : sizeof data;
+    auto n = recv(fd, data, max, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN))
+      return false;
+    if (n < 0)
+      return true;
+    if (slow)
+      next_read = now + 100000000LL;
+    buf.append(data, n);
+    if (!upgraded) {
+      auto end = buf.find("\r\n\r\n");
+      if (end == string::npos)
+        return true;
+      if (buf.compare(0, 12, "HTTP/1.1 101") != 0)
+        return false;
+      upgraded = true;
+      buf.erase(0, end + 4);
+    }
+    size_t pos = 0;
+    while (buf.size() - pos >= 2) {
+      auto *hdr = (const uint8_t *)buf.data() + pos;
+      size_t avail = buf.size() - pos;
+      uint64_t len = hdr[1] & 0x7f;
+      size_t hsz = 2;
+      if (len == 126) {
+        if (avail < 4)
+          break;
+        len = (hdr[2] << 8) | hdr[3];
+        hsz = 4;
+      } else if (len == 127) {
+        if (avail < 10)
+          break;
+        len = 0;
+        for (int i = 0; i < 8; ++i)
+          len = (len << 8) | hdr[2 + i];
+        hsz = 10;
+      }
+      if (avail < hsz + len)
+        break;
+      const char *payload = (const char *)hdr + hsz;
+      pos += hsz + len;
+      if (!measure)
+        continue;
+      // {"time":NS,...
+      if ((hdr[0] & 0x0f) == 1 && len > 8)
+        ages.record_signed(now - strtoll(payload + 8, nullptr, 10));
+      ++messages;
+      bytes += len;
+    }
+    buf.erase(0, pos);
+    return true;
+  }
+};
+
+// Serves the ORE updates written into FILE at R messages per second, N in
+// total, to a growing number of loopback websocket clients conflated at
+// 100ms, a tenth of them slow readers. Measures the messages each client
+// receives and their age, from the server building them to the client
+// reading them, which must stay bounded for the slow clients.
+static int bench_websocket(const char *ytpfile, uint64_t count, double rate) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "websocket benchmark requires --ytp-file\n");
+    return 1;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+  auto *yamal = error ? nullptr : ytp_yamal_new(fd, &error);
+  auto *streams = error ? nullptr : ytp_streams_new(yamal, &error);
+  if (error) {
+    fprintf(stderr, "could not open %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  constexpr size_t instruments = 256;
+  vector<ytp_mmnode_offs> chans;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  for (size_t i = 0; i < instruments && !error; ++i) {
+    string ch = "ore/ws/" + to_string(i);
+    chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                         ch.size(), ch.data(),
+                                         encoding.size(), encoding.data(),
+                                         &error));
+  }
+  if (error) {
+    fprintf(stderr, "could not announce streams with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  printf("%-8s %12s %12s %10s %10s %10s %10s %10s %10s\n", "clients",
+         "updates/s", "sent/s", "KB/msg", "msgs/s", "p50 ms", "p99 ms",
+         "slow/s", "slow p99");
+  for (unsigned clients : {100, 250, 500}) {
+    ws_server_cfg_t cfg;
+    cfg.address = "127.0.0.1";
+    cfg.prefix = "ore/ws/";
+    ws_server_t server(yamal, cfg, &error);
+    if (error) {
+      fprintf(stderr, "could not create server with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    // catches up with the updates of the previous cases
+    for (size_t n = 1; n && !error;)
+      n = server.books->poll([](auto &, auto &) {}, [](auto &, auto &) {},
+                             &error);
+    atomic<bool> done = false;
+    atomic<bool> measure = false;
+    atomic<unsigned> failed = 0;
+    vector<ws_bench_client_t> cls(clients);
+    latency_histogram_t fast_ages;
+    latency_histogram_t slow_ages;
+    thread reader([&]() {
+      for (size_t i = 0; i < cls.size(); ++i) {
+        cls[i].slow = i % 10 == 9;
+        failed += !cls[i].connect(server.port);
+      }
+      vector<struct pollfd> fds(cls.size());
+      while (!done) {
+        for (size_t i = 0; i < cls.size(); ++i)
+          fds[i] = {cls[i].fd, POLLIN, 0};
+        ::poll(fds.data(), fds.size(), 1);
+        auto now = fmc_cur_time_ns();
+        for (size_t i = 0; i < cls.size(); ++i) {
+          if (!(fds[i].revents & POLLIN) && !cls[i].slow)
+            continue;
+          auto &ages = cls[i].slow ? slow_ages : fast_ages;
+          failed += !cls[i].read(now, measure, ages);
+        }
+      }
+    });
+    atomic<bool> written = false;
+    thread writer([&]() {
+      fmc_error_t *err = nullptr;
+      ore_bench_write(yamal, chans, count, rate, true, &err);
+      if (err)
+        ++failed;
+      written = true;
+    });
+    // clients are all connected before measuring
+    auto before = chrono::steady_clock::now();
+    while (server.clients.size() < clients && !failed && !error &&
+           chrono::steady_clock::now() - before < chrono::seconds(10))
+      server.poll(&error);
+    auto updates = server.updates;
+    auto messages = server.messages;
+    auto bytes = server.bytes;
+    measure = true;
+    before = chrono::steady_clock::now();
+    while (!written && !error)
+      server.poll(&error);
+    auto ns =
+        chrono::duration<double, nano>(chrono::steady_clock::now() - before)
+            .count();
+    updates = server.updates - updates;
+    messages = server.messages - messages;
+    bytes = server.bytes - bytes;
+    done = true;
+    writer.join();
+    reader.join();
+    uint64_t fast_msgs = 0;
+    uint64_t slow_msgs = 0;
+    for (auto &c : cls) {
+      (c.slow ? slow_msgs : fast_msgs) += c.messages;
+      close(c.fd);
+    }
+    if (error || failed || server.clients.size() != clients) {
+      fprintf(stderr, "websocket benchmark with %u clients failed %s\n",
+              clients, error ? fmc_error_msg(error) : "");
+      return 1;
+    }
+    auto slow = clients / 10;
+    printf("%-8u %12.0f %12.0f %10.1f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+           clients, updates * 1e9 / ns, messages * 1e9 / ns,
+           messages ? bytes / 1e3 / messages : 0.0,
+           fast_msgs * 1e9 / ns / (clients - slow),
+           fast_ages.percentile(50) / 1e6, fast_ages.percentile(99) / 1e6,
+           slow_msgs * 1e9 / ns / slow, slow_ages.percentile(99) / 1e6);
+  }
+  ytp_streams_del(streams, &error);
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
+
+// Top of the book of each channel, by the channel without its prefix
+using bench_tops_t = map<string, pair<ore_level_t, ore_level_t>>;
+
+// Reads the ORE channels with prefix of a yamal into tops, returns the
+// yamal messages read and the time taken in ns.
+static pair<uint64_t, double> bench_read_tops(ytp_yamal_t *yamal,
+                                              const string &prefix,
+                                              bench_tops_t *tops,
+                                              fmc_error_t **error) {
+  ore_filter_t filter;
+  filter.prefix = prefix;
+  ore_books_t books(yamal, move(filter), error);
+  if (*error)
+    return {0, 0.0};
+  uint64_t read = 0;
+  auto on_bbo = [&](const ore_book_event_t &ev, const ore_book_t &book) {
+    auto &top = (*tops)[string(ev.channel.substr(prefix.size()))];
+    top.first = book.bid();
+    top.second = book.ask();
+  };
+  auto before = chrono::steady_clock::now();
+  for (size_t n = 1; n && !*error; read += n)
+    n = books.poll(on_bbo, [](auto &, auto &) {}, error);
+  auto ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                           before)
+                .count();
+  return {read, ns};
+}
+
+// Writes N ORE updates of 1024 instruments into FILE at once, with receive
+// times as if they came at 1M messages per second, and conflates them into
+// FILE.i10, FILE.i100, FILE.m10 and FILE.m100 with an interval or a minimum
+// interval of 10ms and 100ms. Measures the conflation rate and the
+// messages and time downstream readers save, and checks the conflated top
+// of the book of every instrument ends as the original one.
+static int bench_conflation(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "conflation benchmark requires --ytp-file\n");
+    return 1;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+  auto *yamal = error ? nullptr : ytp_yamal_new(fd, &error);
+  auto *streams = error ? nullptr : ytp_streams_new(yamal, &error);
+  if (error) {
+    fprintf(stderr, "could not open %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  constexpr size_t instruments = 1024;
+  vector<ytp_mmnode_offs> chans;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  for (size_t i = 0; i < instruments && !error; ++i) {
+    string ch = "ore/cf/" + to_string(i);
+    chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                         ch.size(), ch.data(),
+                                         encoding.size(), encoding.data(),
+                                         &error));
+  }
+  if (!error)
+    ore_bench_write(yamal, chans, count, 1000000.0, false, &error);
+  bench_tops_t tops;
+  auto [read, read_ns] =
+      error ? make_pair(0UL, 0.0)
+            : bench_read_tops(yamal, "ore/cf/", &tops, &error);
+  if (error) {
+    fprintf(stderr, "could not write updates with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+  printf("%-12s %12s %12s %10s %14s %12s %8s\n", "case", "in msgs",
+         "out msgs", "reduction", "conflate/s", "read ms", "match");
+  printf("%-12s %12" PRIu64 " %12" PRIu64 " %10.1f %14s %12.2f %8s\n",
+         "none", read, read, 1.0, "", read_ns / 1e6, "");
+
+  struct bench_case_t {
+    const char *name;
+    const char *suffix;
+    int64_t interval;
+    int64_t min_interval;
+  };
+  bench_case_t cases[] = {{"interval 10", ".i10", 10000000LL, 0},
+                          {"interval 100", ".i100", 100000000LL, 0},
+                          {"min 10", ".m10", 0, 10000000LL},
+                          {"min 100", ".m100", 0, 100000000LL}};
+  for (auto &c : cases) {
+    auto name = string(ytpfile) + c.suffix;
+    auto ofd = fmc_fopen(name.c_str(), fmc_fmode::READWRITE, &error);
+    auto *out = error ? nullptr : ytp_yamal_new(ofd, &error);
+    if (error) {
+      fprintf(stderr, "could not open %s with error %s\n", name.c_str(),
+              fmc_error_msg(error));
+      return 1;
+    }
+    conflation_cfg_t cfg;
+    cfg.peer = peer;
+    cfg.prefix = "ore/cf/";
+    cfg.interval = c.interval;
+    cfg.min_interval = c.min_interval;
+    uint64_t updates = 0;
+    uint64_t writes = 0;
+    double ns = 0.0;
+    {
+      conflation_t conf(yamal, out, cfg, &error);
+      auto before = chrono::steady_clock::now();
+      for (size_t n = 1; n && !error;)
+        n = conf.poll(&error);
+      if (!error)
+        conf.flush(&error);
+      ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                          before)
+               .count();
+      updates = conf.updates;
+      writes = conf.writes;
+    }
+    bench_tops_t conflated;
+    auto [out_read, out_ns] =
+        error ? make_pair(0UL, 0.0)
+              : bench_read_tops(out, cfg.prefix_out, &conflated, &error);
+    ytp_yamal_del(out, &error);
+    fmc_fclose(ofd, &error);
+    if (error) {
+      fprintf(stderr, "%s conflation failed with error %s\n", c.name,
+              fmc_error_msg(error));
+      return 1;
+    }
+    printf("%-12s %12" PRIu64 " %12" PRIu64 " %10.1f %14.0f %12.2f %8s\n",
+           c.name, read, writes, writes ? (double)read / writes : 0.0,
+           updates * 1e9 / ns, out_ns / 1e6,
+           conflated == tops && out_read == writes ? "yes" : "no");
+  }
+  ytp_streams_del(streams, &error);
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
+
+// CPU time of the calling thread in ns
+static double bench_cpu_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Reads a yamal the way a consumer does, resolving each stream once and
+// skipping the messages of the channels it does not want. Returns the
+// messages wanted and the CPU time taken in ns.
+static pair<uint64_t, double>
+bench_read_selected(ytp_yamal_t *yamal, const vector<string> &patterns,
+                    fmc_error_t **error) {
+  unordered_map<ytp_mmnode_offs, bool> wanted;
+  uint64_t count = 0;
+  uint64_t checksum = 0;
+  auto before = bench_cpu_ns();
+  auto it = ytp_data_begin(yamal, error);
+  while (!*error && !ytp_yamal_term(it)) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+    if (*error)
+      break;
+    auto where = wanted.find(stream);
+    if (where == wanted.end()) {
+      uint64_t aseqno;
+      size_t psz, csz, esz;
+      const char *peer, *channel, *encoding;
+      ytp_mmnode_offs *original, *subscribed;
+      ytp_announcement_lookup(yamal, stream, &aseqno, &psz, &peer, &csz,
+                              &channel, &esz, &encoding, &original,
+                              &subscribed, error);
+      if (*error)
+        break;
+      string_view sv(channel, csz);
+      bool sel = any_of(patterns.begin(), patterns.end(),
+                        [sv](auto &p) { return splitter_match(p, sv); });
+      where = wanted.emplace(stream, sel).first;
+    }
+    if (where->second) {
+      checksum += data[0] + sz;
+      ++count;
+    }
+    it = ytp_yamal_next(yamal, it, error);
+  }
+  auto ns = bench_cpu_ns() - before;
+  if (!checksum && count)
+    fprintf(stderr, "unexpected checksum\n");
+  return {count, ns};
+}
+
+// Writes N messages over 2000 channels into FILE, then compares the CPU
+// time of consumers of 1, 10, 100 and 1000 of the channels reading FILE
+// with reading their own file written by a splitter, FILE.split.0 to
+// FILE.split.3, plus the CPU time of the splitter itself.
+static int bench_splitter(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "splitter benchmark requires --ytp-file\n");
+    return 1;
+  }
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+  auto *yamal = error ? nullptr : ytp_yamal_new(fd, &error);
+  auto *streams = error ? nullptr : ytp_streams_new(yamal, &error);
+  if (error) {
+    fprintf(stderr, "could not open %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  constexpr size_t channels = 2000;
+  vector<ytp_mmnode_offs> chans;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  for (size_t i = 0; i < channels && !error; ++i) {
+    char ch[32];
+    auto csz = snprintf(ch, sizeof ch, "raw/split/%04zu", i);
+    chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                         csz, ch, encoding.size(),
+                                         encoding.data(), &error));
+  }
+  for (uint64_t i = 0; i < count && !error; ++i) {
+    size_t sz = 48 + i % 64;
+    auto *dst = ytp_data_reserve(yamal, sz, &error);
+    if (error)
+      break;
+    memset(dst, 1 + i % 127, sz);
+    ytp_data_commit(yamal, fmc_cur_time_ns(), chans[(i * 7919) % channels],
+                    dst, &error);
+  }
+  if (error) {
+    fprintf(stderr, "could not write messages with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  struct consumer_t {
+    const char *name;
+    vector<string> channels;
+  };
+  vector<consumer_t> consumers = {{"1", {"raw/split/0000"}},
+                                  {"10", {"raw/split/000*"}},
+                                  {"100", {"raw/split/01"}},
+                                  {"1000", {"raw/split/0"}}};
+  vector<fmc_fd> fds;
+  splitter_cfg_t cfg;
+  for (size_t i = 0; i < consumers.size() && !error; ++i) {
+    auto name = string(ytpfile) + ".split." + to_string(i);
+    fds.push_back(fmc_fopen(name.c_str(), fmc_fmode::READWRITE, &error));
+    auto *out = error ? nullptr : ytp_yamal_new(fds.back(), &error);
+    cfg.outputs.push_back({out, consumers[i].channels});
+  }
+  double split_ns = 0.0;
+  uint64_t split_msgs = 0;
+  if (!error) {
+    splitter_t splitter(yamal, cfg, &error);
+    auto before = bench_cpu_ns();
+    for (size_t n = 1; n && !error;)
+      n = splitter.poll(&error);
+    split_ns = bench_cpu_ns() - before;
+    split_msgs = splitter.messages;
+  }
+  if (error) {
+    fprintf(stderr, "could not split with error %s\n", fmc_error_msg(error));
+    return 1;
+  }
+
+  printf("%-10s %12s %14s %14s %10s\n", "channels", "messages",
+         "shared ms cpu", "split ms cpu", "speedup");
+  for (size_t i = 0; i < consumers.size(); ++i) {
+    auto [shared, shared_ns] =
+        bench_read_selected(yamal, consumers[i].channels, &error);
+    auto [own, own_ns] = error ? make_pair(0UL, 0.0)
+                               : bench_read_selected(cfg.outputs[i].yamal,
+                                                     consumers[i].channels,
+                                                     &error);
+    if (error || own != shared) {
+      fprintf(stderr, "consumer of %s channels failed %s\n",
+              consumers[i].name, error ? fmc_error_msg(error) : "");
+      return 1;
+    }
+    printf("%-10s %12" PRIu64 " %14.2f %14.2f %10.1f\n", consumers[i].name,
+           shared, shared_ns / 1e6, own_ns / 1e6, shared_ns / own_ns);
+  }
+  printf("splitter   %12" PRIu64 " %14.2f\n", split_msgs, split_ns / 1e6);
+  for (size_t i = 0; i < fds.size(); ++i) {
+    ytp_yamal_del(cfg.outputs[i].yamal, &error);
+    fmc_fclose(fds[i], &error);
+  }
+  ytp_streams_del(streams, &error);
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
+
+// Writes N messages over 2000 channels into FILE, indexing them into
+// FILE.idx as the feed handlers do, and into FILE.plain without an index.
+// Then compares the CPU time of readers of 1, 10 and 100 of the channels
+// scanning FILE with reading them through the index.
+static int bench_index(const char *ytpfile, uint64_t count) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "index benchmark requires --ytp-file\n");
+    return 1;
+  }
+  constexpr size_t channels = 2000;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  auto write = [&](const string &name, ytp_index_writer_t *index,
+                   ytp_yamal_t **out, fmc_fd *ofd) {
+    *ofd = fmc_fopen(name.c_str(), fmc_fmode::READWRITE, &error);
+    auto *yamal = error ? nullptr : ytp_yamal_new(*ofd, &error);
+    auto *streams = error ? nullptr : ytp_streams_new(yamal, &error);
+    vector<ytp_mmnode_offs> chans;
+    for (size_t i = 0; i < channels && !error; ++i) {
+      char ch[32];
+      auto csz = snprintf(ch, sizeof ch, "raw/index/%04zu", i);
+      chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                           csz, ch, encoding.size(),
+                                           encoding.data(), &error));
+    }
+    auto before = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count && !error; ++i) {
+      size_t sz = 48 + i % 64;
+      auto *dst = ytp_data_reserve(yamal, sz, &error);
+      if (error)
+        break;
+      memset(dst, 1 + i % 127, sz);
+      auto stream = chans[(i * 7919) % channels];
+      auto it = ytp_data_commit(yamal, fmc_cur_time_ns(), stream, dst, &error);
+      if (index && !error)
+        index->append(stream, ytp_data_tell(yamal, it, &error), &error);
+    }
+    auto ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                             before)
+                  .count();
+    if (streams)
+      ytp_streams_del(streams, &error);
+    *out = yamal;
+    return ns / count;
+  };
+
+  auto idxname = string(ytpfile) + ".idx";
+  auto idxfd = fmc_fopen(idxname.c_str(), fmc_fmode::READWRITE, &error);
+  unique_ptr<ytp_index_writer_t> index;
+  if (!error)
+    index = make_unique<ytp_index_writer_t>(idxfd, &error);
+  ytp_yamal_t *yamal = nullptr;
+  ytp_yamal_t *plain = nullptr;
+  fmc_fd fd = -1;
+  fmc_fd plainfd = -1;
+  double indexed_ns = error ? 0.0 : write(ytpfile, index.get(), &yamal, &fd);
+  double plain_ns =
+      error ? 0.0 : write(string(ytpfile) + ".plain", nullptr, &plain,
+                          &plainfd);
+  if (error) {
+    fprintf(stderr, "could not write messages with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+  printf("commit ns/msg %.1f, with index %.1f\n\n", plain_ns, indexed_ns);
+
+  printf("%-10s %12s %14s %14s %10s\n", "channels", "messages",
+         "scan ms cpu", "index ms cpu", "speedup");
+  for (auto [name, pattern] :
+       {make_pair("1", "raw/index/0000"), make_pair("10", "raw/index/000*"),
+        make_pair("100", "raw/index/01")}) {
+    vector<string> patterns = {pattern};
+    auto [scanned, scan_ns] = bench_read_selected(yamal, patterns, &error);
+    uint64_t indexed = 0;
+    double index_ns = 0.0;
+    if (!error) {
+      auto before = bench_cpu_ns();
+      ytp_index_reader_t reader(yamal, idxfd, &error);
+      reader.streams([&](ytp_mmnode_offs stream) {
+        uint64_t seqno;
+        size_t psz, csz, esz;
+        const char *p, *c, *e;
+        ytp_mmnode_offs *original, *subscribed;
+        ytp_announcement_lookup(yamal, stream, &seqno, &psz, &p, &csz, &c,
+                                &esz, &e, &original, &subscribed, &error);
+        return !error && splitter_match(pattern, string_view(c, csz));
+      });
+      uint64_t seqno;
+      int64_t ts;
+      ytp_mmnode_offs stream;
+      size_t sz;
+      const char *data;
+      uint64_t last = 0;
+      while (!error &&
+             reader.next(&seqno, &ts, &stream, &sz, &data, &error)) {
+        if (seqno <= last)
+          fprintf(stderr, "indexed messages out of order\n");
+        last = seqno;
+        ++indexed;
+      }
+      index_ns = bench_cpu_ns() - before;
+    }
+    if (error || indexed != scanned) {
+      fprintf(stderr, "reader of %s channels failed %s\n", name,
+              error ? fmc_error_msg(error) : "");
+      return 1;
+    }
+    printf("%-10s %12" PRIu64 " %14.2f %14.2f %10.1f\n", name, scanned,
+           scan_ns / 1e6, index_ns / 1e6, scan_ns / index_ns);
+  }
+  index.reset();
+  fmc_fclose(idxfd, &error);
+  ytp_yamal_del(plain, &error);
+  fmc_fclose(plainfd, &error);
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
+
+// Feeds N binance samples at R per second to a feed handler engine writing
+// FILE.plain, then FILE with the ring FILE.ring, while a parser thread
+// parses them into ORE, from the file or from the ring and the file, and
+// reports the time from receive to the commit of the ORE message.
+static int bench_ring(const char *ytpfile, uint64_t count, double rate) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "ring benchmark requires --ytp-file\n");
+    return 1;
+  }
+  auto *venue = venue_find("binance");
+  vector<venue_route_t> routes(venue->samples.size());
+  for (size_t i = 0; i < routes.size(); ++i)
+    venue->route(venue->samples[i], &routes[i]);
+
+  struct ordinal_t {
+    uint64_t read = 0;
+    uint64_t done = 0;
+  };
+  auto run = [&](const string &name, const string &ringname,
+                 latency_histogram_t &lat, uint64_t *fromring) {
+    auto fd = fmc_fopen(name.c_str(), fmc_fmode::READWRITE, &error);
+    auto *yamal = error ? nullptr : ytp_yamal_new(fd, &error);
+    auto outname = name + ".ore";
+    auto ofd = error ? -1 : fmc_fopen(outname.c_str(), fmc_fmode::READWRITE,
+                                      &error);
+    auto *out = error ? nullptr : ytp_yamal_new(ofd, &error);
+    auto *streams = error ? nullptr : ytp_streams_new(out, &error);
+    // the parser creates the ring and the handler attaches to it
+    fmc_fd rfd = -1;
+    unique_ptr<spsc_ring_t> ring;
+    if (!error && !ringname.empty()) {
+      unlink(ringname.c_str());
+      rfd = fmc_fopen(ringname.c_str(), fmc_fmode::READWRITE, &error);
+      if (!error)
+        ring = make_unique<spsc_ring_t>(rfd, spsc_ring_capacity, &error);
+    }
+    feed_engine_cfg_t cfg;
+    cfg.peer = "feed-perf";
+    cfg.prefix = "raw/binance/";
+    cfg.ring = ringname;
+    unique_ptr<feed_engine_t> engine;
+    if (!error)
+      engine = make_unique<feed_engine_t>(*venue, yamal, move(cfg), &error);
+    for (auto &route : routes) {
+      if (!error)
+        engine->subscribe(string(route.sec), &error);
+    }
+    if (error) {
+      fprintf(stderr, "could not create engine with error %s\n",
+              fmc_error_msg(error));
+      return false;
+    }
+
+    atomic<bool> failed = false;
+    thread parser([&]() {
+      fmc_error_t *err = nullptr;
+      struct chan_t {
+        parser_t parser;
+        ytp_mmnode_offs out = 0;
+        ordinal_t ord;
+      };
+      unordered_map<ytp_mmnode_offs, chan_t> chans;
+      ore_writer_t writer;
+      auto chan = [&](ytp_mmnode_offs stream) -> chan_t * {
+        auto [where, added] = chans.try_emplace(stream);
+        if (!added)
+          return &where->second;
+        uint64_t seqno;
+        size_t psz, csz, esz;
+        const char *p, *c, *e;
+        ytp_mmnode_offs *original, *subscribed;
+        ytp_announcement_lookup(yamal, stream, &seqno, &psz, &p, &csz, &c,
+                                &esz, &e, &original, &subscribed, &err);
+        if (err)
+          return nullptr;
+        auto sv = string_view(c, csz).substr(strlen("raw/"));
+        where->second.parser = venue->resolver(sv, &err).second;
+        auto ch = "ore/" + string(sv);
+        where->second.out = ytp_streams_announce(
+            streams, psz, p, ch.size(), ch.data(), esz, e, &err);
+        return err ? nullptr : &where->second;
+      };
+      auto parse = [&](chan_t *c, int64_t ts, string_view data) {
+        uint64_t last = 0;
+        writer.reset();
+        c->parser(data, &writer, ts, &last, false, &err);
+        if (err)
+          return;
+        auto *dst = ytp_data_reserve(out, writer.size(), &err);
+        if (err)
+          return;
+        writer.encode(dst);
+        ytp_data_commit(out, fmc_cur_time_ns(), c->out, dst, &err);
+        lat.record_signed(fmc_cur_time_ns() - ts);
+      };
+      auto it = ytp_data_begin(yamal, &err);
+      uint64_t read = 0;
+      while (!err && read < count) {
+        if (auto *rec = ring ? ring->peek() : nullptr; rec) {
+          auto *c = chan(rec->stream);
+          if (c && rec->ordinal == c->ord.done) {
+            ++c->ord.done;
+            ++*fromring;
+            parse(c, rec->ts, string_view((const char *)(rec + 1),
+                                          rec->size));
+          }
+          ring->pop();
+          continue;
+        }
+        if (ytp_yamal_term(it)) {
+          this_thread::yield();
+          continue;
+        }
+        uint64_t seqno;
+        int64_t ts;
+        ytp_mmnode_offs stream;
+        size_t sz;
+        const char *data;
+        ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, &err);
+        auto *c = err ? nullptr : chan(stream);
+        if (c && c->ord.read++ == c->ord.done) {
+          ++c->ord.done;
+          parse(c, ts, string_view(data, sz));
+        }
+        read += !err;
+        it = err ? it : ytp_yamal_next(yamal, it, &err);
+      }
+      if (err) {
+        fprintf(stderr, "could not parse with error %s\n",
+                fmc_error_msg(err));
+        failed = true;
+      }
+    });
+    auto period = 1e9 / rate;
+    auto start = fmc_cur_time_ns();
+    for (uint64_t i = 0; i < count && !failed; ++i) {
+      // yields so that the parser runs even on a single core
+      while (fmc_cur_time_ns() < start + (int64_t)(i * period))
+        this_thread::yield();
+      auto msg = venue->samples[i % venue->samples.size()];
+      engine->receive(msg.data(), msg.size(), fmc_cur_time_ns());
+    }
+    parser.join();
+    engine.reset();
+    ring.reset();
+    if (rfd != -1)
+      fmc_fclose(rfd, &error);
+    ytp_streams_del(streams, &error);
+    ytp_yamal_del(out, &error);
+    fmc_fclose(ofd, &error);
+    ytp_yamal_del(yamal, &error);
+    fmc_fclose(fd, &error);
+    return !failed;
+  };
+
+  printf("%-8s %10s %10s %10s %10s %10s %10s\n", "mode", "messages",
+         "from ring", "p50 us", "p99 us", "p99.9 us", "max us");
+  for (bool with_ring : {false, true}) {
+    latency_histogram_t lat;
+    uint64_t fromring = 0;
+    auto name = with_ring ? string(ytpfile) : string(ytpfile) + ".plain";
+    auto ringname = with_ring ? string(ytpfile) + ".ring" : string();
+    if (!run(name, ringname, lat, &fromring))
+      return 1;
+    printf("%-8s %10" PRIu64 " %10" PRIu64 " %10.2f %10.2f %10.2f %10.2f\n",
+           with_ring ? "ring" : "file", lat.count(), fromring,
+           lat.percentile(50.0) / 1e3, lat.percentile(99.0) / 1e3,
+           lat.percentile(99.9) / 1e3, lat.max() / 1e3);
+  }
+  return 0;
+}
+
+// Commits N messages at R per second into FILE.default, then into
+// FILE.prefault with 64MB prefaulted ahead of the writer, then into
+// FILE.mlock with huge pages advised and the window locked as well, and
+// reports the tail of the commit time and the page faults of the writer.
+static int bench_pager(const char *ytpfile, uint64_t count, double rate) {
+  fmc_error_t *error = nullptr;
+  if (!ytpfile) {
+    fprintf(stderr, "pager benchmark requires --ytp-file\n");
+    return 1;
+  }
+  constexpr size_t channels = 64;
+  string peer = "feed-perf";
+  string encoding = "Content-Type application/msgpack\n"
+                    "Content-Schema ore1.1.3";
+  tsc_clock::ns_per_tick();
+  printf("%-10s %9s %9s %9s %9s %9s %10s %10s\n", "pages", "p50 ns",
+         "p99 ns", "p99.9 ns", "p99.99 ns", "max us", "minflt", "majflt");
+  for (auto name : {"default", "prefault", "mlock"}) {
+    yamal_pager_cfg_t pcfg;
+    if (name != string_view("default"))
+      pcfg.prefault = 64ULL << 20;
+    if (name == string_view("mlock"))
+      pcfg.hugepages = pcfg.mlock = true;
+    auto file = string(ytpfile) + "." + name;
+    unlink(file.c_str());
+    auto fd = fmc_fopen(file.c_str(), fmc_fmode::READWRITE, &error);
+    auto *yamal = error ? nullptr : ytp_yamal_new(fd, &error);
+    auto *streams = error ? nullptr : ytp_streams_new(yamal, &error);
+    vector<ytp_mmnode_offs> chans;
+    for (size_t i = 0; i < channels && !error; ++i) {
+      string ch = "raw/pager/" + to_string(i);
+      chans.push_back(ytp_streams_announce(streams, peer.size(), peer.data(),
+                                           ch.size(), ch.data(),
+                                           encoding.size(), encoding.data(),
+                                           &error));
+    }
+    unique_ptr<yamal_pager_t> pager;
+    if (!error && pcfg.enabled()) {
+      pager = make_unique<yamal_pager_t>(fd, pcfg, &error);
+      if (!error)
+        pager->start();
+    }
+    if (error) {
+      fprintf(stderr, "could not open %s with error %s\n", file.c_str(),
+              fmc_error_msg(error));
+      return 1;
+    }
+    latency_histogram_t lat;
+    struct rusage before, after;
+    getrusage(RUSAGE_THREAD, &before);
+    auto period = 1e9 / rate;
+    auto start = fmc_cur_time_ns();
+    for (uint64_t i = 0; i < count && !error; ++i) {
+      while (fmc_cur_time_ns() < start + (int64_t)(i * period))
+        ;
+      size_t sz = 128 + i % 256;
+      auto t0 = tsc_clock::now();
+      auto *dst = ytp_data_reserve(yamal, sz, &error);
+      if (error)
+        break;
+      memset(dst, 1 + i % 127, sz);
+      auto it = ytp_data_commit(yamal, fmc_cur_time_ns(),
+                                chans[i % channels], dst, &error);
+      lat.record(tsc_clock::ns(tsc_clock::now() - t0));
+      if (pager && !error)
+        pager->advance(ytp_data_tell(yamal, it, &error));
+    }
+    getrusage(RUSAGE_THREAD, &after);
+    string msg;
+    if (pager) {
+      pager->stop();
+      if (pager->failed(&msg))
+        fprintf(stderr, "%s pager failed with error %s\n", name,
+                msg.c_str());
+    }
+    if (error) {
+      fprintf(stderr, "could not write %s with error %s\n", file.c_str(),
+              fmc_error_msg(error));
+      return 1;
+    }
+    printf("%-10s %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64
+           " %9.1f %10ld %10ld\n",
+           name, lat.percentile(50.0), lat.percentile(99.0),
+           lat.percentile(99.9), lat.percentile(99.99), lat.max() / 1e3,
+           after.ru_minflt - before.ru_minflt,
+           after.ru_majflt - before.ru_majflt);
+    pager.reset();
+    ytp_streams_del(streams, &error);
+    ytp_yamal_del(yamal, &error);
+    fmc_fclose(fd, &error);
+  }
+  return 0;
+}
+
+int main(int argc, const char **argv) {
+  fmc_error_t *error = nullptr;
+  const char *bench = nullptr;
+  const char *count = nullptr;
+  const char *ytpfile = nullptr;
+  const char *rate = nullptr;
+  fmc_cmdline_opt_t options[] = {/* 0 */ {"--help", false, NULL},
+                                 /* 1 */ {"--bench", true, &bench},
+                                 /* 2 */ {"--count", false, &count},
+                                 /* 3 */ {"--ytp-file", false, &ytpfile},
+                                 /* 4 */ {"--rate", false, &rate},
+                                 {NULL}};
+  fmc_cmdline_opt_proc(argc, argv, options, &error);
+  if (options[0].set) {
+    printf("feed-perf --bench BENCH [--count N] [--ytp-file FILE] "
+           "[--rate R]\n\n"
+           "Feed micro benchmarks.\n\n"
+           "Runs the benchmark BENCH N times, available benchmarks:\n"
+           "  encode  ORE encoding with cmp against the recording writer\n"
+           "  schema  typed fixed width ORE encoding and decoding\n"
+           "  book    ORE decoding and book building over the captured "
+           "file FILE,\n"
+           "          N passes over the file, 1 by default\n"
+           "  VENUE   feed handler engine routing and yamal writing "
+           "into FILE and\n"
+           "          parsing of recorded messages of the venue VENUE, "
+           "binance,\n"
+           "          coinbase, kraken or okx, 1000000 messages by "
+           "default\n"
+           "  deflate permessage-deflate inflate cost and TLS record fill "
+           "time at R\n"
+           "          messages per second, 1000 by default, for N raw "
+           "messages of\n"
+           "          each venue in FILE, 100000 by default, or the venue "
+           "samples\n"
+           "  contention  4 feed handler engines writing N messages each "
+           "at once into\n"
+           "          FILE, then each into FILE.0 to FILE.3, and reading "
+           "back the\n"
+           "          file and the merge of the 4 files, 1000000 by "
+           "default\n"
+           "  fanout  tcp distribution of FILE, after writing N messages "
+           "into it, to\n"
+           "          1, 4, 16 and 64 loopback subscribers, 1000000 by "
+           "default\n"
+           "  multicast  loopback multicast of FILE, after writing N "
+           "messages into\n"
+           "          it, with gap fill, 1000000 by default\n"
+           "  kafka   N messages written into FILE while a kafka sink "
+           "produces them\n"
+           "          to a loopback broker stand-in, 1000000 by default\n"
+           "  websocket  N ORE updates written into FILE at R per second, "
+           "400000 and\n"
+           "          200000 by default, served conflated to 100, 250 and "
+           "500 loopback\n"
+           "          websocket clients\n"
+           "  conflation  N ORE updates written into FILE at once, "
+           "1000000 by default,\n"
+           "          conflated at 10ms and 100ms intervals into FILE.i10, "
+           "FILE.i100,\n"
+           "          FILE.m10 and FILE.m100\n"
+           "  splitter  N messages over 2000 channels written into FILE, "
+           "1000000 by\n"
+           "          default, read by consumers of 1 to 1000 channels from "
+           "FILE and\n"
+           "          from their own file split into FILE.split.0 to "
+           "FILE.split.3\n"
+           "  index   N messages over 2000 channels written into FILE "
+           "with an index,\n"
+           "          1000000 by default, read by readers of 1 to 100 "
+           "channels by\n"
+           "          scanning FILE and through the index\n"
+           "  ring    N binance messages at R per second, 200000 and "
+           "100000 by default,\n"
+           "          through a feed handler and a parser thread, without "
+           "and with\n"
+           "          the ring FILE.ring, receive to ORE commit latency\n"
+           "  pager   N messages committed at R per second, 1000000 and "
+           "1000000 by\n"
+           "          default, into FILE.default, FILE.prefault and "
+           "FILE.mlock, commit\n"
+           "          time tail without and with the pages prefaulted "
+           "and locked\n");
+    return 0;
+  }
+  if (error) {
+    fprintf(stderr, "could not process args: %s\n", fmc_error_msg(error));
+    return 1;
+  }
+  uint64_t n = count ? stoull(count) : 10000000ULL;
+  string_view name = bench;
+  if (name == "book")
+    return bench_book(ytpfile, count ? n : 1);
+  if (auto *venue = venue_find(name); venue)
+    return bench_venue(*venue, ytpfile, count ? n : 1000000ULL);
+  if (name == "deflate")
+    return bench_deflate(ytpfile, count ? n : 100000ULL,
+                         rate ? stod(rate) : 1000.0);
+  if (name == "contention")
+    return bench_contention(ytpfile, count ? n : 1000000ULL);
+  if (name == "fanout")
+    return bench_fanout(ytpfile, count ? n : 1000000ULL);
+  if (name == "multicast")
+    return bench_multicast(ytpfile, count ? n : 1000000ULL);
+  if (name == "kafka")
+    return bench_kafka(ytpfile, count ? n : 1000000ULL);
+  if (name == "websocket")
+    return bench_websocket(ytpfile, count ? n : 400000ULL,
+                           rate ? stod(rate) : 200000.0);
+  if (name == "conflation")
+    return bench_conflation(ytpfile, count ? n : 1000000ULL);
+  if (name == "splitter")
+    return bench_splitter(ytpfile, count ? n : 1000000ULL);
+  if (name == "index")
+    return bench_index(ytpfile, count ? n : 1000000ULL);
+  if (name == "pager")
+    return bench_pager(ytpfile, count ? n : 1000000ULL,
+                       rate ? stod(rate) : 1000000.0);
+  if (name == "ring")
+    return bench_ring(ytpfile, count ? n : 200000ULL,
+                      rate ? stod(rate) : 100000.0);
+  if (name == "encode")
+    return bench_encode(n);
+  if (name == "schema")
+    return bench_schema(n);
+  fprintf(stderr, "unknown benchmark %s\n", bench);
+  return 1;
+}
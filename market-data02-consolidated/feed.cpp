@@ -7,59 +7,124 @@
 
 #include <fmc/component.h>
 
+#include "venue-component.hpp"
+
 struct fmc_reactor_api_v1 *_reactor;
 
-struct binance_feed_handler_component *
-binance_feed_handler_component_new(struct fmc_cfg_sect_item *cfg,
-                                   struct fmc_reactor_ctx *ctx,
-                                   char **inp_tps) noexcept;
+struct runner_t *feed_parser_component_new(struct fmc_cfg_sect_item *cfg,
+                                           struct fmc_reactor_ctx *ctx,
+                                           char **inp_tps) noexcept;
 
-void binance_feed_handler_component_del(
-    struct binance_feed_handler_component *comp) noexcept;
+void feed_parser_component_del(struct runner_t *comp) noexcept;
 
-extern struct fmc_cfg_node_spec *binance_feed_handler_cfg;
+extern struct fmc_cfg_node_spec *feed_parser_cfg;
 
-extern size_t binance_feed_handler_struct_sz;
+extern size_t feed_parser_struct_sz;
 
-struct kraken_feed_handler_component *
-kraken_feed_handler_component_new(struct fmc_cfg_sect_item *cfg,
-                                  struct fmc_reactor_ctx *ctx,
-                                  char **inp_tps) noexcept;
+struct latency_analytics_t *
+latency_analytics_component_new(struct fmc_cfg_sect_item *cfg,
+                                struct fmc_reactor_ctx *ctx,
+                                char **inp_tps) noexcept;
 
-void kraken_feed_handler_component_del(
-    struct kraken_feed_handler_component *comp) noexcept;
+void latency_analytics_component_del(
+    struct latency_analytics_t *comp) noexcept;
 
-extern struct fmc_cfg_node_spec *kraken_feed_handler_cfg;
+extern struct fmc_cfg_node_spec *latency_analytics_cfg;
 
-extern size_t kraken_feed_handler_struct_sz;
+extern size_t latency_analytics_struct_sz;
 
-struct runner_t *feed_parser_component_new(struct fmc_cfg_sect_item *cfg,
-                                           struct fmc_reactor_ctx *ctx,
-                                           char **inp_tps) noexcept;
+struct tcp_distributor_comp_t *
+tcp_distributor_component_new(struct fmc_cfg_sect_item *cfg,
+                              struct fmc_reactor_ctx *ctx,
+                              char **inp_tps) noexcept;
 
-void feed_parser_component_del(struct runner_t *comp) noexcept;
+void tcp_distributor_component_del(
+    struct tcp_distributor_comp_t *comp) noexcept;
 
-extern struct fmc_cfg_node_spec *feed_parser_cfg;
+extern struct fmc_cfg_node_spec *tcp_distributor_cfg;
 
-extern size_t feed_parser_struct_sz;
+extern size_t tcp_distributor_struct_sz;
+
+struct tcp_receiver_comp_t *
+tcp_receiver_component_new(struct fmc_cfg_sect_item *cfg,
+                           struct fmc_reactor_ctx *ctx,
+                           char **inp_tps) noexcept;
+
+void tcp_receiver_component_del(struct tcp_receiver_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *tcp_receiver_cfg;
+
+extern size_t tcp_receiver_struct_sz;
+
+struct mcast_publisher_comp_t *
+mcast_publisher_component_new(struct fmc_cfg_sect_item *cfg,
+                              struct fmc_reactor_ctx *ctx,
+                              char **inp_tps) noexcept;
+
+void mcast_publisher_component_del(
+    struct mcast_publisher_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *mcast_publisher_cfg;
+
+extern size_t mcast_publisher_struct_sz;
+
+struct mcast_receiver_comp_t *
+mcast_receiver_component_new(struct fmc_cfg_sect_item *cfg,
+                             struct fmc_reactor_ctx *ctx,
+                             char **inp_tps) noexcept;
+
+void mcast_receiver_component_del(
+    struct mcast_receiver_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *mcast_receiver_cfg;
+
+extern size_t mcast_receiver_struct_sz;
+
+struct kafka_sink_comp_t *
+kafka_sink_component_new(struct fmc_cfg_sect_item *cfg,
+                         struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept;
+
+void kafka_sink_component_del(struct kafka_sink_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *kafka_sink_cfg;
+
+extern size_t kafka_sink_struct_sz;
+
+struct ws_server_comp_t *
+ws_server_component_new(struct fmc_cfg_sect_item *cfg,
+                        struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept;
+
+void ws_server_component_del(struct ws_server_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *ws_server_cfg;
+
+extern size_t ws_server_struct_sz;
+
+struct conflation_comp_t *
+conflation_component_new(struct fmc_cfg_sect_item *cfg,
+                         struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept;
+
+void conflation_component_del(struct conflation_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *conflation_cfg;
+
+extern size_t conflation_struct_sz;
+
+struct splitter_comp_t *
+splitter_component_new(struct fmc_cfg_sect_item *cfg,
+                       struct fmc_reactor_ctx *ctx, char **inp_tps) noexcept;
+
+void splitter_component_del(struct splitter_comp_t *comp) noexcept;
+
+extern struct fmc_cfg_node_spec *splitter_cfg;
+
+extern size_t splitter_struct_sz;
 
 struct fmc_component_def_v1 components[] = {
-    {
-        .tp_name = "binance-feed-handler",
-        .tp_descr = "Binance feed handler component",
-        .tp_size = binance_feed_handler_struct_sz,
-        .tp_cfgspec = binance_feed_handler_cfg,
-        .tp_new = (fmc_newfunc)binance_feed_handler_component_new,
-        .tp_del = (fmc_delfunc)binance_feed_handler_component_del,
-    },
-    {
-        .tp_name = "kraken-feed-handler",
-        .tp_descr = "Kraken feed handler component",
-        .tp_size = kraken_feed_handler_struct_sz,
-        .tp_cfgspec = kraken_feed_handler_cfg,
-        .tp_new = (fmc_newfunc)kraken_feed_handler_component_new,
-        .tp_del = (fmc_delfunc)kraken_feed_handler_component_del,
-    },
+    venue_component_def<binance_venue>(),
+    venue_component_def<kraken_venue>(),
+    venue_component_def<coinbase_venue>(),
+    venue_component_def<okx_venue>(),
     {
         .tp_name = "feed-parser",
         .tp_descr = "Feed parser component",
@@ -68,6 +133,78 @@ struct fmc_component_def_v1 components[] = {
         .tp_new = (fmc_newfunc)feed_parser_component_new,
         .tp_del = (fmc_delfunc)feed_parser_component_del,
     },
+    {
+        .tp_name = "latency-analytics",
+        .tp_descr = "One-way latency analytics component",
+        .tp_size = latency_analytics_struct_sz,
+        .tp_cfgspec = latency_analytics_cfg,
+        .tp_new = (fmc_newfunc)latency_analytics_component_new,
+        .tp_del = (fmc_delfunc)latency_analytics_component_del,
+    },
+    {
+        .tp_name = "tcp-distributor",
+        .tp_descr = "Yamal TCP distributor component",
+        .tp_size = tcp_distributor_struct_sz,
+        .tp_cfgspec = tcp_distributor_cfg,
+        .tp_new = (fmc_newfunc)tcp_distributor_component_new,
+        .tp_del = (fmc_delfunc)tcp_distributor_component_del,
+    },
+    {
+        .tp_name = "tcp-receiver",
+        .tp_descr = "Yamal TCP receiver component",
+        .tp_size = tcp_receiver_struct_sz,
+        .tp_cfgspec = tcp_receiver_cfg,
+        .tp_new = (fmc_newfunc)tcp_receiver_component_new,
+        .tp_del = (fmc_delfunc)tcp_receiver_component_del,
+    },
+    {
+        .tp_name = "mcast-publisher",
+        .tp_descr = "Yamal UDP multicast publisher component",
+        .tp_size = mcast_publisher_struct_sz,
+        .tp_cfgspec = mcast_publisher_cfg,
+        .tp_new = (fmc_newfunc)mcast_publisher_component_new,
+        .tp_del = (fmc_delfunc)mcast_publisher_component_del,
+    },
+    {
+        .tp_name = "mcast-receiver",
+        .tp_descr = "Yamal UDP multicast receiver component",
+        .tp_size = mcast_receiver_struct_sz,
+        .tp_cfgspec = mcast_receiver_cfg,
+        .tp_new = (fmc_newfunc)mcast_receiver_component_new,
+        .tp_del = (fmc_delfunc)mcast_receiver_component_del,
+    },
+    {
+        .tp_name = "kafka-sink",
+        .tp_descr = "Kafka protocol sink component",
+        .tp_size = kafka_sink_struct_sz,
+        .tp_cfgspec = kafka_sink_cfg,
+        .tp_new = (fmc_newfunc)kafka_sink_component_new,
+        .tp_del = (fmc_delfunc)kafka_sink_component_del,
+    },
+    {
+        .tp_name = "ws-server",
+        .tp_descr = "Conflated BBO and trade websocket server component",
+        .tp_size = ws_server_struct_sz,
+        .tp_cfgspec = ws_server_cfg,
+        .tp_new = (fmc_newfunc)ws_server_component_new,
+        .tp_del = (fmc_delfunc)ws_server_component_del,
+    },
+    {
+        .tp_name = "conflation",
+        .tp_descr = "Throttled BBO conflation component",
+        .tp_size = conflation_struct_sz,
+        .tp_cfgspec = conflation_cfg,
+        .tp_new = (fmc_newfunc)conflation_component_new,
+        .tp_del = (fmc_delfunc)conflation_component_del,
+    },
+    {
+        .tp_name = "splitter",
+        .tp_descr = "Yamal splitter into per consumer channel subsets",
+        .tp_size = splitter_struct_sz,
+        .tp_cfgspec = splitter_cfg,
+        .tp_new = (fmc_newfunc)splitter_component_new,
+        .tp_del = (fmc_delfunc)splitter_component_del,
+    },
     {NULL},
 };
 
@@ -0,0 +1,217 @@
+"""
+        COPYRIGHT (c) 2019-2023 by Featuremine Corporation.
+
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+"""
+
+import argparse
+import socketserver
+import struct
+import threading
+import time
+import zlib
+
+# Stand-in for a Kafka broker that accepts the Produce v3 requests of the
+# kafka-sink component, checks and decodes their record batches and
+# acknowledges them, optionally late or with errors.
+
+crc_table = []
+for i in range(256):
+    crc = i
+    for _ in range(8):
+        crc = (crc >> 1) ^ 0x82f63b78 if crc & 1 else crc >> 1
+    crc_table.append(crc)
+
+
+def crc32c(data):
+    crc = 0xffffffff
+    for b in data:
+        crc = crc_table[(crc ^ b) & 0xff] ^ (crc >> 8)
+    return crc ^ 0xffffffff
+
+
+class reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        val = struct.unpack_from(fmt, self.data, self.pos)
+        self.pos += struct.calcsize(fmt)
+        return val[0] if len(val) == 1 else val
+
+    def bytes(self, size):
+        val = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return val
+
+    def string(self):
+        size = self.take(">h")
+        return None if size < 0 else self.bytes(size).decode()
+
+    def varint(self):
+        shift = 0
+        z = 0
+        while True:
+            b = self.data[self.pos]
+            self.pos += 1
+            z |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return (z >> 1) ^ -(z & 1)
+
+
+def decode_batch(data, verify, keep=False):
+    r = reader(data)
+    base, length, epoch, magic, crc = r.take(">qiibI")
+    if magic != 2:
+        raise ValueError("unsupported magic {}".format(magic))
+    if verify and crc32c(data[21:]) != crc:
+        raise ValueError("crc mismatch")
+    attributes, last_delta, first_ts, max_ts, pid, pepoch, seq, count = r.take(">hiqqqhii")
+    records = data[r.pos:]
+    codec = attributes & 7
+    if codec == 1:
+        records = zlib.decompress(records, 31)
+    elif codec != 0:
+        raise ValueError("unsupported compression {}".format(codec))
+    rr = reader(records)
+    values = 0
+    kept = []
+    for i in range(count):
+        size = rr.varint()
+        end = rr.pos + size
+        rr.pos += 1
+        rr.varint()
+        if rr.varint() != i:
+            raise ValueError("invalid offset delta")
+        key = rr.bytes(rr.varint())
+        size = rr.varint()
+        values += max(size, 0)
+        if keep:
+            kept.append((key, rr.bytes(size)))
+        rr.pos = end
+    if rr.pos != len(records) or last_delta != count - 1:
+        raise ValueError("invalid records")
+    return count, values, len(data), kept
+
+
+class broker:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.offsets = {}
+        self.records = 0
+        self.values = 0
+        self.wire = 0
+        self.requests = 0
+        self.corrupt = 0
+        # key and value of every record acknowledged, with --keep
+        self.kept = []
+
+    def produce(self, r):
+        r.string()
+        acks, timeout = r.take(">hi")
+        responses = []
+        for _ in range(r.take(">i")):
+            topic = r.string()
+            partitions = []
+            for _ in range(r.take(">i")):
+                partition = r.take(">i")
+                batch = r.bytes(r.take(">i"))
+                error = 0
+                with self.lock:
+                    self.requests += 1
+                    fail = self.args.fail_every and self.requests % self.args.fail_every == 0
+                base = -1
+                if fail:
+                    error = 7
+                else:
+                    try:
+                        count, values, wire, kept = decode_batch(
+                            batch, not self.args.no_verify, self.args.keep)
+                    except ValueError as e:
+                        print("invalid batch:", e)
+                        error = 2  # CORRUPT_MESSAGE
+                        with self.lock:
+                            self.corrupt += 1
+                if not error:
+                    with self.lock:
+                        base = self.offsets.get((topic, partition), 0)
+                        self.offsets[(topic, partition)] = base + count
+                        self.records += count
+                        self.values += values
+                        self.wire += wire
+                        self.kept.extend(kept)
+                partitions.append((partition, error, base))
+            responses.append((topic, partitions))
+        out = struct.pack(">i", len(responses))
+        for topic, partitions in responses:
+            out += struct.pack(">h", len(topic)) + topic.encode() + struct.pack(">i", len(partitions))
+            for partition, error, base in partitions:
+                out += struct.pack(">ihqq", partition, error, base, -1)
+        return out + struct.pack(">i", 0)
+
+    def report(self):
+        last = (0, 0, 0)
+        while True:
+            time.sleep(1)
+            with self.lock:
+                now = (self.records, self.values, self.wire)
+                offsets = dict(self.offsets)
+            print("records/s {:>10} value MB/s {:>8.1f} wire MB/s {:>8.1f} offsets {}".format(
+                now[0] - last[0], (now[1] - last[1]) / 1e6, (now[2] - last[2]) / 1e6,
+                " ".join("{}/{}:{}".format(t, p, o) for (t, p), o in sorted(offsets.items()))), flush=True)
+            last = now
+
+
+def handler_for(b):
+    class handler(socketserver.BaseRequestHandler):
+        def handle(self):
+            try:
+                self.serve()
+            except ConnectionError:
+                # the sink reconnects after an error response
+                pass
+
+        def serve(self):
+            buf = b""
+            while True:
+                data = self.request.recv(1 << 20)
+                if not data:
+                    return
+                buf += data
+                while len(buf) >= 4:
+                    size = struct.unpack_from(">i", buf)[0]
+                    if len(buf) < 4 + size:
+                        break
+                    r = reader(buf[4:4 + size])
+                    buf = buf[4 + size:]
+                    key, version, corr = r.take(">hhi")
+                    r.string()
+                    if key != 0 or version != 3:
+                        print("unsupported request {} version {}".format(key, version))
+                        return
+                    body = struct.pack(">i", corr) + b.produce(r)
+                    if b.args.delay:
+                        time.sleep(b.args.delay / 1000)
+                    self.request.sendall(struct.pack(">i", len(body)) + body)
+    return handler
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Kafka broker stand-in for the kafka-sink component")
+    parser.add_argument("--port", help="port to listen on", type=int, default=9092)
+    parser.add_argument("--delay", help="milliseconds to wait before each response", type=int, default=0)
+    parser.add_argument("--fail-every", help="answer every Nth request with a retriable error",
+                        type=int, default=0)
+    parser.add_argument("--no-verify", help="do not check the batch CRC", default=False, action='store_true')
+    parser.add_argument("--keep", help="keep the records acknowledged", default=False, action='store_true')
+    args = parser.parse_args()
+
+    b = broker(args)
+    threading.Thread(target=b.report, daemon=True).start()
+    socketserver.ThreadingTCPServer.allow_reuse_address = True
+    socketserver.ThreadingTCPServer(("", args.port), handler_for(b)).serve_forever()
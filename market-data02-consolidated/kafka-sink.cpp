@@ -0,0 +1,575 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+
+#include <fmc++/error.hpp>
+#include <fmc++/logger.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/time.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+
+#include "kafka-sink.hpp"
+#include "tcp-distributor.hpp"
+
+using namespace std;
+
+/* messages read from the file per step */
+static constexpr size_t read_max = 4096;
+
+static constexpr int64_t metrics_period = 1000000000LL;
+
+/* Produce request of the protocol */
+static constexpr int16_t produce_key = 0;
+static constexpr int16_t produce_version = 3;
+/* offset of the correlation id in a request */
+static constexpr size_t correlation_offset = 8;
+/* offset of the attributes in a record batch, where the crc starts */
+static constexpr size_t attributes_offset = 21;
+
+bool kafka_compression_parse(string_view name, kafka_compression_t *c) {
+  if (name == "none")
+    *c = kafka_compression_t::NONE;
+  else if (name == "gzip")
+    *c = kafka_compression_t::GZIP;
+  else
+    return false;
+  return true;
+}
+
+static const array<uint32_t, 256> crc32c_table = [] {
+  array<uint32_t, 256> table;
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int k = 0; k < 8; ++k)
+      crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78U : crc >> 1;
+    table[i] = crc;
+  }
+  return table;
+}();
+
+uint32_t kafka_crc32c(uint32_t crc, const void *data, size_t sz) {
+  auto *p = (const uint8_t *)data;
+  crc = ~crc;
+  for (size_t i = 0; i < sz; ++i)
+    crc = crc32c_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+int32_t kafka_partition(string_view key, int32_t partitions) {
+  // murmur2 of the Java client
+  const uint32_t m = 0x5bd1e995;
+  auto *data = (const uint8_t *)key.data();
+  size_t len = key.size();
+  uint32_t h = 0x9747b28cU ^ (uint32_t)len;
+  for (size_t i = 0; i + 4 <= len; i += 4) {
+    uint32_t k = data[i] | data[i + 1] << 8 | data[i + 2] << 16 |
+                 (uint32_t)data[i + 3] << 24;
+    k *= m;
+    k ^= k >> 24;
+    k *= m;
+    h *= m;
+    h ^= k;
+  }
+  auto *tail = data + (len & ~(size_t)3);
+  switch (len % 4) {
+  case 3:
+    h ^= tail[2] << 16;
+    [[fallthrough]];
+  case 2:
+    h ^= tail[1] << 8;
+    [[fallthrough]];
+  case 1:
+    h ^= tail[0];
+    h *= m;
+  }
+  h ^= h >> 13;
+  h *= m;
+  h ^= h >> 15;
+  return (int32_t)((h & 0x7fffffff) % (uint32_t)partitions);
+}
+
+template <class T> static void put(string &s, T v) {
+  for (int i = sizeof(T) - 1; i >= 0; --i)
+    s.push_back((char)((uint64_t)v >> (8 * i)));
+}
+
+template <class T> static void put_at(string &s, size_t pos, T v) {
+  for (int i = sizeof(T) - 1; i >= 0; --i)
+    s[pos++] = (char)((uint64_t)v >> (8 * i));
+}
+
+static void put_str(string &s, string_view v) {
+  put<int16_t>(s, v.size());
+  s.append(v);
+}
+
+static size_t varint_size(int64_t v) {
+  uint64_t z = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+  size_t n = 1;
+  for (; z >= 0x80; z >>= 7)
+    ++n;
+  return n;
+}
+
+static void put_varint(string &s, int64_t v) {
+  uint64_t z = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+  for (; z >= 0x80; z >>= 7)
+    s.push_back((char)(z | 0x80));
+  s.push_back((char)z);
+}
+
+// reads the big endian fields of a response
+struct response_reader_t {
+  const char *p;
+  const char *end;
+  bool ok = true;
+
+  template <class T> T get() {
+    if (end - p < (ptrdiff_t)sizeof(T)) {
+      ok = false;
+      return 0;
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+      v = v << 8 | (uint8_t)*p++;
+    return (T)v;
+  }
+  void skip(int64_t sz) {
+    if (sz < 0 || end - p < sz) {
+      ok = false;
+      return;
+    }
+    p += sz;
+  }
+};
+
+/* errors after which the request may succeed when sent again */
+static bool retriable(int16_t code) {
+  switch (code) {
+  case 3:  // UNKNOWN_TOPIC_OR_PARTITION
+  case 5:  // LEADER_NOT_AVAILABLE
+  case 6:  // NOT_LEADER_OR_FOLLOWER
+  case 7:  // REQUEST_TIMED_OUT
+  case 13: // NETWORK_EXCEPTION
+  case 19: // NOT_ENOUGH_REPLICAS
+  case 20: // NOT_ENOUGH_REPLICAS_AFTER_APPEND
+    return true;
+  }
+  return false;
+}
+
+kafka_sink_t::kafka_sink_t(ytp_yamal_t *yamal, kafka_sink_cfg_t c,
+                           fmc_error_t **error)
+    : yamal(yamal), cfg(std::move(c)) {
+  fmc_error_clear(error);
+  struct sockaddr_in addr;
+  RETURN_ERROR_UNLESS(dist_sockaddr_parse(cfg.address, cfg.port, &addr),
+                      error, , "invalid broker address", cfg.address);
+  RETURN_ERROR_UNLESS(!cfg.topic.empty(), error, , "topic is required");
+  RETURN_ERROR_UNLESS(cfg.partitions > 0, error, ,
+                      "partitions must be positive");
+  RETURN_ERROR_UNLESS(cfg.acks == 1 || cfg.acks == -1, error, ,
+                      "acks must be 1 or -1");
+  RETURN_ERROR_UNLESS(cfg.batch > 0 && cfg.buffer > 0 && cfg.in_flight > 0,
+                      error, , "batch, buffer and in flight must be positive");
+  RETURN_ERROR_UNLESS(cfg.from == "start" || cfg.from == "end", error, ,
+                      "from must be start or end");
+  streams = ytp_streams_new(yamal, error);
+  RETURN_ON_ERROR(error, , "could not create streams");
+  metrics_stream = metrics_stream_announce(streams, cfg.peer, error);
+  RETURN_ON_ERROR(error, , "could not announce metrics stream");
+  it = cfg.from == "start" ? ytp_data_begin(yamal, error)
+                           : ytp_data_end(yamal, error);
+  RETURN_ON_ERROR(error, , "could not obtain iterator");
+  open.resize(cfg.partitions);
+}
+
+kafka_sink_t::~kafka_sink_t() {
+  stop();
+  fmc_error_t *error = nullptr;
+  if (fd != -1)
+    close(fd);
+  if (streams)
+    ytp_streams_del(streams, &error);
+}
+
+void kafka_sink_t::start() {
+  thread = std::thread([this]() {
+    fmc_error_t *error = nullptr;
+    while (!stopping && !error)
+      step(1, &error);
+    if (error) {
+      lock_guard<std::mutex> lock(error_mutex);
+      error_msg = fmc_error_msg(error);
+    }
+    stopped = true;
+  });
+}
+
+void kafka_sink_t::stop() {
+  stopping = true;
+  if (thread.joinable())
+    thread.join();
+}
+
+bool kafka_sink_t::failed(string *msg) {
+  if (!stopped)
+    return false;
+  lock_guard<std::mutex> lock(error_mutex);
+  *msg = error_msg;
+  return !error_msg.empty();
+}
+
+void kafka_sink_t::append(string_view key, const char *data, size_t sz,
+                          int64_t ts, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto partition = kafka_partition(key, cfg.partitions);
+  auto &batch = open[partition];
+  int64_t ms = ts / 1000000;
+  if (!batch) {
+    batch = make_unique<batch_t>();
+    batch->partition = partition;
+    batch->opened = fmc_cur_time_ns();
+    batch->first_ts = batch->max_ts = ms;
+  }
+  auto delta = ms - batch->first_ts;
+  auto offset = (int64_t)batch->records;
+  size_t body = 1 + varint_size(delta) + varint_size(offset) +
+                varint_size(key.size()) + key.size() + varint_size(sz) + sz +
+                1;
+  auto &s = batch->data;
+  auto before = s.size();
+  put_varint(s, body);
+  s.push_back(0); // attributes
+  put_varint(s, delta);
+  put_varint(s, offset);
+  put_varint(s, key.size());
+  s.append(key);
+  put_varint(s, sz);
+  s.append(data, sz);
+  put_varint(s, 0); // headers
+  auto added = s.size() - before;
+  batch->bytes += added;
+  batch->max_ts = max(batch->max_ts, ms);
+  ++batch->records;
+  buffered += added;
+  ++buffered_records;
+  if (batch->bytes >= cfg.batch)
+    seal(partition, error);
+}
+
+void kafka_sink_t::seal(int32_t partition, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto batch = move(open[partition]);
+  string records;
+  if (cfg.compression == kafka_compression_t::GZIP) {
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    RETURN_ERROR_UNLESS(deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16,
+                                     8, Z_DEFAULT_STRATEGY) == Z_OK,
+                        error, , "could not initialize gzip");
+    records.resize(deflateBound(&zs, batch->data.size()));
+    zs.next_in = (Bytef *)batch->data.data();
+    zs.avail_in = batch->data.size();
+    zs.next_out = (Bytef *)records.data();
+    zs.avail_out = records.size();
+    auto ret = deflate(&zs, Z_FINISH);
+    records.resize(zs.total_out);
+    deflateEnd(&zs);
+    RETURN_ERROR_UNLESS(ret == Z_STREAM_END, error, ,
+                        "could not compress batch");
+  } else {
+    records.swap(batch->data);
+  }
+
+  string &req = batch->data;
+  req.clear();
+  req.reserve(records.size() + cfg.topic.size() + cfg.client_id.size() + 128);
+  put<int32_t>(req, 0); // size
+  put<int16_t>(req, produce_key);
+  put<int16_t>(req, produce_version);
+  put<int32_t>(req, 0); // correlation id, set when sent
+  put_str(req, cfg.client_id);
+  put<int16_t>(req, -1); // no transactional id
+  put<int16_t>(req, cfg.acks);
+  put<int32_t>(req, cfg.timeout_ms);
+  put<int32_t>(req, 1);
+  put_str(req, cfg.topic);
+  put<int32_t>(req, 1);
+  put<int32_t>(req, batch->partition);
+  put<int32_t>(req, 0); // record batch size
+  auto start = req.size();
+  put<int64_t>(req, 0);  // base offset
+  put<int32_t>(req, 0);  // batch length
+  put<int32_t>(req, -1); // partition leader epoch
+  put<int8_t>(req, 2);   // magic
+  put<uint32_t>(req, 0); // crc
+  put<int16_t>(req, (int16_t)cfg.compression);
+  put<int32_t>(req, batch->records - 1);
+  put<int64_t>(req, batch->first_ts);
+  put<int64_t>(req, batch->max_ts);
+  put<int64_t>(req, -1); // producer id
+  put<int16_t>(req, -1); // producer epoch
+  put<int32_t>(req, -1); // base sequence
+  put<int32_t>(req, batch->records);
+  req.append(records);
+  put_at<int32_t>(req, start - 4, req.size() - start);
+  put_at<int32_t>(req, start + 8, req.size() - start - 12);
+  auto crc_start = start + attributes_offset;
+  put_at<uint32_t>(req, crc_start - 4,
+                   kafka_crc32c(0, req.data() + crc_start,
+                                req.size() - crc_start));
+  put_at<int32_t>(req, 0, req.size() - 4);
+  sealed.push_back(move(batch));
+}
+
+void kafka_sink_t::read(fmc_error_t **error) {
+  fmc_error_clear(error);
+  for (size_t count = 0; count < read_max && buffered < cfg.buffer &&
+                         !ytp_yamal_term(it);
+       ++count) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+    RETURN_ON_ERROR(error, , "could not read data");
+    auto where = channels.find(stream);
+    if (where == channels.end()) {
+      uint64_t aseqno;
+      size_t psz, csz, esz;
+      const char *peer, *channel, *encoding;
+      ytp_mmnode_offs *original, *subscribed;
+      ytp_announcement_lookup(yamal, stream, &aseqno, &psz, &peer, &csz,
+                              &channel, &esz, &encoding, &original,
+                              &subscribed, error);
+      RETURN_ON_ERROR(error, , "could not look up stream announcement");
+      string_view sv{channel, csz};
+      auto match = [sv](auto &prefix) { return fmc::starts_with(sv, prefix); };
+      bool sel = cfg.prefixes.empty() ||
+                 any_of(cfg.prefixes.begin(), cfg.prefixes.end(), match);
+      where = channels.emplace(stream, sel ? string(sv) : string()).first;
+    }
+    if (!where->second.empty()) {
+      append(where->second, data, sz, ts, error);
+      if (*error)
+        return;
+    }
+    it = ytp_yamal_next(yamal, it, error);
+    RETURN_ON_ERROR(error, , "could not obtain next iterator");
+  }
+}
+
+void kafka_sink_t::connect(fmc_error_t **error) {
+  fmc_error_clear(error);
+  struct sockaddr_in addr;
+  dist_sockaddr_parse(cfg.address, cfg.port, &addr);
+  fd = dist_socket(SOCK_STREAM);
+  RETURN_ERROR_UNLESS(fd != -1, error, , "could not create socket:",
+                      strerror(errno));
+  if (::connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0 &&
+      errno != EINPROGRESS) {
+    disconnect(strerror(errno));
+    return;
+  }
+  connecting = true;
+}
+
+void kafka_sink_t::disconnect(const char *reason) {
+  fmc::notice("kafka sink disconnected from", cfg.address, cfg.port, ",",
+              reason);
+  close(fd);
+  fd = -1;
+  connecting = false;
+  rbuf.clear();
+  // the requests not acknowledged are sent again, in order
+  sent = 0;
+  while (!inflight.empty()) {
+    sealed.push_front(move(inflight.back().second));
+    inflight.pop_back();
+  }
+  reconnect = fmc_cur_time_ns() + cfg.retry;
+  ++metrics.cur.reconnects;
+}
+
+void kafka_sink_t::send(fmc_error_t **error) {
+  fmc_error_clear(error);
+  while (!sealed.empty() && inflight.size() < cfg.in_flight) {
+    auto &req = sealed.front()->data;
+    if (sent == 0)
+      put_at<int32_t>(req, correlation_offset, ++correlation);
+    auto n = ::send(fd, req.data() + sent, req.size() - sent,
+                    MSG_DONTWAIT | dist_send_flags);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        disconnect(strerror(errno));
+      return;
+    }
+    sent += n;
+    if (sent < req.size())
+      return;
+    sent = 0;
+    inflight.emplace_back(correlation, move(sealed.front()));
+    sealed.pop_front();
+  }
+}
+
+void kafka_sink_t::receive(fmc_error_t **error) {
+  fmc_error_clear(error);
+  char buf[64 << 10];
+  for (;;) {
+    auto n = recv(fd, buf, sizeof buf, MSG_DONTWAIT);
+    if (n == 0) {
+      disconnect("closed by the broker");
+      return;
+    }
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        disconnect(strerror(errno));
+      break;
+    }
+    rbuf.append(buf, n);
+  }
+
+  size_t pos = 0;
+  while (rbuf.size() - pos >= 4) {
+    response_reader_t size{rbuf.data() + pos, rbuf.data() + rbuf.size()};
+    auto sz = size.get<int32_t>();
+    if (sz < 0 || rbuf.size() - pos - 4 < (size_t)sz)
+      break;
+    response_reader_t r{rbuf.data() + pos + 4, rbuf.data() + pos + 4 + sz};
+    pos += 4 + sz;
+    auto corr = r.get<int32_t>();
+    if (!r.ok || inflight.empty() || inflight.front().first != corr) {
+      disconnect("unexpected response");
+      return;
+    }
+    int16_t code = 0;
+    auto topics = r.get<int32_t>();
+    for (int32_t t = 0; t < topics && r.ok; ++t) {
+      r.skip(r.get<int16_t>());
+      auto partitions = r.get<int32_t>();
+      for (int32_t p = 0; p < partitions && r.ok; ++p) {
+        r.get<int32_t>();
+        if (auto c = r.get<int16_t>(); c)
+          code = c;
+        r.get<int64_t>(); // base offset
+        r.get<int64_t>(); // log append time
+      }
+    }
+    if (!r.ok) {
+      disconnect("invalid response");
+      return;
+    }
+    auto &batch = inflight.front().second;
+    if (code) {
+      ++metrics.cur.parse_errors;
+      RETURN_ERROR_UNLESS(retriable(code), error, ,
+                          "broker refused records of partition",
+                          batch->partition, "with error code", code);
+      disconnect(("broker error code " + to_string(code)).c_str());
+      return;
+    }
+    metrics.cur.messages += batch->records;
+    metrics.cur.bytes += batch->bytes;
+    buffered -= batch->bytes;
+    buffered_records -= batch->records;
+    wire_bytes += batch->data.size();
+    acked += batch->records;
+    ++batches;
+    inflight.pop_front();
+  }
+  rbuf.erase(0, pos);
+}
+
+uint64_t kafka_sink_t::backlog(fmc_error_t **error) {
+  // the distance to the end of the file, without walking the messages
+  fmc_error_clear(error);
+  auto end = ytp_data_end(yamal, error);
+  if (*error)
+    return 0;
+  auto last = ytp_data_tell(yamal, end, error);
+  if (*error)
+    return 0;
+  auto pos = ytp_data_tell(yamal, it, error);
+  if (*error)
+    return 0;
+  return last > pos ? last - pos : 0;
+}
+
+void kafka_sink_t::step(int timeout, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto before = buffered_records;
+  read(error);
+  if (*error)
+    return;
+  // keep reading without waiting while there is data
+  if (buffered_records != before)
+    timeout = 0;
+
+  auto now = fmc_cur_time_ns();
+  for (auto &batch : open) {
+    if (batch && now - batch->opened >= cfg.linger) {
+      seal(batch->partition, error);
+      if (*error)
+        return;
+    }
+  }
+
+  if (fd == -1 && now >= reconnect) {
+    connect(error);
+    if (*error)
+      return;
+  }
+  if (fd == -1) {
+    ::poll(nullptr, 0, timeout);
+  } else {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (connecting ||
+        (!sealed.empty() && inflight.size() < cfg.in_flight))
+      pfd.events |= POLLOUT;
+    if (::poll(&pfd, 1, timeout) > 0) {
+      if (connecting) {
+        int err = 0;
+        socklen_t len = sizeof err;
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+          disconnect(strerror(err));
+        } else {
+          connecting = false;
+          fmc::notice("kafka sink connected to", cfg.address, cfg.port);
+        }
+      }
+      if (fd != -1 && !connecting && (pfd.revents & (POLLIN | POLLHUP)))
+        receive(error);
+      if (*error)
+        return;
+    }
+    if (fd != -1 && !connecting)
+      send(error);
+    if (*error)
+      return;
+  }
+
+  if (now >= metrics_time) {
+    metrics_time = now + metrics_period;
+    metrics.cur.queue_depth = buffered + backlog(error);
+    RETURN_ON_ERROR(error, , "could not measure input backlog");
+    metrics.publish(yamal, metrics_stream, error);
+    RETURN_ON_ERROR(error, , "could not publish metrics");
+  }
+}
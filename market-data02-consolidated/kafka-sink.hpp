@@ -0,0 +1,151 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fmc/error.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+#include "metrics.hpp"
+
+/*
+ * Kafka protocol pieces used by the sink. Records are produced with
+ * Produce v3 requests carrying one RecordBatch v2 each, big endian as the
+ * protocol requires.
+ */
+enum class kafka_compression_t : int16_t {
+  NONE = 0,
+  GZIP = 1,
+};
+
+bool kafka_compression_parse(std::string_view name, kafka_compression_t *c);
+
+/* CRC-32C of the record batches */
+uint32_t kafka_crc32c(uint32_t crc, const void *data, size_t sz);
+
+/* partition of a key, as chosen by the default Kafka partitioner */
+int32_t kafka_partition(std::string_view key, int32_t partitions);
+
+struct kafka_sink_cfg_t {
+  std::string peer = "kafka-sink"; /* peer of the metrics stream */
+  std::string address = "127.0.0.1";
+  int port = 9092;
+  std::string topic;
+  int32_t partitions = 1;
+  std::string client_id = "feed";
+  std::vector<std::string> prefixes; /* channels produced, all if empty */
+  std::string from = "start";        /* or end for new data only */
+  int16_t acks = 1;                  /* 1 for the leader, -1 for all */
+  int32_t timeout_ms = 30000;
+  kafka_compression_t compression = kafka_compression_t::GZIP;
+  size_t batch = 256 << 10;     /* record bytes of a batch */
+  int64_t linger = 5000000LL;   /* time a batch waits to fill */
+  size_t buffer = 64ULL << 20;  /* record bytes read and not acknowledged */
+  size_t in_flight = 5;         /* requests waiting for a response */
+  int64_t retry = 1000000000LL; /* time before reconnecting */
+};
+
+/*
+ * Produces the data messages of the selected channels of a yamal file to
+ * a Kafka broker, keyed by channel, partitioned by key and with the
+ * message time as record timestamp. The broker has to be the leader of
+ * every partition of the topic.
+ *
+ * The sink runs on its own thread. It reads the file only while the
+ * records not yet acknowledged by the broker take less than buffer bytes,
+ * so a slow broker makes the sink fall behind in the file instead of
+ * growing its memory, and never slows down the writers of the file.
+ * Requests are pipelined, after an error or a lost connection the
+ * requests not acknowledged are sent again in order, so a record can be
+ * produced more than once.
+ *
+ * Once a second the sink publishes metrics on stats/PEER/metrics of the
+ * file: records and bytes acknowledged, error responses as parse errors,
+ * reconnections, and as queue depth the bytes read and not acknowledged
+ * plus the bytes of the file not read yet.
+ */
+struct kafka_sink_t {
+  kafka_sink_t(ytp_yamal_t *yamal, kafka_sink_cfg_t cfg, fmc_error_t **error);
+  ~kafka_sink_t();
+
+  /* starts the thread of the sink */
+  void start();
+  /* stops the thread, the records not acknowledged are dropped */
+  void stop();
+  /* whether the thread has stopped with an error, and the error */
+  bool failed(std::string *msg);
+
+  /* one pass of the thread, waits at most timeout ms for the broker */
+  void step(int timeout, fmc_error_t **error);
+
+  struct batch_t {
+    int32_t partition = 0;
+    uint64_t records = 0;
+    size_t bytes = 0; /* record bytes before compression */
+    int64_t opened = 0;
+    int64_t first_ts = 0; /* ms */
+    int64_t max_ts = 0;
+    std::string data; /* records, then the whole request once sealed */
+  };
+
+  void read(fmc_error_t **error);
+  void append(std::string_view key, const char *data, size_t sz, int64_t ts,
+              fmc_error_t **error);
+  void seal(int32_t partition, fmc_error_t **error);
+  void connect(fmc_error_t **error);
+  void disconnect(const char *reason);
+  void send(fmc_error_t **error);
+  void receive(fmc_error_t **error);
+  uint64_t backlog(fmc_error_t **error);
+
+  ytp_yamal_t *yamal = nullptr;
+  ytp_streams_t *streams = nullptr;
+  kafka_sink_cfg_t cfg;
+  ytp_iterator_t it = nullptr;
+  /* channel of each selected stream, empty if not selected */
+  std::unordered_map<ytp_mmnode_offs, std::string> channels;
+  std::vector<std::unique_ptr<batch_t>> open; /* one per partition */
+  std::deque<std::unique_ptr<batch_t>> sealed;
+  std::deque<std::pair<int32_t, std::unique_ptr<batch_t>>> inflight;
+  size_t sent = 0; /* bytes of the front sealed request written */
+  size_t buffered = 0;
+  uint64_t buffered_records = 0;
+  int32_t correlation = 0;
+
+  int fd = -1;
+  bool connecting = false;
+  int64_t reconnect = 0; /* time of the next connection attempt */
+  std::string rbuf;
+
+  ytp_mmnode_offs metrics_stream = 0;
+  metrics_t metrics;
+  int64_t metrics_time = 0;
+
+  std::thread thread;
+  std::atomic<bool> stopping = false;
+  std::atomic<bool> stopped = false;
+  std::mutex error_mutex;
+  std::string error_msg; /* guarded by error_mutex */
+
+  /* records acknowledged, readable from other threads */
+  std::atomic<uint64_t> acked = 0;
+  uint64_t batches = 0;
+  uint64_t wire_bytes = 0; /* bytes of the requests acknowledged */
+};
@@ -38,10 +38,12 @@ using namespace std;
 using namespace fmc;
 
 struct kraken_parse_ctx {
-  string_view bidqt = "null"sv;
-  string_view askqt = "null"sv;
-  string_view bidpx = "null"sv;
-  string_view askpx = "null"sv;
+  // copies of the last quote, the message may be gone by the next one,
+  // as when it was read from a ring
+  string bidqt = "null";
+  string askqt = "null";
+  string bidpx = "null";
+  string askpx = "null";
   string_view symbol;
   bool announced = false;
 };
@@ -58,8 +60,8 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
   if (feedtype == "spread") {
     // This section here is kraken parsing code
     auto parse_kraken_spread =
-        [ctx = kraken_parse_ctx{}](string_view in, cmp_str_t *cmp, int64_t tm,
-                                   uint64_t *last, bool skip,
+        [ctx = kraken_parse_ctx{}](string_view in, ore_writer_t *out,
+                                   int64_t tm, uint64_t *last, bool skip,
                                    fmc_error_t **error) mutable {
           *last = tm;
           std::string_view bidpx;
@@ -77,6 +79,10 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
           tie(ts, rem) = simple_json_parse(rem, "\"", "\"");
           RETURN_ERROR_UNLESS(ts.size(), error, false,
                               "could not parse message", in);
+          auto vendor_ns = decimal_time_ns(ts);
+          RETURN_ERROR_UNLESS(vendor_ns, error, false,
+                              "could not parse vendor time in message", in);
+          auto offset = tm - vendor_ns;
           tie(bidqt, rem) = simple_json_parse(rem, "\"", "\"");
           RETURN_ERROR_UNLESS(bidqt.size(), error, false,
                               "could not parse message", in);
@@ -112,15 +118,15 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
             // ORE Book Control Message
             // [13, receive, vendor offset, vendor seqno, batch, imnt id,
             // uncross, command]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)13,     // Message Type ID
-                          (int64_t)tm,     // recv_time
-                          (int64_t)0,      // vendor_offset
-                          (uint64_t)0,     // vendor_seqno
-                          (uint8_t)1,      // batch
-                          (int32_t)chanid, // imnt id
-                          (uint8_t)0,      // uncross
-                          'C'              // command
+            ore_write(out, error,
+                      (uint8_t)13,     // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)0,     // vendor_seqno
+                      (uint8_t)1,      // batch
+                      (int32_t)chanid, // imnt id
+                      (uint8_t)0,      // uncross
+                      'C'              // command
             );
             if (*error)
               return false;
@@ -130,46 +136,46 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
             // ORE Order Modify Message
             // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
             // id, new price, new qty]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)6,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)*last,
-                          (uint8_t)batch,  // batch (firts message)
-                          (int32_t)chanid, // imnt_id
-                          (int32_t)chanid, // order_id
-                          (int32_t)chanid, // new_order_id
-                          bidpx,           // price
-                          bidqt,           // qty
-                          (uint8_t) true   // is_bid
+            ore_write(out, error,
+                      (uint8_t)6,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)*last,
+                      (uint8_t)batch,  // batch (firts message)
+                      (int32_t)chanid, // imnt_id
+                      (int32_t)chanid, // order_id
+                      (int32_t)chanid, // new_order_id
+                      bidpx,           // price
+                      bidqt,           // qty
+                      (uint8_t) true   // is_bid
             );
           } else if (bid_add) {
             // ORE Order Add Message
             // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
             // price, qty, is bid]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)1,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)*last,
-                          (uint8_t)batch,  // batch (firts message)
-                          (int32_t)chanid, // imnt_id
-                          (int32_t)chanid, // order_id
-                          bidpx,           // price
-                          bidqt,           // qty
-                          true             // is_bid
+            ore_write(out, error,
+                      (uint8_t)1,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)*last,
+                      (uint8_t)batch,  // batch (firts message)
+                      (int32_t)chanid, // imnt_id
+                      (int32_t)chanid, // order_id
+                      bidpx,           // price
+                      bidqt,           // qty
+                      true             // is_bid
             );
           } else if (bid_del) {
             // ORE Order Delete Message
             // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)5,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)*last,
-                          (uint8_t)batch,  // batch (firts message)
-                          (int32_t)chanid, // imnt_id
-                          (int32_t)chanid  // order_id
+            ore_write(out, error,
+                      (uint8_t)5,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)*last,
+                      (uint8_t)batch,  // batch (firts message)
+                      (int32_t)chanid, // imnt_id
+                      (int32_t)chanid  // order_id
             );
           }
           if (*error)
@@ -179,45 +185,45 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
             // ORE Order Modify Message
             // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
             // id, new price, new qty]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)6,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)*last,
-                          (uint8_t)0,            // batch (last batch message)
-                          (int32_t)chanid,       // imnt_id
-                          (int32_t)(chanid + 1), // order_id
-                          (int32_t)(chanid + 1), // new_order_id
-                          askpx,                 // price
-                          askqt                  // qty
+            ore_write(out, error,
+                      (uint8_t)6,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)*last,
+                      (uint8_t)0,            // batch (last batch message)
+                      (int32_t)chanid,       // imnt_id
+                      (int32_t)(chanid + 1), // order_id
+                      (int32_t)(chanid + 1), // new_order_id
+                      askpx,                 // price
+                      askqt                  // qty
             );
           } else if (ask_add) {
             // ORE Order Add Message
             // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
             // price, qty, is bid]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)1,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)*last,
-                          (uint8_t)0,            // batch (last batch message)
-                          (int32_t)chanid,       // imnt_id
-                          (int32_t)(chanid + 1), // order_id
-                          askpx,                 // price
-                          askqt,                 // qty
-                          false                  // is_bid
+            ore_write(out, error,
+                      (uint8_t)1,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)*last,
+                      (uint8_t)0,            // batch (last batch message)
+                      (int32_t)chanid,       // imnt_id
+                      (int32_t)(chanid + 1), // order_id
+                      askpx,                 // price
+                      askqt,                 // qty
+                      false                  // is_bid
             );
           } else if (ask_del) {
             // ORE Order Delete Message
             // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)5,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)*last,
-                          (uint8_t)0,           // batch (last batch message)
-                          (int32_t)chanid,      // imnt_id
-                          (int32_t)(chanid + 1) // order_id
+            ore_write(out, error,
+                      (uint8_t)5,      // Message Type ID
+                      (int64_t)tm,     // recv_time
+                      (int64_t)offset, // vendor_offset
+                      (uint64_t)*last,
+                      (uint8_t)0,           // batch (last batch message)
+                      (int32_t)chanid,      // imnt_id
+                      (int32_t)(chanid + 1) // order_id
             );
           }
 
@@ -225,9 +231,9 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
         };
     return {outsv, parse_kraken_spread};
   } else if (feedtype == "trade") {
-    auto parse_kraken_trade = [ocurrence = 0](string_view in, cmp_str_t *cmp,
-                                              int64_t tm, uint64_t *last,
-                                              bool skip,
+    auto parse_kraken_trade = [ocurrence = 0](string_view in,
+                                              ore_writer_t *out, int64_t tm,
+                                              uint64_t *last, bool skip,
                                               fmc_error_t **error) mutable {
       auto trades_pos = in.find("[", 1);
       RETURN_ERROR_UNLESS(trades_pos != std::string_view::npos, error, false,
@@ -245,34 +251,20 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
         }
         string_view trdpx;
         string_view trdqt;
-        string_view vendorsecs;
-        string_view vendorus;
+        string_view vendortime;
         string_view side;
-        string_view tmp;
         tie(trdpx, trademsg) = simple_json_parse(trademsg, "\"", "\"");
         RETURN_ERROR_UNLESS(trdpx.size(), error, false,
                             "could not parse trade price in message", in);
         tie(trdqt, trademsg) = simple_json_parse(trademsg, "\"", "\"");
         RETURN_ERROR_UNLESS(trdqt.size(), error, false,
                             "could not parse trade quantity in message", in);
-        tie(vendorsecs, tmp) = simple_json_parse(trademsg, "\"", ".");
-        RETURN_ERROR_UNLESS(vendorsecs.size(), error, false,
-                            "could not parse vendor seconds price in message",
-                            in);
-        auto [vendor_s, parsed_s] = fmc::from_string_view<uint64_t>(vendorsecs);
-        RETURN_ERROR_UNLESS(vendorsecs.size() == parsed_s.size(), error, false,
-                            "could not parse integer from seconds in message",
-                            in);
-        tie(vendorus, trademsg) = simple_json_parse(trademsg, ".", "\"");
-        RETURN_ERROR_UNLESS(vendorus.size(), error, false,
-                            "could not parse vendor microseconds in message",
-                            in);
-        auto [vendor_us, parsed_us] =
-            fmc::from_string_view<uint64_t>(vendorsecs);
-        RETURN_ERROR_UNLESS(
-            vendorsecs.size() == parsed_us.size(), error, false,
-            "could not parse integer from microseconds in message", in);
-        auto vendor_ns = vendor_s * 1000000000ULL + vendor_us * 1000ULL;
+        tie(vendortime, trademsg) = simple_json_parse(trademsg, "\"", "\"");
+        RETURN_ERROR_UNLESS(vendortime.size(), error, false,
+                            "could not parse vendor time in message", in);
+        uint64_t vendor_ns = decimal_time_ns(vendortime);
+        RETURN_ERROR_UNLESS(vendor_ns, error, false,
+                            "could not parse vendor time in message", in);
         if (seqno == 0) {
           ocurrence += *last == vendor_ns;
           ocurrence *= *last == vendor_ns;
@@ -287,16 +279,16 @@ pair<string_view, parser_t> get_kraken_channel_in(string_view sv,
         // ORE Off Book Trade Message
         // [11, receive, vendor offset, vendor seqno, batch, imnt id, trade
         // price, qty, decorator]
-        cmp_ore_write(cmp, error,
-                      (uint8_t)11,               // Message Type ID
-                      (int64_t)tm,               // receive
-                      (int64_t)(tm - vendor_ns), // vendor offset in ns
-                      (uint64_t)seqno,           // vendor seqno
-                      (uint8_t)0,                // batch
-                      (uint64_t)chanid,          // imnt_id
-                      trdpx,                     // trade price
-                      trdqt,                     // qty
-                      string_view(side == "b" ? "b" : "a"));
+        ore_write(out, error,
+                  (uint8_t)11,               // Message Type ID
+                  (int64_t)tm,               // receive
+                  (int64_t)(tm - vendor_ns), // vendor offset in ns
+                  (uint64_t)seqno,           // vendor seqno
+                  (uint8_t)0,                // batch
+                  (uint64_t)chanid,          // imnt_id
+                  trdpx,                     // trade price
+                  trdqt,                     // qty
+                  string_view(side == "b" ? "b" : "a"));
       }
 
       return *error == nullptr;
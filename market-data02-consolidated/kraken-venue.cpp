@@ -0,0 +1,155 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <libwebsockets.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "feed-engine.hpp"
+#include "kraken-parser.hpp"
+
+/*
+ * Kraken public websocket, data messages are arrays ending with the
+ * channel name and the pair, [ID,...,"spread","XBT/USD"], and control
+ * messages are objects with an "event" field
+ */
+
+static const char *const kraken_types[] = {"spread", "trade"};
+
+static std::string kraken_path(const std::set<std::string> &secs) {
+  return "/";
+}
+
+static void kraken_request(bool subscribe,
+                           const std::vector<std::string> &secs,
+                           unsigned *id, std::vector<std::string> &out) {
+  for (auto *tp : kraken_types) {
+    std::string msg = "{\"event\":\"";
+    msg.append(subscribe ? "subscribe" : "unsubscribe");
+    msg.append("\",\"reqid\":");
+    msg.append(std::to_string(++*id));
+    msg.append(",\"pair\":[");
+    char sep = ' ';
+    for (auto &sec : secs) {
+      msg.push_back(sep);
+      msg.push_back('"');
+      msg.append(sec);
+      msg.push_back('"');
+      sep = ',';
+    }
+    msg.append("],\"subscription\":{\"name\":\"");
+    msg.append(tp);
+    msg.append("\"}}");
+    out.push_back(std::move(msg));
+  }
+}
+
+static venue_msg_t kraken_event(std::string_view data) {
+  const char *in = data.data();
+  size_t len = data.size();
+  size_t alen = 0;
+  auto *p = lws_json_simple_find(in, len, "\"event\"", &alen);
+  if (!p) {
+    lwsl_err("%s, message does not contain \"event\":\n", __func__);
+    return venue_msg_t::INVALID;
+  }
+  auto event = std::string_view(p + 2, alen - 3);
+  if (event == "subscriptionStatus" || event == "systemStatus") {
+    p = lws_json_simple_find(in, len, "\"status\"", &alen);
+    if (!p) {
+      lwsl_err("%s, message does not contain \"status\":\n", __func__);
+      return venue_msg_t::INVALID;
+    }
+    auto status = std::string_view(p + 2, alen - 3);
+    if (status != "subscribed" && status != "unsubscribed" &&
+        status != "online") {
+      lwsl_err("%s, unable to complete subscription, \"status\" value is "
+               "%.*s and message contains %.*s:\n",
+               __func__, (int)status.size(), status.data(), (int)len, in);
+      return venue_msg_t::FATAL;
+    }
+  } else if (event == "error") {
+    lwsl_err("%s, unable to complete subscription, received error message: "
+             "%.*s:\n",
+             __func__, (int)len, in);
+    return venue_msg_t::FATAL;
+  }
+  return venue_msg_t::CONTROL;
+}
+
+static venue_msg_t kraken_route(std::string_view data, venue_route_t *out) {
+  if (data.empty())
+    return venue_msg_t::INVALID;
+  if (data[0] == '{')
+    return kraken_event(data);
+  // the pair and the channel name are the last two strings
+  std::string_view names[2];
+  auto offset = data.size();
+  for (auto &name : names) {
+    auto offset2 = data.rfind('"', offset - 1);
+    auto offset1 = offset2 == std::string_view::npos || offset2 == 0
+                       ? std::string_view::npos
+                       : data.rfind('"', offset2 - 1);
+    if (offset1 == std::string_view::npos) {
+      lwsl_err("%s, could not find expected quote character in message, "
+               "invalid data received \"%.*s\":\n",
+               __func__, (int)data.size(), data.data());
+      return venue_msg_t::INVALID;
+    }
+    name = data.substr(offset1 + 1, offset2 - offset1 - 1);
+    offset = offset1;
+  }
+  out->sec = names[0];
+  out->type = names[1];
+  out->data = data;
+  return venue_msg_t::DATA;
+}
+
+// Spread and trade messages carry the vendor time as the third string,
+// in seconds with microsecond precision. Returns 0 if not found.
+static int64_t kraken_vendor_time(std::string_view data) {
+  std::string_view val;
+  std::string_view rem = data;
+  for (int i = 0; i < 3; ++i) {
+    tie(val, rem) = simple_json_parse(rem, "\"", "\"");
+    if (!val.size())
+      return 0;
+  }
+  return decimal_time_ns(val);
+}
+
+static const std::string_view kraken_samples[] = {
+    R"([340,["27341.10000","27341.20000","1680000000.123456",)"
+    R"("1.25000000","0.37500000"],"spread","XBT/USD"])",
+    R"([337,[["27341.20000","0.00100000","1680000000.124567","b","l",""]],)"
+    R"("trade","XBT/USD"])",
+    R"([341,["1787.06000","1787.07000","1680000000.125678",)"
+    R"("41.52520000","12.50000000"],"spread","ETH/USD"])",
+    R"([338,[["1787.07000","0.37500000","1680000000.126789","s","m",""]],)"
+    R"("trade","ETH/USD"])"};
+
+constinit const venue_t kraken_venue = {
+    .name = "kraken",
+    .component = "kraken-feed-handler",
+    .descr = "Kraken feed handler component",
+    .encoding = "Content-Type application/json\n"
+                "Content-Schema Kraken",
+    .address = "ws.kraken.com",
+    .port = 443,
+    .us_address = nullptr,
+    .us_port = 0,
+    .types = kraken_types,
+    .contiguous = nullptr,
+    .path_subscribes = false,
+    .path = kraken_path,
+    .request = kraken_request,
+    .route = kraken_route,
+    .vendor_time = kraken_vendor_time,
+    .resolver = get_kraken_channel_in,
+    .samples = kraken_samples,
+};
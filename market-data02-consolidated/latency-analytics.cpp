@@ -0,0 +1,300 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "latency.hpp"
+#include "ore-reader.hpp"
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/component.h>
+#include <fmc/files.h>
+#include <fmc/time.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+using namespace fmc;
+
+extern struct fmc_reactor_api_v1 *_reactor;
+
+// One-way latency summary of a venue, published once per interval on
+// stats/<peer>/one-way. Offsets are ORE receive time minus vendor time in
+// nanoseconds, so they include the skew between the local and the vendor
+// clocks, and may be negative. Min and max are exact.
+// Skew is the lowest offset seen over the rolling window, it is an upper
+// bound of the local clock being ahead of the vendor's, a negative skew
+// means the local clock is behind. Python can read it with
+// struct.unpack('<32sQ7qQ', msg).
+struct one_way_record_t {
+  char venue[32];
+  uint64_t count;
+  int64_t min;
+  int64_t p50;
+  int64_t p90;
+  int64_t p99;
+  int64_t p999;
+  int64_t max;
+  int64_t skew;
+  uint64_t interval;
+};
+
+constexpr string_view one_way_encoding =
+    "Content-Type application/octet-stream\n"
+    "Content-Schema one-way1";
+
+struct latency_analytics_t {
+  fmc_component_HEAD;
+
+  struct venue_t {
+    string name;
+    signed_latency_histogram_t hist;
+    int64_t min = INT64_MAX;
+    int64_t max = INT64_MIN;
+    // lowest offset of each of the last intervals
+    deque<int64_t> minima;
+  };
+
+  ~latency_analytics_t();
+  void init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error);
+  bool process_one(fmc_error_t **error);
+  venue_t *get_venue(ytp_mmnode_offs stream, fmc_error_t **error);
+  void publish(int64_t now, fmc_error_t **error);
+
+  string peer;
+  string_view prefix = "ore/";
+  fmc_fd fd = -1;
+  ytp_yamal_t *yamal = nullptr;
+  ytp_streams_t *streams = nullptr;
+  ytp_iterator_t it;
+  ytp_mmnode_offs stats_stream = 0ULL;
+  unordered_map<ytp_mmnode_offs, venue_t *> s_in;
+  unordered_map<string, unique_ptr<venue_t>> venues;
+  int64_t start = 0LL;
+  int64_t last = 0LL;
+  size_t window = 60;
+  static constexpr int64_t delay = 1000000000LL;
+};
+
+latency_analytics_t::~latency_analytics_t() {
+  fmc_error_t *error = nullptr;
+  if (streams)
+    ytp_streams_del(streams, &error);
+  if (yamal)
+    ytp_yamal_del(yamal, &error);
+  if (fd != -1)
+    fmc_fclose(fd, &error);
+}
+
+void latency_analytics_t::init(struct fmc_cfg_sect_item *cfg,
+                               fmc_error_t **error) {
+  fd = fmc_fopen(fmc_cfg_sect_item_get(cfg, "ytp-file")->node.value.str,
+                 fmc_fmode::READWRITE, error);
+  RETURN_ON_ERROR(error, , "could not open yamal file",
+                  fmc_cfg_sect_item_get(cfg, "ytp-file")->node.value.str);
+  yamal = ytp_yamal_new(fd, error);
+  RETURN_ON_ERROR(error, , "could not create yamal");
+  streams = ytp_streams_new(yamal, error);
+  RETURN_ON_ERROR(error, , "could not create stream");
+  it = ytp_data_begin(yamal, error);
+  RETURN_ON_ERROR(error, , "could not obtain iterator");
+  peer = fmc_cfg_sect_item_get(cfg, "peer")->node.value.str;
+  if (auto *item = fmc_cfg_sect_item_get(cfg, "window"); item) {
+    RETURN_ERROR_UNLESS(item->node.value.int64 > 0, error, ,
+                        "window must be positive");
+    window = item->node.value.int64;
+  }
+  string chstr = "stats/" + peer + "/one-way";
+  stats_stream = ytp_streams_announce(
+      streams, peer.size(), peer.data(), chstr.size(), chstr.data(),
+      one_way_encoding.size(), one_way_encoding.data(), error);
+  RETURN_ON_ERROR(error, , "could not announce stats stream");
+  start = fmc_cur_time_ns();
+}
+
+latency_analytics_t::venue_t *
+latency_analytics_t::get_venue(ytp_mmnode_offs stream, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto where = s_in.find(stream);
+  if (where != s_in.end())
+    return where->second;
+
+  uint64_t seqno;
+  size_t psz, csz, esz;
+  const char *origpeer, *channel, *encoding;
+  ytp_mmnode_offs *original, *subscribed;
+  ytp_announcement_lookup(yamal, stream, &seqno, &psz, &origpeer, &csz,
+                          &channel, &esz, &encoding, &original, &subscribed,
+                          error);
+  RETURN_ON_ERROR(error, nullptr, "could not look up stream announcement");
+  string_view sv{channel, csz};
+  if (!starts_with(sv, prefix)) {
+    return s_in.emplace(stream, nullptr).first->second;
+  }
+  // the venue is the first component of the channel name
+  auto [venuesv, sep, rem] = split(sv.substr(prefix.size()), "/");
+  string venue(venuesv);
+  auto vit = venues.find(venue);
+  if (vit == venues.end()) {
+    auto info = make_unique<venue_t>();
+    info->name = venue;
+    vit = venues.emplace(venue, move(info)).first;
+  }
+  return s_in.emplace(stream, vit->second.get()).first->second;
+}
+
+void latency_analytics_t::publish(int64_t now, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto interval = last ? now - last : 0;
+  for (auto &[name, venue] : venues) {
+    venue->minima.push_back(venue->min);
+    if (venue->minima.size() > window)
+      venue->minima.pop_front();
+    venue->min = INT64_MAX;
+    auto max = venue->max;
+    venue->max = INT64_MIN;
+    auto &hist = venue->hist;
+    if (!hist.count())
+      continue;
+    one_way_record_t rec;
+    memset(rec.venue, 0, sizeof(rec.venue));
+    memcpy(rec.venue, name.data(), std::min(name.size(), sizeof(rec.venue)));
+    rec.count = hist.count();
+    rec.min = venue->minima.back();
+    rec.p50 = hist.percentile(50.0);
+    rec.p90 = hist.percentile(90.0);
+    rec.p99 = hist.percentile(99.0);
+    rec.p999 = hist.percentile(99.9);
+    rec.max = max;
+    rec.skew = *min_element(venue->minima.begin(), venue->minima.end());
+    rec.interval = interval;
+    hist.reset();
+    auto *dst = ytp_data_reserve(yamal, sizeof(rec), error);
+    RETURN_ON_ERROR(error, , "could not reserve message");
+    memcpy(dst, &rec, sizeof(rec));
+    ytp_data_commit(yamal, now, stats_stream, dst, error);
+    RETURN_ON_ERROR(error, , "could not commit message");
+  }
+}
+
+bool latency_analytics_t::process_one(fmc_error_t **error) {
+  if (!ytp_yamal_term(it)) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+    RETURN_ON_ERROR(error, false, "could not read data");
+    it = ytp_yamal_next(yamal, it, error);
+    RETURN_ON_ERROR(error, false, "could not obtain next iterator");
+    auto *venue = get_venue(stream, error);
+    if (*error)
+      return false;
+    // history before the component started is not part of the window
+    if (venue && ts >= start) {
+      msgpack_reader_t rd(string_view(data, sz));
+      ore_msg_t msg;
+      while (!rd.empty()) {
+        RETURN_ERROR_UNLESS(ore_decode(rd, &msg), error, false,
+                            "could not decode ORE message on venue",
+                            venue->name);
+        // messages without vendor time have zero offset
+        if (!msg.vendor_offset)
+          continue;
+        venue->hist.record(msg.vendor_offset);
+        venue->min = std::min(venue->min, msg.vendor_offset);
+        venue->max = std::max(venue->max, msg.vendor_offset);
+      }
+    }
+  }
+  if (auto now = fmc_cur_time_ns(); last + delay < now) {
+    publish(now, error);
+    RETURN_ON_ERROR(error, false, "could not publish one-way latency");
+    last = now;
+  }
+  return true;
+}
+
+void latency_analytics_component_del(
+    struct latency_analytics_t *comp) noexcept {
+  delete comp;
+}
+
+static void latency_analytics_component_process_one(
+    struct fmc_component *self, struct fmc_reactor_ctx *ctx,
+    fmc_time64_t now) noexcept {
+  struct latency_analytics_t *comp = (latency_analytics_t *)self;
+  try {
+    fmc_error_t *error = nullptr;
+    if (comp->process_one(&error)) {
+      _reactor->queue(ctx);
+    } else {
+      _reactor->set_error(ctx, "%s", fmc_error_msg(error));
+    }
+  } catch (std::exception &e) {
+    _reactor->set_error(ctx, "%s", e.what());
+  }
+}
+
+struct latency_analytics_t *
+latency_analytics_component_new(struct fmc_cfg_sect_item *cfg,
+                                struct fmc_reactor_ctx *ctx,
+                                char **inp_tps) noexcept {
+  fmc_error_t *error = nullptr;
+  struct latency_analytics_t *comp = new struct latency_analytics_t();
+  comp->init(cfg, &error);
+  if (error) {
+    goto cleanup;
+  }
+  _reactor->on_exec(ctx, latency_analytics_component_process_one);
+  _reactor->queue(ctx);
+  return comp;
+cleanup:
+  delete comp;
+  _reactor->set_error(ctx, "%s", fmc_error_msg(error));
+  return nullptr;
+}
+
+struct fmc_cfg_node_spec latency_analytics_cfgspec[] = {
+    {.key = "peer",
+     .descr = "Latency analytics peer name",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "ytp-file",
+     .descr = "Latency analytics ytp file with the ORE data",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "window",
+     .descr = "Number of one second intervals used to estimate clock skew, "
+              "60 by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {NULL},
+};
+
+struct fmc_cfg_node_spec *latency_analytics_cfg = latency_analytics_cfgspec;
+
+size_t latency_analytics_struct_sz = sizeof(struct latency_analytics_t);
@@ -0,0 +1,35 @@
+"""
+        COPYRIGHT (c) 2019-2023 by Featuremine Corporation.
+        
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+"""
+
+import argparse
+import struct
+from yamal import yamal
+
+record = struct.Struct('<32s9Q')
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--ytp-file", help="ytp file name", required=True)
+    parser.add_argument("--follow", help="keep waiting for new data", default=False, required=False, action='store_true')
+    args = parser.parse_args()
+
+    y = yamal(args.ytp_file)
+    dat = y.data()
+
+    print("{:<40} {:<16} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}".format(
+        "channel", "stage", "count", "p50", "p90", "p99", "p99.9", "p99.99", "max"))
+    it = iter(dat)
+    while(True):
+        for seq, ts, strm, msg in it:
+            if not strm.channel.startswith("stats/") or not strm.channel.endswith("/latency"):
+                continue
+            stage, count, mn, p50, p90, p99, p999, p9999, mx, interval = record.unpack(msg)
+            print("{:<40} {:<16} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}".format(
+                strm.channel, stage.rstrip(b'\0').decode(), count, p50, p90, p99, p999, p9999, mx))
+        if not args.follow:
+            break
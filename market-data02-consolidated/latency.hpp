@@ -0,0 +1,238 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+
+#include <fmc/error.h>
+#include <fmc/time.h>
+#include <ytp/data.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Low overhead timestamps for measuring intervals within a process. Uses
+// the invariant TSC where available and falls back to the wall clock.
+// Tick values are only comparable within the same process.
+struct tsc_clock {
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)fmc_cur_time_ns();
+#endif
+  }
+
+  // Converts a tick interval to nanoseconds
+  static uint64_t ns(uint64_t ticks) {
+    return (uint64_t)((double)ticks * ns_per_tick());
+  }
+
+  // Calibrated once per process against the wall clock, the first call
+  // takes about 10ms.
+  static double ns_per_tick() {
+    static const double ratio = calibrate();
+    return ratio;
+  }
+
+private:
+  static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+    auto ns0 = fmc_cur_time_ns();
+    auto tk0 = __rdtsc();
+    while (fmc_cur_time_ns() - ns0 < 10000000LL)
+      ;
+    auto ns1 = fmc_cur_time_ns();
+    auto tk1 = __rdtsc();
+    return (double)(ns1 - ns0) / (double)(tk1 - tk0);
+#else
+    return 1.0;
+#endif
+  }
+};
+
+// Log-linear histogram in the spirit of HdrHistogram. Values below 32 are
+// exact, above that each power of two is split in 32 buckets, keeping the
+// relative error of reported percentiles under about 3%. Recording is a
+// couple of instructions and never allocates.
+class latency_histogram_t {
+public:
+  static constexpr unsigned sub_bits = 5;
+  static constexpr uint64_t sub_count = 1ULL << sub_bits;
+  static constexpr size_t bucket_count = (64 - sub_bits + 1) * sub_count;
+
+  static size_t index(uint64_t v) {
+    if (v < sub_count)
+      return v;
+    unsigned shift = 63 - __builtin_clzll(v) - sub_bits;
+    return (shift + 1) * sub_count + ((v >> shift) & (sub_count - 1));
+  }
+
+  // Highest value that falls into the bucket
+  static uint64_t value(size_t idx) {
+    if (idx < sub_count)
+      return idx;
+    unsigned shift = idx / sub_count - 1;
+    uint64_t sub = idx % sub_count;
+    return ((sub_count + sub) << shift) + ((1ULL << shift) - 1);
+  }
+
+  void record(uint64_t v) {
+    ++counts_[index(v)];
+    ++count_;
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+  }
+
+  // Records signed intervals, negative values are the result of clock
+  // skew between hosts and are recorded as zero. Named apart from record()
+  // so that a long long interval does not make the call ambiguous.
+  void record_signed(int64_t v) {
+    record((uint64_t)std::max<int64_t>(v, 0));
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t min() const { return count_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+
+  uint64_t percentile(double p) const {
+    if (!count_)
+      return 0;
+    auto target = (uint64_t)((double)count_ * p / 100.0 + 0.5);
+    return at_rank(std::max<uint64_t>(target, 1));
+  }
+
+  // Value of the sample at rank, the lowest sample being rank 1
+  uint64_t at_rank(uint64_t rank) const {
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+      seen += counts_[i];
+      if (seen >= rank)
+        return std::min(value(i), max_);
+    }
+    return max_;
+  }
+
+  void reset() {
+    counts_.fill(0);
+    count_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+  }
+
+private:
+  std::array<uint64_t, bucket_count> counts_ = {};
+  uint64_t count_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+};
+
+// Histogram of signed values, such as offsets between the clocks of two
+// hosts. Negative values are kept by magnitude in a histogram of their own,
+// so percentiles below zero have the same relative error as above it.
+class signed_latency_histogram_t {
+public:
+  void record(int64_t v) {
+    if (v < 0)
+      neg_.record(-(uint64_t)v);
+    else
+      pos_.record((uint64_t)v);
+  }
+
+  uint64_t count() const { return neg_.count() + pos_.count(); }
+
+  int64_t percentile(double p) const {
+    auto n = count();
+    if (!n)
+      return 0;
+    auto target = (uint64_t)((double)n * p / 100.0 + 0.5);
+    target = std::max<uint64_t>(target, 1);
+    // the lowest ranks are the negative values of largest magnitude
+    auto negs = neg_.count();
+    if (target <= negs)
+      return -(int64_t)neg_.at_rank(negs - target + 1);
+    return (int64_t)pos_.at_rank(target - negs);
+  }
+
+  void reset() {
+    neg_.reset();
+    pos_.reset();
+  }
+
+private:
+  latency_histogram_t neg_;
+  latency_histogram_t pos_;
+};
+
+// Summary of one stage published on the latency stats stream. All values
+// are in nanoseconds and little endian, python can read it with
+// struct.unpack('<32s9Q', msg).
+struct latency_record_t {
+  char stage[32];
+  uint64_t count;
+  uint64_t min;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t p999;
+  uint64_t p9999;
+  uint64_t max;
+  uint64_t interval;
+};
+
+constexpr std::string_view latency_encoding =
+    "Content-Type application/octet-stream\n"
+    "Content-Schema latency1";
+
+inline ytp_mmnode_offs latency_stream_announce(ytp_streams_t *streams,
+                                               std::string_view peer,
+                                               fmc_error_t **error) {
+  std::string chstr = "stats/";
+  chstr.append(peer);
+  chstr.append("/latency");
+  return ytp_streams_announce(streams, peer.size(), peer.data(), chstr.size(),
+                              chstr.data(), latency_encoding.size(),
+                              latency_encoding.data(), error);
+}
+
+// Publishes the summary of a stage measured over interval nanoseconds and
+// resets the histogram for the next interval. Nothing is published for
+// stages without samples, so idle components do not grow the file.
+inline void latency_publish(ytp_yamal_t *yamal, ytp_mmnode_offs stream,
+                            std::string_view stage, int64_t interval,
+                            latency_histogram_t &hist, fmc_error_t **error) {
+  fmc_error_clear(error);
+  if (!hist.count())
+    return;
+  auto *dst = ytp_data_reserve(yamal, sizeof(latency_record_t), error);
+  if (*error)
+    return;
+  latency_record_t rec;
+  memset(rec.stage, 0, sizeof(rec.stage));
+  memcpy(rec.stage, stage.data(), std::min(stage.size(), sizeof(rec.stage)));
+  rec.count = hist.count();
+  rec.min = hist.min();
+  rec.p50 = hist.percentile(50.0);
+  rec.p90 = hist.percentile(90.0);
+  rec.p99 = hist.percentile(99.0);
+  rec.p999 = hist.percentile(99.9);
+  rec.p9999 = hist.percentile(99.99);
+  rec.max = hist.max();
+  rec.interval = (uint64_t)interval;
+  memcpy(dst, &rec, sizeof(rec));
+  ytp_data_commit(yamal, fmc_cur_time_ns(), stream, dst, error);
+  hist.reset();
+}
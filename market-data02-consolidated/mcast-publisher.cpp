@@ -0,0 +1,625 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <fmc++/error.hpp>
+#include <fmc++/logger.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/time.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+
+#include "mcast-publisher.hpp"
+
+using namespace std;
+
+/* largest UDP datagram */
+static constexpr size_t mcast_datagram_max = 65507;
+
+/* datagrams read per recvmmsg */
+static constexpr size_t mcast_receive_batch = 32;
+
+/* gap fill requests served per poll */
+static constexpr size_t mcast_requests_max = 64;
+
+/* packets requested at most per retry period */
+static constexpr uint64_t mcast_requested_max = 4 * mcast_gap_max;
+
+static bool inaddr_parse(const string &address, struct in_addr *addr) {
+  return inet_pton(AF_INET, address.c_str(), addr) == 1;
+}
+
+static int udp_socket(fmc_error_t **error) {
+  int fd = dist_socket(SOCK_DGRAM);
+  RETURN_ERROR_UNLESS(fd != -1, error, -1, "could not create socket:",
+                      strerror(errno));
+  return fd;
+}
+
+mcast_publisher_t::mcast_publisher_t(ytp_yamal_t *yamal,
+                                     mcast_publisher_cfg_t c,
+                                     fmc_error_t **error)
+    : yamal(yamal), cfg(std::move(c)) {
+  fmc_error_clear(error);
+  struct sockaddr_in group, gap;
+  struct in_addr iface;
+  RETURN_ERROR_UNLESS(dist_sockaddr_parse(cfg.address, cfg.port, &group) &&
+                          IN_MULTICAST(ntohl(group.sin_addr.s_addr)),
+                      error, , "invalid multicast address", cfg.address);
+  RETURN_ERROR_UNLESS(inaddr_parse(cfg.interface, &iface), error, ,
+                      "invalid interface address", cfg.interface);
+  RETURN_ERROR_UNLESS(dist_sockaddr_parse(cfg.gap_address, cfg.gap_port, &gap),
+                      error, , "invalid gap fill address", cfg.gap_address);
+  RETURN_ERROR_UNLESS(cfg.packet >= sizeof(mcast_packet_hdr_t) +
+                                        sizeof(dist_frame_hdr_t) &&
+                          cfg.packet <= mcast_datagram_max,
+                      error, , "invalid packet size", cfg.packet);
+  RETURN_ERROR_UNLESS(cfg.history > 0 && cfg.batch > 0, error, ,
+                      "history and batch must be positive");
+  RETURN_ERROR_UNLESS(cfg.from == "start" || cfg.from == "end", error, ,
+                      "from must be start or end");
+
+  fd = udp_socket(error);
+  if (*error)
+    return;
+  unsigned char ttl = cfg.ttl;
+  unsigned char loop = cfg.loop;
+  RETURN_ERROR_UNLESS(
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof iface) == 0 &&
+          setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof ttl) ==
+              0 &&
+          setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof loop) ==
+              0,
+      error, , "could not configure multicast:", strerror(errno));
+  RETURN_ERROR_UNLESS(connect(fd, (struct sockaddr *)&group, sizeof group) ==
+                          0,
+                      error, , "could not connect to", cfg.address, cfg.port,
+                      ":", strerror(errno));
+
+  gap_fd = udp_socket(error);
+  if (*error)
+    return;
+  RETURN_ERROR_UNLESS(bind(gap_fd, (struct sockaddr *)&gap, sizeof gap) == 0,
+                      error, , "could not bind to", cfg.gap_address,
+                      cfg.gap_port, ":", strerror(errno));
+  socklen_t len = sizeof gap;
+  getsockname(gap_fd, (struct sockaddr *)&gap, &len);
+  gap_port = ntohs(gap.sin_port);
+
+  session = fmc_cur_time_ns();
+  it = cfg.from == "start" ? ytp_data_begin(yamal, error)
+                           : ytp_data_end(yamal, error);
+  RETURN_ON_ERROR(error, , "could not obtain iterator");
+  out.resize(cfg.batch * cfg.packet);
+  iovs.resize(cfg.batch);
+  msgs.reserve(cfg.batch);
+}
+
+mcast_publisher_t::~mcast_publisher_t() {
+  if (fd != -1)
+    close(fd);
+  if (gap_fd != -1)
+    close(gap_fd);
+}
+
+bool mcast_publisher_t::selected(ytp_mmnode_offs stream,
+                                 fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto where = streams.find(stream);
+  if (where != streams.end())
+    return where->second;
+
+  uint64_t seqno;
+  size_t psz, csz, esz;
+  const char *peer, *channel, *encoding;
+  ytp_mmnode_offs *original, *subscribed;
+  ytp_announcement_lookup(yamal, stream, &seqno, &psz, &peer, &csz, &channel,
+                          &esz, &encoding, &original, &subscribed, error);
+  RETURN_ON_ERROR(error, false, "could not look up stream announcement");
+  string_view sv{channel, csz};
+  auto match = [sv](auto &prefix) { return fmc::starts_with(sv, prefix); };
+  bool sel = cfg.prefixes.empty() ||
+             any_of(cfg.prefixes.begin(), cfg.prefixes.end(), match);
+  streams.emplace(stream, sel);
+  return sel;
+}
+
+size_t mcast_publisher_t::pack(ytp_iterator_t &from, char *dst,
+                               uint16_t &frames, ytp_mmnode_offs &first,
+                               fmc_error_t **error) {
+  fmc_error_clear(error);
+  size_t pos = sizeof(mcast_packet_hdr_t);
+  uint16_t count = 0;
+  bool live = &from == &it;
+  while (count < frames && !ytp_yamal_term(from)) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(yamal, from, &seqno, &ts, &stream, &sz, &data, error);
+    RETURN_ON_ERROR(error, pos, "could not read data");
+    bool sel = selected(stream, error);
+    if (*error)
+      return pos;
+    if (sel) {
+      size_t need = sizeof(dist_frame_hdr_t) + sz;
+      if (sizeof(mcast_packet_hdr_t) + need > cfg.packet) {
+        if (live) {
+          ++oversize;
+          fmc::notice("message of", sz, "bytes does not fit a packet");
+        }
+      } else if (pos + need > cfg.packet) {
+        break;
+      } else {
+        dist_frame_hdr_t hdr = {};
+        hdr.size = sz;
+        hdr.type = (uint8_t)dist_frame_t::DATA;
+        hdr.stream = stream;
+        hdr.ts = ts;
+        hdr.offset = ytp_data_tell(yamal, from, error);
+        RETURN_ON_ERROR(error, pos, "could not obtain offset");
+        if (count == 0)
+          first = hdr.offset;
+        memcpy(dst + pos, &hdr, sizeof hdr);
+        memcpy(dst + pos + sizeof hdr, data, sz);
+        pos += need;
+        ++count;
+      }
+    }
+    from = ytp_yamal_next(yamal, from, error);
+    RETURN_ON_ERROR(error, pos, "could not obtain next iterator");
+  }
+  frames = count;
+  return pos;
+}
+
+void mcast_publisher_t::publish(fmc_error_t **error) {
+  fmc_error_clear(error);
+  if (out_pos == msgs.size()) {
+    // the previous batch is out, build the next one
+    msgs.clear();
+    out_pos = 0;
+    for (size_t i = 0; i < cfg.batch; ++i) {
+      char *dst = out.data() + i * cfg.packet;
+      uint16_t frames = UINT16_MAX;
+      ytp_mmnode_offs first = 0;
+      auto sz = pack(it, dst, frames, first, error);
+      if (*error)
+        return;
+      if (!frames)
+        break;
+      mcast_packet_hdr_t hdr = {};
+      hdr.session = session;
+      hdr.seqno = seqno++;
+      hdr.frames = frames;
+      hdr.type = (uint8_t)mcast_packet_t::PUBLISH;
+      memcpy(dst, &hdr, sizeof hdr);
+      history.push_back({first, frames});
+      if (history.size() > cfg.history)
+        history.pop_front();
+      iovs[i] = {dst, sz};
+      struct mmsghdr msg;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_hdr.msg_iov = &iovs[i];
+      msg.msg_hdr.msg_iovlen = 1;
+      msgs.push_back(msg);
+      ++packets;
+      messages += frames;
+    }
+  }
+
+  auto now = fmc_cur_time_ns();
+  if (out_pos == msgs.size()) {
+    if (now - last_send < cfg.heartbeat)
+      return;
+    // tells the receivers the packets to expect while there is no data
+    mcast_packet_hdr_t hdr = {};
+    hdr.session = session;
+    hdr.seqno = seqno;
+    hdr.type = (uint8_t)mcast_packet_t::HEARTBEAT;
+    ::send(fd, &hdr, sizeof hdr, 0);
+    last_send = now;
+    return;
+  }
+  auto n = sendmmsg(fd, msgs.data() + out_pos, msgs.size() - out_pos, 0);
+  if (n < 0) {
+    // the packets are sent on the next poll
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+      return;
+    RETURN_ERROR(error, , "could not send packets:", strerror(errno));
+  }
+  out_pos += n;
+  last_send = now;
+}
+
+void mcast_publisher_t::reply(const char *data, size_t sz,
+                              const struct sockaddr_in &to) {
+  // a reply dropped here is requested again by the receiver
+  sendto(gap_fd, data, sz, MSG_DONTWAIT, (const struct sockaddr *)&to,
+         sizeof to);
+}
+
+void mcast_publisher_t::serve(const mcast_request_t &req,
+                              const struct sockaddr_in &to,
+                              fmc_error_t **error) {
+  fmc_error_clear(error);
+  if (req.session != session)
+    return;
+  ++requests;
+  if (req.type == (uint8_t)mcast_request_type_t::GAP) {
+    uint64_t base = seqno - history.size();
+    uint64_t first = req.first;
+    uint64_t end = min(req.first + min(req.count, mcast_gap_max), seqno);
+    if (first < base) {
+      mcast_packet_hdr_t hdr = {};
+      hdr.session = session;
+      hdr.seqno = base;
+      hdr.type = (uint8_t)mcast_packet_t::LOST;
+      reply((const char *)&hdr, sizeof hdr, to);
+      first = base;
+    }
+    vector<char> buf(cfg.packet);
+    for (auto s = first; s < end; ++s) {
+      auto &rec = history[s - base];
+      auto from = ytp_data_seek(yamal, rec.offset, error);
+      RETURN_ON_ERROR(error, , "could not seek to packet", s);
+      uint16_t frames = rec.frames;
+      ytp_mmnode_offs offset;
+      auto sz = pack(from, buf.data(), frames, offset, error);
+      if (*error)
+        return;
+      mcast_packet_hdr_t hdr = {};
+      hdr.session = session;
+      hdr.seqno = s;
+      hdr.frames = frames;
+      hdr.type = (uint8_t)mcast_packet_t::RETRANSMIT;
+      memcpy(buf.data(), &hdr, sizeof hdr);
+      reply(buf.data(), sz, to);
+      ++retransmitted;
+    }
+  } else if (req.type == (uint8_t)mcast_request_type_t::ANNOUNCE) {
+    // only streams that have been published
+    auto where = streams.find(req.first);
+    if (where == streams.end() || !where->second)
+      return;
+    uint64_t aseqno;
+    size_t psz, csz, esz;
+    const char *peer, *channel, *encoding;
+    ytp_mmnode_offs *original, *subscribed;
+    ytp_announcement_lookup(yamal, req.first, &aseqno, &psz, &peer, &csz,
+                            &channel, &esz, &encoding, &original, &subscribed,
+                            error);
+    RETURN_ON_ERROR(error, , "could not look up stream announcement");
+    mcast_packet_hdr_t hdr = {};
+    hdr.session = session;
+    hdr.frames = 1;
+    hdr.type = (uint8_t)mcast_packet_t::ANNOUNCE;
+    dist_frame_hdr_t frame = {};
+    frame.size = sizeof(dist_announce_t) + psz + csz + esz;
+    frame.type = (uint8_t)dist_frame_t::ANNOUNCE;
+    frame.stream = req.first;
+    dist_announce_t sizes = {(uint32_t)psz, (uint32_t)csz, (uint32_t)esz};
+    string buf;
+    buf.append((const char *)&hdr, sizeof hdr);
+    buf.append((const char *)&frame, sizeof frame);
+    buf.append((const char *)&sizes, sizeof sizes);
+    buf.append(peer, psz);
+    buf.append(channel, csz);
+    buf.append(encoding, esz);
+    if (buf.size() <= mcast_datagram_max)
+      reply(buf.data(), buf.size(), to);
+  }
+}
+
+void mcast_publisher_t::poll(fmc_error_t **error) {
+  fmc_error_clear(error);
+  publish(error);
+  if (*error)
+    return;
+  for (size_t i = 0; i < mcast_requests_max; ++i) {
+    mcast_request_t req;
+    struct sockaddr_in from;
+    socklen_t len = sizeof from;
+    auto n = recvfrom(gap_fd, &req, sizeof req, MSG_DONTWAIT,
+                      (struct sockaddr *)&from, &len);
+    if (n < 0)
+      break;
+    if (n != sizeof req)
+      continue;
+    serve(req, from, error);
+    if (*error)
+      return;
+  }
+}
+
+mcast_receiver_t::mcast_receiver_t(ytp_yamal_t *yamal, mcast_receiver_cfg_t c,
+                                   fmc_error_t **error)
+    : yamal(yamal), cfg(std::move(c)) {
+  fmc_error_clear(error);
+  struct sockaddr_in group;
+  struct ip_mreq mreq;
+  RETURN_ERROR_UNLESS(dist_sockaddr_parse(cfg.address, cfg.port, &group) &&
+                          IN_MULTICAST(ntohl(group.sin_addr.s_addr)),
+                      error, , "invalid multicast address", cfg.address);
+  RETURN_ERROR_UNLESS(inaddr_parse(cfg.interface, &mreq.imr_interface),
+                      error, , "invalid interface address", cfg.interface);
+  RETURN_ERROR_UNLESS(
+      dist_sockaddr_parse(cfg.gap_address, cfg.gap_port, &gap_addr), error, ,
+      "invalid gap fill address", cfg.gap_address);
+  RETURN_ERROR_UNLESS(cfg.retry > 0 && cfg.pending > 0, error, ,
+                      "retry and pending must be positive");
+  mreq.imr_multiaddr = group.sin_addr;
+
+  fd = udp_socket(error);
+  if (*error)
+    return;
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+  struct sockaddr_in any = group;
+  any.sin_addr.s_addr = htonl(INADDR_ANY);
+  RETURN_ERROR_UNLESS(bind(fd, (struct sockaddr *)&any, sizeof any) == 0,
+                      error, , "could not bind to port", cfg.port, ":",
+                      strerror(errno));
+  socklen_t len = sizeof any;
+  getsockname(fd, (struct sockaddr *)&any, &len);
+  port = ntohs(any.sin_port);
+  RETURN_ERROR_UNLESS(setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                                 sizeof mreq) == 0,
+                      error, , "could not join", cfg.address, ":",
+                      strerror(errno));
+
+  gap_fd = udp_socket(error);
+  if (*error)
+    return;
+  if (cfg.rcvbuf > 0) {
+    for (int sock : {fd, gap_fd}) {
+      if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &cfg.rcvbuf,
+                     sizeof cfg.rcvbuf) != 0)
+        fmc::notice("could not set SO_RCVBUF:", strerror(errno));
+    }
+  }
+
+  ystreams = ytp_streams_new(yamal, error);
+  RETURN_ON_ERROR(error, , "could not create streams");
+  buf.resize(mcast_receive_batch * mcast_datagram_max);
+  iovs.resize(mcast_receive_batch);
+  msgs.resize(mcast_receive_batch);
+  for (size_t i = 0; i < mcast_receive_batch; ++i) {
+    iovs[i] = {buf.data() + i * mcast_datagram_max, mcast_datagram_max};
+    memset(&msgs[i], 0, sizeof msgs[i]);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+mcast_receiver_t::~mcast_receiver_t() {
+  fmc_error_t *error = nullptr;
+  if (fd != -1)
+    close(fd);
+  if (gap_fd != -1)
+    close(gap_fd);
+  if (ystreams)
+    ytp_streams_del(ystreams, &error);
+}
+
+void mcast_receiver_t::request(mcast_request_type_t type, uint64_t first,
+                               uint32_t count) {
+  mcast_request_t req = {};
+  req.session = session;
+  req.first = first;
+  req.count = count;
+  req.type = (uint8_t)type;
+  sendto(gap_fd, &req, sizeof req, MSG_DONTWAIT,
+         (const struct sockaddr *)&gap_addr, sizeof gap_addr);
+}
+
+bool mcast_receiver_t::commit(const char *data, size_t sz,
+                              fmc_error_t **error) {
+  fmc_error_clear(error);
+  // the messages of a packet are committed once all of its streams are known
+  bool known_streams = true;
+  dist_frame_hdr_t hdr;
+  for (size_t pos = sizeof(mcast_packet_hdr_t); pos < sz;
+       pos += sizeof hdr + hdr.size) {
+    RETURN_ERROR_UNLESS(sz - pos >= sizeof hdr, error, false,
+                        "invalid packet");
+    memcpy(&hdr, data + pos, sizeof hdr);
+    RETURN_ERROR_UNLESS(sz - pos - sizeof hdr >= hdr.size &&
+                            hdr.type == (uint8_t)dist_frame_t::DATA,
+                        error, false, "invalid packet");
+    if (!streams.count(hdr.stream)) {
+      wanted.insert(hdr.stream);
+      known_streams = false;
+    }
+  }
+  if (!known_streams)
+    return false;
+  for (size_t pos = sizeof(mcast_packet_hdr_t); pos < sz;
+       pos += sizeof hdr + hdr.size) {
+    memcpy(&hdr, data + pos, sizeof hdr);
+    auto *dst = ytp_data_reserve(yamal, hdr.size, error);
+    RETURN_ON_ERROR(error, false, "could not reserve message");
+    memcpy(dst, data + pos + sizeof hdr, hdr.size);
+    ytp_data_commit(yamal, hdr.ts, streams[hdr.stream], dst, error);
+    RETURN_ON_ERROR(error, false, "could not commit message");
+    ++messages;
+  }
+  return true;
+}
+
+void mcast_receiver_t::announce(const char *data, size_t sz,
+                                fmc_error_t **error) {
+  fmc_error_clear(error);
+  dist_frame_hdr_t hdr;
+  for (size_t pos = sizeof(mcast_packet_hdr_t); sz - pos >= sizeof hdr;
+       pos += sizeof hdr + hdr.size) {
+    memcpy(&hdr, data + pos, sizeof hdr);
+    dist_announce_t sizes;
+    RETURN_ERROR_UNLESS(hdr.type == (uint8_t)dist_frame_t::ANNOUNCE &&
+                            sz - pos - sizeof hdr >= hdr.size &&
+                            hdr.size >= sizeof sizes,
+                        error, , "invalid announcement");
+    const char *payload = data + pos + sizeof hdr;
+    memcpy(&sizes, payload, sizeof sizes);
+    RETURN_ERROR_UNLESS((uint64_t)sizes.peer + sizes.channel +
+                                sizes.encoding + sizeof sizes ==
+                            hdr.size,
+                        error, , "invalid announcement");
+    wanted.erase(hdr.stream);
+    if (streams.count(hdr.stream))
+      continue;
+    const char *peer = payload + sizeof sizes;
+    const char *channel = peer + sizes.peer;
+    const char *encoding = channel + sizes.channel;
+    auto stream =
+        ytp_streams_announce(ystreams, sizes.peer, peer, sizes.channel,
+                             channel, sizes.encoding, encoding, error);
+    RETURN_ON_ERROR(error, , "could not announce stream");
+    streams.emplace(hdr.stream, stream);
+  }
+}
+
+void mcast_receiver_t::handle(const char *data, size_t sz,
+                              fmc_error_t **error) {
+  fmc_error_clear(error);
+  mcast_packet_hdr_t hdr;
+  if (sz < sizeof hdr)
+    return;
+  memcpy(&hdr, data, sizeof hdr);
+  auto type = (mcast_packet_t)hdr.type;
+  if (hdr.session != session) {
+    // only the live packets of a newer publisher start a session
+    if (hdr.session < session || (type != mcast_packet_t::PUBLISH &&
+                                  type != mcast_packet_t::HEARTBEAT))
+      return;
+    fmc::notice("receiver joined session", hdr.session, "of", cfg.address,
+                cfg.port, "at packet", hdr.seqno);
+    session = hdr.session;
+    expected = known = hdr.seqno;
+    held.clear();
+    streams.clear();
+    wanted.clear();
+  }
+  switch (type) {
+  case mcast_packet_t::RETRANSMIT:
+    ++retransmitted;
+    [[fallthrough]];
+  case mcast_packet_t::PUBLISH:
+    ++packets;
+    known = max(known, hdr.seqno + 1);
+    if (hdr.seqno < expected || held.count(hdr.seqno)) {
+      ++duplicates;
+      return;
+    }
+    // in sequence packets are committed without being held
+    if (hdr.seqno == expected && held.empty()) {
+      if (commit(data, sz, error))
+        ++expected;
+      if (*error || hdr.seqno != expected)
+        return;
+    }
+    held.emplace(hdr.seqno, vector<char>(data, data + sz));
+    break;
+  case mcast_packet_t::HEARTBEAT:
+    known = max(known, hdr.seqno);
+    break;
+  case mcast_packet_t::ANNOUNCE:
+    announce(data, sz, error);
+    break;
+  case mcast_packet_t::LOST:
+    if (hdr.seqno > expected) {
+      fmc::notice("receiver lost packets", expected, "to", hdr.seqno - 1);
+      lost += hdr.seqno - expected;
+      held.erase(held.begin(), held.lower_bound(hdr.seqno));
+      expected = hdr.seqno;
+    }
+    break;
+  }
+}
+
+void mcast_receiver_t::drain(fmc_error_t **error) {
+  fmc_error_clear(error);
+  while (!held.empty()) {
+    auto where = held.begin();
+    if (where->first < expected) {
+      held.erase(where);
+      continue;
+    }
+    if (where->first > expected) {
+      // give up on the gap once too many packets are held after it
+      if (held.size() <= cfg.pending)
+        break;
+      fmc::notice("receiver lost packets", expected, "to", where->first - 1);
+      lost += where->first - expected;
+      expected = where->first;
+    }
+    if (!commit(where->second.data(), where->second.size(), error))
+      break;
+    held.erase(where);
+    ++expected;
+  }
+}
+
+void mcast_receiver_t::receive(int sock, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto n = recvmmsg(sock, msgs.data(), msgs.size(), MSG_DONTWAIT, nullptr);
+  for (int i = 0; i < n; ++i) {
+    if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+      continue;
+    handle((const char *)iovs[i].iov_base, msgs[i].msg_len, error);
+    if (*error)
+      return;
+  }
+}
+
+void mcast_receiver_t::poll(fmc_error_t **error) {
+  fmc_error_clear(error);
+  receive(fd, error);
+  if (*error)
+    return;
+  receive(gap_fd, error);
+  if (*error)
+    return;
+  drain(error);
+  if (*error || !session)
+    return;
+
+  auto now = fmc_cur_time_ns();
+  if (now < next_request)
+    return;
+  // requests the gaps before, between and after the packets held
+  uint64_t asked = 0;
+  auto ask = [&](uint64_t first, uint64_t end) {
+    while (first < end && asked < mcast_requested_max) {
+      auto count = min<uint64_t>({end - first, mcast_gap_max,
+                                  mcast_requested_max - asked});
+      request(mcast_request_type_t::GAP, first, count);
+      first += count;
+      asked += count;
+    }
+  };
+  uint64_t first = expected;
+  for (auto &[seqno, packet] : held) {
+    if (asked >= mcast_requested_max)
+      break;
+    ask(first, seqno);
+    first = seqno + 1;
+  }
+  ask(first, known);
+  for (auto stream : wanted)
+    request(mcast_request_type_t::ANNOUNCE, stream, 1);
+  if (asked || !wanted.empty())
+    next_request = now + cfg.retry;
+  requested += asked;
+}
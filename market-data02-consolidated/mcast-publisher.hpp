@@ -0,0 +1,239 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fmc/error.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+#include "tcp-distributor.hpp"
+
+#ifndef __linux__
+/*
+ * sendmmsg(2) and recvmmsg(2) are Linux only, elsewhere the batches are
+ * sent and received one datagram at a time with the same interface
+ */
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+
+inline int sendmmsg(int fd, struct mmsghdr *msgs, unsigned int n,
+                    int flags) {
+  unsigned int i = 0;
+  for (; i < n; ++i) {
+    auto sent = sendmsg(fd, &msgs[i].msg_hdr, flags);
+    if (sent < 0)
+      return i ? (int)i : -1;
+    msgs[i].msg_len = sent;
+  }
+  return i;
+}
+
+inline int recvmmsg(int fd, struct mmsghdr *msgs, unsigned int n, int flags,
+                    struct timespec *) {
+  unsigned int i = 0;
+  for (; i < n; ++i) {
+    auto got = recvmsg(fd, &msgs[i].msg_hdr, flags);
+    if (got < 0)
+      return i ? (int)i : -1;
+    msgs[i].msg_len = got;
+  }
+  return i;
+}
+#endif
+
+/*
+ * UDP multicast distribution of a yamal file. The publisher packs the data
+ * messages of the selected channels into datagrams of at most the packet
+ * size, each one a mcast_packet_hdr_t followed by the frames of the tcp
+ * distributor. The packets of a session are numbered from 0, a heartbeat
+ * carrying the next number is sent while there is nothing to publish.
+ *
+ * Receivers send mcast_request_t datagrams to the gap fill port of the
+ * publisher, which answers them to the sender: the packets of a gap are
+ * rebuilt from the yamal file and sent again, and the announcement of a
+ * stream is sent the first time a receiver sees one of its messages.
+ * Fields are little endian.
+ */
+enum class mcast_packet_t : uint8_t {
+  PUBLISH = 'P',    /* data frames */
+  RETRANSMIT = 'R', /* data frames of a packet requested again */
+  HEARTBEAT = 'H',  /* no frames, seqno is the number of the next packet */
+  ANNOUNCE = 'A',   /* announcement frames, seqno unused */
+  LOST = 'L',       /* no frames, packets before seqno are not available */
+};
+
+struct mcast_packet_hdr_t {
+  uint64_t session; /* publisher start time */
+  uint64_t seqno;
+  uint16_t frames;
+  uint8_t type; /* mcast_packet_t */
+  uint8_t pad[5];
+};
+
+enum class mcast_request_type_t : uint8_t {
+  GAP = 'G',      /* count packets from first */
+  ANNOUNCE = 'A', /* announcement of stream first */
+};
+
+struct mcast_request_t {
+  uint64_t session;
+  uint64_t first;
+  uint32_t count;
+  uint8_t type; /* mcast_request_type_t */
+  uint8_t pad[3];
+};
+
+/* packets resent at most for one gap request */
+constexpr uint32_t mcast_gap_max = 256;
+
+struct mcast_publisher_cfg_t {
+  std::string address = "239.192.0.1"; /* multicast group */
+  int port = 0;
+  std::string interface = "0.0.0.0"; /* address of the outgoing interface */
+  int ttl = 1;
+  bool loop = true; /* deliver to receivers on this host */
+  size_t packet = 1472; /* datagram size, the MTU without IP and UDP */
+  std::vector<std::string> prefixes; /* channels published, all if empty */
+  std::string from = "end"; /* start to publish the whole file */
+  std::string gap_address = "0.0.0.0";
+  int gap_port = 0; /* 0 picks a free port */
+  size_t history = 1 << 20; /* packets that can be sent again */
+  size_t batch = 64; /* packets per sendmmsg */
+  int64_t heartbeat = 100000000LL;
+};
+
+/*
+ * Publishes the data of a yamal file on a multicast group and serves the
+ * gap fill requests of the receivers. Messages larger than a packet are
+ * not published. Keeps the file offset of the first message of every
+ * packet in the history, so packets are sent again without being stored.
+ *
+ * Does not own the yamal, and is driven by calling poll(), which never
+ * blocks.
+ */
+struct mcast_publisher_t {
+  mcast_publisher_t(ytp_yamal_t *yamal, mcast_publisher_cfg_t cfg,
+                    fmc_error_t **error);
+  ~mcast_publisher_t();
+
+  /* publishes the new messages and answers the pending requests */
+  void poll(fmc_error_t **error);
+
+  struct packet_rec_t {
+    ytp_mmnode_offs offset; /* first message of the packet */
+    uint16_t frames;
+  };
+
+  bool selected(ytp_mmnode_offs stream, fmc_error_t **error);
+  /*
+   * packs the messages from it into dst, up to frames of them, and returns
+   * the bytes used, leaves it after the last message packed
+   */
+  size_t pack(ytp_iterator_t &it, char *dst, uint16_t &frames,
+              ytp_mmnode_offs &first, fmc_error_t **error);
+  void publish(fmc_error_t **error);
+  void serve(const mcast_request_t &req, const struct sockaddr_in &to,
+             fmc_error_t **error);
+  void reply(const char *data, size_t sz, const struct sockaddr_in &to);
+
+  ytp_yamal_t *yamal = nullptr;
+  mcast_publisher_cfg_t cfg;
+  int fd = -1;
+  int gap_fd = -1;
+  int gap_port = 0; /* port the gap fill requests are received on */
+  uint64_t session = 0;
+  ytp_iterator_t it = nullptr;
+  std::unordered_map<ytp_mmnode_offs, bool> streams;
+  uint64_t seqno = 0; /* next packet */
+  std::deque<packet_rec_t> history;
+  /* packets built and not sent yet */
+  std::vector<char> out;
+  std::vector<struct mmsghdr> msgs;
+  std::vector<struct iovec> iovs;
+  size_t out_pos = 0;
+  int64_t last_send = 0;
+
+  uint64_t packets = 0;
+  uint64_t messages = 0;
+  uint64_t retransmitted = 0;
+  uint64_t requests = 0;
+  uint64_t oversize = 0;
+};
+
+struct mcast_receiver_cfg_t {
+  std::string address = "239.192.0.1"; /* multicast group */
+  int port = 0;
+  std::string interface = "0.0.0.0"; /* address of the joining interface */
+  std::string gap_address = "127.0.0.1";
+  int gap_port = 0;
+  int rcvbuf = 0; /* SO_RCVBUF, the system default if 0 */
+  int64_t retry = 20000000LL; /* time before a request is sent again */
+  size_t pending = 1 << 16; /* packets held after a gap */
+};
+
+/*
+ * Joins a multicast group of a publisher and writes the messages received
+ * into a local yamal in sequence. Packets after a gap are held while the
+ * gap is requested from the publisher, and messages of a stream not yet
+ * known wait for its announcement. Packets that the publisher no longer
+ * has, or that do not arrive before more than pending packets are held,
+ * are counted as lost and skipped.
+ */
+struct mcast_receiver_t {
+  mcast_receiver_t(ytp_yamal_t *yamal, mcast_receiver_cfg_t cfg,
+                   fmc_error_t **error);
+  ~mcast_receiver_t();
+
+  /* reads the packets available and commits the messages in sequence */
+  void poll(fmc_error_t **error);
+
+  void receive(int sock, fmc_error_t **error);
+  void handle(const char *data, size_t sz, fmc_error_t **error);
+  /* false if the packet waits for the announcement of a stream */
+  bool commit(const char *data, size_t sz, fmc_error_t **error);
+  void announce(const char *data, size_t sz, fmc_error_t **error);
+  /* commits the packets that are next in sequence */
+  void drain(fmc_error_t **error);
+  void request(mcast_request_type_t type, uint64_t first, uint32_t count);
+
+  ytp_yamal_t *yamal = nullptr;
+  ytp_streams_t *ystreams = nullptr;
+  mcast_receiver_cfg_t cfg;
+  int fd = -1;
+  int gap_fd = -1;
+  int port = 0; /* port of the group joined */
+  struct sockaddr_in gap_addr;
+  uint64_t session = 0;
+  uint64_t expected = 0; /* next packet to commit */
+  uint64_t known = 0;    /* packets published as far as we know */
+  std::map<uint64_t, std::vector<char>> held;
+  std::unordered_map<uint64_t, ytp_mmnode_offs> streams;
+  std::unordered_set<uint64_t> wanted; /* streams to be announced */
+  int64_t next_request = 0;
+  std::vector<char> buf;
+  std::vector<struct mmsghdr> msgs;
+  std::vector<struct iovec> iovs;
+
+  uint64_t packets = 0;
+  uint64_t messages = 0;
+  uint64_t requested = 0; /* packets requested again */
+  uint64_t retransmitted = 0;
+  uint64_t duplicates = 0;
+  uint64_t lost = 0;
+};
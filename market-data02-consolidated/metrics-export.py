@@ -0,0 +1,98 @@
+"""
+        COPYRIGHT (c) 2019-2023 by Featuremine Corporation.
+        
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+"""
+
+import argparse
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from yamal import yamal
+
+record = struct.Struct('<9Q')
+one_way = struct.Struct('<32sQ7qQ')
+one_way_fields = ["min", "p50", "p90", "p99", "p99.9", "max"]
+fields = ["interval", "messages", "bytes", "duplicates", "parse_errors",
+          "reconnects", "gaps", "ring_drops", "queue_depth"]
+gauges = {"queue_depth"}
+
+latest = {}
+latest_one_way = {}
+lock = threading.Lock()
+
+
+def follow(ytp_file, once):
+    y = yamal(ytp_file)
+    it = iter(y.data())
+    while True:
+        for seq, ts, strm, msg in it:
+            if not strm.channel.startswith("stats/"):
+                continue
+            if strm.channel.endswith("/metrics"):
+                peer = strm.channel[len("stats/"):-len("/metrics")]
+                with lock:
+                    latest[peer] = (ts, record.unpack(msg))
+            elif strm.channel.endswith("/one-way"):
+                venue, count, *values = one_way.unpack(msg)
+                with lock:
+                    latest_one_way[venue.rstrip(b'\0').decode()] = (ts, values)
+        if once:
+            break
+        time.sleep(0.1)
+
+
+def exposition():
+    lines = []
+    with lock:
+        snapshot = dict(latest)
+        one_way_snapshot = dict(latest_one_way)
+    for i, name in enumerate(fields):
+        if name == "interval":
+            continue
+        kind = "gauge" if name in gauges else "counter"
+        metric = "feed_" + name + ("" if kind == "gauge" else "_total")
+        lines.append("# TYPE {} {}".format(metric, kind))
+        for peer, (ts, values) in sorted(snapshot.items()):
+            lines.append('{}{{peer="{}"}} {} {}'.format(metric, peer, values[i], ts // 1000000))
+    if one_way_snapshot:
+        lines.append("# TYPE feed_one_way_latency_ns gauge")
+        for venue, (ts, values) in sorted(one_way_snapshot.items()):
+            for q, val in zip(one_way_fields, values):
+                lines.append('feed_one_way_latency_ns{{venue="{}",stat="{}"}} {} {}'.format(venue, q, val, ts // 1000000))
+        lines.append("# TYPE feed_clock_skew_ns gauge")
+        for venue, (ts, values) in sorted(one_way_snapshot.items()):
+            lines.append('feed_clock_skew_ns{{venue="{}"}} {} {}'.format(venue, values[6], ts // 1000000))
+    return "\n".join(lines) + "\n"
+
+
+class handler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        body = exposition().encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain; version=0.0.4")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Exports the metrics streams of the feed components in Prometheus text format")
+    parser.add_argument("--ytp-file", help="ytp file name", required=True)
+    parser.add_argument("--port", help="serve metrics over http on this port instead of printing them once",
+                        type=int, default=None, required=False)
+    args = parser.parse_args()
+
+    if args.port is None:
+        follow(args.ytp_file, True)
+        print(exposition(), end="")
+    else:
+        threading.Thread(target=follow, args=(args.ytp_file, False), daemon=True).start()
+        ThreadingHTTPServer(("", args.port), handler).serve_forever()
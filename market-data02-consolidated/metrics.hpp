@@ -0,0 +1,85 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+
+#include <fmc/error.h>
+#include <fmc/time.h>
+#include <ytp/data.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+// Counters and gauges of a component published on the metrics stats
+// stream. Counters are cumulative since the component started, so a
+// lost or late record does not lose counts, gauges are sampled at
+// publishing time. All values are little endian, python can read it with
+// struct.unpack('<9Q', msg).
+struct metrics_record_t {
+  uint64_t interval = 0;    // ns since the previous record
+  uint64_t messages = 0;    // input messages processed
+  uint64_t bytes = 0;       // input bytes processed
+  uint64_t duplicates = 0;  // input messages dropped as duplicates
+  uint64_t parse_errors = 0;
+  uint64_t reconnects = 0;
+  uint64_t gaps = 0;        // jumps in contiguous vendor sequence numbers
+  uint64_t ring_drops = 0;  // messages that did not fit the consumer ring
+  uint64_t queue_depth = 0; // gauge, input bytes pending processing
+};
+
+constexpr std::string_view metrics_encoding =
+    "Content-Type application/octet-stream\n"
+    "Content-Schema metrics2";
+
+inline ytp_mmnode_offs metrics_stream_announce(ytp_streams_t *streams,
+                                               std::string_view peer,
+                                               fmc_error_t **error) {
+  std::string chstr = "stats/";
+  chstr.append(peer);
+  chstr.append("/metrics");
+  return ytp_streams_announce(streams, peer.size(), peer.data(), chstr.size(),
+                              chstr.data(), metrics_encoding.size(),
+                              metrics_encoding.data(), error);
+}
+
+// Metrics of a single component. Updating is a plain increment of a
+// field of cur, formatting is left to the readers of the stream.
+struct metrics_t {
+  metrics_record_t cur;
+
+  // Publishes the current values if any counter changed since the
+  // previous record, so idle components do not grow the file. Gauges are
+  // sampled along but do not trigger a record on their own.
+  void publish(ytp_yamal_t *yamal, ytp_mmnode_offs stream,
+               fmc_error_t **error) {
+    fmc_error_clear(error);
+    auto now = fmc_cur_time_ns();
+    cur.interval = 0;
+    if (memcmp(&cur, &last_, offsetof(metrics_record_t, queue_depth)) == 0)
+      return;
+    cur.interval = last_time_ ? (uint64_t)(now - last_time_) : 0;
+    auto *dst = ytp_data_reserve(yamal, sizeof(metrics_record_t), error);
+    if (*error)
+      return;
+    memcpy(dst, &cur, sizeof(cur));
+    ytp_data_commit(yamal, now, stream, dst, error);
+    if (*error)
+      return;
+    last_ = cur;
+    last_.interval = 0;
+    last_time_ = now;
+  }
+
+private:
+  metrics_record_t last_;
+  int64_t last_time_ = 0;
+};
@@ -0,0 +1,149 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "common.hpp"
+#include <cmp/cmp.h>
+#include <fmc++/error.hpp>
+#include <fmc++/logger.hpp>
+#include <fmc++/mpl.hpp>
+#include <fmc++/serialization.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc++/time.hpp>
+#include <fmc/cmdline.h>
+#include <fmc/files.h>
+#include <fmc/time.h>
+#include <tuple>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+
+// vendor time of OKX messages in milliseconds, returns 0 if invalid
+inline int64_t okx_time_ns(string_view in) {
+  auto ts = simple_json_parse(in, "\"ts\":\"", "\"").first;
+  auto [ms, parsed] = fmc::from_string_view<int64_t>(ts);
+  if (!ts.size() || parsed.size() != ts.size())
+    return 0;
+  return ms * 1000000LL;
+}
+
+// OKX public channels, the parsers receive the data array of the push
+// messages. bbo-tbt carries the best bid and offer, asks and bids are
+// arrays of [price, size, 0, orders] with at most one level, and trades
+// the trades, possibly several per message.
+pair<string_view, parser_t> get_okx_channel_in(string_view sv,
+                                               fmc_error_t **error) {
+  auto pos = sv.find_last_of('@');
+  auto none = make_pair<string_view, parser_t>(string_view(), nullptr);
+  RETURN_ERROR_UNLESS(pos != sv.npos, error, none,
+                      "missing @ in the OKX stream name", sv);
+
+  auto feedtype = sv.substr(pos + 1);
+  auto outsv = sv.substr(0, pos);
+  if (feedtype == "bbo-tbt") {
+    auto parse_okx_bbo =
+        [st = bbo_state_t{}](string_view in, ore_writer_t *out, int64_t tm,
+                             uint64_t *last, bool skip,
+                             fmc_error_t **error) mutable {
+          auto val = simple_json_parse(in, "\"seqId\":", ",}").first;
+          auto [seqno, parsed] = fmc::from_string_view<uint64_t>(val);
+          RETURN_ERROR_UNLESS(val.size() && val.size() == parsed.size(), error,
+                              false, "could not parse message", in);
+          if (seqno <= *last)
+            return false;
+          *last = seqno;
+          auto vendor_ns = okx_time_ns(in);
+          RETURN_ERROR_UNLESS(vendor_ns, error, false,
+                              "could not parse vendor time in message", in);
+          string_view pxs[2];
+          string_view qts[2];
+          const string_view keys[2] = {"\"bids\":["sv, "\"asks\":["sv};
+          for (int side = 0; side < 2; ++side) {
+            auto [level, rem] = simple_json_parse(in, keys[side], "]");
+            RETURN_ERROR_UNLESS(rem.size(), error, false,
+                                "could not parse message", in);
+            if (!level.size())
+              continue;
+            tie(pxs[side], rem) = simple_json_parse(level, "\"", "\"");
+            tie(qts[side], rem) = simple_json_parse(rem, "\"", "\"");
+            RETURN_ERROR_UNLESS(pxs[side].size() && qts[side].size(), error,
+                                false, "could not parse message", in);
+          }
+          return ore_write_bbo(st, out, tm, tm - vendor_ns, seqno, pxs[0],
+                               qts[0], pxs[1], qts[1], skip, error);
+        };
+    return {outsv, parse_okx_bbo};
+  } else if (feedtype == "trades") {
+    auto parse_okx_trades = [](string_view in, ore_writer_t *out, int64_t tm,
+                               uint64_t *last, bool skip,
+                               fmc_error_t **error) {
+      auto rem = in;
+      string_view trademsg;
+      bool found = false;
+      bool processed = false;
+      while (true) {
+        tie(trademsg, rem) = simple_json_parse(rem, "{", "}");
+        if (!trademsg.size())
+          break;
+        found = true;
+        auto val = simple_json_parse(trademsg, "\"tradeId\":\"", "\"").first;
+        auto [seqno, parsed] = fmc::from_string_view<uint64_t>(val);
+        RETURN_ERROR_UNLESS(val.size() && val.size() == parsed.size(), error,
+                            false, "could not parse message", in);
+        if (seqno <= *last)
+          continue;
+        *last = seqno;
+        processed = true;
+        auto vendor_ns = okx_time_ns(trademsg);
+        RETURN_ERROR_UNLESS(vendor_ns, error, false,
+                            "could not parse vendor time in message", in);
+        auto trdpx = simple_json_parse(trademsg, "\"px\":\"", "\"").first;
+        RETURN_ERROR_UNLESS(trdpx.size(), error, false,
+                            "could not parse trade price in message", in);
+        auto trdqt = simple_json_parse(trademsg, "\"sz\":\"", "\"").first;
+        RETURN_ERROR_UNLESS(trdqt.size(), error, false,
+                            "could not parse trade quantity in message", in);
+        // side of the taker order
+        auto side = simple_json_parse(trademsg, "\"side\":\"", "\"").first;
+        RETURN_ERROR_UNLESS(side.size(), error, false,
+                            "could not parse side in message", in);
+
+        // ORE Off Book Trade Message
+        // [11, receive, vendor offset, vendor seqno, batch, imnt id, trade
+        // price, qty, decorator]
+        ore_write(out, error,
+                  (uint8_t)11,               // Message Type ID
+                  (int64_t)tm,               // receive
+                  (int64_t)(tm - vendor_ns), // vendor offset in ns
+                  (uint64_t)seqno,           // vendor seqno
+                  (uint8_t)0,                // batch
+                  (uint64_t)chanid,          // imnt_id
+                  trdpx,                     // trade price
+                  trdqt,                     // qty
+                  string_view(side == "sell" ? "b" : "a"));
+      }
+      RETURN_ERROR_UNLESS(found, error, false, "could not parse message", in);
+      return processed;
+    };
+    return {outsv, parse_okx_trades};
+  }
+  RETURN_ERROR(error, none, "unknown OKX stream type", feedtype);
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <libwebsockets.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "feed-engine.hpp"
+#include "okx-parser.hpp"
+
+/*
+ * OKX v5 public websocket, push messages name their stream in "arg",
+ * {"arg":{"channel":"trades","instId":"BTC-USDT"},"data":[...]}, and
+ * control messages are objects with an "event" field
+ */
+
+static const char *const okx_types[] = {"bbo-tbt", "trades"};
+
+static std::string okx_path(const std::set<std::string> &secs) {
+  return "/ws/v5/public";
+}
+
+static void okx_request(bool subscribe, const std::vector<std::string> &secs,
+                        unsigned *id, std::vector<std::string> &out) {
+  std::string msg = "{\"op\":\"";
+  msg.append(subscribe ? "subscribe" : "unsubscribe");
+  msg.append("\",\"args\":[");
+  char sep = ' ';
+  for (auto &sec : secs) {
+    for (auto *tp : okx_types) {
+      msg.push_back(sep);
+      msg.append("{\"channel\":\"");
+      msg.append(tp);
+      msg.append("\",\"instId\":\"");
+      msg.append(sec);
+      msg.append("\"}");
+      sep = ',';
+    }
+  }
+  msg.append("]}");
+  out.push_back(std::move(msg));
+}
+
+static venue_msg_t okx_route(std::string_view msg, venue_route_t *out) {
+  if (msg == "pong")
+    return venue_msg_t::CONTROL;
+  if (auto event = simple_json_parse(msg, "\"event\":\"", "\"").first;
+      event.size()) {
+    if (event == "error") {
+      lwsl_err("%s, received error message: %.*s:\n", __func__,
+               (int)msg.size(), msg.data());
+      return venue_msg_t::FATAL;
+    }
+    lwsl_user("%s: %.*s\n", __func__, (int)msg.size(), msg.data());
+    return venue_msg_t::CONTROL;
+  }
+  // the stream is named in "arg", ahead of the data
+  out->type = simple_json_parse(msg, "\"channel\":\"", "\"").first;
+  out->sec = simple_json_parse(msg, "\"instId\":\"", "\"").first;
+  auto pos = msg.find("\"data\":");
+  auto end = msg.find_last_of(']');
+  if (!out->type.size() || !out->sec.size() || pos == msg.npos ||
+      end == msg.npos || end < pos) {
+    lwsl_err("%s, invalid message %.*s:\n", __func__, (int)msg.size(),
+             msg.data());
+    return venue_msg_t::INVALID;
+  }
+  pos += sizeof("\"data\":") - 1;
+  out->data = msg.substr(pos, end + 1 - pos);
+  return venue_msg_t::DATA;
+}
+
+static int64_t okx_vendor_time(std::string_view data) {
+  return okx_time_ns(data);
+}
+
+static const std::string_view okx_samples[] = {
+    R"({"arg":{"channel":"bbo-tbt","instId":"BTC-USDT"},"data":[{)"
+    R"("asks":[["27341.2","0.375","0","2"]],)"
+    R"("bids":[["27341.1","1.25","0","3"]],)"
+    R"("ts":"1680000000123","seqId":3402114571}]})",
+    R"({"arg":{"channel":"trades","instId":"BTC-USDT"},"data":[{)"
+    R"("instId":"BTC-USDT","tradeId":"412230915","px":"27341.2",)"
+    R"("sz":"0.001","side":"buy","ts":"1680000000124","count":"1"}]})",
+    R"({"arg":{"channel":"bbo-tbt","instId":"ETH-USDT"},"data":[{)"
+    R"("asks":[["1787.07","12.5","0","4"]],)"
+    R"("bids":[["1787.06","41.5252","0","7"]],)"
+    R"("ts":"1680000000125","seqId":2817740932}]})",
+    R"({"arg":{"channel":"trades","instId":"ETH-USDT"},"data":[{)"
+    R"("instId":"ETH-USDT","tradeId":"301772514","px":"1787.06",)"
+    R"("sz":"0.375","side":"sell","ts":"1680000000126","count":"2"}]})"};
+
+constinit const venue_t okx_venue = {
+    .name = "okx",
+    .component = "okx-feed-handler",
+    .descr = "OKX feed handler component",
+    .encoding = "Content-Type application/json\n"
+                "Content-Schema OKX",
+    .address = "ws.okx.com",
+    .port = 8443,
+    .us_address = nullptr,
+    .us_port = 0,
+    .types = okx_types,
+    // trades may aggregate several trade ids into one message
+    .contiguous = nullptr,
+    .path_subscribes = false,
+    .path = okx_path,
+    .request = okx_request,
+    .route = okx_route,
+    .vendor_time = okx_vendor_time,
+    .resolver = get_okx_channel_in,
+    .samples = okx_samples,
+};
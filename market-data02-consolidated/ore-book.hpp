@@ -0,0 +1,352 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ore-columns.hpp"
+#include "ore-schema.hpp"
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/yamal.h>
+
+// Aggregated price level, orders is the number of orders at the level
+struct ore_level_t {
+  double px = 0.0;
+  double qty = 0.0;
+  uint32_t orders = 0;
+
+  bool operator==(const ore_level_t &o) const {
+    return px == o.px && qty == o.qty;
+  }
+  bool operator!=(const ore_level_t &o) const { return !(*this == o); }
+};
+
+// Price level book of a single instrument built from ORE order messages.
+// Levels are kept in sorted vectors with the best level last, updates
+// cluster around the top of the book so they touch the end of the vector.
+class ore_book_t {
+public:
+  void add(int32_t id, double px, double qty, bool is_bid) {
+    auto [where, added] = orders_.try_emplace(id, order_t{px, qty, is_bid});
+    if (!added) {
+      level_remove(where->second);
+      where->second = order_t{px, qty, is_bid};
+    }
+    level_add(where->second);
+  }
+
+  // Replaces order id with new_id keeping its side. Returns false if the
+  // order is not in the book.
+  bool modify(int32_t id, int32_t new_id, double px, double qty) {
+    auto where = orders_.find(id);
+    if (where == orders_.end())
+      return false;
+    auto is_bid = where->second.is_bid;
+    level_remove(where->second);
+    if (new_id == id) {
+      where->second = order_t{px, qty, is_bid};
+      level_add(where->second);
+      return true;
+    }
+    orders_.erase(where);
+    add(new_id, px, qty, is_bid);
+    return true;
+  }
+
+  // Returns false if the order is not in the book
+  bool remove(int32_t id) {
+    auto where = orders_.find(id);
+    if (where == orders_.end())
+      return false;
+    level_remove(where->second);
+    orders_.erase(where);
+    return true;
+  }
+
+  void clear() {
+    orders_.clear();
+    bids_.clear();
+    asks_.clear();
+  }
+
+  // Best levels, an empty side returns a level without orders
+  ore_level_t bid() const {
+    return bids_.empty() ? ore_level_t{} : bids_.back();
+  }
+  ore_level_t ask() const {
+    return asks_.empty() ? ore_level_t{} : asks_.back();
+  }
+
+  // Levels of each side, best level last
+  const std::vector<ore_level_t> &bids() const { return bids_; }
+  const std::vector<ore_level_t> &asks() const { return asks_; }
+  size_t orders() const { return orders_.size(); }
+
+private:
+  struct order_t {
+    double px;
+    double qty;
+    bool is_bid;
+  };
+
+  std::vector<ore_level_t> &levels(bool is_bid) {
+    return is_bid ? bids_ : asks_;
+  }
+
+  // Position of px in levels sorted with the best price last, searched
+  // from the top of the book
+  static auto level_find(std::vector<ore_level_t> &lvls, double px,
+                         bool is_bid) {
+    auto it = lvls.end();
+    while (it != lvls.begin()) {
+      auto &prev = *(it - 1);
+      if (prev.px == px || (is_bid ? prev.px < px : prev.px > px))
+        break;
+      --it;
+    }
+    return it;
+  }
+
+  void level_add(const order_t &ord) {
+    auto &lvls = levels(ord.is_bid);
+    auto it = level_find(lvls, ord.px, ord.is_bid);
+    if (it != lvls.begin() && (it - 1)->px == ord.px) {
+      --it;
+      it->qty += ord.qty;
+      ++it->orders;
+      return;
+    }
+    lvls.insert(it, ore_level_t{ord.px, ord.qty, 1});
+  }
+
+  void level_remove(const order_t &ord) {
+    auto &lvls = levels(ord.is_bid);
+    auto it = level_find(lvls, ord.px, ord.is_bid);
+    if (it == lvls.begin() || (it - 1)->px != ord.px)
+      return;
+    --it;
+    // quantities are decimals, drop the level by order count so rounding
+    // never leaves an empty level behind
+    if (--it->orders == 0)
+      lvls.erase(it);
+    else
+      it->qty -= ord.qty;
+  }
+
+  std::unordered_map<int32_t, order_t> orders_;
+  std::vector<ore_level_t> bids_;
+  std::vector<ore_level_t> asks_;
+};
+
+// Identifies the instrument and the ORE message behind a callback. The
+// channel view is valid for the lifetime of the ore_books_t.
+struct ore_book_event_t {
+  std::string_view channel;
+  int32_t imnt_id = 0;
+  int64_t receive = 0;
+  int64_t vendor_offset = 0;
+  uint64_t vendor_seqno = 0;
+};
+
+// Off book trade, side is 1 if the buyer was the maker, 0 if the seller
+// was and -1 when unknown
+struct ore_trade_t {
+  double px = 0.0;
+  double qty = 0.0;
+  int8_t side = -1;
+};
+
+// Builds the books of every instrument in the ORE channels of a yamal
+// file. Messages are decoded in place, prices and quantities are parsed
+// straight from the string views into the mmap.
+//
+// poll() invokes on_bbo(const ore_book_event_t &, const ore_book_t &) when
+// the best bid or ask of a book changed at the end of a batch, and
+// on_trade(const ore_book_event_t &, const ore_trade_t &) for every trade.
+// The time bounds of the filter only select the callbacks, books are
+// always built from the start of the file.
+class ore_books_t {
+public:
+  ore_books_t(ytp_yamal_t *yamal, ore_filter_t filter, fmc_error_t **error)
+      : yamal_(yamal), filter_(std::move(filter)) {
+    fmc_error_clear(error);
+    it_ = ytp_data_begin(yamal_, error);
+    RETURN_ON_ERROR(error, , "could not obtain iterator");
+  }
+
+  // Processes up to max yamal messages that are available without
+  // blocking, so it may be used to follow a live file. Returns the number
+  // of yamal messages read.
+  template <class OnBbo, class OnTrade>
+  size_t poll(OnBbo &&on_bbo, OnTrade &&on_trade, fmc_error_t **error,
+              size_t max = 4096) {
+    fmc_error_clear(error);
+    size_t count = 0;
+    for (; count < max && !ytp_yamal_term(it_); ++count) {
+      uint64_t seqno;
+      int64_t ts;
+      ytp_mmnode_offs stream;
+      size_t sz;
+      const char *data;
+      ytp_data_read(yamal_, it_, &seqno, &ts, &stream, &sz, &data, error);
+      RETURN_ON_ERROR(error, count, "could not read data");
+      it_ = ytp_yamal_next(yamal_, it_, error);
+      RETURN_ON_ERROR(error, count, "could not obtain next iterator");
+      auto *chan = resolve(stream, error);
+      RETURN_ON_ERROR(error, count, "could not look up stream announcement");
+      if (!chan)
+        continue;
+      msgpack_reader_t rd(std::string_view(data, sz));
+      while (!rd.empty()) {
+        bool ok = ore_schema_decode(rd, [&](auto &msg) {
+          apply(*chan, msg, on_bbo, on_trade, error);
+        });
+        RETURN_ERROR_UNLESS(ok, error, count,
+                            "could not decode ORE message on channel",
+                            chan->name);
+        if (*error)
+          return count;
+        ++messages_;
+      }
+    }
+    return count;
+  }
+
+  // Book of an instrument, nullptr if nothing was seen for it yet
+  const ore_book_t *book(std::string_view channel, int32_t imnt_id) const {
+    for (auto &chan : channels_) {
+      if (chan->name != channel)
+        continue;
+      auto where = chan->books.find(imnt_id);
+      return where == chan->books.end() ? nullptr : &where->second.book;
+    }
+    return nullptr;
+  }
+
+  // Number of ORE messages decoded
+  uint64_t messages() const { return messages_; }
+
+private:
+  struct entry_t {
+    ore_book_t book;
+    // top of the book at the last on_bbo callback
+    ore_level_t bid;
+    ore_level_t ask;
+  };
+
+  struct channel_t {
+    std::string name;
+    std::unordered_map<int32_t, entry_t> books;
+  };
+
+  channel_t *resolve(ytp_mmnode_offs stream, fmc_error_t **error) {
+    auto where = streams_.find(stream);
+    if (where != streams_.end())
+      return where->second;
+    uint64_t seqno;
+    size_t psz, csz, esz;
+    const char *peer, *channel, *encoding;
+    ytp_mmnode_offs *original, *subscribed;
+    ytp_announcement_lookup(yamal_, stream, &seqno, &psz, &peer, &csz,
+                            &channel, &esz, &encoding, &original, &subscribed,
+                            error);
+    if (*error)
+      return nullptr;
+    std::string_view sv{channel, csz};
+    bool selected =
+        fmc::starts_with(sv, filter_.prefix) &&
+        (filter_.channels.empty() ||
+         std::find(filter_.channels.begin(), filter_.channels.end(), sv) !=
+             filter_.channels.end());
+    channel_t *chan = nullptr;
+    if (selected) {
+      // peers publishing the same channel update the same books
+      for (auto &c : channels_)
+        if (c->name == sv)
+          chan = c.get();
+      if (!chan) {
+        channels_.push_back(std::make_unique<channel_t>());
+        chan = channels_.back().get();
+        chan->name = sv;
+      }
+    }
+    return streams_.emplace(stream, chan).first->second;
+  }
+
+  template <class Msg>
+  static ore_book_event_t event(const channel_t &chan, const Msg &msg) {
+    return ore_book_event_t{chan.name, msg.imnt_id, msg.receive,
+                            msg.vendor_offset, msg.vendor_seqno};
+  }
+
+  bool in_range(int64_t receive) const {
+    return receive >= filter_.start && receive <= filter_.end;
+  }
+
+  template <class Msg, class OnBbo, class OnTrade>
+  void apply(channel_t &chan, const Msg &msg, OnBbo &on_bbo,
+             OnTrade &on_trade, fmc_error_t **error) {
+    if constexpr (std::is_same_v<Msg, ore_off_book_trade_t>) {
+      if (!in_range(msg.receive))
+        return;
+      ore_trade_t trd;
+      trd.px = ore_parse_decimal(msg.price);
+      trd.qty = ore_parse_decimal(msg.qty);
+      trd.side = msg.decorator == "b" ? 1 : msg.decorator == "a" ? 0 : -1;
+      const ore_book_event_t ev = event(chan, msg);
+      on_trade(ev, std::as_const(trd));
+      return;
+    } else {
+      auto &entry = chan.books[msg.imnt_id];
+      auto &book = entry.book;
+      bool found = true;
+      if constexpr (std::is_same_v<Msg, ore_order_add_t>) {
+        book.add(msg.id, ore_parse_decimal(msg.price),
+                 ore_parse_decimal(msg.qty), msg.is_bid);
+      } else if constexpr (std::is_same_v<Msg, ore_order_modify_t>) {
+        found = book.modify(msg.id, msg.new_id, ore_parse_decimal(msg.price),
+                            ore_parse_decimal(msg.qty));
+      } else if constexpr (std::is_same_v<Msg, ore_order_delete_t>) {
+        found = book.remove(msg.id);
+      } else if constexpr (std::is_same_v<Msg, ore_book_control_t>) {
+        if (msg.command == 'C')
+          book.clear();
+      }
+      RETURN_ERROR_UNLESS(found, error, , "could not find order",
+                          std::to_string(msg.id), "on channel", chan.name);
+      // the top of the book is only consistent at the end of a batch
+      if (msg.batch || !in_range(msg.receive))
+        return;
+      auto bid = book.bid();
+      auto ask = book.ask();
+      if (bid == entry.bid && ask == entry.ask)
+        return;
+      entry.bid = bid;
+      entry.ask = ask;
+      const ore_book_event_t ev = event(chan, msg);
+      on_bbo(ev, std::as_const(book));
+    }
+  }
+
+  ytp_yamal_t *yamal_;
+  ore_filter_t filter_;
+  ytp_iterator_t it_ = nullptr;
+  std::unordered_map<ytp_mmnode_offs, channel_t *> streams_;
+  std::vector<std::unique_ptr<channel_t>> channels_;
+  uint64_t messages_ = 0;
+};
@@ -0,0 +1,369 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ore-reader.hpp"
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/yamal.h>
+
+// Structure-of-arrays representation of ORE messages. Every ORE message
+// becomes one row, the channel column indexes into the channels vector.
+struct ore_columns_t {
+  std::vector<std::string> channels;
+  std::vector<int64_t> receive;
+  std::vector<int64_t> vendor_offset;
+  std::vector<uint64_t> vendor_seqno;
+  std::vector<uint32_t> channel;
+  std::vector<uint8_t> type;
+  std::vector<uint8_t> batch;
+  std::vector<int8_t> side;
+  std::vector<int32_t> id;
+  std::vector<double> price;
+  std::vector<double> qty;
+
+  size_t size() const { return receive.size(); }
+
+  void reserve(size_t n) {
+    receive.reserve(n);
+    vendor_offset.reserve(n);
+    vendor_seqno.reserve(n);
+    channel.reserve(n);
+    type.reserve(n);
+    batch.reserve(n);
+    side.reserve(n);
+    id.reserve(n);
+    price.reserve(n);
+    qty.reserve(n);
+  }
+
+  void push_back(const ore_msg_t &msg, uint32_t chan) {
+    receive.push_back(msg.receive);
+    vendor_offset.push_back(msg.vendor_offset);
+    vendor_seqno.push_back(msg.vendor_seqno);
+    channel.push_back(chan);
+    type.push_back(msg.type);
+    batch.push_back(msg.batch);
+    side.push_back(msg.side);
+    id.push_back(msg.id);
+    price.push_back(msg.price);
+    qty.push_back(msg.qty);
+  }
+
+  void append(const ore_columns_t &o) {
+    auto cat = [](auto &dst, const auto &src) {
+      dst.insert(dst.end(), src.begin(), src.end());
+    };
+    cat(receive, o.receive);
+    cat(vendor_offset, o.vendor_offset);
+    cat(vendor_seqno, o.vendor_seqno);
+    cat(channel, o.channel);
+    cat(type, o.type);
+    cat(batch, o.batch);
+    cat(side, o.side);
+    cat(id, o.id);
+    cat(price, o.price);
+    cat(qty, o.qty);
+  }
+};
+
+// Selects which ORE messages are loaded. An empty channel list selects
+// every channel starting with prefix; times are inclusive bounds on the
+// ORE receive time in nanoseconds.
+struct ore_filter_t {
+  std::string_view prefix = "ore/";
+  std::vector<std::string> channels;
+  int64_t start = INT64_MIN;
+  int64_t end = INT64_MAX;
+};
+
+// Parses the whole of a command line argument of the ORE tools as a
+// number, false if any of it is not
+template <class T> inline bool ore_parse_arg(const char *str, T *val) {
+  std::string_view sv = str;
+  auto [num, parsed] = fmc::from_string_view<T>(sv);
+  *val = num;
+  return !sv.empty() && parsed.size() == sv.size();
+}
+
+inline bool ore_parse_arg(const char *str, double *val) {
+  char *end = nullptr;
+  *val = strtod(str, &end);
+  return *str && !*end;
+}
+
+// Raw yamal message pending decode, data points into the yamal mmap
+struct ore_slice_t {
+  const char *data;
+  size_t sz;
+  uint32_t channel;
+};
+
+// Decodes a range of raw messages into columns. Returns false on the first
+// message that cannot be decoded.
+inline bool ore_columns_decode(const ore_slice_t *first,
+                               const ore_slice_t *last,
+                               const ore_filter_t &filter,
+                               ore_columns_t *cols) {
+  cols->reserve(2 * (last - first));
+  ore_msg_t msg;
+  for (; first != last; ++first) {
+    msgpack_reader_t rd(std::string_view(first->data, first->sz));
+    while (!rd.empty()) {
+      if (!ore_decode(rd, &msg))
+        return false;
+      if (msg.receive < filter.start || msg.receive > filter.end)
+        continue;
+      cols->push_back(msg, first->channel);
+    }
+  }
+  return true;
+}
+
+// Loads ORE messages from yamal into columns. The yamal file is walked once
+// to select the messages, then the selected range is split in contiguous
+// chunks that are decoded in parallel and concatenated in file order.
+inline void ore_columns_load(ytp_yamal_t *yamal, const ore_filter_t &filter,
+                             unsigned threads, ore_columns_t *cols,
+                             fmc_error_t **error) {
+  fmc_error_clear(error);
+  std::unordered_map<ytp_mmnode_offs, int64_t> streams;
+  std::unordered_map<std::string_view, uint32_t> indexes;
+  std::vector<ore_slice_t> slices;
+
+  auto resolve = [&](ytp_mmnode_offs stream) -> int64_t {
+    auto where = streams.find(stream);
+    if (where != streams.end())
+      return where->second;
+    uint64_t seqno;
+    size_t psz, csz, esz;
+    const char *peer, *channel, *encoding;
+    ytp_mmnode_offs *original, *subscribed;
+    ytp_announcement_lookup(yamal, stream, &seqno, &psz, &peer, &csz, &channel,
+                            &esz, &encoding, &original, &subscribed, error);
+    if (*error)
+      return -1;
+    std::string_view sv{channel, csz};
+    bool selected =
+        fmc::starts_with(sv, filter.prefix) &&
+        (filter.channels.empty() ||
+         std::find(filter.channels.begin(), filter.channels.end(), sv) !=
+             filter.channels.end());
+    int64_t idx = -1;
+    if (selected) {
+      // Peers publishing the same channel share the channel index
+      auto it = indexes.find(sv);
+      if (it == indexes.end()) {
+        it = indexes.emplace(sv, (uint32_t)cols->channels.size()).first;
+        cols->channels.emplace_back(sv);
+      }
+      idx = it->second;
+    }
+    return streams.emplace(stream, idx).first->second;
+  };
+
+  auto it = ytp_data_begin(yamal, error);
+  RETURN_ON_ERROR(error, , "could not obtain iterator");
+  for (; !ytp_yamal_term(it); it = ytp_yamal_next(yamal, it, error)) {
+    RETURN_ON_ERROR(error, , "could not obtain next iterator");
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+    RETURN_ON_ERROR(error, , "could not read data");
+    auto idx = resolve(stream);
+    RETURN_ON_ERROR(error, , "could not look up stream announcement");
+    // the parser commits after receive, so anything committed before the
+    // start time cannot contain messages in range
+    if (idx < 0 || ts < filter.start)
+      continue;
+    slices.push_back(ore_slice_t{data, sz, (uint32_t)idx});
+  }
+  RETURN_ON_ERROR(error, , "could not obtain next iterator");
+
+  threads = std::max(1U, std::min<unsigned>(threads, slices.size() / 1024 + 1));
+  std::vector<ore_columns_t> parts(threads);
+  std::vector<char> ok(threads, 1);
+  std::vector<std::thread> workers;
+  size_t chunk = (slices.size() + threads - 1) / threads;
+  for (unsigned i = 0; i < threads; ++i) {
+    auto *first = slices.data() + std::min(slices.size(), i * chunk);
+    auto *last = slices.data() + std::min(slices.size(), (i + 1) * chunk);
+    workers.emplace_back([=, &filter, &parts, &ok]() {
+      ok[i] = ore_columns_decode(first, last, filter, &parts[i]);
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  for (unsigned i = 0; i < threads; ++i) {
+    RETURN_ERROR_UNLESS(ok[i], error, , "could not decode ORE message");
+  }
+
+  size_t total = cols->size();
+  for (auto &part : parts)
+    total += part.size();
+  cols->reserve(total);
+  for (auto &part : parts)
+    cols->append(part);
+}
+
+template <class T> struct npy_descr;
+template <> struct npy_descr<int64_t> {
+  static constexpr std::string_view value = "<i8";
+};
+template <> struct npy_descr<uint64_t> {
+  static constexpr std::string_view value = "<u8";
+};
+template <> struct npy_descr<int32_t> {
+  static constexpr std::string_view value = "<i4";
+};
+template <> struct npy_descr<uint32_t> {
+  static constexpr std::string_view value = "<u4";
+};
+template <> struct npy_descr<uint8_t> {
+  static constexpr std::string_view value = "|u1";
+};
+template <> struct npy_descr<int8_t> {
+  static constexpr std::string_view value = "|i1";
+};
+template <> struct npy_descr<double> {
+  static constexpr std::string_view value = "<f8";
+};
+
+// Writes a column as a NumPy .npy file (format version 1.0). Columns can
+// be memory mapped directly by numpy, pandas or pyarrow.
+template <class T>
+inline bool ore_npy_write(const std::string &path, const std::vector<T> &col) {
+  std::string header = "{'descr': '";
+  header.append(npy_descr<T>::value);
+  header.append("', 'fortran_order': False, 'shape': (");
+  header.append(std::to_string(col.size()));
+  header.append(",), }");
+  // magic, version and header length take 10 bytes, total must be
+  // aligned to 64 bytes and the header terminated with a newline
+  size_t total = (10 + header.size() + 1 + 63) / 64 * 64;
+  header.append(total - 10 - header.size() - 1, ' ');
+  header.push_back('\n');
+
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  uint16_t hlen = (uint16_t)header.size();
+  uint8_t preamble[10] = {0x93,
+                          'N',
+                          'U',
+                          'M',
+                          'P',
+                          'Y',
+                          1,
+                          0,
+                          (uint8_t)(hlen & 0xff),
+                          (uint8_t)(hlen >> 8)};
+  bool ok = fwrite(preamble, 1, sizeof(preamble), f) == sizeof(preamble) &&
+            fwrite(header.data(), 1, header.size(), f) == header.size() &&
+            fwrite(col.data(), sizeof(T), col.size(), f) == col.size();
+  return fclose(f) == 0 && ok;
+}
+
+// Reads a column written by ore_npy_write. Only one dimensional,
+// C ordered arrays of the expected type are accepted.
+template <class T>
+inline bool ore_npy_read(const std::string &path, std::vector<T> *col) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  uint8_t preamble[10];
+  std::string header;
+  bool ok = fread(preamble, 1, sizeof(preamble), f) == sizeof(preamble) &&
+            memcmp(preamble, "\x93NUMPY", 6) == 0 && preamble[6] == 1;
+  if (ok) {
+    header.resize(preamble[8] | (preamble[9] << 8));
+    ok = fread(header.data(), 1, header.size(), f) == header.size();
+  }
+  auto descr = std::string("'descr': '") + std::string(npy_descr<T>::value);
+  auto shape = header.find("'shape': (");
+  ok = ok && header.find(descr) != std::string::npos &&
+       header.find("'fortran_order': False") != std::string::npos &&
+       shape != std::string::npos;
+  if (ok) {
+    auto [rows, rem] = fmc::from_string_view<uint64_t>(
+        std::string_view(header).substr(shape + 10));
+    col->resize(rows);
+    ok = rem.size() && fread(col->data(), sizeof(T), rows, f) == rows;
+  }
+  fclose(f);
+  return ok;
+}
+
+// Saves columns into the directory dir, one .npy file per column and
+// channels.txt with one channel name per line.
+inline void ore_columns_save(const std::string &dir, const ore_columns_t &cols,
+                             fmc_error_t **error) {
+  fmc_error_clear(error);
+  std::ofstream channels{dir + "/channels.txt"};
+  for (auto &ch : cols.channels)
+    channels << ch << '\n';
+  channels.close();
+  bool ok = channels.good() &&
+            ore_npy_write(dir + "/receive.npy", cols.receive) &&
+            ore_npy_write(dir + "/vendor_offset.npy", cols.vendor_offset) &&
+            ore_npy_write(dir + "/vendor_seqno.npy", cols.vendor_seqno) &&
+            ore_npy_write(dir + "/channel.npy", cols.channel) &&
+            ore_npy_write(dir + "/type.npy", cols.type) &&
+            ore_npy_write(dir + "/batch.npy", cols.batch) &&
+            ore_npy_write(dir + "/side.npy", cols.side) &&
+            ore_npy_write(dir + "/id.npy", cols.id) &&
+            ore_npy_write(dir + "/price.npy", cols.price) &&
+            ore_npy_write(dir + "/qty.npy", cols.qty);
+  RETURN_ERROR_UNLESS(ok, error, , "could not write columns to", dir);
+}
+
+// Reads columns saved by ore_columns_save, no decoding is involved.
+inline void ore_columns_read(const std::string &dir, ore_columns_t *cols,
+                             fmc_error_t **error) {
+  fmc_error_clear(error);
+  std::ifstream channels{dir + "/channels.txt"};
+  RETURN_ERROR_UNLESS(channels.good(), error, , "could not open",
+                      dir + "/channels.txt");
+  cols->channels.clear();
+  for (std::string line; std::getline(channels, line);)
+    cols->channels.push_back(line);
+  bool ok = ore_npy_read(dir + "/receive.npy", &cols->receive) &&
+            ore_npy_read(dir + "/vendor_offset.npy", &cols->vendor_offset) &&
+            ore_npy_read(dir + "/vendor_seqno.npy", &cols->vendor_seqno) &&
+            ore_npy_read(dir + "/channel.npy", &cols->channel) &&
+            ore_npy_read(dir + "/type.npy", &cols->type) &&
+            ore_npy_read(dir + "/batch.npy", &cols->batch) &&
+            ore_npy_read(dir + "/side.npy", &cols->side) &&
+            ore_npy_read(dir + "/id.npy", &cols->id) &&
+            ore_npy_read(dir + "/price.npy", &cols->price) &&
+            ore_npy_read(dir + "/qty.npy", &cols->qty);
+  RETURN_ERROR_UNLESS(ok, error, , "could not read columns from", dir);
+  auto rows = cols->size();
+  ok = cols->vendor_offset.size() == rows &&
+       cols->vendor_seqno.size() == rows && cols->channel.size() == rows &&
+       cols->type.size() == rows && cols->batch.size() == rows &&
+       cols->side.size() == rows && cols->id.size() == rows &&
+       cols->price.size() == rows && cols->qty.size() == rows;
+  RETURN_ERROR_UNLESS(ok, error, , "inconsistent column sizes in", dir);
+}
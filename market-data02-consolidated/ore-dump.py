@@ -25,6 +25,8 @@ if __name__ == '__main__':
     it = iter(dat)
     while(True):
         for seq, ts, strm, msg in it:
+            if not strm.channel.startswith("ore/"):
+                continue
             unpacker = msgpack.Unpacker(BytesIO(msg), raw=False)
             for unpacked in unpacker:
                 print(strm.channel, unpacked)
@@ -0,0 +1,138 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ore-columns.hpp"
+#include <fmc++/strings.hpp>
+#include <fmc/cmdline.h>
+#include <fmc/files.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+
+static const char *usage =
+    "ore-export --ytp-file FILE --output DIR [--channels CHANNELS] "
+    "[--prefix PREFIX] [--start NS] [--end NS] [--threads N]\n";
+
+int main(int argc, const char **argv) {
+  fmc_error_t *error = nullptr;
+  const char *ytpfile = nullptr;
+  const char *output = nullptr;
+  const char *channels = nullptr;
+  const char *prefix = nullptr;
+  const char *start = nullptr;
+  const char *end = nullptr;
+  const char *threads = nullptr;
+  fmc_cmdline_opt_t options[] = {/* 0 */ {"--help", false, NULL},
+                                 /* 1 */ {"--ytp-file", true, &ytpfile},
+                                 /* 2 */ {"--output", true, &output},
+                                 /* 3 */ {"--channels", false, &channels},
+                                 /* 4 */ {"--prefix", false, &prefix},
+                                 /* 5 */ {"--start", false, &start},
+                                 /* 6 */ {"--end", false, &end},
+                                 /* 7 */ {"--threads", false, &threads},
+                                 {NULL}};
+  fmc_cmdline_opt_proc(argc, argv, options, &error);
+  if (options[0].set) {
+    printf("%s\n"
+           "ORE Columnar Exporter.\n\n"
+           "Application will read ORE messages from the yamal file FILE and "
+           "will write one NumPy\n"
+           "column file per ORE field into the directory DIR, together with "
+           "channels.txt\n"
+           "mapping the channel column to channel names. CHANNELS is a comma "
+           "separated list\n"
+           "of channels to export, by default every channel starting with "
+           "PREFIX (ore/) is\n"
+           "exported. Messages are selected by receive time between NS "
+           "bounds and are\n"
+           "decoded in parallel by N threads.\n",
+           usage);
+    return 0;
+  }
+  if (error) {
+    fprintf(stderr, "could not process args: %s\n%s", fmc_error_msg(error),
+            usage);
+    return 1;
+  }
+
+  ore_filter_t filter;
+  if (prefix)
+    filter.prefix = prefix;
+  for (string_view rem = channels ? channels : ""; rem.size();) {
+    auto [chan, sep, next] = fmc::split(rem, ",");
+    if (chan.size())
+      filter.channels.emplace_back(chan);
+    rem = next;
+  }
+  if (start && !ore_parse_arg(start, &filter.start)) {
+    fprintf(stderr, "invalid --start %s\n%s", start, usage);
+    return 1;
+  }
+  if (end && !ore_parse_arg(end, &filter.end)) {
+    fprintf(stderr, "invalid --end %s\n%s", end, usage);
+    return 1;
+  }
+  unsigned nthreads = thread::hardware_concurrency();
+  if (threads && (!ore_parse_arg(threads, &nthreads) || !nthreads)) {
+    fprintf(stderr, "invalid --threads %s, it must be positive\n%s",
+            threads, usage);
+    return 1;
+  }
+
+  if (mkdir(output, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "could not create output directory %s: %s\n", output,
+            strerror(errno));
+    return 1;
+  }
+
+  auto fd = fmc_fopen(ytpfile, fmc_fmode::READ, &error);
+  if (error) {
+    fprintf(stderr, "could not open file %s with error %s\n", ytpfile,
+            fmc_error_msg(error));
+    return 1;
+  }
+  auto *yamal = ytp_yamal_new(fd, &error);
+  if (error) {
+    fprintf(stderr, "could not create yamal with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+
+  auto before = chrono::steady_clock::now();
+  ore_columns_t cols;
+  ore_columns_load(yamal, filter, nthreads, &cols, &error);
+  if (error) {
+    fprintf(stderr, "could not load ORE messages with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+  auto after = chrono::steady_clock::now();
+
+  ore_columns_save(output, cols, &error);
+  if (error) {
+    fprintf(stderr, "could not write columns to %s with error %s\n", output,
+            fmc_error_msg(error));
+    return 1;
+  }
+  printf("exported %zu messages on %zu channels in %.3f s\n", cols.size(),
+         cols.channels.size(),
+         chrono::duration<double>(after - before).count());
+
+  ytp_yamal_del(yamal, &error);
+  fmc_fclose(fd, &error);
+  return 0;
+}
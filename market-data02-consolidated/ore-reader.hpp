@@ -0,0 +1,386 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string_view>
+
+// Zero-copy msgpack reader. It only understands the subset of msgpack
+// produced by the feed parser, strings are returned as views into the
+// source buffer, so the buffer must outlive the decoded values.
+struct msgpack_reader_t {
+  const uint8_t *pos = nullptr;
+  const uint8_t *end = nullptr;
+
+  msgpack_reader_t() = default;
+  msgpack_reader_t(std::string_view buf)
+      : pos((const uint8_t *)buf.data()),
+        end((const uint8_t *)buf.data() + buf.size()) {}
+
+  bool empty() const { return pos >= end; }
+
+  template <class T> bool load(T *val) {
+    if (end - pos < (ptrdiff_t)sizeof(T))
+      return false;
+    T tmp = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+      tmp = (T)((tmp << 8) | pos[i]);
+    pos += sizeof(T);
+    *val = tmp;
+    return true;
+  }
+
+  bool read_array(uint32_t *n) {
+    if (empty())
+      return false;
+    uint8_t tag = *pos++;
+    if ((tag & 0xf0) == 0x90) {
+      *n = tag & 0x0f;
+      return true;
+    }
+    if (tag == 0xdc) {
+      uint16_t sz;
+      if (!load(&sz))
+        return false;
+      *n = sz;
+      return true;
+    }
+    if (tag == 0xdd)
+      return load(n);
+    return false;
+  }
+
+  bool read_int(int64_t *val) {
+    if (empty())
+      return false;
+    uint8_t tag = *pos++;
+    if (tag <= 0x7f) {
+      *val = tag;
+      return true;
+    }
+    if (tag >= 0xe0) {
+      *val = (int8_t)tag;
+      return true;
+    }
+    switch (tag) {
+    case 0xcc: {
+      uint8_t v;
+      return load(&v) && (*val = v, true);
+    }
+    case 0xcd: {
+      uint16_t v;
+      return load(&v) && (*val = v, true);
+    }
+    case 0xce: {
+      uint32_t v;
+      return load(&v) && (*val = v, true);
+    }
+    case 0xcf: {
+      uint64_t v;
+      return load(&v) && (*val = (int64_t)v, true);
+    }
+    case 0xd0: {
+      uint8_t v;
+      return load(&v) && (*val = (int8_t)v, true);
+    }
+    case 0xd1: {
+      uint16_t v;
+      return load(&v) && (*val = (int16_t)v, true);
+    }
+    case 0xd2: {
+      uint32_t v;
+      return load(&v) && (*val = (int32_t)v, true);
+    }
+    case 0xd3: {
+      uint64_t v;
+      return load(&v) && (*val = (int64_t)v, true);
+    }
+    case 0xc2:
+      *val = 0;
+      return true;
+    case 0xc3:
+      *val = 1;
+      return true;
+    }
+    return false;
+  }
+
+  bool read_uint(uint64_t *val) { return read_int((int64_t *)val); }
+
+  bool read_double(double *val) {
+    if (empty())
+      return false;
+    uint8_t tag = *pos;
+    if (tag == 0xca) {
+      ++pos;
+      uint32_t bits;
+      float f;
+      if (!load(&bits))
+        return false;
+      memcpy(&f, &bits, sizeof(f));
+      *val = f;
+      return true;
+    }
+    if (tag == 0xcb) {
+      ++pos;
+      uint64_t bits;
+      if (!load(&bits))
+        return false;
+      memcpy(val, &bits, sizeof(*val));
+      return true;
+    }
+    int64_t i;
+    if (!read_int(&i))
+      return false;
+    *val = (double)i;
+    return true;
+  }
+
+  bool read_str(std::string_view *val) {
+    if (empty())
+      return false;
+    uint8_t tag = *pos++;
+    uint32_t sz = 0;
+    if ((tag & 0xe0) == 0xa0) {
+      sz = tag & 0x1f;
+    } else if (tag == 0xd9 || tag == 0xc4) {
+      uint8_t v;
+      if (!load(&v))
+        return false;
+      sz = v;
+    } else if (tag == 0xda || tag == 0xc5) {
+      uint16_t v;
+      if (!load(&v))
+        return false;
+      sz = v;
+    } else if (tag == 0xdb || tag == 0xc6) {
+      if (!load(&sz))
+        return false;
+    } else {
+      return false;
+    }
+    if ((uint64_t)(end - pos) < sz)
+      return false;
+    *val = std::string_view((const char *)pos, sz);
+    pos += sz;
+    return true;
+  }
+
+  bool is_str() const {
+    if (empty())
+      return false;
+    uint8_t tag = *pos;
+    return (tag & 0xe0) == 0xa0 || tag == 0xd9 || tag == 0xda || tag == 0xdb;
+  }
+
+  bool skip() {
+    if (empty())
+      return false;
+    uint8_t tag = *pos;
+    if ((tag & 0xf0) == 0x90 || tag == 0xdc || tag == 0xdd) {
+      uint32_t n;
+      if (!read_array(&n))
+        return false;
+      while (n--)
+        if (!skip())
+          return false;
+      return true;
+    }
+    if ((tag & 0xf0) == 0x80 || tag == 0xde || tag == 0xdf) {
+      ++pos;
+      uint32_t n = tag & 0x0f;
+      if (tag == 0xde) {
+        uint16_t v;
+        if (!load(&v))
+          return false;
+        n = v;
+      } else if (tag == 0xdf && !load(&n)) {
+        return false;
+      }
+      for (uint64_t i = 0; i < 2ULL * n; ++i)
+        if (!skip())
+          return false;
+      return true;
+    }
+    if (tag == 0xc0) {
+      ++pos;
+      return true;
+    }
+    if (tag == 0xca || tag == 0xcb) {
+      double d;
+      return read_double(&d);
+    }
+    std::string_view sv;
+    if (is_str() || tag == 0xc4 || tag == 0xc5 || tag == 0xc6)
+      return read_str(&sv);
+    int64_t i;
+    return read_int(&i);
+  }
+};
+
+// Parses decimal strings the way venues send prices and quantities,
+// e.g. "27341.12000000". Falls back to strtod for anything unusual.
+inline double ore_parse_decimal(std::string_view sv) {
+  static constexpr double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18};
+  size_t i = 0;
+  bool neg = sv.size() && sv[0] == '-';
+  i += neg;
+  uint64_t mant = 0;
+  int digits = 0;
+  int frac = -1;
+  for (; i < sv.size(); ++i) {
+    char c = sv[i];
+    if (c >= '0' && c <= '9') {
+      mant = mant * 10 + (c - '0');
+      digits += mant != 0;
+      frac += frac >= 0;
+    } else if (c == '.' && frac < 0) {
+      frac = 0;
+    } else {
+      break;
+    }
+  }
+  if (i == sv.size() && digits <= 18 && frac <= 18) {
+    double val = (double)mant / pow10[frac < 0 ? 0 : frac];
+    return neg ? -val : val;
+  }
+  char buf[64];
+  size_t sz = sv.size() < sizeof(buf) - 1 ? sv.size() : sizeof(buf) - 1;
+  memcpy(buf, sv.data(), sz);
+  buf[sz] = '\0';
+  return strtod(buf, nullptr);
+}
+
+enum ore_msg_type_t : uint8_t {
+  ORE_ORDER_ADD = 1,
+  ORE_ORDER_DELETE = 5,
+  ORE_ORDER_MODIFY = 6,
+  ORE_OFF_BOOK_TRADE = 11,
+  ORE_BOOK_CONTROL = 13,
+};
+
+// Decoded ORE message. Only fields relevant to the message type are set,
+// side is 1 for bid, 0 for ask and -1 when unknown.
+struct ore_msg_t {
+  uint8_t type = 0;
+  int64_t receive = 0;
+  int64_t vendor_offset = 0;
+  uint64_t vendor_seqno = 0;
+  uint8_t batch = 0;
+  int32_t imnt_id = 0;
+  int32_t id = 0;
+  int32_t new_id = 0;
+  double price = 0.0;
+  double qty = 0.0;
+  int8_t side = -1;
+  uint8_t uncross = 0;
+  char command = 0;
+};
+
+inline bool ore_read_decimal(msgpack_reader_t &rd, double *val) {
+  if (rd.is_str()) {
+    std::string_view sv;
+    if (!rd.read_str(&sv))
+      return false;
+    *val = ore_parse_decimal(sv);
+    return true;
+  }
+  return rd.read_double(val);
+}
+
+template <class T> inline bool ore_read_field(msgpack_reader_t &rd, T *val) {
+  int64_t tmp;
+  if (!rd.read_int(&tmp))
+    return false;
+  *val = (T)tmp;
+  return true;
+}
+
+// Decodes one ORE message from the reader, a single yamal message may
+// contain several ORE messages back to back.
+// Returns false if the data is not a valid ORE message.
+inline bool ore_decode(msgpack_reader_t &rd, ore_msg_t *msg) {
+  uint32_t n;
+  if (!rd.read_array(&n) || n < 6)
+    return false;
+  *msg = ore_msg_t{};
+  if (!ore_read_field(rd, &msg->type) || !rd.read_int(&msg->receive) ||
+      !rd.read_int(&msg->vendor_offset) || !rd.read_uint(&msg->vendor_seqno) ||
+      !ore_read_field(rd, &msg->batch) || !ore_read_field(rd, &msg->imnt_id))
+    return false;
+  n -= 6;
+  uint32_t used = 0;
+  switch (msg->type) {
+  case ORE_ORDER_ADD:
+    // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
+    // price, qty, is bid]
+    if (n < 4 || !ore_read_field(rd, &msg->id) ||
+        !ore_read_decimal(rd, &msg->price) ||
+        !ore_read_decimal(rd, &msg->qty) || !ore_read_field(rd, &msg->side))
+      return false;
+    used = 4;
+    break;
+  case ORE_ORDER_DELETE:
+    // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
+    if (n < 1 || !ore_read_field(rd, &msg->id))
+      return false;
+    used = 1;
+    break;
+  case ORE_ORDER_MODIFY:
+    // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
+    // id, new price, new qty]
+    if (n < 4 || !ore_read_field(rd, &msg->id) ||
+        !ore_read_field(rd, &msg->new_id) ||
+        !ore_read_decimal(rd, &msg->price) || !ore_read_decimal(rd, &msg->qty))
+      return false;
+    used = 4;
+    if (n > 4) {
+      if (!ore_read_field(rd, &msg->side))
+        return false;
+      ++used;
+    }
+    break;
+  case ORE_OFF_BOOK_TRADE: {
+    // [11, receive, vendor offset, vendor seqno, batch, imnt id, trade
+    // price, qty, decorator]
+    std::string_view decorator;
+    if (n < 3 || !ore_read_decimal(rd, &msg->price) ||
+        !ore_read_decimal(rd, &msg->qty) || !rd.read_str(&decorator))
+      return false;
+    msg->side = decorator == "b" ? 1 : decorator == "a" ? 0 : -1;
+    used = 3;
+  } break;
+  case ORE_BOOK_CONTROL:
+    // [13, receive, vendor offset, vendor seqno, batch, imnt id,
+    // uncross, command]
+    if (n < 2 || !ore_read_field(rd, &msg->uncross))
+      return false;
+    if (rd.is_str()) {
+      std::string_view cmd;
+      if (!rd.read_str(&cmd) || cmd.empty())
+        return false;
+      msg->command = cmd[0];
+    } else if (!ore_read_field(rd, &msg->command)) {
+      return false;
+    }
+    used = 2;
+    break;
+  default:
+    break;
+  }
+  for (; used < n; ++used)
+    if (!rd.skip())
+      return false;
+  return true;
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "ore-columns.hpp"
+#include "ore-replay.hpp"
+#include <fmc/cmdline.h>
+#include <fmc/files.h>
+#include <ytp/yamal.h>
+
+using namespace std;
+
+static const char *usage =
+    "ore-replay (--ytp-file FILE | --columns DIR) [--save DIR] "
+    "[--pace PACE] [--repeat N]\n";
+
+int main(int argc, const char **argv) {
+  fmc_error_t *error = nullptr;
+  const char *ytpfile = nullptr;
+  const char *columns = nullptr;
+  const char *save = nullptr;
+  const char *pace = nullptr;
+  const char *repeat = nullptr;
+  fmc_cmdline_opt_t options[] = {/* 0 */ {"--help", false, NULL},
+                                 /* 1 */ {"--ytp-file", false, &ytpfile},
+                                 /* 2 */ {"--columns", false, &columns},
+                                 /* 3 */ {"--save", false, &save},
+                                 /* 4 */ {"--pace", false, &pace},
+                                 /* 5 */ {"--repeat", false, &repeat},
+                                 {NULL}};
+  fmc_cmdline_opt_proc(argc, argv, options, &error);
+  if (options[0].set) {
+    printf("%s\n"
+           "ORE Replay.\n\n"
+           "Application will decode ORE messages from the yamal file FILE "
+           "once, or load columns\n"
+           "previously saved with --save or exported with ore-export from "
+           "DIR, and will replay\n"
+           "them N times reporting the replay throughput. PACE 0 replays at "
+           "max speed, 1.0\n"
+           "reproduces the recorded pace.\n",
+           usage);
+    return 0;
+  }
+  if (error) {
+    fprintf(stderr, "could not process args: %s\n%s", fmc_error_msg(error),
+            usage);
+    return 1;
+  }
+  if (!ytpfile == !columns) {
+    fprintf(stderr, "exactly one of --ytp-file or --columns is required\n%s",
+            usage);
+    return 1;
+  }
+  // checked before loading, which may take a while
+  double pace_val = 0.0;
+  if (pace && (!ore_parse_arg(pace, &pace_val) || !(pace_val >= 0.0))) {
+    fprintf(stderr, "invalid --pace %s, it must not be negative\n%s", pace,
+            usage);
+    return 1;
+  }
+  int count = 1;
+  if (repeat && (!ore_parse_arg(repeat, &count) || count < 1)) {
+    fprintf(stderr, "invalid --repeat %s, it must be positive\n%s", repeat,
+            usage);
+    return 1;
+  }
+
+  ore_columns_t cols;
+  auto before = chrono::steady_clock::now();
+  if (ytpfile) {
+    auto fd = fmc_fopen(ytpfile, fmc_fmode::READ, &error);
+    if (error) {
+      fprintf(stderr, "could not open file %s with error %s\n", ytpfile,
+              fmc_error_msg(error));
+      return 1;
+    }
+    auto *yamal = ytp_yamal_new(fd, &error);
+    if (error) {
+      fprintf(stderr, "could not create yamal with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+    ore_columns_load(yamal, ore_filter_t{}, thread::hardware_concurrency(),
+                     &cols, &error);
+    ytp_yamal_del(yamal, &error);
+    fmc_fclose(fd, &error);
+  } else {
+    ore_columns_read(columns, &cols, &error);
+  }
+  if (error) {
+    fprintf(stderr, "could not load ORE columns with error %s\n",
+            fmc_error_msg(error));
+    return 1;
+  }
+  auto after = chrono::steady_clock::now();
+  printf("loaded %zu messages on %zu channels in %.3f s\n", cols.size(),
+         cols.channels.size(),
+         chrono::duration<double>(after - before).count());
+
+  if (save) {
+    if (mkdir(save, 0755) != 0 && errno != EEXIST) {
+      fprintf(stderr, "could not create directory %s: %s\n", save,
+              strerror(errno));
+      return 1;
+    }
+    ore_columns_save(save, cols, &error);
+    if (error) {
+      fprintf(stderr, "could not save columns with error %s\n",
+              fmc_error_msg(error));
+      return 1;
+    }
+  }
+
+  ore_replay_t replay(cols, pace_val);
+  for (int i = 0; i < count; ++i) {
+    double notional = 0.0;
+    replay.reset();
+    before = chrono::steady_clock::now();
+    auto rows = replay.run([&](const ore_columns_t &c, size_t row) {
+      notional += c.price[row] * c.qty[row];
+    });
+    after = chrono::steady_clock::now();
+    auto secs = chrono::duration<double>(after - before).count();
+    printf("replay %d: %zu messages in %.3f s, %.0f msg/s, notional %f\n", i,
+           rows, secs, rows / secs, notional);
+  }
+  return 0;
+}
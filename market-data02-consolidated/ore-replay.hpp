@@ -0,0 +1,145 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "ore-columns.hpp"
+#include <fmc/time.h>
+
+// Streams rows of decoded ORE columns in receive time order, rows with the
+// same receive time in file order. With pace set to 0 rows are delivered
+// as fast as the consumer takes them, otherwise the gaps between receive
+// times are reproduced scaled by pace, i.e. 1.0 is the recorded pace and
+// 10.0 is ten times faster.
+//
+// Callbacks are invoked as f(const ore_columns_t &cols, size_t row).
+// The columns are never modified, so the same decoded day can be
+// replayed any number of times, also concurrently by several replays.
+// Files written by several parsers, or by a parser merging late input,
+// are not in receive time order, for those the replay keeps its own order
+// of the rows, which is the file order otherwise.
+class ore_replay_t {
+public:
+  static constexpr size_t max_speed_batch = 4096;
+
+  ore_replay_t(const ore_columns_t &cols, double pace = 0.0)
+      : cols_(&cols), pace_(pace), first_(0), last_(cols.size()), pos_(0) {
+    auto &rcv = cols.receive;
+    if (std::is_sorted(rcv.begin(), rcv.end()))
+      return;
+    order_.resize(rcv.size());
+    std::iota(order_.begin(), order_.end(), 0);
+    std::stable_sort(order_.begin(), order_.end(),
+                     [&](size_t a, size_t b) { return rcv[a] < rcv[b]; });
+  }
+
+  // Restricts the replay to rows with receive time in [start, end).
+  void range(int64_t start, int64_t end) {
+    first_ = lower_bound(0, start);
+    last_ = lower_bound(first_, end);
+    reset();
+  }
+
+  void reset() {
+    pos_ = first_;
+    wall_start_ = 0;
+  }
+
+  bool done() const { return pos_ >= last_; }
+  size_t position() const { return pos_; }
+  double pace() const { return pace_; }
+  void pace(double pace) {
+    pace_ = pace;
+    wall_start_ = 0;
+  }
+
+  // Wall clock time at which the next row is due, 0 if it is due now.
+  int64_t next_due() const {
+    if (pace_ <= 0.0 || done() || wall_start_ == 0)
+      return 0;
+    auto delta = (double)(receive(pos_) - data_start_) / pace_;
+    return wall_start_ + (int64_t)delta;
+  }
+
+  // Delivers the rows that are due at time now without blocking. Suitable
+  // for calling from a reactor component. Returns the number of rows
+  // delivered.
+  template <class F> size_t poll(F &&f, int64_t now = fmc_cur_time_ns()) {
+    if (done())
+      return 0;
+    if (wall_start_ == 0) {
+      wall_start_ = now;
+      data_start_ = receive(pos_);
+    }
+    size_t start = pos_;
+    if (pace_ <= 0.0) {
+      size_t stop = std::min(last_, pos_ + max_speed_batch);
+      for (; pos_ < stop; ++pos_)
+        f(*cols_, row(pos_));
+      return pos_ - start;
+    }
+    // rows with receive time before this are due
+    auto horizon = data_start_ + (int64_t)((double)(now - wall_start_) * pace_);
+    for (; pos_ < last_ && receive(pos_) <= horizon; ++pos_)
+      f(*cols_, row(pos_));
+    return pos_ - start;
+  }
+
+  // Delivers every remaining row, sleeping between rows when paced.
+  // Returns the number of rows delivered.
+  template <class F> size_t run(F &&f) {
+    size_t count = 0;
+    while (!done()) {
+      count += poll(f);
+      auto due = next_due();
+      if (!due)
+        continue;
+      auto wait = due - fmc_cur_time_ns();
+      // spin on short gaps, sleeping would overshoot
+      if (wait > spin_threshold)
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(wait - spin_threshold));
+    }
+    return count;
+  }
+
+private:
+  static constexpr int64_t spin_threshold = 100000LL;
+
+  // row at a position of the replay
+  size_t row(size_t pos) const { return order_.empty() ? pos : order_[pos]; }
+  int64_t receive(size_t pos) const { return cols_->receive[row(pos)]; }
+
+  // first position from from on with receive time not before t
+  size_t lower_bound(size_t from, int64_t t) const {
+    size_t lo = from, hi = cols_->size();
+    while (lo < hi) {
+      auto mid = lo + (hi - lo) / 2;
+      if (receive(mid) < t)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  const ore_columns_t *cols_;
+  std::vector<size_t> order_; // rows in receive time order, empty if sorted
+  double pace_;
+  size_t first_;
+  size_t last_;
+  size_t pos_;
+  int64_t wall_start_ = 0;
+  int64_t data_start_ = 0;
+};
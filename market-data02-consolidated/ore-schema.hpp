@@ -0,0 +1,341 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "ore-reader.hpp"
+
+// Typed ORE messages. Each message lists its fields in wire order, the
+// encoder emits every field with a fixed width msgpack type, so the size
+// of a message is known at compile time except for the length of its
+// strings and the emission has no data dependent branches. The output is
+// regular msgpack, any ORE reader can decode it.
+//
+// Header common to all messages:
+// [type, receive, vendor offset, vendor seqno, batch, imnt id, ...]
+
+#define ORE_SCHEMA_HEADER                                                      \
+  int64_t receive = 0;                                                         \
+  int64_t vendor_offset = 0;                                                   \
+  uint64_t vendor_seqno = 0;                                                   \
+  uint8_t batch = 0;                                                           \
+  int32_t imnt_id = 0
+
+#define ORE_SCHEMA_HEADER_FIELDS(T)                                            \
+  &T::receive, &T::vendor_offset, &T::vendor_seqno, &T::batch, &T::imnt_id
+
+// [1, receive, vendor offset, vendor seqno, batch, imnt id, id, price, qty,
+// is bid]
+struct ore_order_add_t {
+  static constexpr uint8_t type = ORE_ORDER_ADD;
+  ORE_SCHEMA_HEADER;
+  int32_t id = 0;
+  std::string_view price;
+  std::string_view qty;
+  bool is_bid = false;
+  static constexpr auto fields() {
+    using T = ore_order_add_t;
+    return std::make_tuple(ORE_SCHEMA_HEADER_FIELDS(T), &T::id, &T::price,
+                           &T::qty, &T::is_bid);
+  }
+};
+
+// [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
+struct ore_order_delete_t {
+  static constexpr uint8_t type = ORE_ORDER_DELETE;
+  ORE_SCHEMA_HEADER;
+  int32_t id = 0;
+  static constexpr auto fields() {
+    using T = ore_order_delete_t;
+    return std::make_tuple(ORE_SCHEMA_HEADER_FIELDS(T), &T::id);
+  }
+};
+
+// [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new id,
+// new price, new qty]
+struct ore_order_modify_t {
+  static constexpr uint8_t type = ORE_ORDER_MODIFY;
+  ORE_SCHEMA_HEADER;
+  int32_t id = 0;
+  int32_t new_id = 0;
+  std::string_view price;
+  std::string_view qty;
+  static constexpr auto fields() {
+    using T = ore_order_modify_t;
+    return std::make_tuple(ORE_SCHEMA_HEADER_FIELDS(T), &T::id, &T::new_id,
+                           &T::price, &T::qty);
+  }
+};
+
+// [11, receive, vendor offset, vendor seqno, batch, imnt id, trade price,
+// qty, decorator]
+struct ore_off_book_trade_t {
+  static constexpr uint8_t type = ORE_OFF_BOOK_TRADE;
+  ORE_SCHEMA_HEADER;
+  std::string_view price;
+  std::string_view qty;
+  std::string_view decorator;
+  static constexpr auto fields() {
+    using T = ore_off_book_trade_t;
+    return std::make_tuple(ORE_SCHEMA_HEADER_FIELDS(T), &T::price, &T::qty,
+                           &T::decorator);
+  }
+};
+
+// [13, receive, vendor offset, vendor seqno, batch, imnt id, uncross,
+// command]
+struct ore_book_control_t {
+  static constexpr uint8_t type = ORE_BOOK_CONTROL;
+  ORE_SCHEMA_HEADER;
+  uint8_t uncross = 0;
+  char command = 0;
+  static constexpr auto fields() {
+    using T = ore_book_control_t;
+    return std::make_tuple(ORE_SCHEMA_HEADER_FIELDS(T), &T::uncross,
+                           &T::command);
+  }
+};
+
+#undef ORE_SCHEMA_HEADER
+#undef ORE_SCHEMA_HEADER_FIELDS
+
+// Strings are emitted as str8, longer strings are not valid ORE
+constexpr size_t ore_schema_max_str = 0xff;
+
+template <class F> struct ore_schema_field;
+
+template <> struct ore_schema_field<uint8_t> {
+  static constexpr uint8_t tag = 0xcc;
+  static constexpr size_t size = 2;
+};
+template <> struct ore_schema_field<int32_t> {
+  static constexpr uint8_t tag = 0xd2;
+  static constexpr size_t size = 5;
+};
+template <> struct ore_schema_field<int64_t> {
+  static constexpr uint8_t tag = 0xd3;
+  static constexpr size_t size = 9;
+};
+template <> struct ore_schema_field<uint64_t> {
+  static constexpr uint8_t tag = 0xcf;
+  static constexpr size_t size = 9;
+};
+template <> struct ore_schema_field<bool> {
+  static constexpr uint8_t tag = 0xc2;
+  static constexpr size_t size = 1;
+};
+// single character fixstr
+template <> struct ore_schema_field<char> {
+  static constexpr uint8_t tag = 0xa1;
+  static constexpr size_t size = 2;
+};
+// str8 header, the characters are added at runtime
+template <> struct ore_schema_field<std::string_view> {
+  static constexpr uint8_t tag = 0xd9;
+  static constexpr size_t size = 2;
+};
+
+template <class Msg, class M> struct ore_schema_member;
+template <class Msg, class F> struct ore_schema_member<Msg, F Msg::*> {
+  using type = F;
+};
+
+template <class Msg, size_t I>
+using ore_schema_field_t = typename ore_schema_member<
+    Msg, std::tuple_element_t<I, decltype(Msg::fields())>>::type;
+
+template <class Msg> constexpr size_t ore_schema_field_count() {
+  return std::tuple_size_v<decltype(Msg::fields())>;
+}
+
+template <class Msg, size_t... I>
+constexpr size_t ore_schema_fixed_size(std::index_sequence<I...>) {
+  // array header and message type
+  return 1 + ore_schema_field<uint8_t>::size +
+         (ore_schema_field<ore_schema_field_t<Msg, I>>::size + ... + 0);
+}
+
+template <class Msg, size_t... I>
+constexpr size_t ore_schema_str_count(std::index_sequence<I...>) {
+  return (std::is_same_v<ore_schema_field_t<Msg, I>, std::string_view> + ... +
+          0);
+}
+
+// Encoded size of Msg without the characters of its strings
+template <class Msg>
+constexpr size_t ore_schema_fixed_size_v = ore_schema_fixed_size<Msg>(
+    std::make_index_sequence<ore_schema_field_count<Msg>()>());
+
+// Worst case encoded size of Msg
+template <class Msg>
+constexpr size_t ore_schema_max_size_v =
+    ore_schema_fixed_size_v<Msg> +
+    ore_schema_str_count<Msg>(
+        std::make_index_sequence<ore_schema_field_count<Msg>()>()) *
+        ore_schema_max_str;
+
+static_assert(ore_schema_fixed_size_v<ore_order_delete_t> == 42);
+static_assert(ore_schema_fixed_size_v<ore_book_control_t> == 41);
+
+template <class F> inline size_t ore_schema_str_len(const F &) { return 0; }
+inline size_t ore_schema_str_len(std::string_view sv) { return sv.size(); }
+
+// Exact encoded size of msg
+template <class Msg> inline size_t ore_schema_size(const Msg &msg) {
+  size_t sz = ore_schema_fixed_size_v<Msg>;
+  std::apply(
+      [&](auto... member) {
+        ((sz += ore_schema_str_len(msg.*member)), ...);
+      },
+      Msg::fields());
+  return sz;
+}
+
+template <class T> inline uint8_t *ore_schema_store(uint8_t *out, T val) {
+  using U = std::make_unsigned_t<T>;
+  U v = (U)val;
+  for (size_t i = sizeof(T); i-- > 0;) {
+    out[i] = (uint8_t)v;
+    v >>= 8;
+  }
+  return out + sizeof(T);
+}
+
+template <class F> inline uint8_t *ore_schema_put(uint8_t *out, F val) {
+  *out = ore_schema_field<F>::tag;
+  return ore_schema_store(out + 1, val);
+}
+
+template <> inline uint8_t *ore_schema_put(uint8_t *out, bool val) {
+  *out = ore_schema_field<bool>::tag | (uint8_t)val;
+  return out + 1;
+}
+
+template <> inline uint8_t *ore_schema_put(uint8_t *out, char val) {
+  out[0] = ore_schema_field<char>::tag;
+  out[1] = (uint8_t)val;
+  return out + 2;
+}
+
+template <>
+inline uint8_t *ore_schema_put(uint8_t *out, std::string_view val) {
+  out[0] = ore_schema_field<std::string_view>::tag;
+  out[1] = (uint8_t)val.size();
+  memcpy(out + 2, val.data(), val.size());
+  return out + 2 + val.size();
+}
+
+// Encodes msg into dst, which must have room for ore_schema_size(msg)
+// bytes. Strings longer than ore_schema_max_str are not valid ORE, the
+// caller is expected to validate them. Returns the end of the message.
+template <class Msg> inline char *ore_schema_encode(char *dst, const Msg &msg) {
+  constexpr size_t count = ore_schema_field_count<Msg>() + 1;
+  static_assert(count <= 15, "ORE messages are encoded as fixarray");
+  auto *out = (uint8_t *)dst;
+  *out++ = 0x90 | count;
+  out = ore_schema_put(out, Msg::type);
+  std::apply(
+      [&](auto... member) { ((out = ore_schema_put(out, msg.*member)), ...); },
+      Msg::fields());
+  return (char *)out;
+}
+
+// Reads a field written with its fixed width type, falls back to the
+// generic reader for any other msgpack representation.
+template <class F> inline bool ore_schema_get(msgpack_reader_t &rd, F *val) {
+  constexpr size_t sz = ore_schema_field<F>::size;
+  if (rd.end - rd.pos >= (ptrdiff_t)sz && *rd.pos == ore_schema_field<F>::tag) {
+    ++rd.pos;
+    return rd.load(val);
+  }
+  return ore_read_field(rd, val);
+}
+
+template <> inline bool ore_schema_get(msgpack_reader_t &rd, bool *val) {
+  int64_t tmp;
+  if (!rd.read_int(&tmp))
+    return false;
+  *val = tmp;
+  return true;
+}
+
+template <> inline bool ore_schema_get(msgpack_reader_t &rd, char *val) {
+  if (rd.is_str()) {
+    std::string_view sv;
+    if (!rd.read_str(&sv) || sv.size() != 1)
+      return false;
+    *val = sv[0];
+    return true;
+  }
+  return ore_read_field(rd, val);
+}
+
+template <>
+inline bool ore_schema_get(msgpack_reader_t &rd, std::string_view *val) {
+  return rd.read_str(val);
+}
+
+// Decodes the fields of a message after its type, views point into the
+// reader buffer. Extra trailing fields are skipped.
+template <class Msg>
+inline bool ore_schema_decode_body(msgpack_reader_t &rd, uint32_t n,
+                                   Msg *msg) {
+  constexpr uint32_t count = ore_schema_field_count<Msg>();
+  if (n < count + 1)
+    return false;
+  bool ok = std::apply(
+      [&](auto... member) {
+        return (ore_schema_get(rd, &(msg->*member)) && ...);
+      },
+      Msg::fields());
+  for (uint32_t i = count + 1; ok && i < n; ++i)
+    ok = rd.skip();
+  return ok;
+}
+
+// Decodes one ORE message and calls f with the typed message. Returns
+// false if the data is not a valid ORE message, unknown message types are
+// skipped without calling f.
+template <class F> inline bool ore_schema_decode(msgpack_reader_t &rd, F &&f) {
+  uint32_t n;
+  uint8_t type;
+  if (!rd.read_array(&n) || n < 1 || !ore_schema_get(rd, &type))
+    return false;
+  switch (type) {
+  case ORE_ORDER_ADD: {
+    ore_order_add_t msg;
+    return ore_schema_decode_body(rd, n, &msg) && (f(msg), true);
+  }
+  case ORE_ORDER_DELETE: {
+    ore_order_delete_t msg;
+    return ore_schema_decode_body(rd, n, &msg) && (f(msg), true);
+  }
+  case ORE_ORDER_MODIFY: {
+    ore_order_modify_t msg;
+    return ore_schema_decode_body(rd, n, &msg) && (f(msg), true);
+  }
+  case ORE_OFF_BOOK_TRADE: {
+    ore_off_book_trade_t msg;
+    return ore_schema_decode_body(rd, n, &msg) && (f(msg), true);
+  }
+  case ORE_BOOK_CONTROL: {
+    ore_book_control_t msg;
+    return ore_schema_decode_body(rd, n, &msg) && (f(msg), true);
+  }
+  }
+  for (uint32_t i = 1; i < n; ++i)
+    if (!rd.skip())
+      return false;
+  return true;
+}
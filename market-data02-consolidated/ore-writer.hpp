@@ -0,0 +1,229 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Msgpack writer for the ORE messages produced from one input message.
+// Yamal reservations cannot be shrunk and a single input message may
+// produce several ORE messages, so the fields are recorded first while
+// keeping track of the exact encoded size. Once the parser is done the
+// caller reserves exactly size() bytes and encode() writes the msgpack
+// straight into the reservation, the output is written only once.
+//
+// Strings are recorded as views, they must stay valid until encode() is
+// called. Parsers only record views into the input yamal messages and
+// string literals, which outlive the call.
+class ore_writer_t {
+public:
+  // Records one ORE message, encoded as a msgpack array of args
+  template <class... Args> void write(Args &&...args) {
+    push(field_t::ARRAY, sizeof...(Args));
+    (add(std::forward<Args>(args)), ...);
+  }
+
+  // Exact size of the encoded messages
+  size_t size() const { return size_; }
+  bool empty() const { return fields_.empty(); }
+
+  // Keeps the field storage, so steady state recording never allocates
+  void reset() {
+    fields_.clear();
+    size_ = 0;
+  }
+
+  // Encodes the recorded messages into dst, which must have room for
+  // size() bytes. Returns the end of the encoded data.
+  char *encode(char *dst) const {
+    auto *out = (uint8_t *)dst;
+    for (auto &f : fields_) {
+      switch (f.kind) {
+      case field_t::ARRAY:
+        if (f.u <= 0x0f) {
+          *out++ = 0x90 | (uint8_t)f.u;
+        } else if (f.u <= 0xffff) {
+          *out++ = 0xdc;
+          out = store<uint16_t>(out, f.u);
+        } else {
+          *out++ = 0xdd;
+          out = store<uint32_t>(out, f.u);
+        }
+        break;
+      case field_t::UINT:
+        out = encode_uint(out, f.u);
+        break;
+      case field_t::INT:
+        out = encode_int(out, f.i);
+        break;
+      case field_t::BOOL:
+        *out++ = f.u ? 0xc3 : 0xc2;
+        break;
+      case field_t::CHAR:
+        *out++ = 0xa1;
+        *out++ = (uint8_t)f.u;
+        break;
+      case field_t::DOUBLE: {
+        uint64_t bits;
+        memcpy(&bits, &f.d, sizeof(bits));
+        *out++ = 0xcb;
+        out = store<uint64_t>(out, bits);
+      } break;
+      case field_t::STR:
+        if (f.len <= 31) {
+          *out++ = 0xa0 | (uint8_t)f.len;
+        } else if (f.len <= 0xff) {
+          *out++ = 0xd9;
+          *out++ = (uint8_t)f.len;
+        } else if (f.len <= 0xffff) {
+          *out++ = 0xda;
+          out = store<uint16_t>(out, f.len);
+        } else {
+          *out++ = 0xdb;
+          out = store<uint32_t>(out, f.len);
+        }
+        memcpy(out, f.s, f.len);
+        out += f.len;
+        break;
+      }
+    }
+    return (char *)out;
+  }
+
+  static constexpr size_t uint_size(uint64_t v) {
+    if (v <= 0x7f)
+      return 1;
+    if (v <= 0xff)
+      return 2;
+    if (v <= 0xffff)
+      return 3;
+    return v <= 0xffffffff ? 5 : 9;
+  }
+
+  static constexpr size_t int_size(int64_t v) {
+    if (v >= 0)
+      return uint_size(v);
+    if (v >= -32)
+      return 1;
+    if (v >= -128)
+      return 2;
+    if (v >= -32768)
+      return 3;
+    return v >= INT32_MIN ? 5 : 9;
+  }
+
+  static constexpr size_t str_size(size_t len) {
+    return len + (len <= 31 ? 1 : len <= 0xff ? 2 : len <= 0xffff ? 3 : 5);
+  }
+
+private:
+  struct field_t {
+    enum kind_t : uint8_t { ARRAY, UINT, INT, BOOL, CHAR, DOUBLE, STR };
+    kind_t kind;
+    uint32_t len;
+    union {
+      uint64_t u;
+      int64_t i;
+      double d;
+      const char *s;
+    };
+  };
+
+  void push(typename field_t::kind_t kind, uint64_t u) {
+    auto &f = fields_.emplace_back();
+    f.kind = kind;
+    f.u = u;
+    size_ += kind == field_t::ARRAY ? (u <= 0x0f ? 1 : u <= 0xffff ? 3 : 5)
+             : kind == field_t::UINT ? uint_size(u)
+             : kind == field_t::CHAR ? 2
+                                     : 1;
+  }
+
+  template <class T> void add(T &&val) {
+    using Type = std::decay_t<T>;
+    if constexpr (std::is_same_v<Type, bool>) {
+      push(field_t::BOOL, val);
+    } else if constexpr (std::is_same_v<Type, char>) {
+      push(field_t::CHAR, (uint8_t)val);
+    } else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>) {
+      auto &f = fields_.emplace_back();
+      f.kind = field_t::INT;
+      f.i = val;
+      size_ += int_size(val);
+    } else if constexpr (std::is_integral_v<Type>) {
+      push(field_t::UINT, val);
+    } else if constexpr (std::is_floating_point_v<Type>) {
+      auto &f = fields_.emplace_back();
+      f.kind = field_t::DOUBLE;
+      f.d = val;
+      size_ += 9;
+    } else {
+      std::string_view sv(val);
+      auto &f = fields_.emplace_back();
+      f.kind = field_t::STR;
+      f.len = sv.size();
+      f.s = sv.data();
+      size_ += str_size(sv.size());
+    }
+  }
+
+  template <class T> static uint8_t *store(uint8_t *out, uint64_t v) {
+    for (size_t i = sizeof(T); i-- > 0;) {
+      out[i] = (uint8_t)v;
+      v >>= 8;
+    }
+    return out + sizeof(T);
+  }
+
+  static uint8_t *encode_uint(uint8_t *out, uint64_t v) {
+    if (v <= 0x7f) {
+      *out++ = (uint8_t)v;
+    } else if (v <= 0xff) {
+      *out++ = 0xcc;
+      *out++ = (uint8_t)v;
+    } else if (v <= 0xffff) {
+      *out++ = 0xcd;
+      out = store<uint16_t>(out, v);
+    } else if (v <= 0xffffffff) {
+      *out++ = 0xce;
+      out = store<uint32_t>(out, v);
+    } else {
+      *out++ = 0xcf;
+      out = store<uint64_t>(out, v);
+    }
+    return out;
+  }
+
+  static uint8_t *encode_int(uint8_t *out, int64_t v) {
+    if (v >= 0)
+      return encode_uint(out, v);
+    if (v >= -32) {
+      *out++ = (uint8_t)v;
+    } else if (v >= -128) {
+      *out++ = 0xd0;
+      *out++ = (uint8_t)v;
+    } else if (v >= -32768) {
+      *out++ = 0xd1;
+      out = store<uint16_t>(out, (uint64_t)v);
+    } else if (v >= INT32_MIN) {
+      *out++ = 0xd2;
+      out = store<uint32_t>(out, (uint64_t)v);
+    } else {
+      *out++ = 0xd3;
+      out = store<uint64_t>(out, (uint64_t)v);
+    }
+    return out;
+  }
+
+  std::vector<field_t> fields_;
+  size_t size_ = 0;
+};
@@ -20,7 +20,12 @@
 #include <unordered_map>
 
 #include "common.hpp"
-#include "kraken-parser.hpp"
+#include "feed-engine.hpp"
+#include "latency.hpp"
+#include "metrics.hpp"
+#include "spsc-ring.hpp"
+#include "yamal-pager.hpp"
+#include "ytp-merge.hpp"
 #include <cmp/cmp.h>
 #include <fmc++/error.hpp>
 #include <fmc++/logger.hpp>
@@ -43,252 +48,6 @@ using namespace fmc;
 
 extern struct fmc_reactor_api_v1 *_reactor;
 
-struct binance_parse_ctx {
-  string_view bidqt = "null"sv;
-  string_view askqt = "null"sv;
-  string_view bidpx = "null"sv;
-  string_view askpx = "null"sv;
-  string_view symbol;
-  bool announced = false;
-};
-
-pair<string_view, parser_t> get_binance_channel_in(string_view sv,
-                                                   fmc_error_t **error) {
-  auto pos = sv.find_last_of('@');
-  auto none = make_pair<string_view, parser_t>(string_view(), nullptr);
-  RETURN_ERROR_UNLESS(pos != sv.npos, error, none,
-                      "missing @ in the Binance stream name", sv);
-
-  auto feedtype = sv.substr(pos + 1);
-  auto outsv = sv.substr(0, pos);
-  if (feedtype == "bookTicker") {
-    // This section here is binance parsing code
-    auto parse_binance_bookTicker =
-        [ctx = binance_parse_ctx{}](string_view in, cmp_str_t *cmp, int64_t tm,
-                                    uint64_t *last, bool skip,
-                                    fmc_error_t **error) mutable {
-          auto [val, rem] = simple_json_parse(in, "\"u\":");
-          RETURN_ERROR_UNLESS(val.size(), error, false,
-                              "could not parse message", in);
-          auto [seqno, parsed] = fmc::from_string_view<uint64_t>(val);
-          RETURN_ERROR_UNLESS(val.size() == parsed.size(), error, false,
-                              "could not parse message", in);
-          if (seqno <= *last)
-            return false;
-          *last = seqno;
-          string_view bidqt;
-          string_view askqt;
-          string_view bidpx;
-          string_view askpx;
-          tie(bidpx, rem) = simple_json_parse(rem, "\"b\":\"", "\",");
-          RETURN_ERROR_UNLESS(bidpx.size(), error, false,
-                              "could not parse message", in);
-          tie(bidqt, rem) = simple_json_parse(rem, "\"B\":\"", "\",");
-          RETURN_ERROR_UNLESS(bidqt.size(), error, false,
-                              "could not parse message", in);
-          tie(askpx, rem) = simple_json_parse(rem, "\"a\":\"", "\",");
-          RETURN_ERROR_UNLESS(askpx.size(), error, false,
-                              "could not parse message", in);
-          tie(askqt, rem) = simple_json_parse(rem, "\"A\":\"", "\"}");
-          RETURN_ERROR_UNLESS(askqt.size(), error, false,
-                              "could not parse message", in);
-
-          // TODO: need to fix this
-          bool has_bid = bidpx != "null";
-          bool has_ask = askpx != "null";
-          bool had_bid = ctx.bidpx != "null";
-          bool had_ask = ctx.askpx != "null";
-          bool bid_mod = had_bid & has_bid & (bidpx == ctx.bidpx);
-          bool ask_mod = had_ask & has_ask & (askpx == ctx.askpx);
-          bool bid_add = !had_bid & has_bid;
-          bool ask_add = !had_ask & has_ask;
-          bool bid_del = had_bid & !has_bid;
-          bool ask_del = had_ask & !has_ask;
-
-          bool batch = ask_mod | ask_add | ask_del;
-          bool announce = (!ctx.announced) & (bid_add | ask_add);
-          ctx.announced |= announce;
-
-          ctx.bidpx = bidpx;
-          ctx.bidqt = bidqt;
-          ctx.askpx = askpx;
-          ctx.askqt = askqt;
-
-          if (skip)
-            return true;
-
-          if (announce) {
-            // ORE Book Control Message
-            // [13, receive, vendor offset, vendor seqno, batch, imnt id,
-            // uncross, command]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)13,     // Message Type ID
-                          (int64_t)tm,     // recv_time
-                          (int64_t)0,      // vendor_offset
-                          (uint64_t)0,     // vendor_seqno
-                          (uint8_t)1,      // batch
-                          (int32_t)chanid, // imnt id
-                          (uint8_t)0,      // uncross
-                          'C'              // command
-            );
-            if (*error)
-              return false;
-          }
-
-          if (bid_mod) {
-            // ORE Order Modify Message
-            // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
-            // id, new price, new qty]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)6,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)seqno,
-                          (uint8_t)batch,  // batch (firts message)
-                          (int32_t)chanid, // imnt_id
-                          (int32_t)chanid, // order_id
-                          (int32_t)chanid, // new_order_id
-                          bidpx,           // price
-                          bidqt,           // qty
-                          (uint8_t) true   // is_bid
-            );
-          } else if (bid_add) {
-            // ORE Order Add Message
-            // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
-            // price, qty, is bid]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)1,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)seqno,
-                          (uint8_t)batch,  // batch (firts message)
-                          (int32_t)chanid, // imnt_id
-                          (int32_t)chanid, // order_id
-                          bidpx,           // price
-                          bidqt,           // qty
-                          true             // is_bid
-            );
-          } else if (bid_del) {
-            // ORE Order Delete Message
-            // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)5,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)seqno,
-                          (uint8_t)batch,  // batch (firts message)
-                          (int32_t)chanid, // imnt_id
-                          (int32_t)chanid  // order_id
-            );
-          }
-          if (*error)
-            return false;
-
-          if (ask_mod) {
-            // ORE Order Modify Message
-            // [6, receive, vendor offset, vendor seqno, batch, imnt id, id, new
-            // id, new price, new qty]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)6,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)seqno,
-                          (uint8_t)0,            // batch (last batch message)
-                          (int32_t)chanid,       // imnt_id
-                          (int32_t)(chanid + 1), // order_id
-                          (int32_t)(chanid + 1), // new_order_id
-                          askpx,                 // price
-                          askqt                  // qty
-            );
-          } else if (ask_add) {
-            // ORE Order Add Message
-            // [1, receive, vendor offset, vendor seqno, batch, imnt id, id,
-            // price, qty, is bid]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)1,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)seqno,
-                          (uint8_t)0,            // batch (last batch message)
-                          (int32_t)chanid,       // imnt_id
-                          (int32_t)(chanid + 1), // order_id
-                          askpx,                 // price
-                          askqt,                 // qty
-                          false                  // is_bid
-            );
-          } else if (ask_del) {
-            // ORE Order Delete Message
-            // [5, receive, vendor offset, vendor seqno, batch, imnt id, id]
-            cmp_ore_write(cmp, error,
-                          (uint8_t)5,  // Message Type ID
-                          (int64_t)tm, // recv_time
-                          (int64_t)0,  // vendor_offset
-                          (uint64_t)seqno,
-                          (uint8_t)0,           // batch (last batch message)
-                          (int32_t)chanid,      // imnt_id
-                          (int32_t)(chanid + 1) // order_id
-            );
-          }
-
-          return *error == nullptr;
-        };
-    return {outsv, parse_binance_bookTicker};
-  } else if (feedtype == "trade") {
-    auto parse_binance_trade = [](string_view in, cmp_str_t *cmp, int64_t tm,
-                                  uint64_t *last, bool skip,
-                                  fmc_error_t **error) {
-      auto [val, rem] = simple_json_parse(in, "\"E\":");
-      RETURN_ERROR_UNLESS(val.size(), error, false, "could not parse message",
-                          in);
-      auto [vend_ms, parsed] = fmc::from_string_view<int64_t>(val);
-      RETURN_ERROR_UNLESS(val.size() == parsed.size(), error, false,
-                          "could not parse message", in);
-
-      tie(val, rem) = simple_json_parse(rem, "\"t\":");
-      RETURN_ERROR_UNLESS(val.size(), error, false, "could not parse message",
-                          in);
-      auto [seqno, parsed2] = fmc::from_string_view<uint64_t>(val);
-      RETURN_ERROR_UNLESS(val.size() == parsed2.size(), error, false,
-                          "could not parse message", in);
-
-      if (seqno <= *last)
-        return false;
-      *last = seqno;
-      string_view trdpx;
-      string_view trdqt;
-      string_view isbid;
-      tie(trdpx, rem) = simple_json_parse(rem, "\"p\":\"", "\",");
-      RETURN_ERROR_UNLESS(trdpx.size(), error, false, "could not parse message",
-                          in);
-      tie(trdqt, rem) = simple_json_parse(rem, "\"q\":\"", "\",");
-      RETURN_ERROR_UNLESS(trdqt.size(), error, false, "could not parse message",
-                          in);
-
-      tie(isbid, rem) = simple_json_parse(rem, "\"m\":");
-      RETURN_ERROR_UNLESS(isbid.size(), error, false, "could not parse message",
-                          in);
-
-      // ORE Off Book Trade Message
-      // [11, receive, vendor offset, vendor seqno, batch, imnt id, trade
-      // price, qty, decorator]
-      cmp_ore_write(cmp, error,
-                    (uint8_t)11,                         // Message Type ID
-                    (int64_t)tm,                         // receive
-                    (int64_t)(tm - vend_ms * 1000000LL), // vendor offset in ns
-                    (uint64_t)seqno,                     // vendor seqno
-                    (uint8_t)0,                          // batch
-                    (uint64_t)chanid,                    // imnt_id
-                    trdpx,                               // trade price
-                    trdqt,                               // qty
-                    string_view(isbid == "true" ? "b" : "a"));
-
-      return *error == nullptr;
-    };
-    return {outsv, parse_binance_trade};
-  }
-  RETURN_ERROR(error, none, "unknown Binance stream type", feedtype);
-}
-
 struct runner_t {
   fmc_component_HEAD;
 
@@ -302,6 +61,15 @@ struct runner_t {
     parser_t parser;
     struct stream_out_t *outinfo = nullptr;
     uint64_t seqno = 0ULL;
+    // vendor sequence numbers increase by one, jumps are gaps
+    bool contiguous = false;
+  };
+
+  // messages of a stream of an input with a ring, read from the file and
+  // parsed from either the file or the ring, ordinals in the file
+  struct ordinal_t {
+    uint64_t read = 0ULL;
+    uint64_t done = 0ULL;
   };
 
   enum class PROCESS_STATE {
@@ -314,10 +82,13 @@ struct runner_t {
   bool process_one(fmc_error_t **error);
   bool recover(fmc_error_t **error);
   bool regular(fmc_error_t **error);
+  bool parse(const ytp_merge_t::input_t &input, fmc_error_t **error);
+  uint64_t backlog(fmc_error_t **error);
 
   stream_out_t *get_stream_out(ytp_mmnode_offs stream, fmc_error_t **error);
   stream_out_t *get_stream_out(string_view sv, fmc_error_t **error);
-  stream_in_t *get_stream_in(ytp_mmnode_offs stream, fmc_error_t **error);
+  stream_in_t *get_stream_in(const ytp_merge_t::input_t &input,
+                             fmc_error_t **error);
   stream_out_t *emplace_stream_out(ytp_mmnode_offs stream);
 
   // We use a hash map to store stream info
@@ -325,32 +96,45 @@ struct runner_t {
       unordered_map<ytp_mmnode_offs, unique_ptr<stream_out_t>>;
   using channels_in_t = unordered_map<string_view, unique_ptr<stream_in_t>>;
   using streams_in_t = unordered_map<ytp_mmnode_offs, stream_in_t *>;
-  // This map contains a context factory for each supported feed
-  unordered_map<string, resolver_t> resolvers = {
-      {"binance", get_binance_channel_in}, {"kraken", get_kraken_channel_in}};
   // Hash map to keep track of outgoing streams
   streams_out_t s_out;
+  // channels are shared by the inputs, so the same channel written by a
+  // primary and a backup handler to different files is deduplicated
   channels_in_t ch_in;
-  streams_in_t s_in;
+  // stream offsets are specific to the file, one map per input
+  vector<streams_in_t> s_in;
   string_view prefix_out = "ore/";
   string_view prefix_in = "raw/";
   string_view encoding = "Content-Type application/msgpack\n"
                          "Content-Schema ore1.1.3";
   std::string peer;
-  fmc_fd fd_in = -1;
+  vector<fmc_fd> fds_in;
   fmc_fd fd_out = -1;
-  ytp_yamal_t *ytp_in = nullptr;
+  vector<ytp_yamal_t *> ytps_in;
   ytp_yamal_t *ytp_out = nullptr;
+  // keeps the pages ahead of the output writer ready, nullptr if disabled
+  unique_ptr<yamal_pager_t> pager;
   ytp_streams_t *streams = nullptr;
-  cmp_str_t cmp;
-  ytp_iterator_t it_in;
+  ore_writer_t out;
+  // input files merged by receive time
+  ytp_merge_t merge;
+  // ring of each input, from its feed handler, nullptr if none
+  vector<fmc_fd> fds_ring;
+  vector<unique_ptr<spsc_ring_t>> rings;
+  vector<unordered_map<ytp_mmnode_offs, ordinal_t>> ordinals;
+  // sidecar index of each input, nullptr if it is read in full
+  vector<fmc_fd> fds_index;
+  vector<unique_ptr<ytp_index_reader_t>> indexes;
   ytp_iterator_t it_out;
   int64_t last = 0LL;
   static constexpr int64_t delay = 1000000000LL;
-  uint64_t read_count = 0ULL;
   uint64_t msg_count = 0ULL;
-  uint64_t dup_count = 0ULL;
   uint64_t chn_count = 0ULL;
+  ytp_mmnode_offs stats_stream = 0ULL;
+  ytp_mmnode_offs metrics_stream = 0ULL;
+  metrics_t metrics;
+  latency_histogram_t parse_lat;  // input commit to parse completion
+  latency_histogram_t commit_lat; // parse completion to output commit
   static constexpr uint64_t msg_batch = 1000000ULL;
   static constexpr uint64_t chn_batch = 1000ULL;
   PROCESS_STATE process_state = PROCESS_STATE::RECOVERY;
@@ -360,40 +144,132 @@ runner_t::~runner_t() {
   fmc_error_t *error = nullptr;
   if (streams)
     ytp_streams_del(streams, &error);
-  if (ytp_in)
+  for (auto *ytp_in : ytps_in)
     ytp_yamal_del(ytp_in, &error);
+  pager.reset();
   if (ytp_out)
     ytp_yamal_del(ytp_out, &error);
-  if (fd_in != -1)
+  for (auto fd_in : fds_in)
     fmc_fclose(fd_in, &error);
+  rings.clear();
+  for (auto fd_ring : fds_ring)
+    fmc_fclose(fd_ring, &error);
+  indexes.clear();
+  for (auto fd_index : fds_index)
+    fmc_fclose(fd_index, &error);
   if (fd_out != -1)
     fmc_fclose(fd_out, &error);
 }
 
 void runner_t::init(struct fmc_cfg_sect_item *cfg, fmc_error_t **error) {
-  fd_in = fmc_fopen(fmc_cfg_sect_item_get(cfg, "ytp-input")->node.value.str,
-                    fmc_fmode::READ, error);
-  RETURN_ON_ERROR(error, , "could not open input yamal file",
-                  fmc_cfg_sect_item_get(cfg, "ytp-input")->node.value.str);
+  fmc_error_clear(error);
+  vector<const char *> files;
+  if (auto *input = fmc_cfg_sect_item_get(cfg, "ytp-input"); input)
+    files.push_back(input->node.value.str);
+  if (auto *inputs = fmc_cfg_sect_item_get(cfg, "ytp-inputs"); inputs) {
+    for (auto *item = inputs->node.value.arr; item; item = item->next)
+      files.push_back(item->item.value.str);
+  }
+  RETURN_ERROR_UNLESS(!files.empty(), error, ,
+                      "ytp-input or ytp-inputs must be set");
+  vector<string_view> index_files(files.size());
+  if (auto *items = fmc_cfg_sect_item_get(cfg, "indexes"); items) {
+    size_t i = 0;
+    for (auto *item = items->node.value.arr; item; item = item->next, ++i) {
+      RETURN_ERROR_UNLESS(i < files.size(), error, ,
+                          "there are more indexes than inputs");
+      index_files[i] = item->item.value.str;
+    }
+  }
+  indexes.resize(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    auto *file = files[i];
+    auto fd_in = fmc_fopen(file, fmc_fmode::READ, error);
+    RETURN_ON_ERROR(error, , "could not open input yamal file", file);
+    fds_in.push_back(fd_in);
+    auto *ytp_in = ytp_yamal_new(fd_in, error);
+    RETURN_ON_ERROR(error, , "could not create input yamal", file);
+    ytps_in.push_back(ytp_in);
+    if (index_files[i].empty()) {
+      merge.add(ytp_in, error);
+      RETURN_ON_ERROR(error, , "could not obtain iterator", file);
+      continue;
+    }
+    // the feed handler creates the index, it must have started
+    auto index_file = index_files[i];
+    auto fd_index = fmc_fopen(index_file.data(), fmc_fmode::READ, error);
+    RETURN_ON_ERROR(error, , "could not open index file", index_file);
+    fds_index.push_back(fd_index);
+    indexes[i] = make_unique<ytp_index_reader_t>(ytp_in, fd_index, error);
+    RETURN_ON_ERROR(error, , "could not open index", index_file);
+    // only the channels parsed are read from the file
+    auto select = [this, i](ytp_mmnode_offs stream, fmc_error_t **error) {
+      ytp_merge_t::input_t input;
+      input.yamal = ytps_in[i];
+      input.index = i;
+      input.stream = stream;
+      return get_stream_in(input, error) != nullptr;
+    };
+    merge.add(ytp_in, indexes[i].get(), select, error);
+    RETURN_ON_ERROR(error, , "could not obtain iterator", file);
+  }
+  s_in.resize(files.size());
+  rings.resize(files.size());
+  ordinals.resize(files.size());
+  if (auto *items = fmc_cfg_sect_item_get(cfg, "rings"); items) {
+    size_t i = 0;
+    for (auto *item = items->node.value.arr; item; item = item->next, ++i) {
+      RETURN_ERROR_UNLESS(i < files.size(), error, ,
+                          "there are more rings than inputs");
+      string_view file = item->item.value.str;
+      if (file.empty())
+        continue;
+      auto fd_ring = fmc_fopen(file.data(), fmc_fmode::READWRITE, error);
+      RETURN_ON_ERROR(error, , "could not open ring file", file);
+      fds_ring.push_back(fd_ring);
+      rings[i] = make_unique<spsc_ring_t>(fd_ring, spsc_ring_capacity, error);
+      RETURN_ON_ERROR(error, , "could not open ring", file);
+    }
+  }
   fd_out = fmc_fopen(fmc_cfg_sect_item_get(cfg, "ytp-output")->node.value.str,
                      fmc_fmode::READWRITE, error);
   RETURN_ON_ERROR(error, , "could not open output yamal file",
                   fmc_cfg_sect_item_get(cfg, "ytp-output")->node.value.str);
-  ytp_in = ytp_yamal_new(fd_in, error);
-  RETURN_ON_ERROR(error, , "could not create input yamal");
   ytp_out = ytp_yamal_new(fd_out, error);
   RETURN_ON_ERROR(error, , "could not create output yamal");
+  yamal_pager_cfg_t pcfg;
+  if (auto *prefault = fmc_cfg_sect_item_get(cfg, "prefault"); prefault) {
+    RETURN_ERROR_UNLESS(prefault->node.value.int64 >= 0, error, ,
+                        "prefault must not be negative");
+    pcfg.prefault = prefault->node.value.int64;
+  }
+  if (auto *huge = fmc_cfg_sect_item_get(cfg, "hugepages"); huge)
+    pcfg.hugepages = huge->node.value.boolean;
+  if (auto *lock = fmc_cfg_sect_item_get(cfg, "mlock"); lock)
+    pcfg.mlock = lock->node.value.boolean;
+  if (pcfg.enabled()) {
+    pager = make_unique<yamal_pager_t>(fd_out, pcfg, error);
+    RETURN_ON_ERROR(error, , "could not create output pager");
+    pager->start();
+  }
   streams = ytp_streams_new(ytp_out, error);
   RETURN_ON_ERROR(error, , "could not create stream");
-  cmp_str_init(&cmp);
-  it_in = ytp_data_begin(ytp_in, error);
-  RETURN_ON_ERROR(error, , "could not obtain iterator");
   peer = fmc_cfg_sect_item_get(cfg, "peer")->node.value.str;
   it_out = ytp_data_begin(ytp_out, error);
   RETURN_ON_ERROR(error, , "could not obtain iterator");
+  stats_stream = latency_stream_announce(streams, peer, error);
+  RETURN_ON_ERROR(error, , "could not announce stats stream");
+  metrics_stream = metrics_stream_announce(streams, peer, error);
+  RETURN_ON_ERROR(error, , "could not announce metrics stream");
+  // calibrate the tsc clock outside of the hot path
+  tsc_clock::ns_per_tick();
 }
 
 bool runner_t::process_one(fmc_error_t **error) {
+  // the pager runs on its own thread, only its failure is reported here
+  string msg;
+  RETURN_ERROR_UNLESS(!pager || !pager->failed(&msg), error, false,
+                      "output pager failed:", msg);
   switch (process_state) {
   case PROCESS_STATE::RECOVERY:
     if (recover(error)) {
@@ -445,64 +321,115 @@ bool runner_t::recover(fmc_error_t **error) {
 }
 
 bool runner_t::regular(fmc_error_t **error) {
-  if (!ytp_yamal_term(it_in)) {
-    uint64_t seqno;
-    int64_t ts;
-    ytp_mmnode_offs stream;
-    size_t sz;
-    const char *data;
-    ytp_data_read(ytp_in, it_in, &seqno, &ts, &stream, &sz, &data, error);
-    RETURN_ON_ERROR(error, false, "could not obtain iterator");
-    it_in = ytp_yamal_next(ytp_in, it_in, error);
-    RETURN_ON_ERROR(error, false, "could not obtain next iterator");
-    auto *info = get_stream_in(stream, error);
-    if (*error) {
-      return false;
+  // the messages of the rings are parsed as soon as the feed handlers have
+  // them, unless they were read from the file already
+  for (size_t i = 0; i < rings.size(); ++i) {
+    auto *rec = rings[i] ? rings[i]->peek() : nullptr;
+    if (!rec)
+      continue;
+    auto &ord = ordinals[i][rec->stream];
+    if (rec->ordinal == ord.done) {
+      ++ord.done;
+      ytp_merge_t::input_t input;
+      input.yamal = ytps_in[i];
+      input.index = i;
+      input.ts = rec->ts;
+      input.stream = rec->stream;
+      input.sz = rec->size;
+      input.data = (const char *)(rec + 1);
+      if (!parse(input, error))
+        return false;
     }
-    // if this channel not interesting, skip it
-    if (!info) {
-      return true;
+    rings[i]->pop();
+  }
+  auto *input = merge.next(error);
+  RETURN_ON_ERROR(error, false, "could not read input");
+  if (input) {
+    bool parsed = false;
+    if (rings[input->index]) {
+      auto &ord = ordinals[input->index][input->stream];
+      parsed = ord.read++ < ord.done;
+      ord.done += !parsed;
     }
-    ++read_count;
-    seqno = info->seqno;
-    cmp_str_reset(&cmp);
-    bool skip = info->outinfo->count > 0;
-    bool nodup =
-        info->parser(string_view(data, sz), &cmp, ts, &seqno, skip, error);
-    if (*error) {
+    if (!parsed && !parse(*input, error))
       return false;
-    }
-    // duplicate
-    if (!nodup) {
-      ++dup_count;
-      return true;
-    }
-    info->seqno = seqno;
-    // otherwise check if we still recovering
-    if (skip) {
-      --info->outinfo->count;
-      return true;
-    }
-    size_t bufsz = cmp_str_size(&cmp);
-    auto dst = ytp_data_reserve(ytp_out, bufsz, error);
-    RETURN_ON_ERROR(error, false, "could not reserve message");
-    memcpy(dst, cmp_str_data(&cmp), bufsz);
-    ytp_data_commit(ytp_out, fmc_cur_time_ns(), info->outinfo->stream, dst,
-                    error);
-    RETURN_ON_ERROR(error, false, "could not commit message");
-    ++msg_count;
   }
   if (auto now = fmc_cur_time_ns(); last + delay < now) {
+    auto interval = last ? now - last : 0;
     last = now;
-    notice("read:", read_count, "written:", msg_count,
-           "duplicates:", dup_count);
-    read_count = 0ULL;
-    msg_count = 0ULL;
-    dup_count = 0ULL;
+    latency_publish(ytp_out, stats_stream, "commit-parse", interval, parse_lat,
+                    error);
+    RETURN_ON_ERROR(error, false, "could not publish latency stats");
+    latency_publish(ytp_out, stats_stream, "parse-commit", interval,
+                    commit_lat, error);
+    RETURN_ON_ERROR(error, false, "could not publish latency stats");
+    metrics.cur.queue_depth = backlog(error);
+    RETURN_ON_ERROR(error, false, "could not measure input backlog");
+    metrics.publish(ytp_out, metrics_stream, error);
+    RETURN_ON_ERROR(error, false, "could not publish metrics");
+  }
+  return true;
+}
+
+bool runner_t::parse(const ytp_merge_t::input_t &input, fmc_error_t **error) {
+  int64_t ts = input.ts;
+  size_t sz = input.sz;
+  const char *data = input.data;
+  auto *info = get_stream_in(input, error);
+  if (*error) {
+    return false;
+  }
+  // if this channel not interesting, skip it
+  if (!info) {
+    return true;
+  }
+  uint64_t seqno = info->seqno;
+  out.reset();
+  bool skip = info->outinfo->count > 0;
+  bool nodup =
+      info->parser(string_view(data, sz), &out, ts, &seqno, skip, error);
+  if (*error) {
+    return false;
+  }
+  // duplicate
+  // input replayed after a restart is not counted again
+  if (!nodup) {
+    metrics.cur.duplicates += !skip;
+    return true;
+  }
+  bool gap = info->contiguous && info->seqno && seqno > info->seqno + 1;
+  info->seqno = seqno;
+  // otherwise check if we still recovering
+  if (skip) {
+    --info->outinfo->count;
+    return true;
+  }
+  ++metrics.cur.messages;
+  metrics.cur.bytes += sz;
+  metrics.cur.gaps += gap;
+  auto parsed_tsc = tsc_clock::now();
+  parse_lat.record_signed(fmc_cur_time_ns() - ts);
+  // encode straight into the output message
+  auto dst = ytp_data_reserve(ytp_out, out.size(), error);
+  RETURN_ON_ERROR(error, false, "could not reserve message");
+  out.encode(dst);
+  auto it = ytp_data_commit(ytp_out, fmc_cur_time_ns(),
+                            info->outinfo->stream, dst, error);
+  RETURN_ON_ERROR(error, false, "could not commit message");
+  commit_lat.record(tsc_clock::ns(tsc_clock::now() - parsed_tsc));
+  if (pager) {
+    pager->advance(ytp_data_tell(ytp_out, it, error));
+    RETURN_ON_ERROR(error, false, "could not obtain output offset");
   }
   return true;
 }
 
+uint64_t runner_t::backlog(fmc_error_t **error) {
+  auto bytes = merge.backlog(error);
+  RETURN_ON_ERROR(error, bytes, "could not obtain input offsets");
+  return bytes;
+}
+
 runner_t::stream_out_t *runner_t::emplace_stream_out(ytp_mmnode_offs stream) {
   return s_out
       .emplace(stream, make_unique<stream_out_t>(stream_out_t{stream, 0ULL}))
@@ -546,13 +473,16 @@ runner_t::stream_out_t *runner_t::get_stream_out(string_view sv,
   return emplace_stream_out(stream);
 }
 
-runner_t::stream_in_t *runner_t::get_stream_in(ytp_mmnode_offs stream,
-                                               fmc_error_t **error) {
+runner_t::stream_in_t *
+runner_t::get_stream_in(const ytp_merge_t::input_t &input,
+                        fmc_error_t **error) {
   fmc_error_clear(error);
 
-  // Look up the stream in the input stream map
-  auto where = s_in.find(stream);
-  if (where != s_in.end())
+  // Look up the stream in the stream map of the input
+  auto stream = input.stream;
+  auto &streams_in = s_in[input.index];
+  auto where = streams_in.find(stream);
+  if (where != streams_in.end())
     return where->second;
 
   // if we don't know this input stream, look up stream info,
@@ -563,14 +493,14 @@ runner_t::stream_in_t *runner_t::get_stream_in(ytp_mmnode_offs stream,
   const char *origpeer, *channel, *encoding;
   ytp_mmnode_offs *original, *subscribed;
   // This functions looks up stream announcement details
-  ytp_announcement_lookup(ytp_in, stream, &seqno, &psz, &origpeer, &csz,
+  ytp_announcement_lookup(input.yamal, stream, &seqno, &psz, &origpeer, &csz,
                           &channel, &esz, &encoding, &original, &subscribed,
                           error);
   RETURN_ON_ERROR(error, nullptr, "could not look up stream announcement");
   string_view sv{channel, csz};
   // if this stream is one of ours or wrong format, skip
   if (string_view(origpeer, psz) == peer || !starts_with(sv, prefix_in)) {
-    return s_in.emplace(stream, nullptr).first->second;
+    return streams_in.emplace(stream, nullptr).first->second;
   }
 
   sv = sv.substr(prefix_in.size());
@@ -578,20 +508,24 @@ runner_t::stream_in_t *runner_t::get_stream_in(ytp_mmnode_offs stream,
   if (chan_it == ch_in.end()) {
     // we remove the prefix from the input channel name
     auto [feedsv, sep, rem] = split(sv, "/");
-    auto feed = string(feedsv);
-    auto resolver = resolvers.find(feed);
-    RETURN_ERROR_UNLESS(resolver != resolvers.end(), error, nullptr,
-                        "unknown feed", feed);
-    auto [outsv, parser] = resolver->second(sv, error);
+    // every venue of the feed engine provides the parser of its feed
+    auto *venue = venue_find(feedsv);
+    RETURN_ERROR_UNLESS(venue, error, nullptr, "unknown feed", feedsv);
+    auto [outsv, parser] = venue->resolver(sv, error);
     RETURN_ON_ERROR(error, nullptr, "could not find a parser");
     auto *outinfo = get_stream_out(outsv, error);
     RETURN_ON_ERROR(error, nullptr, "could not get out stream");
+    // only some stream types have vendor sequence numbers without holes
+    auto type = sv.substr(sv.find_last_of('@') + 1);
+    bool contiguous = venue->contiguous && type == venue->contiguous;
     chan_it = ch_in
                   .emplace(sv, make_unique<stream_in_t>(stream_in_t{
-                                   .parser = parser, .outinfo = outinfo}))
+                                   .parser = parser,
+                                   .outinfo = outinfo,
+                                   .contiguous = contiguous}))
                   .first;
   }
-  return s_in.emplace(stream, chan_it->second.get()).first->second;
+  return streams_in.emplace(stream, chan_it->second.get()).first->second;
 }
 
 void feed_parser_component_del(struct runner_t *comp) noexcept { delete comp; }
@@ -630,6 +564,10 @@ cleanup:
   return nullptr;
 }
 
+static struct fmc_cfg_type feed_parser_input_spec = {
+    .type = FMC_CFG_STR,
+};
+
 struct fmc_cfg_node_spec feed_parser_cfgspec[] = {
     {.key = "peer",
      .descr = "Feed parser peer name",
@@ -640,11 +578,34 @@ struct fmc_cfg_node_spec feed_parser_cfgspec[] = {
          }},
     {.key = "ytp-input",
      .descr = "Feed parser ytp input name",
-     .required = true,
+     .required = false,
      .type =
          {
              .type = FMC_CFG_STR,
          }},
+    {.key = "ytp-inputs",
+     .descr = "Feed parser ytp input names, merged by receive time",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &feed_parser_input_spec,
+              }}},
+    {.key = "rings",
+     .descr = "Shared memory rings of the feed handlers writing the inputs, "
+              "in the order of the inputs, empty for none",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &feed_parser_input_spec,
+              }}},
+    {.key = "indexes",
+     .descr = "Sidecar indexes of the feed handlers writing the inputs, in "
+              "the order of the inputs, empty for none",
+     .required = false,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &feed_parser_input_spec,
+              }}},
     {.key = "ytp-output",
      .descr = "Feed parser ytp output name",
      .required = true,
@@ -652,6 +613,29 @@ struct fmc_cfg_node_spec feed_parser_cfgspec[] = {
          {
              .type = FMC_CFG_STR,
          }},
+    {.key = "prefault",
+     .descr = "Bytes of ytp-output preallocated and faulted in ahead of the "
+              "feed parser, none by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "hugepages",
+     .descr = "Advise huge pages for the pages of ytp-output ahead of the "
+              "feed parser, used for files on a tmpfs with huge pages enabled",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "mlock",
+     .descr = "Lock the pages of ytp-output around the feed parser in memory",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
     {NULL},
 };
 
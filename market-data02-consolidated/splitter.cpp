@@ -0,0 +1,115 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <fnmatch.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+
+#include "splitter.hpp"
+
+using namespace std;
+
+bool splitter_match(string_view pattern, string_view channel) {
+  if (pattern.find_first_of("*?[") == string_view::npos)
+    return fmc::starts_with(channel, pattern);
+  return fnmatch(string(pattern).c_str(), string(channel).c_str(), 0) == 0;
+}
+
+splitter_t::splitter_t(ytp_yamal_t *source, splitter_cfg_t c,
+                       fmc_error_t **error)
+    : source(source), cfg(move(c)) {
+  fmc_error_clear(error);
+  RETURN_ERROR_UNLESS(cfg.from == "start" || cfg.from == "end", error, ,
+                      "from must be start or end");
+  RETURN_ERROR_UNLESS(!cfg.outputs.empty(), error, ,
+                      "at least one output is required");
+  outputs.resize(cfg.outputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    auto &out = outputs[i];
+    out.yamal = cfg.outputs[i].yamal;
+    out.channels = cfg.outputs[i].channels;
+    RETURN_ERROR_UNLESS(out.yamal != source, error, ,
+                        "an output cannot be the source");
+    out.streams = ytp_streams_new(out.yamal, error);
+    RETURN_ON_ERROR(error, , "could not create streams");
+  }
+  it = cfg.from == "start" ? ytp_data_begin(source, error)
+                           : ytp_data_end(source, error);
+  RETURN_ON_ERROR(error, , "could not obtain iterator");
+}
+
+splitter_t::~splitter_t() {
+  fmc_error_t *error = nullptr;
+  for (auto &out : outputs) {
+    if (out.streams)
+      ytp_streams_del(out.streams, &error);
+  }
+}
+
+pair<uint32_t, uint32_t> splitter_t::route(ytp_mmnode_offs stream,
+                                           fmc_error_t **error) {
+  uint64_t seqno;
+  size_t psz, csz, esz;
+  const char *peer, *channel, *encoding;
+  ytp_mmnode_offs *original, *subscribed;
+  ytp_announcement_lookup(source, stream, &seqno, &psz, &peer, &csz,
+                          &channel, &esz, &encoding, &original, &subscribed,
+                          error);
+  RETURN_ON_ERROR(error, {}, "could not look up stream announcement");
+  string_view sv{channel, csz};
+  pair<uint32_t, uint32_t> r{targets.size(), targets.size()};
+  for (auto &out : outputs) {
+    auto match = [sv](auto &pattern) { return splitter_match(pattern, sv); };
+    if (!out.channels.empty() &&
+        none_of(out.channels.begin(), out.channels.end(), match))
+      continue;
+    auto ostream = ytp_streams_announce(out.streams, psz, peer, csz, channel,
+                                        esz, encoding, error);
+    RETURN_ON_ERROR(error, {}, "could not announce stream", sv);
+    targets.push_back({&out, ostream});
+  }
+  r.second = targets.size();
+  routes.emplace(stream, r);
+  return r;
+}
+
+size_t splitter_t::poll(fmc_error_t **error) {
+  fmc_error_clear(error);
+  size_t count = 0;
+  for (; count < cfg.batch && !ytp_yamal_term(it); ++count) {
+    uint64_t seqno;
+    int64_t ts;
+    ytp_mmnode_offs stream;
+    size_t sz;
+    const char *data;
+    ytp_data_read(source, it, &seqno, &ts, &stream, &sz, &data, error);
+    RETURN_ON_ERROR(error, count, "could not read data");
+    auto where = routes.find(stream);
+    auto r = where != routes.end() ? where->second : route(stream, error);
+    if (*error)
+      return count;
+    for (auto i = r.first; i < r.second; ++i) {
+      auto &t = targets[i];
+      auto *dst = ytp_data_reserve(t.output->yamal, sz, error);
+      RETURN_ON_ERROR(error, count, "could not reserve message");
+      memcpy(dst, data, sz);
+      ytp_data_commit(t.output->yamal, ts, t.stream, dst, error);
+      RETURN_ON_ERROR(error, count, "could not commit message");
+      ++t.output->messages;
+      t.output->bytes += sz;
+    }
+    it = ytp_yamal_next(source, it, error);
+    RETURN_ON_ERROR(error, count, "could not obtain next iterator");
+  }
+  messages += count;
+  return count;
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmc/error.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+/*
+ * Channel filter of a splitter output. A pattern with any of the glob
+ * characters *?[ is matched against the whole channel with fnmatch(3),
+ * so * also matches /, any other pattern is a channel prefix.
+ */
+bool splitter_match(std::string_view pattern, std::string_view channel);
+
+struct splitter_output_cfg_t {
+  ytp_yamal_t *yamal = nullptr;       /* not owned */
+  std::vector<std::string> channels; /* patterns, all channels if empty */
+};
+
+struct splitter_cfg_t {
+  std::vector<splitter_output_cfg_t> outputs;
+  std::string from = "start"; /* or end for new data only */
+  size_t batch = 4096;        /* source messages copied per poll */
+};
+
+/*
+ * Splits a yamal file into subset files, one per consumer. The source is
+ * read once and every data message is copied, with its time, to the
+ * outputs whose patterns match its channel, where the stream is announced
+ * with the same peer, channel and encoding before its first message. A
+ * consumer reading its output only goes through its own channels instead
+ * of every message of the source.
+ *
+ * Streams are resolved once, to the list of output streams they are
+ * copied to, so the cost of a source message is one hash lookup plus one
+ * copy per matching output. The outputs are expected to be new files, a
+ * restarted splitter copies from the start of the source again unless
+ * from is end.
+ */
+struct splitter_t {
+  splitter_t(ytp_yamal_t *source, splitter_cfg_t cfg, fmc_error_t **error);
+  ~splitter_t();
+
+  /* copies the new messages of the source, returns the number read */
+  size_t poll(fmc_error_t **error);
+
+  struct output_t {
+    ytp_yamal_t *yamal = nullptr;
+    ytp_streams_t *streams = nullptr;
+    std::vector<std::string> channels;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+  };
+  struct target_t {
+    output_t *output;
+    ytp_mmnode_offs stream;
+  };
+
+  /* first and last target of a source stream in targets */
+  std::pair<uint32_t, uint32_t> route(ytp_mmnode_offs stream,
+                                      fmc_error_t **error);
+
+  ytp_yamal_t *source = nullptr;
+  splitter_cfg_t cfg;
+  ytp_iterator_t it = nullptr;
+  std::vector<output_t> outputs;
+  /* targets of the source streams, contiguous per stream */
+  std::vector<target_t> targets;
+  std::unordered_map<ytp_mmnode_offs, std::pair<uint32_t, uint32_t>> routes;
+
+  uint64_t messages = 0; /* source messages read */
+};
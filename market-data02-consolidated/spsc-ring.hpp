@@ -0,0 +1,191 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string_view>
+
+#include <fmc++/error.hpp>
+#include <fmc/error.h>
+#include <fmc/files.h>
+#include <ytp/yamal.h>
+
+// Single producer single consumer ring of raw messages in a shared memory
+// file, such as one in /dev/shm, from a feed handler to the feed parser.
+// The ring is a fast path next to the yamal file of the handler, not a
+// replacement for it:
+//  - the handler writes a message to the ring before committing it to its
+//    file and publishes it only once committed, so the ring never has a
+//    message the file does not, and drops it from the ring when the ring
+//    is full, so a slow or absent parser never holds the handler back,
+//  - every message carries its stream in the file of the handler and its
+//    ordinal, the number of messages of the stream before it in the file,
+//    so the parser takes from the ring exactly the messages it has not
+//    read from the file yet, and from the file the ones the ring dropped.
+// Positions grow without wrapping, the producer publishes head and the
+// consumer tail with release semantics. Records are 8 byte aligned, a
+// record that does not fit before the end of the buffer is preceded by a
+// wrap marker and starts over at the beginning.
+struct spsc_ring_hdr_t {
+  char magic[8];
+  uint64_t capacity; // bytes of the buffer, a power of two
+  alignas(64) uint64_t head;
+  alignas(64) uint64_t tail;
+};
+
+struct spsc_ring_rec_t {
+  uint32_t size; // payload bytes, spsc_ring_wrap for a wrap marker
+  uint32_t reserved;
+  ytp_mmnode_offs stream;
+  uint64_t ordinal;
+  int64_t ts; // time the message is committed with
+};
+
+inline constexpr char spsc_ring_magic[8] = {'F', 'E', 'E', 'D',
+                                            'R', 'N', 'G', '1'};
+inline constexpr uint32_t spsc_ring_wrap = UINT32_MAX;
+// capacity of a ring created without a size, by the parser for instance
+inline constexpr size_t spsc_ring_capacity = 16ULL << 20;
+// largest capacity of a ring
+inline constexpr size_t spsc_ring_capacity_max = 1ULL << 40;
+
+struct spsc_ring_t {
+  // Maps the ring in fd, created with capacity bytes if the file is empty,
+  // capacity is rounded up to a power of two
+  spsc_ring_t(fmc_fd fd, size_t capacity, fmc_error_t **error) {
+    fmc_error_clear(error);
+    struct stat st;
+    RETURN_ERROR_UNLESS(fstat(fd, &st) == 0, error, ,
+                        "could not obtain ring size:", strerror(errno));
+    RETURN_ERROR_UNLESS(capacity <= spsc_ring_capacity_max, error, ,
+                        "ring capacity must be at most",
+                        spsc_ring_capacity_max, "bytes");
+    size_t cap = 4096;
+    while (cap < capacity)
+      cap <<= 1;
+    bool create = st.st_size == 0;
+    if (create) {
+      RETURN_ERROR_UNLESS(ftruncate(fd, sizeof(spsc_ring_hdr_t) + cap) == 0,
+                          error, , "could not size ring:", strerror(errno));
+      st.st_size = sizeof(spsc_ring_hdr_t) + cap;
+    }
+    RETURN_ERROR_UNLESS((size_t)st.st_size > sizeof(spsc_ring_hdr_t), error,
+                        , "ring file is too small");
+    size = st.st_size;
+    auto *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                      0);
+    RETURN_ERROR_UNLESS(base != MAP_FAILED, error, ,
+                        "could not map ring:", strerror(errno));
+    hdr = (spsc_ring_hdr_t *)base;
+    buf = (char *)base + sizeof(spsc_ring_hdr_t);
+    if (create) {
+      hdr->capacity = cap;
+      memcpy(hdr->magic, spsc_ring_magic, sizeof spsc_ring_magic);
+    }
+    RETURN_ERROR_UNLESS(
+        memcmp(hdr->magic, spsc_ring_magic, sizeof spsc_ring_magic) == 0 &&
+            sizeof(spsc_ring_hdr_t) + hdr->capacity == size,
+        error, , "not a feed ring");
+    mask = hdr->capacity - 1;
+    head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+  }
+
+  ~spsc_ring_t() {
+    if (hdr)
+      munmap(hdr, size);
+  }
+
+  // Producer, copies a message into the ring and publishes it, false if it
+  // does not fit
+  bool push(ytp_mmnode_offs stream, uint64_t ordinal, int64_t ts,
+            std::string_view data) {
+    if (!write(stream, ordinal, ts, data))
+      return false;
+    publish();
+    return true;
+  }
+
+  // Producer, copies a message into the ring without making it visible to
+  // the consumer, false if it does not fit. The next write replaces it
+  // unless it is published first.
+  bool write(ytp_mmnode_offs stream, uint64_t ordinal, int64_t ts,
+             std::string_view data) {
+    auto need = footprint(data.size());
+    auto room = hdr->capacity - (head & mask);
+    auto total = need + (room < need ? room : 0);
+    if (head + total - tail > hdr->capacity) {
+      tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+      if (head + total - tail > hdr->capacity) {
+        ++dropped;
+        return false;
+      }
+    }
+    auto pos = head;
+    if (room < need) {
+      ((spsc_ring_rec_t *)(buf + (pos & mask)))->size = spsc_ring_wrap;
+      pos += room;
+    }
+    auto *rec = (spsc_ring_rec_t *)(buf + (pos & mask));
+    rec->size = data.size();
+    rec->stream = stream;
+    rec->ordinal = ordinal;
+    rec->ts = ts;
+    memcpy(rec + 1, data.data(), data.size());
+    written = pos + need;
+    return true;
+  }
+
+  // Producer, makes the message written last visible to the consumer
+  void publish() {
+    head = written;
+    __atomic_store_n(&hdr->head, head, __ATOMIC_RELEASE);
+  }
+
+  // Consumer, the next record or nullptr, valid until pop()
+  const spsc_ring_rec_t *peek() {
+    if (tail == head) {
+      head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+      if (tail == head)
+        return nullptr;
+    }
+    auto *rec = (const spsc_ring_rec_t *)(buf + (tail & mask));
+    if (rec->size == spsc_ring_wrap) {
+      tail += hdr->capacity - (tail & mask);
+      return peek();
+    }
+    return rec;
+  }
+
+  // Consumer, releases the record returned by peek()
+  void pop() {
+    auto *rec = (const spsc_ring_rec_t *)(buf + (tail & mask));
+    tail += footprint(rec->size);
+    __atomic_store_n(&hdr->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  static size_t footprint(size_t sz) {
+    return (sizeof(spsc_ring_rec_t) + sz + 7) & ~(size_t)7;
+  }
+
+  spsc_ring_hdr_t *hdr = nullptr;
+  char *buf = nullptr;
+  size_t size = 0;
+  uint64_t mask = 0;
+  // cached positions, the own one is authoritative
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  uint64_t written = 0; // producer, end of the message written last
+  uint64_t dropped = 0; // messages that did not fit
+};
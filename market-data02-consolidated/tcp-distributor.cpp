@@ -0,0 +1,500 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <fmc++/error.hpp>
+#include <fmc++/logger.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/time.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+
+#include "tcp-distributor.hpp"
+
+using namespace std;
+
+/* selection state of a source stream for a subscriber */
+enum : uint8_t {
+  STREAM_SKIPPED = 0,
+  STREAM_SELECTED = 1,  /* not announced to the subscriber yet */
+  STREAM_ANNOUNCED = 2,
+};
+
+/* period of the slow subscriber check */
+static constexpr int64_t lag_period = 1000000000LL;
+
+/* frames of a batch are built here, it is never reallocated */
+static constexpr size_t scratch_size = 64 << 10;
+
+tcp_distributor_t::tcp_distributor_t(ytp_yamal_t *yamal,
+                                     tcp_distributor_cfg_t c,
+                                     fmc_error_t **error)
+    : yamal(yamal), cfg(std::move(c)) {
+  fmc_error_clear(error);
+  struct sockaddr_in addr;
+  RETURN_ERROR_UNLESS(dist_sockaddr_parse(cfg.address, cfg.port, &addr),
+                      error, , "invalid address", cfg.address);
+  fd = dist_socket(SOCK_STREAM);
+  RETURN_ERROR_UNLESS(fd != -1, error, , "could not create socket:",
+                      strerror(errno));
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+  RETURN_ERROR_UNLESS(bind(fd, (struct sockaddr *)&addr, sizeof addr) == 0,
+                      error, , "could not bind to", cfg.address, cfg.port,
+                      ":", strerror(errno));
+  RETURN_ERROR_UNLESS(listen(fd, SOMAXCONN) == 0, error, ,
+                      "could not listen:", strerror(errno));
+  socklen_t len = sizeof addr;
+  getsockname(fd, (struct sockaddr *)&addr, &len);
+  port = ntohs(addr.sin_port);
+  head = ytp_data_begin(yamal, error);
+  RETURN_ON_ERROR(error, , "could not obtain iterator");
+}
+
+tcp_distributor_t::~tcp_distributor_t() {
+  for (auto &sub : subs) {
+    if (sub->fd != -1)
+      close(sub->fd);
+  }
+  if (fd != -1)
+    close(fd);
+}
+
+void tcp_distributor_t::disconnect(subscriber_t &sub, const char *reason) {
+  fmc::notice("subscriber", sub.name, "disconnected,", reason);
+  close(sub.fd);
+  sub.fd = -1;
+}
+
+bool tcp_distributor_t::read_request(subscriber_t &sub, fmc_error_t **error) {
+  fmc_error_clear(error);
+  char buf[512];
+  auto n = recv(sub.fd, buf, sizeof buf, MSG_DONTWAIT);
+  if (n == 0) {
+    disconnect(sub, "closed before the request");
+    return false;
+  }
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return true;
+    disconnect(sub, strerror(errno));
+    return false;
+  }
+  sub.request.append(buf, n);
+  auto nl = sub.request.find('\n');
+  if (nl == string::npos) {
+    if (sub.request.size() <= dist_request_max)
+      return true;
+    disconnect(sub, "request is too long");
+    return false;
+  }
+
+  istringstream line(sub.request.substr(0, nl));
+  string from;
+  line >> from;
+  for (string prefix; line >> prefix;)
+    sub.prefixes.push_back(move(prefix));
+  if (from == "start") {
+    sub.it = ytp_data_begin(yamal, error);
+  } else if (from == "end") {
+    sub.it = ytp_data_end(yamal, error);
+  } else {
+    auto [offset, parsed] = fmc::from_string_view<uint64_t>(from);
+    if (from.empty() || parsed.size() != from.size()) {
+      disconnect(sub, "request does not start with start, end or an offset");
+      return false;
+    }
+    // the offset is that of the last message the subscriber received, so
+    // it resumes with the one after it, 0 or an offset past the messages
+    // read by the distributor cannot be a message it sent
+    if (!offset || offset > head_offset) {
+      disconnect(sub, "requested offset is not that of a message sent");
+      return false;
+    }
+    sub.it = ytp_data_seek(yamal, offset, error);
+    if (!*error)
+      sub.it = ytp_yamal_next(yamal, sub.it, error);
+  }
+  RETURN_ON_ERROR(error, false, "could not position subscriber", sub.name);
+  sub.active = true;
+  fmc::notice("subscriber", sub.name, "requested", sub.request.substr(0, nl));
+  return true;
+}
+
+bool tcp_distributor_t::selected(subscriber_t &sub, ytp_mmnode_offs stream,
+                                 fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto where = sub.streams.find(stream);
+  if (where != sub.streams.end())
+    return where->second != STREAM_SKIPPED;
+
+  uint64_t seqno;
+  size_t psz, csz, esz;
+  const char *peer, *channel, *encoding;
+  ytp_mmnode_offs *original, *subscribed;
+  ytp_announcement_lookup(yamal, stream, &seqno, &psz, &peer, &csz, &channel,
+                          &esz, &encoding, &original, &subscribed, error);
+  RETURN_ON_ERROR(error, false, "could not look up stream announcement");
+  string_view sv{channel, csz};
+  auto match = [sv](auto &prefix) { return fmc::starts_with(sv, prefix); };
+  bool sel = sub.prefixes.empty() ||
+             any_of(sub.prefixes.begin(), sub.prefixes.end(), match);
+  sub.streams.emplace(stream, sel ? STREAM_SELECTED : STREAM_SKIPPED);
+  return sel;
+}
+
+// appends to the frames of the batch, contiguous scratch is sent as one
+static void add_iov(tcp_distributor_t::subscriber_t &sub, const char *base,
+                    size_t len) {
+  if (!sub.iov.empty()) {
+    auto &last = sub.iov.back();
+    if ((char *)last.iov_base + last.iov_len == base) {
+      last.iov_len += len;
+      return;
+    }
+  }
+  sub.iov.push_back({(void *)base, len});
+}
+
+static const char *add_scratch(tcp_distributor_t::subscriber_t &sub,
+                               const void *data, size_t len) {
+  auto *dst = sub.scratch.data() + sub.scratch.size();
+  sub.scratch.insert(sub.scratch.end(), (const char *)data,
+                     (const char *)data + len);
+  add_iov(sub, dst, len);
+  return dst;
+}
+
+bool tcp_distributor_t::send(subscriber_t &sub, fmc_error_t **error) {
+  fmc_error_clear(error);
+  if (sub.iov_pos == sub.iov.size()) {
+    // the previous batch is out, build the next one
+    sub.iov.clear();
+    sub.iov_pos = 0;
+    sub.scratch.clear();
+    size_t batched = 0;
+    while (batched < cfg.batch && !ytp_yamal_term(sub.it) &&
+           sub.iov.size() + 3 <= IOV_MAX) {
+      uint64_t seqno;
+      int64_t ts;
+      ytp_mmnode_offs stream;
+      size_t sz;
+      const char *data;
+      ytp_data_read(yamal, sub.it, &seqno, &ts, &stream, &sz, &data, error);
+      RETURN_ON_ERROR(error, false, "could not read data");
+      bool sel = selected(sub, stream, error);
+      if (*error)
+        return false;
+      if (sel) {
+        auto &state = sub.streams[stream];
+        size_t psz = 0, csz = 0, esz = 0;
+        const char *peer = nullptr, *channel = nullptr, *encoding = nullptr;
+        if (state == STREAM_SELECTED) {
+          uint64_t aseqno;
+          ytp_mmnode_offs *original, *subscribed;
+          ytp_announcement_lookup(yamal, stream, &aseqno, &psz, &peer, &csz,
+                                  &channel, &esz, &encoding, &original,
+                                  &subscribed, error);
+          RETURN_ON_ERROR(error, false, "could not look up stream");
+        }
+        size_t ann = psz + csz + esz;
+        size_t need = sizeof(dist_frame_hdr_t) +
+                      (ann ? sizeof(dist_frame_hdr_t) +
+                                 sizeof(dist_announce_t) + ann
+                           : 0);
+        if (sub.scratch.size() + need > sub.scratch.capacity()) {
+          if (sub.iov.empty()) {
+            disconnect(sub, "announcement does not fit a batch");
+            return false;
+          }
+          break;
+        }
+        if (state == STREAM_SELECTED) {
+          dist_frame_hdr_t hdr = {};
+          hdr.size = sizeof(dist_announce_t) + ann;
+          hdr.type = (uint8_t)dist_frame_t::ANNOUNCE;
+          hdr.stream = stream;
+          dist_announce_t sizes = {(uint32_t)psz, (uint32_t)csz,
+                                   (uint32_t)esz};
+          add_scratch(sub, &hdr, sizeof hdr);
+          add_scratch(sub, &sizes, sizeof sizes);
+          add_scratch(sub, peer, psz);
+          add_scratch(sub, channel, csz);
+          add_scratch(sub, encoding, esz);
+          state = STREAM_ANNOUNCED;
+        }
+        dist_frame_hdr_t hdr = {};
+        hdr.size = sz;
+        hdr.type = (uint8_t)dist_frame_t::DATA;
+        hdr.stream = stream;
+        hdr.ts = ts;
+        hdr.offset = ytp_data_tell(yamal, sub.it, error);
+        RETURN_ON_ERROR(error, false, "could not obtain offset");
+        add_scratch(sub, &hdr, sizeof hdr);
+        add_iov(sub, data, sz);
+        ++messages;
+        bytes += sz;
+      }
+      batched += sz + sizeof(dist_frame_hdr_t);
+      sub.it = ytp_yamal_next(yamal, sub.it, error);
+      RETURN_ON_ERROR(error, false, "could not obtain next iterator");
+    }
+  }
+  if (sub.iov_pos == sub.iov.size())
+    return true;
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof msg);
+  msg.msg_iov = sub.iov.data() + sub.iov_pos;
+  msg.msg_iovlen = sub.iov.size() - sub.iov_pos;
+  auto n = sendmsg(sub.fd, &msg, MSG_DONTWAIT | dist_send_flags);
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return true;
+    disconnect(sub, strerror(errno));
+    return false;
+  }
+  // a partial send resumes from the first frame not fully sent
+  for (size_t left = n; left;) {
+    auto &iov = sub.iov[sub.iov_pos];
+    if (left < iov.iov_len) {
+      iov.iov_base = (char *)iov.iov_base + left;
+      iov.iov_len -= left;
+      break;
+    }
+    left -= iov.iov_len;
+    ++sub.iov_pos;
+  }
+  return true;
+}
+
+void tcp_distributor_t::poll(fmc_error_t **error) {
+  fmc_error_clear(error);
+  // the subscribers are disconnected by how far they are from the end
+  while (!ytp_yamal_term(head)) {
+    head_offset = ytp_data_tell(yamal, head, error);
+    RETURN_ON_ERROR(error, , "could not obtain offset");
+    head = ytp_yamal_next(yamal, head, error);
+    RETURN_ON_ERROR(error, , "could not obtain next iterator");
+  }
+
+  for (;;) {
+    struct sockaddr_in addr;
+    int cfd = dist_accept(fd, &addr);
+    if (cfd == -1)
+      break;
+    int on = 1;
+    setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    auto sub = make_unique<subscriber_t>();
+    sub->fd = cfd;
+    char name[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &addr.sin_addr, name, sizeof name);
+    sub->name = string(name) + ":" + to_string(ntohs(addr.sin_port));
+    sub->scratch.reserve(scratch_size);
+    fmc::notice("subscriber", sub->name, "connected");
+    subs.push_back(move(sub));
+  }
+
+  if (auto now = fmc_cur_time_ns(); now >= lag_check) {
+    lag_check = now + lag_period;
+    for (auto &sub : subs) {
+      if (!sub->active)
+        continue;
+      uint64_t lag = 0;
+      if (!ytp_yamal_term(sub->it)) {
+        lag = head_offset - ytp_data_tell(yamal, sub->it, error);
+        RETURN_ON_ERROR(error, , "could not obtain offset");
+      }
+      // far behind is fine while catching up, not while falling behind
+      if (lag > cfg.max_lag && lag > sub->lag) {
+        ++slow;
+        disconnect(*sub, "too slow");
+      }
+      sub->lag = lag;
+    }
+  }
+
+  for (auto &sub : subs) {
+    if (sub->fd == -1)
+      continue;
+    if (!sub->active)
+      read_request(*sub, error);
+    else
+      send(*sub, error);
+    if (*error)
+      return;
+  }
+  subs.erase(remove_if(subs.begin(), subs.end(),
+                       [](auto &sub) { return sub->fd == -1; }),
+             subs.end());
+}
+
+/* time between connection attempts of the receiver */
+static constexpr int64_t receiver_retry = 1000000000LL;
+/* initial receive buffer, grown for larger messages */
+static constexpr size_t receiver_buffer = 1 << 20;
+
+tcp_receiver_t::tcp_receiver_t(ytp_yamal_t *yamal, tcp_receiver_cfg_t c,
+                               fmc_error_t **error)
+    : yamal(yamal), cfg(std::move(c)), buf(receiver_buffer) {
+  fmc_error_clear(error);
+  struct sockaddr_in addr;
+  RETURN_ERROR_UNLESS(dist_sockaddr_parse(cfg.address, cfg.port, &addr),
+                      error, , "invalid address", cfg.address);
+  RETURN_ERROR_UNLESS(cfg.from == "start" || cfg.from == "end", error, ,
+                      "from must be start or end");
+  ystreams = ytp_streams_new(yamal, error);
+  RETURN_ON_ERROR(error, , "could not create streams");
+}
+
+tcp_receiver_t::~tcp_receiver_t() {
+  fmc_error_t *error = nullptr;
+  if (fd != -1)
+    close(fd);
+  if (ystreams)
+    ytp_streams_del(ystreams, &error);
+}
+
+void tcp_receiver_t::disconnect(const char *reason) {
+  fmc::notice("receiver disconnected from", cfg.address, cfg.port, ",",
+              reason);
+  close(fd);
+  fd = -1;
+  connecting = false;
+  used = 0;
+  // the streams are announced again on the next connection
+  streams.clear();
+  retry = fmc_cur_time_ns() + receiver_retry;
+  ++reconnects;
+}
+
+void tcp_receiver_t::connect(fmc_error_t **error) {
+  fmc_error_clear(error);
+  struct sockaddr_in addr;
+  dist_sockaddr_parse(cfg.address, cfg.port, &addr);
+  fd = dist_socket(SOCK_STREAM);
+  RETURN_ERROR_UNLESS(fd != -1, error, , "could not create socket:",
+                      strerror(errno));
+  if (::connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0 &&
+      errno != EINPROGRESS) {
+    disconnect(strerror(errno));
+    return;
+  }
+  connecting = true;
+}
+
+size_t tcp_receiver_t::process(const char *data, size_t sz,
+                               fmc_error_t **error) {
+  fmc_error_clear(error);
+  size_t pos = 0;
+  dist_frame_hdr_t hdr;
+  while (sz - pos >= sizeof hdr) {
+    memcpy(&hdr, data + pos, sizeof hdr);
+    if (sz - pos - sizeof hdr < hdr.size)
+      break;
+    const char *payload = data + pos + sizeof hdr;
+    if (hdr.type == (uint8_t)dist_frame_t::ANNOUNCE) {
+      dist_announce_t sizes;
+      RETURN_ERROR_UNLESS(hdr.size >= sizeof sizes, error, pos,
+                          "invalid announcement");
+      memcpy(&sizes, payload, sizeof sizes);
+      RETURN_ERROR_UNLESS((uint64_t)sizes.peer + sizes.channel +
+                                  sizes.encoding + sizeof sizes ==
+                              hdr.size,
+                          error, pos, "invalid announcement");
+      const char *peer = payload + sizeof sizes;
+      const char *channel = peer + sizes.peer;
+      const char *encoding = channel + sizes.channel;
+      auto stream =
+          ytp_streams_announce(ystreams, sizes.peer, peer, sizes.channel,
+                               channel, sizes.encoding, encoding, error);
+      RETURN_ON_ERROR(error, pos, "could not announce stream");
+      streams[hdr.stream] = stream;
+    } else if (hdr.type == (uint8_t)dist_frame_t::DATA) {
+      auto where = streams.find(hdr.stream);
+      RETURN_ERROR_UNLESS(where != streams.end(), error, pos,
+                          "data received on a stream not announced");
+      auto *dst = ytp_data_reserve(yamal, hdr.size, error);
+      RETURN_ON_ERROR(error, pos, "could not reserve message");
+      memcpy(dst, payload, hdr.size);
+      ytp_data_commit(yamal, hdr.ts, where->second, dst, error);
+      RETURN_ON_ERROR(error, pos, "could not commit message");
+      offset = hdr.offset;
+      received = true;
+      ++messages;
+    } else {
+      RETURN_ERROR(error, pos, "invalid frame type", (int)hdr.type);
+    }
+    pos += sizeof hdr + hdr.size;
+  }
+  // make room for a frame larger than the buffer
+  if (sz - pos >= sizeof hdr && sizeof hdr + hdr.size > buf.size())
+    buf.resize(sizeof hdr + hdr.size);
+  return pos;
+}
+
+void tcp_receiver_t::poll(fmc_error_t **error) {
+  fmc_error_clear(error);
+  if (fd == -1) {
+    if (fmc_cur_time_ns() >= retry)
+      connect(error);
+    return;
+  }
+  if (connecting) {
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    if (::poll(&pfd, 1, 0) <= 0)
+      return;
+    int err = 0;
+    socklen_t len = sizeof err;
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err) {
+      disconnect(strerror(err));
+      return;
+    }
+    connecting = false;
+    // continue after the last message received before a reconnection
+    string request = received ? to_string(offset) : cfg.from;
+    for (auto &prefix : cfg.prefixes) {
+      request.push_back(' ');
+      request.append(prefix);
+    }
+    request.push_back('\n');
+    if (::send(fd, request.data(), request.size(), dist_send_flags) !=
+        (ssize_t)request.size()) {
+      disconnect("could not send the request");
+      return;
+    }
+    fmc::notice("receiver connected to", cfg.address, cfg.port);
+  }
+  auto n = recv(fd, buf.data() + used, buf.size() - used, MSG_DONTWAIT);
+  if (n == 0) {
+    disconnect("closed by the distributor");
+    return;
+  }
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      disconnect(strerror(errno));
+    return;
+  }
+  used += n;
+  auto done = process(buf.data(), used, error);
+  if (*error)
+    return;
+  memmove(buf.data(), buf.data() + done, used - done);
+  used -= done;
+}
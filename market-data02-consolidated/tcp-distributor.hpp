@@ -0,0 +1,227 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fmc/error.h>
+#include <ytp/streams.h>
+#include <ytp/yamal.h>
+
+/*
+ * TCP distribution of a yamal file. A subscriber connects to the
+ * distributor and sends one request line,
+ *
+ *   FROM [PREFIX ...]\n
+ *
+ * where FROM is start, end, or the source offset of the last message it
+ * has, to continue after it, and the prefixes select the channels, all of
+ * them if there are none. The distributor then streams frames, the
+ * announcement of every selected stream before its first message and the
+ * data messages in file order. Fields are little endian.
+ */
+enum class dist_frame_t : uint8_t {
+  ANNOUNCE = 'A', /* payload is dist_announce_t, peer, channel, encoding */
+  DATA = 'D',     /* payload is the message */
+};
+
+struct dist_frame_hdr_t {
+  uint32_t size; /* payload bytes following the header */
+  uint8_t type;  /* dist_frame_t */
+  uint8_t pad[3];
+  uint64_t stream; /* stream in the source file */
+  int64_t ts;      /* message time, DATA only */
+  uint64_t offset; /* offset of the message in the source file, DATA only */
+};
+
+struct dist_announce_t {
+  uint32_t peer;
+  uint32_t channel;
+  uint32_t encoding;
+};
+
+/* longest request line accepted */
+constexpr size_t dist_request_max = 4096;
+
+/* IPv4 address and port, false if the address is not valid */
+inline bool dist_sockaddr_parse(const std::string &address, int port,
+                                struct sockaddr_in *addr) {
+  memset(addr, 0, sizeof *addr);
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(port);
+  return inet_pton(AF_INET, address.c_str(), &addr->sin_addr) == 1;
+}
+
+/*
+ * Flags of the sends to peers. Where MSG_NOSIGNAL does not exist, such as
+ * on macOS, the sockets are set up with SO_NOSIGPIPE instead.
+ */
+#ifdef MSG_NOSIGNAL
+constexpr int dist_send_flags = MSG_NOSIGNAL;
+#else
+constexpr int dist_send_flags = 0;
+#endif
+
+/* makes a socket non blocking and never raising SIGPIPE */
+inline bool dist_socket_setup(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    return false;
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof on);
+#endif
+  return true;
+}
+
+/* non blocking IPv4 socket of type, -1 with errno set on error */
+inline int dist_socket(int type) {
+  int fd = socket(AF_INET, type, 0);
+  if (fd != -1 && !dist_socket_setup(fd)) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+/* accepts a connection as a non blocking socket, -1 if there is none */
+inline int dist_accept(int fd, struct sockaddr_in *addr) {
+  socklen_t len = sizeof *addr;
+  int cfd = accept(fd, (struct sockaddr *)addr, &len);
+  if (cfd != -1 && !dist_socket_setup(cfd)) {
+    close(cfd);
+    return -1;
+  }
+  return cfd;
+}
+
+struct tcp_distributor_cfg_t {
+  std::string address = "0.0.0.0";
+  int port = 0; /* 0 picks a free port */
+  /*
+   * source bytes a subscriber may be behind the end of the file, once per
+   * second a subscriber further behind than this and than at the last
+   * check is disconnected
+   */
+  uint64_t max_lag = 64ULL << 20;
+  /* source bytes sent to a subscriber at most per call to poll */
+  size_t batch = 256 << 10;
+};
+
+/*
+ * Streams the data of a yamal file to TCP subscribers. Every subscriber
+ * has its own cursor into the file, messages are sent straight from the
+ * file mapping, batched into one sendmsg per subscriber and poll. A
+ * subscriber that does not keep up only holds its cursor, until it is
+ * more than max_lag bytes behind the end of the file and falling further
+ * behind, then it is disconnected.
+ *
+ * Does not own the yamal, and is driven by calling poll(), which never
+ * blocks.
+ */
+struct tcp_distributor_t {
+  tcp_distributor_t(ytp_yamal_t *yamal, tcp_distributor_cfg_t cfg,
+                    fmc_error_t **error);
+  ~tcp_distributor_t();
+
+  /* accepts subscribers and sends each one the messages it is missing */
+  void poll(fmc_error_t **error);
+
+  struct subscriber_t {
+    int fd = -1;
+    std::string name; /* address of the peer */
+    std::string request;
+    bool active = false; /* the request has been received */
+    std::vector<std::string> prefixes;
+    ytp_iterator_t it = nullptr;
+    uint64_t lag = UINT64_MAX; /* source bytes behind at the last check */
+    /* whether each source stream is selected and has been announced */
+    std::unordered_map<ytp_mmnode_offs, uint8_t> streams;
+    /* frames being sent, pointing into scratch and the file mapping */
+    std::vector<struct iovec> iov;
+    size_t iov_pos = 0;
+    std::vector<char> scratch;
+  };
+
+  bool read_request(subscriber_t &sub, fmc_error_t **error);
+  bool selected(subscriber_t &sub, ytp_mmnode_offs stream,
+                fmc_error_t **error);
+  /* returns false if the subscriber has to be disconnected */
+  bool send(subscriber_t &sub, fmc_error_t **error);
+  void disconnect(subscriber_t &sub, const char *reason);
+
+  ytp_yamal_t *yamal = nullptr;
+  tcp_distributor_cfg_t cfg;
+  int fd = -1;
+  int port = 0; /* port we listen on */
+  std::vector<std::unique_ptr<subscriber_t>> subs;
+  ytp_iterator_t head = nullptr; /* last message of the file */
+  uint64_t head_offset = 0;
+  int64_t lag_check = 0; /* time of the next slow subscriber check */
+
+  uint64_t messages = 0; /* data messages sent, over all subscribers */
+  uint64_t bytes = 0;
+  uint64_t slow = 0; /* subscribers disconnected for falling behind */
+};
+
+struct tcp_receiver_cfg_t {
+  std::string address = "127.0.0.1";
+  int port = 0;
+  std::string from = "start"; /* start or end, for the first connection */
+  std::vector<std::string> prefixes;
+};
+
+/*
+ * Subscribes to a tcp distributor and writes what it receives into a
+ * local yamal, announcing the streams with the peer, channel and encoding
+ * of the source. Reconnects after a second when the connection is lost,
+ * continuing after the last message received.
+ */
+struct tcp_receiver_t {
+  tcp_receiver_t(ytp_yamal_t *yamal, tcp_receiver_cfg_t cfg,
+                 fmc_error_t **error);
+  ~tcp_receiver_t();
+
+  /* reads what is available and commits the complete messages */
+  void poll(fmc_error_t **error);
+
+  void connect(fmc_error_t **error);
+  void disconnect(const char *reason);
+  /* returns the bytes of buf used by the frames */
+  size_t process(const char *buf, size_t sz, fmc_error_t **error);
+
+  ytp_yamal_t *yamal = nullptr;
+  ytp_streams_t *ystreams = nullptr;
+  tcp_receiver_cfg_t cfg;
+  int fd = -1;
+  bool connecting = false;
+  int64_t retry = 0; /* time of the next connection attempt */
+  bool received = false;
+  uint64_t offset = 0; /* source offset of the last message */
+  std::unordered_map<uint64_t, ytp_mmnode_offs> streams;
+  std::vector<char> buf;
+  size_t used = 0;
+
+  uint64_t messages = 0;
+  uint64_t reconnects = 0;
+};
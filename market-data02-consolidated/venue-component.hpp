@@ -0,0 +1,375 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+ *****************************************************************************/
+
+#pragma once
+
+#include <libwebsockets.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+
+#include <fmc++/error.hpp>
+#include <fmc/component.h>
+#include <fmc/config.h>
+#include <fmc/files.h>
+#include <ytp/yamal.h>
+
+#include "feed-engine.hpp"
+
+extern struct fmc_reactor_api_v1 *_reactor;
+
+/*
+ * Feed handler component of a venue, publishes the venue streams on the
+ * channels raw/NAME/SEC@TYPE of ytp-file
+ */
+template <const venue_t &Venue> struct venue_component_t {
+  fmc_component_HEAD;
+  fmc_fd fd = -1;
+  ytp_yamal_t *yamal = nullptr;
+  std::unique_ptr<yamal_pager_t> pager;
+  std::unique_ptr<feed_engine_t> engine;
+
+  venue_component_t(struct fmc_cfg_sect_item *cfg) {
+    using namespace std;
+
+    fmc_error_t *error = nullptr;
+
+    lwsl_user("%s feed handler\n", Venue.name);
+
+    feed_engine_cfg_t ecfg;
+    ecfg.peer = fmc_cfg_sect_item_get(cfg, "peer")->node.value.str;
+    ecfg.prefix = string("raw/") + Venue.name + "/";
+    if (auto usregion = fmc_cfg_sect_item_get(cfg, "us-region"); usregion)
+      ecfg.us_region = usregion->node.value.boolean;
+    if (auto control = fmc_cfg_sect_item_get(cfg, "control"); control)
+      ecfg.control = control->node.value.str;
+    if (auto ctlfile = fmc_cfg_sect_item_get(cfg, "control-file"); ctlfile)
+      ecfg.control_file = ctlfile->node.value.str;
+    if (auto endpoint = fmc_cfg_sect_item_get(cfg, "endpoint"); endpoint)
+      ecfg.endpoint = endpoint->node.value.str;
+    if (auto deflate = fmc_cfg_sect_item_get(cfg, "deflate"); deflate)
+      ecfg.deflate = deflate->node.value.boolean;
+    if (auto takeover = fmc_cfg_sect_item_get(cfg, "deflate-server-takeover");
+        takeover)
+      ecfg.server_context_takeover = takeover->node.value.boolean;
+    if (auto takeover = fmc_cfg_sect_item_get(cfg, "deflate-client-takeover");
+        takeover)
+      ecfg.client_context_takeover = takeover->node.value.boolean;
+    if (auto bits = fmc_cfg_sect_item_get(cfg, "deflate-window-bits"); bits)
+      ecfg.server_window_bits = bits->node.value.int64;
+    if (auto busypoll = fmc_cfg_sect_item_get(cfg, "busy-poll"); busypoll)
+      ecfg.busy_poll_us = busypoll->node.value.int64;
+    if (auto rcvbuf = fmc_cfg_sect_item_get(cfg, "rcvbuf"); rcvbuf)
+      ecfg.rcvbuf = rcvbuf->node.value.int64;
+    if (auto nodelay = fmc_cfg_sect_item_get(cfg, "nodelay"); nodelay)
+      ecfg.nodelay = nodelay->node.value.boolean;
+    if (auto quickack = fmc_cfg_sect_item_get(cfg, "quickack"); quickack)
+      ecfg.quickack = quickack->node.value.boolean;
+    if (auto ts = fmc_cfg_sect_item_get(cfg, "timestamping"); ts)
+      fmc_runtime_error_unless(
+          rx_timestamps_parse(ts->node.value.str, &ecfg.timestamping))
+          << "timestamping must be none, software or hardware, not "
+          << ts->node.value.str;
+    if (auto index = fmc_cfg_sect_item_get(cfg, "index-file"); index)
+      ecfg.index = index->node.value.str;
+    if (auto ring = fmc_cfg_sect_item_get(cfg, "ring-file"); ring)
+      ecfg.ring = ring->node.value.str;
+    if (auto size = fmc_cfg_sect_item_get(cfg, "ring-size"); size) {
+      fmc_runtime_error_unless(size->node.value.int64 > 0 &&
+                               (uint64_t)size->node.value.int64 <=
+                                   spsc_ring_capacity_max)
+          << "ring-size must be positive and at most "
+          << spsc_ring_capacity_max << " bytes";
+      ecfg.ring_size = size->node.value.int64;
+    }
+    yamal_pager_cfg_t pcfg;
+    if (auto prefault = fmc_cfg_sect_item_get(cfg, "prefault"); prefault) {
+      fmc_runtime_error_unless(prefault->node.value.int64 >= 0)
+          << "prefault must not be negative";
+      pcfg.prefault = prefault->node.value.int64;
+    }
+    if (auto huge = fmc_cfg_sect_item_get(cfg, "hugepages"); huge)
+      pcfg.hugepages = huge->node.value.boolean;
+    if (auto lock = fmc_cfg_sect_item_get(cfg, "mlock"); lock)
+      pcfg.mlock = lock->node.value.boolean;
+
+    auto *ytpfile = fmc_cfg_sect_item_get(cfg, "ytp-file")->node.value.str;
+    fd = fmc_fopen(ytpfile, fmc_fmode::READWRITE, &error);
+    fmc_runtime_error_unless(!error) << "could not open file " << ytpfile
+                                     << " with error " << fmc_error_msg(error);
+    yamal = ytp_yamal_new(fd, &error);
+    fmc_runtime_error_unless(!error)
+        << "could not create yamal with error " << fmc_error_msg(error);
+
+    if (pcfg.enabled()) {
+      pager = make_unique<yamal_pager_t>(fd, pcfg, &error);
+      fmc_runtime_error_unless(!error)
+          << "could not create pager with error " << fmc_error_msg(error);
+      pager->start();
+      ecfg.pager = pager.get();
+    }
+
+    engine = make_unique<feed_engine_t>(Venue, yamal, move(ecfg), &error);
+    fmc_runtime_error_unless(!error)
+        << "could not create " << Venue.name
+        << " feed handler with error " << fmc_error_msg(error);
+
+    // load securities from the configuration
+    for (auto *item = fmc_cfg_sect_item_get(cfg, "securities")->node.value.arr;
+         item; item = item->next) {
+      engine->subscribe(item->item.value.str, &error);
+      fmc_runtime_error_unless(!error)
+          << "could not subscribe to " << item->item.value.str
+          << " with error " << fmc_error_msg(error);
+    }
+
+    struct lws_context_creation_info info;
+    memset(&info, 0, sizeof info);
+    engine->start(info, &error);
+    fmc_runtime_error_unless(!error)
+        << "could not start " << Venue.name << " feed handler with error "
+        << fmc_error_msg(error);
+  }
+  bool process_one() {
+    fmc_runtime_error_unless(!engine->interrupted)
+        << Venue.name << " feed handler has been interrupted";
+    // the pager runs on its own thread, only its failure is reported here
+    std::string msg;
+    fmc_runtime_error_unless(!pager || !pager->failed(&msg))
+        << Venue.name << " feed handler pager failed with error " << msg;
+    return engine->service(-1);
+  }
+  ~venue_component_t() {
+    engine.reset();
+    pager.reset();
+
+    fmc_error_t *error = nullptr;
+    if (yamal)
+      ytp_yamal_del(yamal, &error);
+    if (fd != -1)
+      fmc_fclose(fd, &error);
+
+    lwsl_user("Completed\n");
+  }
+
+  static void component_process_one(struct fmc_component *self,
+                                    struct fmc_reactor_ctx *ctx,
+                                    fmc_time64_t now) noexcept {
+    auto *comp = (venue_component_t *)self;
+    try {
+      if (comp->process_one())
+        _reactor->queue(ctx);
+      else
+        _reactor->set_error(ctx, "%s feed handler has stopped", Venue.name);
+    } catch (std::exception &e) {
+      _reactor->set_error(ctx, "%s", e.what());
+    }
+  }
+
+  static venue_component_t *component_new(struct fmc_cfg_sect_item *cfg,
+                                          struct fmc_reactor_ctx *ctx,
+                                          char **inp_tps) noexcept {
+    venue_component_t *comp = nullptr;
+    try {
+      comp = new venue_component_t(cfg);
+      _reactor->on_exec(ctx, component_process_one);
+      _reactor->queue(ctx);
+    } catch (std::exception &e) {
+      _reactor->set_error(ctx, "%s", e.what());
+    }
+    return comp;
+  }
+
+  static void component_del(venue_component_t *comp) noexcept {
+    delete comp;
+  }
+};
+
+inline struct fmc_cfg_type venue_security_spec = {
+    .type = FMC_CFG_STR,
+};
+
+inline struct fmc_cfg_node_spec venue_component_cfgspec[] = {
+    {.key = "securities",
+     .descr = "Securities for subscription",
+     .required = true,
+     .type = {.type = FMC_CFG_ARR,
+              .spec{
+                  .array = &venue_security_spec,
+              }}},
+    {.key = "peer",
+     .descr = "Feed handler peer name",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "ytp-file",
+     .descr = "Feed handler ytp-file name",
+     .required = true,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "us-region",
+     .descr = "Configure the feed handler to use US region URLs, only for "
+              "venues with a US endpoint",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "control",
+     .descr = "Channel with subscription commands for the feed handler",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "control-file",
+     .descr = "Yamal file of the control channel, required with control",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "endpoint",
+     .descr = "ws://HOST:PORT or wss://HOST:PORT to connect to instead of "
+              "the venue, e.g. a server replaying recorded frames",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "deflate",
+     .descr = "Negotiate permessage-deflate, true by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "deflate-server-takeover",
+     .descr = "Allow the server to keep its compression context across "
+              "messages, true by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "deflate-client-takeover",
+     .descr = "Keep the client compression context across requests, false "
+              "by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "deflate-window-bits",
+     .descr = "Maximum server compression window bits, 8 to 15",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "busy-poll",
+     .descr = "SO_BUSY_POLL of the socket in microseconds",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "rcvbuf",
+     .descr = "SO_RCVBUF of the socket in bytes",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "nodelay",
+     .descr = "Set TCP_NODELAY on the socket",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "quickack",
+     .descr = "Keep TCP_QUICKACK set on the socket",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "timestamping",
+     .descr = "Kernel receive timestamps, none, software or hardware",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "index-file",
+     .descr = "Sidecar index of the raw channels of ytp-file, for readers "
+              "of a few channels",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "ring-file",
+     .descr = "Shared memory ring the raw messages are also passed to the "
+              "feed parser through, e.g. /dev/shm/binance.ring",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_STR,
+         }},
+    {.key = "ring-size",
+     .descr = "Bytes of a ring created by the feed handler, 16MB by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "prefault",
+     .descr = "Bytes of ytp-file preallocated and faulted in ahead of the "
+              "feed handler, none by default",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_INT64,
+         }},
+    {.key = "hugepages",
+     .descr = "Advise huge pages for the pages of ytp-file ahead of the feed "
+              "handler, used for files on a tmpfs with huge pages enabled",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {.key = "mlock",
+     .descr = "Lock the pages of ytp-file around the feed handler in memory",
+     .required = false,
+     .type =
+         {
+             .type = FMC_CFG_BOOLEAN,
+         }},
+    {NULL},
+};
+
+/* component definition of a venue, for the components table of the module */
+template <const venue_t &Venue>
+struct fmc_component_def_v1 venue_component_def() {
+  using component_t = venue_component_t<Venue>;
+  return {
+      .tp_name = Venue.component,
+      .tp_descr = Venue.descr,
+      .tp_size = sizeof(component_t),
+      .tp_cfgspec = venue_component_cfgspec,
+      .tp_new = (fmc_newfunc)component_t::component_new,
+      .tp_del = (fmc_delfunc)component_t::component_del,
+  };
+}
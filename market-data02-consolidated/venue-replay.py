@@ -0,0 +1,59 @@
+"""
+        COPYRIGHT (c) 2019-2023 by Featuremine Corporation.
+        
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+"""
+
+"""
+Replays recorded websocket frames, one frame per line of the frames file,
+to every feed handler that connects, so that the venue components can be
+tested offline by pointing their endpoint to ws://127.0.0.1:PORT.
+"""
+
+import argparse
+import asyncio
+import websockets
+
+
+def load(path):
+    with open(path) as f:
+        return [line.rstrip('\n') for line in f if line.strip()]
+
+
+async def replay(ws, frames, args):
+    if args.wait:
+        # venues subscribing with requests send them once connected
+        print("request:", await ws.recv())
+    for i in range(args.loops):
+        for frame in frames:
+            await ws.send(frame)
+            if args.rate:
+                await asyncio.sleep(1.0 / args.rate)
+    print("replayed", len(frames) * args.loops, "frames")
+    # keep the session open until the feed handler disconnects
+    async for msg in ws:
+        print("request:", msg)
+
+
+async def main(args):
+    frames = load(args.frames)
+
+    async def handler(ws, *unused):
+        await replay(ws, frames, args)
+
+    async with websockets.serve(handler, args.host, args.port):
+        await asyncio.Future()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Recorded websocket frames replay server")
+    parser.add_argument("--frames", help="file with one recorded frame per line", required=True)
+    parser.add_argument("--host", help="address to listen on", default="127.0.0.1")
+    parser.add_argument("--port", help="port to listen on", type=int, default=9001)
+    parser.add_argument("--rate", help="frames per second, 0 for as fast as possible", type=float, default=0)
+    parser.add_argument("--loops", help="number of times the frames are replayed", type=int, default=1)
+    parser.add_argument("--wait", help="wait for the first request before replaying", action="store_true")
+    args = parser.parse_args()
+    asyncio.run(main(args))
@@ -0,0 +1,330 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <charconv>
+
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/time.h>
+#include <libwebsockets.h>
+
+#include "ws-server.hpp"
+
+using namespace std;
+
+/* period of the scan for the clients due for a message */
+static constexpr int64_t check_period = 1000000LL;
+
+/*
+ * bytes sent and not acknowledged by the peer yet, 0 where the kernel does
+ * not tell, which skips the check of max_queued
+ */
+static int unacked_bytes(int fd) {
+  int queued = 0;
+#ifdef SIOCOUTQ
+  if (ioctl(fd, SIOCOUTQ, &queued) != 0)
+    queued = 0;
+#endif
+  return queued;
+}
+
+/* lws session data, the client is owned by the server */
+struct ws_session_t {
+  ws_server_t::client_t *client;
+};
+
+static int callback_ws(struct lws *wsi, enum lws_callback_reasons reason,
+                       void *user, void *in, size_t len) {
+  auto *srv = (ws_server_t *)lws_context_user(lws_get_context(wsi));
+  auto *sess = (ws_session_t *)user;
+
+  switch (reason) {
+
+  case LWS_CALLBACK_ESTABLISHED: {
+    auto &c = srv->clients.emplace_back(make_unique<ws_server_t::client_t>());
+    c->wsi = wsi;
+    c->interval = srv->cfg.interval;
+    sess->client = c.get();
+  } break;
+
+  case LWS_CALLBACK_RECEIVE:
+    if (sess->client)
+      srv->command(*sess->client, string_view((const char *)in, len));
+    break;
+
+  case LWS_CALLBACK_SERVER_WRITEABLE:
+    if (sess->client)
+      return srv->write(*sess->client);
+    break;
+
+  case LWS_CALLBACK_CLOSED: {
+    auto &cs = srv->clients;
+    auto where = find_if(cs.begin(), cs.end(), [sess](auto &c) {
+      return c.get() == sess->client;
+    });
+    if (where != cs.end()) {
+      swap(*where, cs.back());
+      cs.pop_back();
+    }
+    sess->client = nullptr;
+  } break;
+
+  default:
+    break;
+  }
+
+  return lws_callback_http_dummy(wsi, reason, user, in, len);
+}
+
+/* clients not naming a protocol get the first one */
+static const struct lws_protocols protocols[] = {
+    {"ore-bbo", callback_ws, sizeof(ws_session_t), 4096, 0, NULL, 0},
+    LWS_PROTOCOL_LIST_TERM};
+
+ws_server_t::ws_server_t(ytp_yamal_t *yamal, ws_server_cfg_t c,
+                         fmc_error_t **error)
+    : yamal(yamal), cfg(move(c)) {
+  fmc_error_clear(error);
+  RETURN_ERROR_UNLESS(cfg.min_interval > 0 &&
+                          cfg.interval >= cfg.min_interval,
+                      error, , "interval must be at least the minimum "
+                      "interval, which must be positive");
+  ore_filter_t filter;
+  filter.prefix = cfg.prefix;
+  books = make_unique<ore_books_t>(yamal, move(filter), error);
+  RETURN_ON_ERROR(error, , "could not create books");
+
+  struct lws_context_creation_info info;
+  memset(&info, 0, sizeof info);
+  info.port = cfg.port;
+  info.iface = cfg.address.empty() ? nullptr : cfg.address.c_str();
+  info.protocols = protocols;
+  info.user = this;
+  context = lws_create_context(&info);
+  RETURN_ERROR_UNLESS(context, error, , "could not create websocket server "
+                      "on port", to_string(cfg.port));
+  auto *vhost = lws_get_vhost_by_name(context, "default");
+  port = vhost ? lws_get_vhost_listen_port(vhost) : cfg.port;
+  out.resize(LWS_PRE);
+}
+
+ws_server_t::~ws_server_t() {
+  if (context)
+    lws_context_destroy(context);
+}
+
+void ws_server_t::poll(fmc_error_t **error) {
+  fmc_error_clear(error);
+  books->poll(
+      [this](const ore_book_event_t &ev, const ore_book_t &book) {
+        on_bbo(ev, book);
+      },
+      [this](const ore_book_event_t &ev, const ore_trade_t &trd) {
+        on_trade(ev, trd);
+      },
+      error, cfg.batch);
+  RETURN_ON_ERROR(error, , "could not read ORE messages");
+
+  auto now = fmc_cur_time_ns();
+  if (now >= next_check) {
+    next_check = now + check_period;
+    for (auto &c : clients) {
+      if (c->writable || now < c->next || c->seen == version)
+        continue;
+      if (unacked_bytes(lws_get_socket_fd(c->wsi)) > cfg.max_queued)
+        continue;
+      c->writable = true;
+      lws_callback_on_writable(c->wsi);
+    }
+  }
+  RETURN_ERROR_UNLESS(lws_service(context, -1) >= 0, error, ,
+                      "could not service websocket clients");
+}
+
+ws_server_t::instrument_t &
+ws_server_t::instrument(const ore_book_event_t &ev) {
+  auto key = make_pair(ev.channel.data(), ev.imnt_id);
+  auto [where, added] = index.try_emplace(key, instruments.size());
+  if (added) {
+    auto &inst = instruments.emplace_back();
+    inst.channel = ev.channel;
+    inst.imnt_id = ev.imnt_id;
+  }
+  return instruments[where->second];
+}
+
+void ws_server_t::on_bbo(const ore_book_event_t &ev, const ore_book_t &book) {
+  auto &inst = instrument(ev);
+  inst.bid = book.bid();
+  inst.ask = book.ask();
+  inst.bbo_receive = ev.receive;
+  inst.bbo_version = ++version;
+  ++updates;
+}
+
+void ws_server_t::on_trade(const ore_book_event_t &ev,
+                           const ore_trade_t &trd) {
+  auto &inst = instrument(ev);
+  inst.trade = trd;
+  inst.trade_receive = ev.receive;
+  ++inst.trades;
+  inst.volume += trd.qty;
+  inst.trade_version = ++version;
+  ++updates;
+}
+
+bool ws_server_t::selected(client_t &c, size_t idx) {
+  if (c.instruments.size() < instruments.size())
+    c.instruments.resize(instruments.size());
+  auto &ci = c.instruments[idx];
+  if (ci.selected < 0) {
+    auto &inst = instruments[idx];
+    auto match = [&inst](const string &p) {
+      return fmc::starts_with(inst.channel, p);
+    };
+    ci.selected = c.prefixes.empty() ||
+                  any_of(c.prefixes.begin(), c.prefixes.end(), match);
+    // trades before the selection are not counted
+    ci.trades = inst.trades;
+    ci.volume = inst.volume;
+  }
+  return ci.selected;
+}
+
+void ws_server_t::command(client_t &c, string_view cmd) {
+  while (!cmd.empty() && (cmd.back() == '\n' || cmd.back() == '\r'))
+    cmd.remove_suffix(1);
+  auto sep = cmd.find(' ');
+  auto verb = cmd.substr(0, sep);
+  auto arg = sep == string_view::npos ? string_view() : cmd.substr(sep + 1);
+  if (verb == "subscribe") {
+    c.prefixes.emplace_back(arg);
+  } else if (verb == "unsubscribe") {
+    c.prefixes.erase(remove(c.prefixes.begin(), c.prefixes.end(), arg),
+                     c.prefixes.end());
+  } else if (verb == "interval") {
+    auto ms = strtoll(string(arg).c_str(), nullptr, 10);
+    c.interval = max<int64_t>(ms * 1000000LL, cfg.min_interval);
+    return;
+  } else {
+    return;
+  }
+  // the next message is a snapshot of the new selection
+  c.instruments.clear();
+  c.seen = 0;
+}
+
+static void append(string &out, int64_t val) {
+  char buf[24];
+  auto res = to_chars(buf, buf + sizeof buf, val);
+  out.append(buf, res.ptr);
+}
+
+/* shortest of 15 or 17 digits that reads back as the same double */
+static void append(string &out, double val) {
+  char buf[32];
+  auto sz = snprintf(buf, sizeof buf, "%.15g", val);
+  if (strtod(buf, nullptr) != val)
+    sz = snprintf(buf, sizeof buf, "%.17g", val);
+  out.append(buf, sz);
+}
+
+static void append(string &out, const ore_level_t &lvl) {
+  out += '[';
+  append(out, lvl.px);
+  out += ',';
+  append(out, lvl.qty);
+  out += ',';
+  append(out, (int64_t)lvl.orders);
+  out += ']';
+}
+
+/* channel and instrument id, channels are plain names without quotes */
+static void append_key(string &out, const ws_server_t::instrument_t &inst) {
+  out += "{\"channel\":\"";
+  out += inst.channel;
+  out += "\",\"imnt\":";
+  append(out, (int64_t)inst.imnt_id);
+}
+
+bool ws_server_t::build(client_t &c, int64_t now) {
+  out.resize(LWS_PRE);
+  out += "{\"time\":";
+  append(out, now);
+  out += ",\"bbo\":[";
+  size_t count = 0;
+  for (size_t i = 0; i < instruments.size(); ++i) {
+    auto &inst = instruments[i];
+    if (inst.bbo_version <= c.seen || !selected(c, i))
+      continue;
+    if (count++)
+      out += ',';
+    append_key(out, inst);
+    out += ",\"receive\":";
+    append(out, inst.bbo_receive);
+    out += ",\"bid\":";
+    append(out, inst.bid);
+    out += ",\"ask\":";
+    append(out, inst.ask);
+    out += '}';
+  }
+  out += "],\"trades\":[";
+  size_t bbos = count;
+  for (size_t i = 0; i < instruments.size(); ++i) {
+    auto &inst = instruments[i];
+    if (inst.trade_version <= c.seen || !selected(c, i))
+      continue;
+    auto &ci = c.instruments[i];
+    if (count++ > bbos)
+      out += ',';
+    append_key(out, inst);
+    out += ",\"receive\":";
+    append(out, inst.trade_receive);
+    out += ",\"px\":";
+    append(out, inst.trade.px);
+    out += ",\"qty\":";
+    append(out, inst.trade.qty);
+    out += ",\"side\":\"";
+    out += inst.trade.side == 1 ? "b" : inst.trade.side == 0 ? "a" : "";
+    out += "\",\"count\":";
+    append(out, (int64_t)(inst.trades - ci.trades));
+    out += ",\"volume\":";
+    append(out, inst.volume - ci.volume);
+    out += '}';
+    ci.trades = inst.trades;
+    ci.volume = inst.volume;
+  }
+  out += "]}";
+  c.seen = version;
+  return count;
+}
+
+int ws_server_t::write(client_t &c) {
+  c.writable = false;
+  auto now = fmc_cur_time_ns();
+  if (!build(c, now))
+    return 0;
+  auto sz = out.size() - LWS_PRE;
+  // lws keeps what the socket does not take and only calls back writable
+  // once it is sent, so at most one message is pending per client
+  if (lws_write(c.wsi, (unsigned char *)out.data() + LWS_PRE, sz,
+                LWS_WRITE_TEXT) < (int)sz)
+    return -1;
+  c.next = now + c.interval;
+  ++c.messages;
+  ++messages;
+  bytes += sz;
+  return 0;
+}
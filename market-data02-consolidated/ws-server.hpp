@@ -0,0 +1,143 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmc/alignment.h>
+#include <fmc/error.h>
+#include <ytp/yamal.h>
+
+#include "ore-book.hpp"
+
+struct lws;
+struct lws_context;
+
+struct ws_instrument_hash {
+  size_t operator()(const std::pair<const char *, int32_t> &key) const {
+    return fmc_hash_combine(std::hash<const char *>{}(key.first),
+                            std::hash<int32_t>{}(key.second));
+  }
+};
+
+struct ws_server_cfg_t {
+  std::string address; /* interface name or address, all if empty */
+  int port = 0;        /* 0 picks a free port */
+  std::string prefix = "ore/";       /* ORE channels served */
+  int64_t interval = 100000000LL;    /* default time between updates */
+  int64_t min_interval = 10000000LL; /* shortest interval a client sets */
+  int max_queued = 1 << 16; /* bytes in the socket of a client */
+  size_t batch = 4096;      /* yamal messages read per poll */
+};
+
+/*
+ * Serves the top of the book and the trades of the ORE channels of a
+ * yamal file to websocket clients, such as browser dashboards, as JSON
+ * text messages:
+ *
+ * {"time":NS,"bbo":[{"channel":C,"imnt":I,"receive":NS,
+ *   "bid":[PX,QTY,ORDERS],"ask":[PX,QTY,ORDERS]}],
+ *  "trades":[{"channel":C,"imnt":I,"receive":NS,"px":PX,"qty":QTY,
+ *   "side":"b"|"a"|"","count":N,"volume":V}]}
+ *
+ * Updates are conflated per client. A client gets at most one message per
+ * interval with the latest state of the instruments that changed since
+ * its previous message, px and qty of a trade being the last trade and
+ * count and volume the trades since then, so the first message is a
+ * snapshot of every instrument. A new message is only built once the
+ * previous one was written to the socket and the kernel holds less than
+ * max_queued bytes for the client, so a slow client receives less frequent
+ * updates of the latest state instead of a growing queue. The kernel queue
+ * is only checked on Linux, through SIOCOUTQ.
+ *
+ * Clients receive every instrument until they send commands as text
+ * messages:
+ *   subscribe PREFIX    instruments of the channels starting with PREFIX
+ *   unsubscribe PREFIX
+ *   interval MS         time between updates, at least min_interval
+ *
+ * Does not own the yamal, and is driven by calling poll(), which never
+ * blocks.
+ */
+struct ws_server_t {
+  ws_server_t(ytp_yamal_t *yamal, ws_server_cfg_t cfg, fmc_error_t **error);
+  ~ws_server_t();
+
+  /* applies the new ORE messages and serves the clients */
+  void poll(fmc_error_t **error);
+
+  struct instrument_t {
+    std::string channel;
+    int32_t imnt_id = 0;
+    ore_level_t bid;
+    ore_level_t ask;
+    int64_t bbo_receive = 0;
+    uint64_t bbo_version = 0;
+    ore_trade_t trade;
+    int64_t trade_receive = 0;
+    uint64_t trades = 0;
+    double volume = 0.0;
+    uint64_t trade_version = 0;
+  };
+
+  struct client_t {
+    struct lws *wsi = nullptr;
+    std::vector<std::string> prefixes; /* all instruments if empty */
+    int64_t interval = 0;
+    int64_t next = 0;      /* earliest time of the next message */
+    uint64_t seen = 0;     /* version of the previous message */
+    bool writable = false; /* waiting for the socket */
+    struct instrument_t {
+      int8_t selected = -1; /* not known yet */
+      uint64_t trades = 0;  /* at the previous message */
+      double volume = 0.0;
+    };
+    std::vector<instrument_t> instruments;
+    uint64_t messages = 0;
+  };
+
+  /* port the server listens on */
+  int port = 0;
+
+  void on_bbo(const ore_book_event_t &ev, const ore_book_t &book);
+  void on_trade(const ore_book_event_t &ev, const ore_trade_t &trd);
+  instrument_t &instrument(const ore_book_event_t &ev);
+  bool selected(client_t &c, size_t idx);
+  void command(client_t &c, std::string_view cmd);
+  /* builds the message of a client into out, false if nothing changed */
+  bool build(client_t &c, int64_t now);
+  /* writes the message of a client, -1 to close the connection */
+  int write(client_t &c);
+
+  ytp_yamal_t *yamal = nullptr;
+  ws_server_cfg_t cfg;
+  std::unique_ptr<ore_books_t> books;
+  struct lws_context *context = nullptr;
+  std::vector<instrument_t> instruments;
+  /*
+   * index of the instrument of a channel view and instrument id, the views
+   * of ore_books_t are stable so their addresses identify the channels
+   */
+  std::unordered_map<std::pair<const char *, int32_t>, size_t,
+                     ws_instrument_hash>
+      index;
+  std::vector<std::unique_ptr<client_t>> clients;
+  uint64_t version = 0; /* of the last change of any instrument */
+  int64_t next_check = 0;
+  std::string out; /* LWS_PRE bytes, then the message */
+
+  uint64_t updates = 0;
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+};
@@ -0,0 +1,134 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <fmc++/error.hpp>
+
+#include "yamal-pager.hpp"
+
+using namespace std;
+
+yamal_pager_t::yamal_pager_t(fmc_fd fd, yamal_pager_cfg_t c,
+                             fmc_error_t **error)
+    : fd(fd), cfg(c) {
+  fmc_error_clear(error);
+  auto page = (size_t)sysconf(_SC_PAGESIZE);
+  RETURN_ERROR_UNLESS(cfg.step && cfg.step % page == 0, error, ,
+                      "pager step must be a multiple of the page size");
+}
+
+yamal_pager_t::~yamal_pager_t() {
+  stop();
+  for (auto &chunk : chunks)
+    munmap(chunk.addr, cfg.step);
+}
+
+void yamal_pager_t::start() {
+  thread = std::thread([this]() {
+    fmc_error_t *error = nullptr;
+    while (!stopping && !error) {
+      if (!step(&error))
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    if (error) {
+      lock_guard<std::mutex> lock(error_mutex);
+      error_msg = fmc_error_msg(error);
+    }
+    stopped = true;
+  });
+}
+
+void yamal_pager_t::stop() {
+  stopping = true;
+  if (thread.joinable())
+    thread.join();
+}
+
+bool yamal_pager_t::failed(string *msg) {
+  if (!stopped)
+    return false;
+  lock_guard<std::mutex> lock(error_mutex);
+  *msg = error_msg;
+  return !error_msg.empty();
+}
+
+bool yamal_pager_t::step(fmc_error_t **error) {
+  fmc_error_clear(error);
+  // nothing is known of the writer before its first commit
+  auto pos = position.load(memory_order_relaxed);
+  if (!pos)
+    return false;
+  auto base = pos / cfg.step * cfg.step;
+  auto want = base + (max(cfg.prefault, cfg.step) + cfg.step - 1) /
+                         cfg.step * cfg.step;
+  bool moved = false;
+  // the step before the writer stays, for the message being written
+  while (!chunks.empty() && chunks.front().offset + cfg.step < base) {
+    munmap(chunks.front().addr, cfg.step);
+    chunks.pop_front();
+    moved = true;
+  }
+  end = max(end, base < cfg.step ? 0 : base - cfg.step);
+  for (; end < want; end += cfg.step, moved = true) {
+    if (!map(end, error))
+      return *error ? false : moved;
+  }
+  return moved;
+}
+
+bool yamal_pager_t::map(uint64_t offset, fmc_error_t **error) {
+#ifdef __linux__
+  // never shrinks the file, unlike truncating it, so it is safe next to
+  // the writer growing the file itself
+  RETURN_ERROR_UNLESS(fallocate(fd, 0, offset, cfg.step) == 0, error, false,
+                      "could not preallocate yamal file:", strerror(errno));
+#else
+  // without fallocate the file is not grown here, truncating it could undo
+  // the writer growing it at the same time, so the pages are only faulted
+  // in once the writer has allocated them
+  struct stat st;
+  RETURN_ERROR_UNLESS(fstat(fd, &st) == 0, error, false,
+                      "could not obtain yamal file size:", strerror(errno));
+  if ((uint64_t)st.st_size < offset + cfg.step)
+    return false;
+#endif
+  auto *addr = mmap(nullptr, cfg.step, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, offset);
+  RETURN_ERROR_UNLESS(addr != MAP_FAILED, error, false,
+                      "could not map yamal file:", strerror(errno));
+  chunks.push_back({offset, addr});
+#ifdef MADV_HUGEPAGE
+  // only a hint, files that cannot use huge pages ignore it
+  if (cfg.hugepages)
+    madvise(addr, cfg.step, MADV_HUGEPAGE);
+#endif
+  bool populated = false;
+#ifdef MADV_POPULATE_WRITE
+  populated = madvise(addr, cfg.step, MADV_POPULATE_WRITE) == 0;
+#endif
+  // kernels before 5.14, the pages are faulted in for writing by adding
+  // zero, which leaves a page the writer has reached already as it is
+  if (!populated) {
+    auto page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < cfg.step; off += page)
+      __atomic_fetch_add((uint64_t *)((char *)addr + off), 0,
+                         __ATOMIC_RELAXED);
+  }
+  if (cfg.mlock) {
+    RETURN_ERROR_UNLESS(::mlock(addr, cfg.step) == 0, error, false,
+                        "could not lock yamal file window:", strerror(errno));
+  }
+  return true;
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fmc/error.h>
+#include <fmc/files.h>
+
+struct yamal_pager_cfg_t {
+  size_t prefault = 0;      /* bytes kept ready past the writer */
+  bool hugepages = false;   /* advise huge pages for the window */
+  bool mlock = false;       /* lock the window in memory */
+  size_t step = 2ULL << 20; /* the window moves by this many bytes */
+
+  bool enabled() const { return prefault || hugepages || mlock; }
+};
+
+/*
+ * Keeps the pages of a yamal file ahead of its writer ready, so that the
+ * writer does not take the first touch page faults on its commit path.
+ * The window goes from a step behind the writer to prefault bytes, at
+ * least a step, past it:
+ *  - the extents of the window are allocated with fallocate(2), so on a
+ *    tmpfs, such as /dev/shm, the pages themselves are allocated ahead,
+ *    on platforms without fallocate only the extents the writer has
+ *    allocated already are prepared,
+ *  - the pages are faulted in for writing, without changing them, through
+ *    a mapping of the window, so they are in the page cache when the
+ *    writer gets to them,
+ *  - with hugepages, the mapping is advised to use huge pages, which takes
+ *    effect for files on a tmpfs with huge pages enabled, see
+ *    /sys/kernel/mm/transparent_hugepage/shmem_enabled,
+ *  - with mlock, the window is locked in memory, which needs a large
+ *    enough RLIMIT_MEMLOCK.
+ * The writer reports the offset of its last commit with advance(), and
+ * the pager runs on its own thread, so none of this work is done by the
+ * writer. The pages of the writer mapping of the file are still mapped on
+ * first touch, as minor faults on pages already in memory.
+ */
+struct yamal_pager_t {
+  yamal_pager_t(fmc_fd fd, yamal_pager_cfg_t cfg, fmc_error_t **error);
+  ~yamal_pager_t();
+
+  /* starts the thread of the pager */
+  void start();
+  /* stops the thread and releases the window */
+  void stop();
+  /* whether the thread has stopped with an error, and the error */
+  bool failed(std::string *msg);
+
+  /* writer, the file offset of the last message committed */
+  void advance(uint64_t offset) {
+    position.store(offset, std::memory_order_relaxed);
+  }
+
+  /* moves the window to the writer, false if it was there already */
+  bool step(fmc_error_t **error);
+
+  struct chunk_t {
+    uint64_t offset;
+    void *addr;
+  };
+
+  /* maps and prepares the step at offset, false if it cannot be yet */
+  bool map(uint64_t offset, fmc_error_t **error);
+
+  fmc_fd fd = -1;
+  yamal_pager_cfg_t cfg;
+  std::deque<chunk_t> chunks; /* mapped steps of the window, in order */
+  uint64_t end = 0;           /* end of the window */
+
+  std::atomic<uint64_t> position = 0;
+  std::thread thread;
+  std::atomic<bool> stopping = false;
+  std::atomic<bool> stopped = false;
+  std::mutex error_mutex;
+  std::string error_msg; /* guarded by error_mutex */
+};
@@ -0,0 +1,265 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmc++/error.hpp>
+#include <fmc/error.h>
+#include <fmc/files.h>
+#include <ytp/data.h>
+#include <ytp/yamal.h>
+
+// Sidecar index of a yamal file, with the messages of each stream linked
+// together so that a reader follows only the streams it wants instead of
+// walking every message of the file. The index is a header and fixed size
+// records, record n at n * sizeof(ytp_index_rec_t), 0 meaning none:
+//  - a record per message, in commit order, with the yamal offset of the
+//    message and the record of the next message of the same stream,
+//  - the first record of a stream also links the first record of the next
+//    stream, from heads in the header, so readers find the streams without
+//    reading the messages.
+// Links and the record count are written last, with release semantics,
+// so readers of the mapped file see complete records. The index has a
+// single writer, which appends the messages it commits itself, so it is
+// meant for files with one writer, such as the file of a feed handler.
+struct ytp_index_rec_t {
+  uint64_t offset;      // yamal offset of the message
+  uint64_t stream;      // stream of the message
+  uint64_t next;        // next record of the stream
+  uint64_t next_stream; // first record of the next stream, first records only
+};
+
+struct ytp_index_hdr_t {
+  char magic[8];
+  uint64_t records;
+  uint64_t heads; // first record of the first stream
+  uint64_t reserved;
+};
+
+static_assert(sizeof(ytp_index_hdr_t) == sizeof(ytp_index_rec_t));
+
+inline constexpr char ytp_index_magic[8] = {'Y', 'T', 'P', 'I',
+                                            'D', 'X', '1', '\0'};
+// address space mapped for an index, the file grows within it
+inline constexpr size_t ytp_index_reserve = 1ULL << 36;
+// the file grows by this many bytes at a time
+inline constexpr size_t ytp_index_chunk = 1ULL << 22;
+
+inline uint64_t ytp_index_load(const uint64_t *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void ytp_index_store(uint64_t *p, uint64_t val) {
+  __atomic_store_n(p, val, __ATOMIC_RELEASE);
+}
+
+// Maps the index file fd, readable and writable if write is set
+inline char *ytp_index_map(fmc_fd fd, bool write, fmc_error_t **error) {
+  fmc_error_clear(error);
+  auto prot = PROT_READ | (write ? PROT_WRITE : 0);
+  auto *base = mmap(nullptr, ytp_index_reserve, prot, MAP_SHARED, fd, 0);
+  RETURN_ERROR_UNLESS(base != MAP_FAILED, error, nullptr,
+                      "could not map index:", strerror(errno));
+  return (char *)base;
+}
+
+// Appends the messages committed to a yamal to its index
+struct ytp_index_writer_t {
+  // Opens the index in fd, created if the file is empty, or continued
+  ytp_index_writer_t(fmc_fd fd, fmc_error_t **error) : fd(fd) {
+    base = ytp_index_map(fd, true, error);
+    if (*error)
+      return;
+    struct stat st;
+    RETURN_ERROR_UNLESS(fstat(fd, &st) == 0, error, ,
+                        "could not obtain index size:", strerror(errno));
+    size = st.st_size;
+    if (size < sizeof(ytp_index_hdr_t)) {
+      grow(sizeof(ytp_index_hdr_t), error);
+      if (*error)
+        return;
+      memcpy(hdr()->magic, ytp_index_magic, sizeof ytp_index_magic);
+    }
+    RETURN_ERROR_UNLESS(
+        memcmp(hdr()->magic, ytp_index_magic, sizeof ytp_index_magic) == 0,
+        error, , "not a yamal index");
+    // the last record of every stream, to link the next one
+    count = hdr()->records;
+    for (uint64_t n = 1; n <= count; ++n) {
+      auto *r = rec(n);
+      if (!tails.count(r->stream))
+        last_head = n;
+      tails[r->stream] = n;
+    }
+  }
+
+  ~ytp_index_writer_t() {
+    if (base)
+      munmap(base, ytp_index_reserve);
+  }
+
+  // Appends a message of stream at the yamal offset, in commit order
+  void append(ytp_mmnode_offs stream, ytp_mmnode_offs offset,
+              fmc_error_t **error) {
+    fmc_error_clear(error);
+    auto n = count + 1;
+    if ((n + 1) * sizeof(ytp_index_rec_t) > size) {
+      grow((n + 1) * sizeof(ytp_index_rec_t), error);
+      if (*error)
+        return;
+    }
+    auto *r = rec(n);
+    r->offset = offset;
+    r->stream = stream;
+    r->next = 0;
+    r->next_stream = 0;
+    auto [where, added] = tails.try_emplace(stream, n);
+    if (added) {
+      ytp_index_store(last_head ? &rec(last_head)->next_stream
+                                : &hdr()->heads,
+                      n);
+      last_head = n;
+    } else {
+      ytp_index_store(&rec(where->second)->next, n);
+      where->second = n;
+    }
+    ytp_index_store(&hdr()->records, n);
+    count = n;
+  }
+
+  void grow(size_t min, fmc_error_t **error) {
+    auto want = (min + ytp_index_chunk - 1) / ytp_index_chunk * ytp_index_chunk;
+    RETURN_ERROR_UNLESS(want <= ytp_index_reserve, error, ,
+                        "index is full");
+    RETURN_ERROR_UNLESS(ftruncate(fd, want) == 0, error, ,
+                        "could not grow index:", strerror(errno));
+    size = want;
+  }
+
+  ytp_index_hdr_t *hdr() { return (ytp_index_hdr_t *)base; }
+  ytp_index_rec_t *rec(uint64_t n) { return (ytp_index_rec_t *)base + n; }
+
+  fmc_fd fd = -1;
+  char *base = nullptr;
+  size_t size = 0;
+  uint64_t count = 0;
+  uint64_t last_head = 0;
+  std::unordered_map<ytp_mmnode_offs, uint64_t> tails;
+};
+
+// Reads the messages of the selected streams of a yamal, in commit order,
+// through its index. A reader of k streams goes through their messages
+// only, at O(log k) each, and through the first record of every stream to
+// find the ones it wants. Like ytp_merge_t, streams at the end of their
+// messages are checked again on every call so that a file still being
+// written is followed.
+struct ytp_index_reader_t {
+  ytp_index_reader_t(ytp_yamal_t *yamal, fmc_fd fd, fmc_error_t **error)
+      : yamal(yamal) {
+    base = ytp_index_map(fd, false, error);
+    if (*error)
+      return;
+    RETURN_ERROR_UNLESS(fmc_fsize(fd, error) >= sizeof(ytp_index_hdr_t) &&
+                            memcmp(hdr()->magic, ytp_index_magic,
+                                   sizeof ytp_index_magic) == 0,
+                        error, , "not a yamal index");
+  }
+
+  ~ytp_index_reader_t() {
+    if (base)
+      munmap(base, ytp_index_reserve);
+  }
+
+  // Calls select with each stream indexed since the previous call, the
+  // messages of the streams it returns true for are read
+  void streams(const std::function<bool(ytp_mmnode_offs)> &select) {
+    for (;;) {
+      auto n = head ? ytp_index_load(&rec(head)->next_stream)
+                    : ytp_index_load(&hdr()->heads);
+      if (!n)
+        return;
+      head = n;
+      if (select(rec(n)->stream))
+        idle.push_back({n, true});
+    }
+  }
+
+  // Reads the next message of the selected streams, false if there is
+  // none yet
+  bool next(uint64_t *seqno, int64_t *ts, ytp_mmnode_offs *stream,
+            size_t *sz, const char **data, fmc_error_t **error) {
+    fmc_error_clear(error);
+    // streams at the end may have new messages, older than those queued
+    polled.swap(idle);
+    for (auto c : polled)
+      push(c);
+    polled.clear();
+    if (heap.empty())
+      return false;
+    std::pop_heap(heap.begin(), heap.end(), later);
+    auto c = heap.back();
+    heap.pop_back();
+    offset = rec(c.rec)->offset;
+    auto it = ytp_data_seek(yamal, offset, error);
+    RETURN_ON_ERROR(error, false, "could not seek indexed message");
+    ytp_data_read(yamal, it, seqno, ts, stream, sz, data, error);
+    RETURN_ON_ERROR(error, false, "could not read indexed message");
+    // the record was read, the cursor waits for the following one
+    idle.push_back({c.rec, false});
+    return true;
+  }
+
+  // record of a stream, pending if it has not been read yet
+  struct cursor_t {
+    uint64_t rec;
+    bool pending;
+  };
+
+  ytp_index_hdr_t *hdr() { return (ytp_index_hdr_t *)base; }
+  ytp_index_rec_t *rec(uint64_t n) { return (ytp_index_rec_t *)base + n; }
+
+  ytp_yamal_t *yamal = nullptr;
+  char *base = nullptr;
+  uint64_t head = 0;   // last stream seen
+  uint64_t offset = 0; // yamal offset of the last message read, 0 if none
+
+private:
+  static bool later(const cursor_t &a, const cursor_t &b) {
+    return a.rec > b.rec;
+  }
+
+  // queues the next record of the cursor, or leaves it idle
+  void push(cursor_t c) {
+    if (!c.pending) {
+      auto next = ytp_index_load(&rec(c.rec)->next);
+      if (!next) {
+        idle.push_back(c);
+        return;
+      }
+      c = {next, true};
+    }
+    heap.push_back(c);
+    std::push_heap(heap.begin(), heap.end(), later);
+  }
+
+  std::vector<cursor_t> heap;
+  std::vector<cursor_t> idle;
+  std::vector<cursor_t> polled;
+};
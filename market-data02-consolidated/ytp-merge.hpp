@@ -0,0 +1,166 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ytp-index.hpp"
+#include <fmc/error.h>
+#include <ytp/data.h>
+#include <ytp/yamal.h>
+
+// K-way merge of the data messages of several yamal files by message time,
+// ties go to the file added first. A heap orders the inputs that have a
+// message ready, inputs at the end of their file are checked again on
+// every call so that files still being written are followed. A message
+// that arrives late, after messages with a later time from other files
+// have been returned, is returned on arrival. An input with a sidecar
+// index is read through it, and only the streams it selects are returned.
+struct ytp_merge_t {
+  // whether the messages of a stream of an indexed input are wanted
+  using select_t = std::function<bool(ytp_mmnode_offs, fmc_error_t **)>;
+
+  struct input_t {
+    ytp_yamal_t *yamal = nullptr;
+    ytp_iterator_t it = nullptr;
+    size_t index = 0;
+    // index of the input and its stream selection, nullptr if none
+    ytp_index_reader_t *reader = nullptr;
+    select_t select;
+    // next message of the input, valid until the following call to next()
+    uint64_t seqno = 0;
+    int64_t ts = 0;
+    ytp_mmnode_offs stream = 0;
+    size_t sz = 0;
+    const char *data = nullptr;
+  };
+
+  // Adds an input read from its first data message, the merge does not
+  // own the yamal
+  void add(ytp_yamal_t *yamal, fmc_error_t **error) {
+    add(yamal, nullptr, nullptr, error);
+  }
+
+  // Adds an input read through its index, the merge does not own either
+  void add(ytp_yamal_t *yamal, ytp_index_reader_t *reader, select_t select,
+           fmc_error_t **error) {
+    fmc_error_clear(error);
+    auto input = std::make_unique<input_t>();
+    input->yamal = yamal;
+    input->reader = reader;
+    input->select = std::move(select);
+    input->index = inputs.size();
+    input->it = ytp_data_begin(yamal, error);
+    if (*error)
+      return;
+    idle.push_back(input.get());
+    inputs.push_back(std::move(input));
+  }
+
+  // Returns the input with the earliest next message, or nullptr if every
+  // input is at the end of its file
+  input_t *next(fmc_error_t **error) {
+    fmc_error_clear(error);
+    if (last) {
+      push(last, error);
+      last = nullptr;
+      if (*error)
+        return nullptr;
+    }
+    // inputs at the end of their file may have new messages
+    polled.swap(idle);
+    for (auto *input : polled) {
+      push(input, error);
+      if (*error)
+        return nullptr;
+    }
+    polled.clear();
+    if (heap.empty())
+      return nullptr;
+    std::pop_heap(heap.begin(), heap.end(), later);
+    last = heap.back();
+    heap.pop_back();
+    return last;
+  }
+
+  // Bytes of the inputs not yet returned, the distance from the position
+  // of each input to the end of its file, so it takes the same time
+  // however far behind the merge is. An indexed input is at its last
+  // message read, and the distance includes the streams it does not read.
+  uint64_t backlog(fmc_error_t **error) const {
+    fmc_error_clear(error);
+    uint64_t bytes = 0;
+    for (auto *input : heap)
+      bytes += input->sz;
+    for (auto &input : inputs) {
+      auto end = ytp_data_end(input->yamal, error);
+      if (*error)
+        return bytes;
+      auto last = ytp_data_tell(input->yamal, end, error);
+      if (*error)
+        return bytes;
+      auto pos = input->reader ? input->reader->offset : 0;
+      if (!pos)
+        pos = ytp_data_tell(input->yamal, input->it, error);
+      if (*error)
+        return bytes;
+      bytes += last > pos ? last - pos : 0;
+    }
+    return bytes;
+  }
+
+  std::vector<std::unique_ptr<input_t>> inputs;
+
+private:
+  static bool later(const input_t *a, const input_t *b) {
+    return a->ts > b->ts || (a->ts == b->ts && a->index > b->index);
+  }
+
+  // reads the next message of the input into the heap, or leaves the
+  // input idle at the end of its file
+  void push(input_t *input, fmc_error_t **error) {
+    if (input->reader) {
+      input->reader->streams([&](ytp_mmnode_offs stream) {
+        return !*error && input->select(stream, error);
+      });
+      if (*error)
+        return;
+      if (input->reader->next(&input->seqno, &input->ts, &input->stream,
+                              &input->sz, &input->data, error)) {
+        heap.push_back(input);
+        std::push_heap(heap.begin(), heap.end(), later);
+      } else if (!*error) {
+        idle.push_back(input);
+      }
+      return;
+    }
+    if (ytp_yamal_term(input->it)) {
+      idle.push_back(input);
+      return;
+    }
+    ytp_data_read(input->yamal, input->it, &input->seqno, &input->ts,
+                  &input->stream, &input->sz, &input->data, error);
+    if (*error)
+      return;
+    input->it = ytp_yamal_next(input->yamal, input->it, error);
+    if (*error)
+      return;
+    heap.push_back(input);
+    std::push_heap(heap.begin(), heap.end(), later);
+  }
+
+  std::vector<input_t *> heap;
+  std::vector<input_t *> idle;
+  std::vector<input_t *> polled;
+  input_t *last = nullptr;
+};
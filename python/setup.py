@@ -19,6 +19,14 @@ if sys.version_info < (3, 6, 0):
 
 import setuptools
 
+
+class BinaryDistribution(setuptools.Distribution):
+    """The _ore extension is built by cmake, the wheel is still tagged with
+    the python ABI it is built for"""
+    def has_ext_modules(self):
+        return True
+
+
 setuptools.setup (
     name = 'tutorials',
     version = tutorials_version,
@@ -31,10 +39,13 @@ setuptools.setup (
         'Programming Language :: Python :: 3 :: Only',
     ],
     package_data={
-        'tutorials': ['*.py']
+        'tutorials': ['*.py', '*.so'],
+        'tutorials.tests': ['data/*']
     },
     license='COPYRIGHT (c) 2019-2023 by Featuremine Corporation',
     packages=['tutorials', 'tutorials.tests'],
     scripts=['scripts/test-tutorials-python'],
-    requires=['yamal']
+    requires=['yamal', 'numpy'],
+    install_requires=['numpy'],
+    distclass=BinaryDistribution
 )
@@ -0,0 +1,298 @@
+/******************************************************************************
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *****************************************************************************/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ore-columns.hpp"
+#include "ore-reader.hpp"
+#include <fmc++/error.hpp>
+#include <fmc++/strings.hpp>
+#include <fmc/files.h>
+#include <ytp/announcement.h>
+#include <ytp/data.h>
+#include <ytp/yamal.h>
+
+// Decoded ORE message as laid out in the NumPy structured array, it must
+// match tutorials.ore.dtype, which is aligned like a C struct.
+struct ore_row_t {
+  int64_t receive;
+  int64_t vendor_offset;
+  uint64_t vendor_seqno;
+  double price;
+  double qty;
+  uint32_t channel;
+  int32_t imnt_id;
+  int32_t id;
+  int32_t new_id;
+  uint8_t type;
+  uint8_t batch;
+  int8_t side;
+  uint8_t uncross;
+  char command;
+};
+
+static_assert(sizeof(ore_row_t) == 64);
+
+// Decodes ORE messages from a yamal file in batches. Keeps the iterator
+// between batches, so it also follows a file that is being written.
+struct ore_batch_reader_t {
+  ~ore_batch_reader_t() {
+    fmc_error_t *error = nullptr;
+    if (yamal)
+      ytp_yamal_del(yamal, &error);
+    if (fd != -1)
+      fmc_fclose(fd, &error);
+  }
+
+  void open(const char *path, fmc_error_t **error) {
+    fd = fmc_fopen(path, fmc_fmode::READ, error);
+    RETURN_ON_ERROR(error, , "could not open yamal file", path);
+    yamal = ytp_yamal_new(fd, error);
+    RETURN_ON_ERROR(error, , "could not create yamal");
+    it = ytp_data_begin(yamal, error);
+    RETURN_ON_ERROR(error, , "could not obtain iterator");
+  }
+
+  int64_t resolve(ytp_mmnode_offs stream, fmc_error_t **error) {
+    auto where = streams.find(stream);
+    if (where != streams.end())
+      return where->second;
+    uint64_t seqno;
+    size_t psz, csz, esz;
+    const char *peer, *channel, *encoding;
+    ytp_mmnode_offs *original, *subscribed;
+    ytp_announcement_lookup(yamal, stream, &seqno, &psz, &peer, &csz, &channel,
+                            &esz, &encoding, &original, &subscribed, error);
+    if (*error)
+      return -1;
+    std::string_view sv{channel, csz};
+    bool selected =
+        fmc::starts_with(sv, filter.prefix) &&
+        (filter.channels.empty() ||
+         std::find(filter.channels.begin(), filter.channels.end(), sv) !=
+             filter.channels.end());
+    int64_t idx = -1;
+    if (selected) {
+      // peers publishing the same channel share the channel index
+      auto it = std::find(channels.begin(), channels.end(), sv);
+      idx = it - channels.begin();
+      if (it == channels.end())
+        channels.emplace_back(sv);
+    }
+    return streams.emplace(stream, idx).first->second;
+  }
+
+  // Replaces rows with the ORE messages of the next yamal messages. Stops
+  // at the end of the yamal message that reaches count rows, so a batch
+  // may exceed count by the rest of that message.
+  void read(size_t count, fmc_error_t **error) {
+    fmc_error_clear(error);
+    rows.clear();
+    ore_msg_t msg;
+    while (rows.size() < count && !ytp_yamal_term(it)) {
+      uint64_t seqno;
+      int64_t ts;
+      ytp_mmnode_offs stream;
+      size_t sz;
+      const char *data;
+      ytp_data_read(yamal, it, &seqno, &ts, &stream, &sz, &data, error);
+      RETURN_ON_ERROR(error, , "could not read data");
+      it = ytp_yamal_next(yamal, it, error);
+      RETURN_ON_ERROR(error, , "could not obtain next iterator");
+      auto idx = resolve(stream, error);
+      RETURN_ON_ERROR(error, , "could not look up stream announcement");
+      // the parser commits after receive, so anything committed before
+      // the start time cannot contain messages in range
+      if (idx < 0 || ts < filter.start)
+        continue;
+      msgpack_reader_t rd(std::string_view(data, sz));
+      while (!rd.empty()) {
+        RETURN_ERROR_UNLESS(ore_decode(rd, &msg), error, ,
+                            "could not decode ORE message on channel",
+                            channels[idx]);
+        if (msg.receive < filter.start || msg.receive > filter.end)
+          continue;
+        rows.push_back(ore_row_t{msg.receive, msg.vendor_offset,
+                                 msg.vendor_seqno, msg.price, msg.qty,
+                                 (uint32_t)idx, msg.imnt_id, msg.id,
+                                 msg.new_id, msg.type, msg.batch, msg.side,
+                                 msg.uncross, msg.command});
+      }
+    }
+  }
+
+  fmc_fd fd = -1;
+  ytp_yamal_t *yamal = nullptr;
+  ytp_iterator_t it = nullptr;
+  std::string prefix;
+  ore_filter_t filter;
+  std::unordered_map<ytp_mmnode_offs, int64_t> streams;
+  std::vector<std::string> channels;
+  std::vector<ore_row_t> rows;
+};
+
+struct Reader {
+  PyObject_HEAD;
+  ore_batch_reader_t *rd;
+  bool busy;
+};
+
+static void Reader_dealloc(Reader *self) {
+  delete self->rd;
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Reader_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds) {
+  static const char *kwlist[] = {"path",  "prefix", "channels",
+                                 "start", "end",    NULL};
+  const char *path = nullptr;
+  const char *prefix = "ore/";
+  PyObject *channels = Py_None;
+  long long start = INT64_MIN;
+  long long end = INT64_MAX;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|sOLL", (char **)kwlist,
+                                   &path, &prefix, &channels, &start, &end))
+    return NULL;
+
+  auto *rd = new ore_batch_reader_t();
+  rd->prefix = prefix;
+  rd->filter.prefix = rd->prefix;
+  rd->filter.start = start;
+  rd->filter.end = end;
+  if (channels != Py_None) {
+    PyObject *seq = PySequence_Fast(channels, "channels must be a sequence");
+    if (!seq) {
+      delete rd;
+      return NULL;
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); ++i) {
+      const char *chan = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+      if (!chan) {
+        Py_DECREF(seq);
+        delete rd;
+        return NULL;
+      }
+      rd->filter.channels.emplace_back(chan);
+    }
+    Py_DECREF(seq);
+  }
+
+  fmc_error_t *error = nullptr;
+  rd->open(path, &error);
+  if (error) {
+    PyErr_SetString(PyExc_RuntimeError, fmc_error_msg(error));
+    delete rd;
+    return NULL;
+  }
+
+  auto *self = (Reader *)type->tp_alloc(type, 0);
+  if (!self) {
+    delete rd;
+    return NULL;
+  }
+  self->rd = rd;
+  self->busy = false;
+  return (PyObject *)self;
+}
+
+static PyObject *Reader_read(Reader *self, PyObject *args) {
+  Py_ssize_t count = 65536;
+  if (!PyArg_ParseTuple(args, "|n", &count))
+    return NULL;
+  if (count <= 0) {
+    PyErr_SetString(PyExc_ValueError, "count must be positive");
+    return NULL;
+  }
+  // the reader state is not protected while the GIL is released
+  if (self->busy) {
+    PyErr_SetString(PyExc_RuntimeError, "reader is used by another thread");
+    return NULL;
+  }
+  self->busy = true;
+  auto *rd = self->rd;
+  fmc_error_t *error = nullptr;
+  Py_BEGIN_ALLOW_THREADS;
+  rd->read(count, &error);
+  Py_END_ALLOW_THREADS;
+  self->busy = false;
+  if (error) {
+    PyErr_SetString(PyExc_RuntimeError, fmc_error_msg(error));
+    return NULL;
+  }
+  return PyByteArray_FromStringAndSize((const char *)rd->rows.data(),
+                                       rd->rows.size() * sizeof(ore_row_t));
+}
+
+static PyObject *Reader_channels(Reader *self, void *) {
+  auto &channels = self->rd->channels;
+  PyObject *list = PyList_New(channels.size());
+  if (!list)
+    return NULL;
+  for (size_t i = 0; i < channels.size(); ++i) {
+    PyObject *str = PyUnicode_FromStringAndSize(channels[i].data(),
+                                                channels[i].size());
+    if (!str) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, str);
+  }
+  return list;
+}
+
+static PyMethodDef Reader_methods[] = {
+    {"read", (PyCFunction)Reader_read, METH_VARARGS,
+     "read(count=65536)\n--\n\n"
+     "Decodes the ORE messages of the next yamal messages into a bytearray "
+     "of\nrecords. Returns an empty bytearray when no data is available."},
+    {NULL}};
+
+static PyGetSetDef Reader_getset[] = {
+    {"channels", (getter)Reader_channels, NULL,
+     "Channel names indexed by the channel field of the records", NULL},
+    {NULL}};
+
+static PyTypeObject ReaderType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+static PyModuleDef ore_module = {PyModuleDef_HEAD_INIT, "tutorials._ore",
+                                 "Native ORE decoder", -1};
+
+PyMODINIT_FUNC PyInit__ore(void) {
+  ReaderType.tp_name = "tutorials._ore.Reader";
+  ReaderType.tp_basicsize = sizeof(Reader);
+  ReaderType.tp_dealloc = (destructor)Reader_dealloc;
+  ReaderType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ReaderType.tp_doc =
+      "Reader(path, prefix='ore/', channels=None, start=None, end=None)\n"
+      "--\n\n"
+      "Batch decoder of the ORE messages in a yamal file.";
+  ReaderType.tp_methods = Reader_methods;
+  ReaderType.tp_getset = Reader_getset;
+  ReaderType.tp_new = Reader_new;
+  if (PyType_Ready(&ReaderType) < 0)
+    return NULL;
+  PyObject *m = PyModule_Create(&ore_module);
+  if (!m)
+    return NULL;
+  Py_INCREF(&ReaderType);
+  if (PyModule_AddObject(m, "Reader", (PyObject *)&ReaderType) < 0) {
+    Py_DECREF(&ReaderType);
+    Py_DECREF(m);
+    return NULL;
+  }
+  PyModule_AddIntConstant(m, "record_size", sizeof(ore_row_t));
+  return m;
+}
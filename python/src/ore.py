@@ -0,0 +1,84 @@
+"""
+        COPYRIGHT (c) 2019-2023 by Featuremine Corporation.
+
+        This Source Code Form is subject to the terms of the Mozilla Public
+        License, v. 2.0. If a copy of the MPL was not distributed with this
+        file, You can obtain one at https://mozilla.org/MPL/2.0/.
+"""
+
+"""
+Batch decoding of ORE messages into NumPy structured arrays.
+
+    from tutorials import ore
+    rd = ore.reader("consolidated.ytp.0001")
+    for batch in rd:
+        trades = batch[batch['type'] == ore.OFF_BOOK_TRADE]
+        print(rd.channels, trades['price'])
+
+Every ORE message becomes one record, fields that do not apply to the
+message type are zero and side is 1 for bid, 0 for ask and -1 when
+unknown. Decoding runs in native code with the GIL released.
+"""
+
+import numpy as np
+from tutorials import _ore
+
+ORDER_ADD = 1
+ORDER_DELETE = 5
+ORDER_MODIFY = 6
+OFF_BOOK_TRADE = 11
+BOOK_CONTROL = 13
+
+dtype = np.dtype([
+    ('receive', '<i8'),
+    ('vendor_offset', '<i8'),
+    ('vendor_seqno', '<u8'),
+    ('price', '<f8'),
+    ('qty', '<f8'),
+    ('channel', '<u4'),
+    ('imnt_id', '<i4'),
+    ('id', '<i4'),
+    ('new_id', '<i4'),
+    ('type', 'u1'),
+    ('batch', 'u1'),
+    ('side', 'i1'),
+    ('uncross', 'u1'),
+    ('command', 'S1'),
+], align=True)
+
+assert dtype.itemsize == _ore.record_size, "ORE record layout mismatch"
+
+
+class reader:
+    """
+    Reads the ORE channels of a yamal file starting with prefix, or only
+    the listed channels. start and end are inclusive bounds on the ORE
+    receive time in nanoseconds.
+    """
+
+    def __init__(self, path, prefix="ore/", channels=None, start=None, end=None):
+        kwargs = {}
+        if start is not None:
+            kwargs['start'] = start
+        if end is not None:
+            kwargs['end'] = end
+        self._rd = _ore.Reader(path, prefix, channels, **kwargs)
+
+    @property
+    def channels(self):
+        """Channel names indexed by the channel field"""
+        return self._rd.channels
+
+    def read(self, count=65536):
+        """
+        Returns the next batch of about count records, empty if no more data
+        is available yet. Batches end on yamal message boundaries.
+        """
+        return np.frombuffer(self._rd.read(count), dtype=dtype)
+
+    def __iter__(self):
+        while True:
+            batch = self.read()
+            if not len(batch):
+                return
+            yield batch
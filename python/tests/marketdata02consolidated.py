@@ -8,19 +8,137 @@
 
 import unittest
 from yamal import reactor, yamal
-from os import remove
+from os import remove, path
 from multiprocessing import Process
 from time import sleep
 from datetime import datetime, timedelta
 from collections import defaultdict
+import importlib.util
+import os
+import shutil
+import socket
+import struct
+import subprocess
+import sys
 
 def run_reactor(cfg):
     r = reactor()
     r.deploy(cfg)
     r.run(live=True)
 
+def data_file(name):
+    # the helper scripts and recorded data of the tutorial ship with the tests
+    return path.join(path.dirname(path.abspath(__file__)), "data", name)
+
+def free_port(kind=socket.SOCK_STREAM):
+    with socket.socket(socket.AF_INET, kind) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+def tool(name):
+    # the executables of the tutorial, from the build tree when testing it
+    binpath = os.environ.get("TUTORIALSBINPATH")
+    if binpath and path.exists(path.join(binpath, name)):
+        return path.join(binpath, name)
+    return shutil.which(name)
+
+def remove_files(*fnames):
+    for fname in fnames:
+        try:
+            remove(fname)
+        except OSError:
+            pass
+
+def ore_pack(*fields):
+    # msgpack array of an ORE message
+    out = bytes([0x90 | len(fields)])
+    for f in fields:
+        if isinstance(f, bool):
+            out += bytes([0xc3 if f else 0xc2])
+        elif isinstance(f, int):
+            out += bytes([f]) if 0 <= f < 128 else b'\xd3' + struct.pack('>q', f)
+        else:
+            out += bytes([0xa0 | len(f)]) + f.encode()
+    return out
+
+def binance_trade(t):
+    # data of a binance trade message, with vendor sequence number t
+    return (f'{{"e":"trade","E":{1680000000000 + t},"s":"BTCUSDT","t":{t},'
+            f'"p":"{27000 + t}.50000000","q":"0.00100000","b":{2 * t},'
+            f'"a":{2 * t + 1},"T":{1680000000000 + t},"m":false,"M":true}}').encode()
+
+def binance_frames(trades):
+    # frames of a binance session, the quotes of btcusdt and ethusdt keep
+    # their prices and change their quantities, and a trade follows them
+    for t in trades:
+        yield (f'{{"stream":"btcusdt@bookTicker","data":{{"u":{t},"s":"BTCUSDT",'
+               f'"b":"27000.10","B":"{t % 7 + 1}.0","a":"27000.20","A":"2.0"}}}}').encode()
+        yield (f'{{"stream":"ethusdt@bookTicker","data":{{"u":{t},"s":"ETHUSDT",'
+               f'"b":"1800.10","B":"3.0","a":"1800.20","A":"{t % 5 + 1}.0"}}}}').encode()
+        yield b'{"stream":"btcusdt@trade","data":' + binance_trade(t) + b'}'
+
 class TestMarketData02Consolidated(unittest.TestCase):
 
+    def parse_binance_frames(self, fname, frames, trades):
+        """
+        Replays frames to a binance feed handler and parses them into the
+        same file with a feed parser, as test_feed_parser does with the live
+        feed, until the ORE has the number of trades given
+        """
+        from tutorials import ore
+
+        framesfile = fname + ".jsonl"
+        remove_files(fname, framesfile)
+        port = free_port()
+        server = None
+        proc = None
+        try:
+            with open(framesfile, "wb") as f:
+                for frame in frames:
+                    f.write(frame + b'\n')
+            server = subprocess.Popen([sys.executable, data_file("venue-replay.py"),
+                                       "--frames", framesfile, "--port", str(port)])
+            cfg = {
+                "binance" : {
+                    "module" : "feed",
+                    "component" : "binance-feed-handler",
+                    "config" : {
+                        "peer":"binance-feed-handler",
+                        "ytp-file": fname,
+                        "securities": ["btcusdt", "ethusdt"],
+                        "endpoint": f"ws://127.0.0.1:{port}"
+                    }
+                },
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-input": fname,
+                        "ytp-output": fname
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            rd = ore.reader(fname)
+            records = []
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            # trades are the last frames, so the quotes are parsed by then
+            while sum(r['type'] == ore.OFF_BOOK_TRADE for r in records) < trades:
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                records.extend(rd.read())
+                sleep(0.1)
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+            if server is not None:
+                server.terminate()
+                server.wait()
+
     def test_feed_handler_binance_unit(self):
         print("test_feed_handler_binance_unit")
 
@@ -260,7 +378,7 @@ class TestMarketData02Consolidated(unittest.TestCase):
                 for seq, ts, strm, msg in it:
                     if strm.channel.startswith("raw"):
                         rawdata[strm.channel[3:]].append((seq, ts, strm.peer, msg))
-                    else:
+                    elif strm.channel.startswith("ore"):
                         oredata[strm.channel[3:]].append((seq, ts, msg))
                     if strm.channel in expected:
                         expected.remove(strm.channel)
@@ -294,7 +412,7 @@ class TestMarketData02Consolidated(unittest.TestCase):
                     self.assertTrue(parserproc.is_alive())
                     if strm.channel.startswith("raw"):
                         rawdata[strm.channel[3:]].append((seq, ts, strm.peer, msg))
-                    else:
+                    elif strm.channel.startswith("ore"):
                         oredata[strm.channel[3:]].append((seq, ts, msg))
                 if not processed:
                     now = datetime.now()
@@ -308,7 +426,7 @@ class TestMarketData02Consolidated(unittest.TestCase):
             for seq, ts, strm, msg in it:
                 if strm.channel.startswith("raw"):
                     rawdata[strm.channel[3:]].append((seq, ts, strm.peer, msg))
-                else:
+                elif strm.channel.startswith("ore"):
                     oredata[strm.channel[3:]].append((seq, ts, msg))
 
             self.assertTrue(validate_data())
@@ -346,6 +464,1128 @@ class TestMarketData02Consolidated(unittest.TestCase):
                 parserproc.terminate()
                 parserproc.join()
 
+    def test_ore_batch_decode(self):
+        print("test_ore_batch_decode")
+
+        from tutorials import ore
+
+        pack = ore_pack
+
+        fname = "test_ore_batch_decode.ytp"
+        try:
+            remove(fname)
+        except OSError:
+            pass
+
+        y = yamal(fname, closable=False)
+        ss = y.streams()
+        binance = ss.announce("feed-parser", "ore/binance/btcusdt", "Content-Type application/msgpack")
+        raw = ss.announce("binance-feed-handler", "raw/binance/btcusdt@trade", "Content-Type application/json")
+        kraken = ss.announce("feed-parser", "ore/kraken/XBT/USD", "Content-Type application/msgpack")
+
+        binance.write(1000, pack(1, 1000, 0, 1, 1, 100, 100, "10.5", "1.25", True) +
+                      pack(1, 1000, 0, 1, 0, 100, 101, "11", "2", False))
+        raw.write(1001, b'{"e":"trade"}')
+        kraken.write(2000, pack(11, 2000, -3000, 7, 0, 100, "9.5", "0.5", "b"))
+        binance.write(3000, pack(6, 3000, 250, 2, 0, 100, 101, 101, "10.75", "3"))
+
+        rd = ore.reader(fname)
+        batch = rd.read()
+        self.assertEqual(rd.channels, ["ore/binance/btcusdt", "ore/kraken/XBT/USD"])
+        self.assertEqual(len(batch), 4)
+        self.assertEqual(list(batch['type']), [1, 1, 11, 6])
+        self.assertEqual(list(batch['channel']), [0, 0, 1, 0])
+        self.assertEqual(list(batch['price']), [10.5, 11.0, 9.5, 10.75])
+        self.assertEqual(list(batch['side']), [1, 0, 1, -1])
+        self.assertEqual(batch['vendor_offset'][2], -3000)
+        self.assertEqual(batch['new_id'][3], 101)
+        self.assertEqual(len(rd.read()), 0)
+
+        # new data is picked up by the same reader
+        kraken.write(4000, pack(5, 4000, 0, 8, 0, 100, 100))
+        batch = rd.read()
+        self.assertEqual(len(batch), 1)
+        self.assertEqual(batch['type'][0], ore.ORDER_DELETE)
+
+        rd = ore.reader(fname, channels=["ore/binance/btcusdt"], start=2000)
+        batch = rd.read()
+        self.assertEqual(len(batch), 1)
+        self.assertEqual(batch['receive'][0], 3000)
+
+    def replay_venue(self, venue, securities, raw, ore):
+        """
+        Replays the recorded frames of venue to its feed handler and a feed
+        parser, raw maps each raw channel to the message expected on it and
+        ore each ORE channel to its (type, price, qty) records
+        """
+        from tutorials import ore as oredec
+
+        fname = f"test_feed_handler_{venue}_replay.ytp"
+        remove_files(fname)
+        port = free_port()
+        server = None
+        proc = None
+
+        try:
+            server = subprocess.Popen([sys.executable, data_file("venue-replay.py"),
+                                       "--frames", data_file(f"{venue}.jsonl"),
+                                       "--port", str(port), "--wait"])
+            cfg = {
+                venue : {
+                    "module" : "feed",
+                    "component" : f"{venue}-feed-handler",
+                    "config" : {
+                        "peer":f"{venue}-feed-handler",
+                        "ytp-file": fname,
+                        "securities": securities,
+                        "endpoint": f"ws://127.0.0.1:{port}"
+                    }
+                },
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-input": fname,
+                        "ytp-output": fname
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+
+            y = yamal(fname, closable=False)
+            it = iter(y.data())
+            rd = oredec.reader(fname)
+            rawdata = defaultdict(lambda:[])
+            records = []
+            expected = sum(len(recs) for recs in ore.values())
+
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while len(records) < expected or len(rawdata) < len(raw):
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                self.assertIsNone(server.poll())
+                for seq, ts, strm, msg in it:
+                    if strm.channel.startswith("raw/"):
+                        rawdata[strm.channel].append(msg)
+                records.extend(rd.read())
+                sleep(0.1)
+
+            self.assertEqual(dict(rawdata), {ch: [msg] for ch, msg in raw.items()})
+            orerecs = defaultdict(lambda:[])
+            for rec in records:
+                orerecs[rd.channels[rec['channel']]].append(
+                    (int(rec['type']), float(rec['price']), float(rec['qty'])))
+            self.assertEqual(dict(orerecs), ore)
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+            if server is not None:
+                server.terminate()
+                server.wait()
+
+    @unittest.skipIf(importlib.util.find_spec("websockets") is None,
+                     "venue-replay needs websockets")
+    def test_feed_handler_coinbase_replay(self):
+        print("test_feed_handler_coinbase_replay")
+
+        with open(data_file("coinbase.jsonl"), "rb") as f:
+            frames = [line.rstrip(b'\n') for line in f if line.strip()]
+        # the subscriptions frame is a control message
+        ticker_btc, match_btc, ticker_eth, match_eth = frames[1:]
+        self.replay_venue(
+            "coinbase", ["BTC-USD", "ETH-USD"],
+            raw={
+                "raw/coinbase/BTC-USD@ticker": ticker_btc,
+                "raw/coinbase/BTC-USD@matches": match_btc,
+                "raw/coinbase/ETH-USD@ticker": ticker_eth,
+                "raw/coinbase/ETH-USD@matches": match_eth,
+            },
+            ore={
+                "ore/coinbase/BTC-USD": [(13, 0.0, 0.0),
+                                         (1, 27341.12, 1.25),
+                                         (1, 27341.13, 0.375),
+                                         (11, 27341.13, 0.001)],
+                "ore/coinbase/ETH-USD": [(13, 0.0, 0.0),
+                                         (1, 1787.06, 41.5252),
+                                         (1, 1787.07, 12.5),
+                                         (11, 1787.07, 0.375)],
+            })
+
+    @unittest.skipIf(importlib.util.find_spec("websockets") is None,
+                     "venue-replay needs websockets")
+    def test_feed_handler_okx_replay(self):
+        print("test_feed_handler_okx_replay")
+
+        with open(data_file("okx.jsonl"), "rb") as f:
+            frames = [line.rstrip(b'\n') for line in f if line.strip()]
+        # the raw channels carry the data array of the frames after the
+        # subscription events
+        data = [frame[frame.index(b'"data":') + 7:-1] for frame in frames[4:]]
+        self.replay_venue(
+            "okx", ["BTC-USDT", "ETH-USDT"],
+            raw={
+                "raw/okx/BTC-USDT@bbo-tbt": data[0],
+                "raw/okx/BTC-USDT@trades": data[1],
+                "raw/okx/ETH-USDT@bbo-tbt": data[2],
+                "raw/okx/ETH-USDT@trades": data[3],
+            },
+            ore={
+                "ore/okx/BTC-USDT": [(13, 0.0, 0.0),
+                                     (1, 27341.1, 1.25),
+                                     (1, 27341.2, 0.375),
+                                     (11, 27341.2, 0.001)],
+                "ore/okx/ETH-USDT": [(13, 0.0, 0.0),
+                                     (1, 1787.06, 41.5252),
+                                     (1, 1787.07, 12.5),
+                                     (11, 1787.06, 0.375)],
+            })
+
+    def test_mcast_gap_fill(self):
+        print("test_mcast_gap_fill")
+
+        src = "test_mcast_gap_fill_src.ytp"
+        dst = "test_mcast_gap_fill_dst.ytp"
+        remove_files(src, dst)
+        proc = None
+
+        try:
+            y = yamal(src, closable=False)
+            port = free_port(socket.SOCK_DGRAM)
+            gap_port = free_port(socket.SOCK_DGRAM)
+            common = {
+                "address": "239.192.0.43",
+                "port": port,
+                "interface": "127.0.0.1",
+                "gap-address": "127.0.0.1",
+                "gap-port": gap_port
+            }
+            # a receive buffer of a few packets makes the kernel drop most
+            # of a burst, so the receiver has to fill the gaps
+            cfg = {
+                "publisher" : {
+                    "module" : "feed",
+                    "component" : "mcast-publisher",
+                    "config" : {
+                        **common,
+                        "ytp-file": src,
+                        "packet": 256,
+                        "from": "start"
+                    }
+                },
+                "receiver" : {
+                    "module" : "feed",
+                    "component" : "mcast-receiver",
+                    "config" : {
+                        **common,
+                        "ytp-file": dst,
+                        "rcvbuf": 4096,
+                        "retry": 5
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            # the receiver joins the session on a heartbeat of the publisher,
+            # before any data is published
+            sleep(1)
+            self.assertTrue(proc.is_alive())
+
+            ss = y.streams()
+            streams = [ss.announce("mcast-test", f"raw/mcast/{i}", "Content-Type text/plain")
+                       for i in range(3)]
+            for i in range(2000):
+                streams[i % 3].write(1000 + i, f"message {i}".encode())
+            source = [(strm.channel, ts, msg) for seq, ts, strm, msg in y.data()]
+
+            received = []
+            it = iter(yamal(dst, closable=False).data())
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while len(received) < len(source):
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                received.extend((strm.channel, ts, msg) for seq, ts, strm, msg in it)
+                sleep(0.1)
+
+            self.assertEqual(received, source)
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+
+    def test_kafka_sink(self):
+        print("test_kafka_sink")
+
+        import argparse
+        import socketserver
+        import threading
+
+        spec = importlib.util.spec_from_file_location("kafka_mock", data_file("kafka-mock.py"))
+        kafka_mock = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(kafka_mock)
+
+        fname = "test_kafka_sink.ytp"
+        remove_files(fname)
+        proc = None
+        server = None
+
+        try:
+            # every third request fails with a retriable error and every
+            # response is late, so the sink reconnects and produces again
+            broker = kafka_mock.broker(argparse.Namespace(
+                delay=20, fail_every=3, no_verify=False, keep=True))
+            server = socketserver.ThreadingTCPServer(("127.0.0.1", 0),
+                                                     kafka_mock.handler_for(broker))
+            server.daemon_threads = True
+            threading.Thread(target=server.serve_forever, daemon=True).start()
+
+            y = yamal(fname, closable=False)
+            ss = y.streams()
+            streams = [ss.announce("kafka-test", f"raw/kafka/{i}", "Content-Type text/plain")
+                       for i in range(4)]
+            source = []
+            for i in range(1000):
+                msg = f"message {i}".encode()
+                streams[i % 4].write(1000 + i, msg)
+                source.append((f"raw/kafka/{i % 4}".encode(), msg))
+
+            cfg = {
+                "sink" : {
+                    "module" : "feed",
+                    "component" : "kafka-sink",
+                    "config" : {
+                        "ytp-file": fname,
+                        "peer": "kafka-sink",
+                        "address": "127.0.0.1",
+                        "port": server.server_address[1],
+                        "topic": "test",
+                        "partitions": 2,
+                        "batch": 1024,
+                        "linger": 1,
+                        "channels": ["raw/"]
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while True:
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                with broker.lock:
+                    kept = list(broker.kept)
+                if set(source) <= set(kept):
+                    break
+                sleep(0.1)
+
+            with broker.lock:
+                # every batch had a valid crc, and an error was injected
+                self.assertEqual(broker.corrupt, 0)
+                self.assertGreaterEqual(broker.requests, 3)
+            # at least once, records may be produced again after an error
+            self.assertTrue(set(kept) <= set(source))
+            self.assertGreaterEqual(len(kept), len(source))
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+            if server is not None:
+                server.shutdown()
+                server.server_close()
+
+    def test_feed_parser_inputs(self):
+        print("test_feed_parser_inputs")
+
+        from tutorials import ore
+
+        primary = "test_feed_parser_inputs_primary.ytp"
+        backup = "test_feed_parser_inputs_backup.ytp"
+        output = "test_feed_parser_inputs_ore.ytp"
+        remove_files(primary, backup, output)
+        proc = None
+
+        try:
+            # each file misses some of the trades, the backup receives every
+            # trade a little after the primary
+            trades = range(1, 201)
+            for fname, peer, delay, missing in [(primary, "binance-feed-handler", 0, 7),
+                                                (backup, "binance-feed-handler-backup", 1, 5)]:
+                y = yamal(fname, closable=False)
+                strm = y.streams().announce(peer, "raw/binance/btcusdt@trade",
+                                            "Content-Type application/json")
+                for t in trades:
+                    if t % missing:
+                        strm.write(1000 * t + delay, binance_trade(t))
+
+            cfg = {
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-inputs": [primary, backup],
+                        "ytp-output": output
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+
+            rd = ore.reader(output)
+            records = []
+            expected = [t for t in trades if t % 7 or t % 5]
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while len(records) < len(expected):
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                records.extend(rd.read())
+                sleep(0.1)
+            sleep(1)
+            records.extend(rd.read())
+
+            # every trade once, in order, from the input that had it first
+            self.assertEqual(rd.channels, ["ore/binance/btcusdt"])
+            self.assertEqual([int(r['vendor_seqno']) for r in records], expected)
+            self.assertEqual([int(r['receive']) for r in records],
+                             [1000 * t + (0 if t % 7 else 1) for t in expected])
+            self.assertEqual([float(r['price']) for r in records],
+                             [27000.5 + t for t in expected])
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+
+    def test_tcp_distribution(self):
+        print("test_tcp_distribution")
+
+        src = "test_tcp_distribution_src.ytp"
+        dst_all = "test_tcp_distribution_all.ytp"
+        dst_sel = "test_tcp_distribution_sel.ytp"
+        remove_files(src, dst_all, dst_sel)
+        distproc = None
+        recvproc = None
+
+        def contents(it, out):
+            out.extend((strm.channel, ts, msg) for seq, ts, strm, msg in it)
+
+        def wait_for(count, it, out):
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while len(out) < count:
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(recvproc.is_alive())
+                contents(it, out)
+                sleep(0.1)
+
+        try:
+            y = yamal(src, closable=False)
+            ss = y.streams()
+            streams = [ss.announce("tcp-test", f"raw/tcp/{i}", "Content-Type text/plain")
+                       for i in range(3)]
+
+            def write(first, count):
+                for i in range(first, first + count):
+                    streams[i % 3].write(1000 + i, f"message {i}".encode())
+
+            port = free_port()
+            distcfg = {
+                "distributor" : {
+                    "module" : "feed",
+                    "component" : "tcp-distributor",
+                    "config" : {
+                        "ytp-file": src,
+                        "address": "127.0.0.1",
+                        "port": port,
+                        "batch": 4096
+                    }
+                }
+            }
+            recvcfg = {
+                "all" : {
+                    "module" : "feed",
+                    "component" : "tcp-receiver",
+                    "config" : {
+                        "ytp-file": dst_all,
+                        "address": "127.0.0.1",
+                        "port": port
+                    }
+                },
+                "selected" : {
+                    "module" : "feed",
+                    "component" : "tcp-receiver",
+                    "config" : {
+                        "ytp-file": dst_sel,
+                        "address": "127.0.0.1",
+                        "port": port,
+                        "channels": ["raw/tcp/1"]
+                    }
+                }
+            }
+
+            write(0, 500)
+            distproc = Process(target=run_reactor, kwargs={"cfg":distcfg})
+            distproc.start()
+            recvproc = Process(target=run_reactor, kwargs={"cfg":recvcfg})
+            recvproc.start()
+
+            received = []
+            it = iter(yamal(dst_all, closable=False).data())
+            wait_for(500, it, received)
+
+            # the receivers resume after the last message they have once
+            # the distributor is back
+            distproc.terminate()
+            distproc.join()
+            write(500, 500)
+            distproc = Process(target=run_reactor, kwargs={"cfg":distcfg})
+            distproc.start()
+
+            source = []
+            contents(iter(y.data()), source)
+            wait_for(len(source), it, received)
+            selected = []
+            expected = [m for m in source if m[0] == "raw/tcp/1"]
+            sel_it = iter(yamal(dst_sel, closable=False).data())
+            wait_for(len(expected), sel_it, selected)
+            # nothing is received twice
+            sleep(1)
+            contents(it, received)
+            contents(sel_it, selected)
+
+            self.assertEqual(received, source)
+            self.assertEqual(selected, expected)
+        finally:
+            for proc in (distproc, recvproc):
+                if proc is not None:
+                    proc.terminate()
+                    proc.join()
+
+    def test_conflation(self):
+        print("test_conflation")
+
+        from tutorials import ore
+
+        src = "test_conflation_ore.ytp"
+        dst = "test_conflation_conflated.ytp"
+        remove_files(src, dst)
+        proc = None
+
+        def bbo(strm, ms, bid, ask):
+            # the first update of a channel as the feed parser writes it
+            ns = 1000000000 + ms * 1000000
+            strm.write(ns, ore_pack(13, ns, 0, 0, 1, 1, 0, "C") +
+                       ore_pack(1, ns, 0, 1, 1, 1, 1, bid, "1", True) +
+                       ore_pack(1, ns, 0, 1, 0, 1, 2, ask, "1", False))
+
+        def modify(strm, ms, seqno, oid, px):
+            ns = 1000000000 + ms * 1000000
+            strm.write(ns, ore_pack(6, ns, 0, seqno, 0, 1, oid, oid, px, "1"))
+
+        try:
+            y = yamal(src, closable=False)
+            ss = y.streams()
+            btc = ss.announce("feed-parser", "ore/binance/btcusdt", "Content-Type application/msgpack")
+            eth = ss.announce("feed-parser", "ore/binance/ethusdt", "Content-Type application/msgpack")
+            bbo(btc, 0, "100", "101")
+            bbo(eth, 0, "10", "11")
+            # btcusdt changes within the first 100ms interval, and its ask in
+            # the next one, ethusdt does not change
+            for i in range(1, 6):
+                modify(btc, 10 * i, 1 + i, 1, f"100.{i}")
+            modify(btc, 250, 7, 2, "102")
+
+            cfg = {
+                "conflation" : {
+                    "module" : "feed",
+                    "component" : "conflation",
+                    "config" : {
+                        "ytp-file": src,
+                        "output-ytp-file": dst,
+                        "interval": 100
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+
+            rd = ore.reader(dst, prefix="conflated/")
+            records = []
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while len(records) < 8:
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                records.extend(rd.read())
+                sleep(0.1)
+            sleep(1)
+            records.extend(rd.read())
+
+            updates = defaultdict(lambda:[])
+            for r in records:
+                updates[rd.channels[r['channel']]].append(
+                    (int(r['type']), float(r['price']), int(r['receive'])))
+            # the latest top of the book at the end of each interval, with
+            # the receive time of its last change, unchanged sides modified
+            # again
+            self.assertEqual(dict(updates), {
+                "conflated/binance/btcusdt": [(13, 0.0, 1050000000),
+                                              (1, 100.5, 1050000000),
+                                              (1, 101.0, 1050000000),
+                                              (6, 100.5, 1250000000),
+                                              (6, 102.0, 1250000000)],
+                "conflated/binance/ethusdt": [(13, 0.0, 1000000000),
+                                              (1, 10.0, 1000000000),
+                                              (1, 11.0, 1000000000)],
+            })
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+
+    def test_splitter(self):
+        print("test_splitter")
+
+        import fnmatch
+
+        src = "test_splitter_src.ytp"
+        outputs = {
+            "test_splitter_binance.ytp": ["raw/binance/"],
+            "test_splitter_trades.ytp": ["*@trade"],
+            "test_splitter_all.ytp": [],
+        }
+        remove_files(src, *outputs)
+        proc = None
+
+        def selected(patterns, channel):
+            if not patterns:
+                return True
+            return any(fnmatch.fnmatchcase(channel, p) if any(c in p for c in "*?[")
+                       else channel.startswith(p) for p in patterns)
+
+        try:
+            y = yamal(src, closable=False)
+            ss = y.streams()
+            streams = [ss.announce("binance-feed-handler", "raw/binance/btcusdt@trade", "Content-Type application/json"),
+                       ss.announce("binance-feed-handler", "raw/binance/btcusdt@bookTicker", "Content-Type application/json"),
+                       ss.announce("kraken-feed-handler", "raw/kraken/XBT/USD@trade", "Content-Type application/json"),
+                       ss.announce("feed-parser", "ore/binance/btcusdt", "Content-Type application/msgpack")]
+
+            def write(first, count):
+                for i in range(first, first + count):
+                    streams[i % len(streams)].write(1000 + i, f"message {i}".encode())
+
+            cfg = {
+                "splitter" : {
+                    "module" : "feed",
+                    "component" : "splitter",
+                    "config" : {
+                        "ytp-file": src,
+                        "outputs": [{"ytp-file": fname, "channels": channels} if channels
+                                    else {"ytp-file": fname}
+                                    for fname, channels in outputs.items()]
+                    }
+                }
+            }
+            # messages written before the splitter starts and while it runs
+            write(0, 400)
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            sleep(1)
+            write(400, 400)
+            source = [(strm.peer, strm.channel, ts, msg) for seq, ts, strm, msg in y.data()]
+
+            for fname, channels in outputs.items():
+                expected = [m for m in source if selected(channels, m[1])]
+                split = []
+                it = iter(yamal(fname, closable=False).data())
+                timeout = timedelta(seconds=60)
+                start = datetime.now()
+                while len(split) < len(expected):
+                    self.assertLess(datetime.now(), start + timeout)
+                    self.assertTrue(proc.is_alive())
+                    split.extend((strm.peer, strm.channel, ts, msg) for seq, ts, strm, msg in it)
+                    sleep(0.1)
+                self.assertEqual(split, expected, fname)
+            # * matches across / in the kraken channel
+            self.assertEqual(len([m for m in source if selected(["*@trade"], m[1])]), 400)
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+
+    def test_latency_analytics(self):
+        print("test_latency_analytics")
+
+        from time import time_ns
+
+        fname = "test_latency_analytics.ytp"
+        remove_files(fname)
+        proc = None
+        one_way = struct.Struct('<32sQ7qQ')
+        # offsets on both sides of zero, as with the local clock behind the
+        # vendor's, zero offsets are messages without vendor time
+        offsets = [-999500 + 1000 * i for i in range(2000)]
+
+        def expected(p):
+            return offsets[max(int(len(offsets) * p / 100.0 + 0.5), 1) - 1]
+
+        try:
+            y = yamal(fname, closable=False)
+            strm = y.streams().announce("feed-parser", "ore/binance/btcusdt", "Content-Type application/msgpack")
+            cfg = {
+                "latency" : {
+                    "module" : "feed",
+                    "component" : "latency-analytics",
+                    "config" : {
+                        "peer": "latency-analytics",
+                        "ytp-file": fname,
+                        "window": 10
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            sleep(1)
+            # a single message, so that all offsets fall in the same interval
+            ns = time_ns()
+            strm.write(ns, b"".join(ore_pack(13, ns, off, i, 1, 1, 0, "C")
+                                    for i, off in enumerate(offsets)))
+
+            records = []
+            it = iter(y.data())
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while not records:
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                records.extend(one_way.unpack(msg) for seq, ts, s, msg in it
+                               if s.channel == "stats/latency-analytics/one-way")
+                sleep(0.1)
+
+            venue, count, mn, p50, p90, p99, p999, mx, skew, interval = records[0]
+            self.assertEqual(venue.rstrip(b'\0'), b"binance")
+            self.assertEqual(count, len(offsets))
+            self.assertEqual(mn, offsets[0])
+            self.assertEqual(mx, offsets[-1])
+            self.assertEqual(skew, offsets[0])
+            # percentiles keep their sign, within the histogram resolution
+            self.assertLess(p50, 0)
+            for value, p in [(p50, 50.0), (p90, 90.0), (p99, 99.0), (p999, 99.9)]:
+                self.assertLessEqual(abs(value - expected(p)), abs(expected(p)) * 0.04, p)
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+
+    @unittest.skipIf(importlib.util.find_spec("websockets") is None,
+                     "venue-replay and the clients need websockets")
+    def test_ws_server(self):
+        print("test_ws_server")
+
+        import asyncio
+        import json
+        import websockets
+        from time import time_ns
+
+        fname = "test_ws_server.ytp"
+        trades = range(1, 201)
+        self.parse_binance_frames(fname, binance_frames(trades), len(trades))
+        port = free_port()
+        url = f"ws://127.0.0.1:{port}"
+        proc = None
+        cfg = {
+            "ws" : {
+                "module" : "feed",
+                "component" : "ws-server",
+                "config" : {
+                    "ytp-file": fname,
+                    "port": port,
+                    "interval": 200
+                }
+            }
+        }
+
+        y = yamal(fname, closable=False)
+        ticker = y.streams().announce("ws-server-test", "ore/test/ticker", "Content-Type application/msgpack")
+
+        async def tick(stop):
+            # the book of another channel changes every 5ms, so the clients
+            # always have an update due
+            ns = time_ns()
+            ticker.write(ns, ore_pack(13, ns, 0, 0, 1, 1, 0, "C") +
+                         ore_pack(1, ns, 0, 1, 1, 1, 1, "100", "1", True) +
+                         ore_pack(1, ns, 0, 1, 0, 1, 2, "101", "1", False))
+            seqno = 1
+            while not stop.is_set():
+                await asyncio.sleep(0.005)
+                seqno += 1
+                ns = time_ns()
+                ticker.write(ns, ore_pack(6, ns, 0, seqno, 0, 1, 1, 1, f"100.{seqno % 10}", "1"))
+
+        async def receive(ws, secs):
+            loop = asyncio.get_running_loop()
+            end = loop.time() + secs
+            msgs = []
+            while (left := end - loop.time()) > 0:
+                try:
+                    msgs.append(json.loads(await asyncio.wait_for(ws.recv(), left)))
+                except asyncio.TimeoutError:
+                    break
+            return msgs
+
+        async def full(ws):
+            return await receive(ws, 2)
+
+        async def fast(ws):
+            await ws.send("interval 50")
+            return await receive(ws, 2)
+
+        async def subscribed(ws):
+            first = json.loads(await ws.recv())
+            await ws.send("subscribe ore/binance/eth")
+            return [first] + await receive(ws, 2)
+
+        async def clients():
+            stop = asyncio.Event()
+            ticking = asyncio.create_task(tick(stop))
+            try:
+                async with websockets.connect(url) as a, websockets.connect(url) as b, \
+                           websockets.connect(url) as c:
+                    return await asyncio.gather(full(a), fast(b), subscribed(c))
+            finally:
+                stop.set()
+                await ticking
+
+        def channels(msg):
+            return {u["channel"] for u in msg["bbo"] + msg["trades"]}
+
+        try:
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            sleep(1)
+            self.assertTrue(proc.is_alive())
+            fullmsgs, fastmsgs, ethmsgs = asyncio.run(clients())
+            self.assertTrue(proc.is_alive())
+
+            # the first message is a snapshot of the parsed books and trades
+            bbo = {u["channel"]: u for u in fullmsgs[0]["bbo"]}
+            self.assertEqual(bbo["ore/binance/btcusdt"]["bid"], [27000.1, trades[-1] % 7 + 1, 1])
+            self.assertEqual(bbo["ore/binance/btcusdt"]["ask"], [27000.2, 2.0, 1])
+            self.assertEqual(bbo["ore/binance/ethusdt"]["bid"], [1800.1, 3.0, 1])
+            self.assertEqual(bbo["ore/binance/ethusdt"]["ask"], [1800.2, trades[-1] % 5 + 1, 1])
+            trd = {u["channel"]: u for u in fullmsgs[0]["trades"]}
+            self.assertEqual(trd["ore/binance/btcusdt"]["px"], 27000 + trades[-1] + 0.5)
+            self.assertEqual(trd["ore/binance/btcusdt"]["qty"], 0.001)
+
+            # messages are at least an interval apart, 200ms by default and
+            # 50ms for the client that asked for it, after its first message
+            def gaps(msgs):
+                return [b["time"] - a["time"] for a, b in zip(msgs, msgs[1:])]
+            self.assertGreaterEqual(len(fullmsgs), 5)
+            self.assertLessEqual(len(fullmsgs), 12)
+            self.assertTrue(all(g >= 200000000 for g in gaps(fullmsgs)), gaps(fullmsgs))
+            self.assertTrue(all(g >= 50000000 for g in gaps(fastmsgs)[1:]), gaps(fastmsgs))
+            self.assertGreater(len(fastmsgs), len(fullmsgs) + 5)
+
+            # once subscribed, the client gets a snapshot of the channels of
+            # the prefix and nothing else, the ticker is not among them
+            first = next((i for i, m in enumerate(ethmsgs[1:], 1)
+                          if "ore/binance/ethusdt" in channels(m)), None)
+            self.assertIsNotNone(first)
+            for msg in ethmsgs[first:]:
+                self.assertTrue(all(ch.startswith("ore/binance/eth") for ch in channels(msg)),
+                                channels(msg))
+        finally:
+            if proc is not None:
+                proc.terminate()
+                proc.join()
+
+    @unittest.skipIf(importlib.util.find_spec("websockets") is None,
+                     "venue-replay needs websockets")
+    @unittest.skipIf(tool("ore-export") is None or tool("ore-replay") is None,
+                     "ore-export and ore-replay are not built")
+    def test_ore_export_replay(self):
+        print("test_ore_export_replay")
+
+        import numpy as np
+        from tutorials import ore
+
+        fname = "test_ore_export.ytp"
+        outdir = "test_ore_export"
+        trades = range(1, 201)
+        self.parse_binance_frames(fname, binance_frames(trades), len(trades))
+        shutil.rmtree(outdir, ignore_errors=True)
+
+        def run(name, *args):
+            return subprocess.run([tool(name), *args], capture_output=True, text=True)
+
+        rd = ore.reader(fname)
+        batches = []
+        while len(batch := rd.read()):
+            batches.append(batch)
+        decoded = np.concatenate(batches)
+
+        res = run("ore-export", "--ytp-file", fname, "--output", outdir, "--threads", "2")
+        self.assertEqual(res.returncode, 0, res.stderr)
+        cols = {name: np.load(path.join(outdir, f"{name}.npy"))
+                for name in ["receive", "type", "price", "qty", "channel"]}
+        with open(path.join(outdir, "channels.txt")) as f:
+            channels = f.read().split()
+        self.assertEqual(len(cols["receive"]), len(decoded))
+        np.testing.assert_array_equal(cols["receive"], decoded["receive"])
+        np.testing.assert_array_equal(cols["type"], decoded["type"])
+        np.testing.assert_array_equal(cols["price"], decoded["price"])
+        np.testing.assert_array_equal(cols["qty"], decoded["qty"])
+        self.assertEqual([channels[c] for c in cols["channel"]],
+                         [rd.channels[c] for c in decoded["channel"]])
+
+        # --start and --end are inclusive bounds of the receive time
+        start, end = decoded["receive"][len(decoded) // 4], decoded["receive"][len(decoded) // 2]
+        ranged = outdir + "_range"
+        shutil.rmtree(ranged, ignore_errors=True)
+        res = run("ore-export", "--ytp-file", fname, "--output", ranged,
+                  "--start", str(start), "--end", str(end))
+        self.assertEqual(res.returncode, 0, res.stderr)
+        inrange = (decoded["receive"] >= start) & (decoded["receive"] <= end)
+        np.testing.assert_array_equal(np.load(path.join(ranged, "receive.npy")),
+                                      decoded["receive"][inrange])
+
+        # bad numbers are rejected with the usage line
+        for args in [["--threads", "0"], ["--threads", "two"], ["--start", "12ab"], ["--end", "1e9"]]:
+            res = run("ore-export", "--ytp-file", fname, "--output", ranged, *args)
+            self.assertEqual(res.returncode, 1, args)
+            self.assertIn("ore-export --ytp-file FILE", res.stderr, args)
+
+        # the exported columns replay once, at max speed
+        res = run("ore-replay", "--columns", outdir)
+        self.assertEqual(res.returncode, 0, res.stderr)
+        self.assertIn(f"loaded {len(decoded)} messages", res.stdout)
+        self.assertIn(f"replay 0: {len(decoded)} messages", res.stdout)
+        self.assertNotIn("replay 1:", res.stdout)
+
+        # a bad pace or repeat is rejected before loading
+        for args in [["--pace", "-1"], ["--pace", "fast"], ["--repeat", "0"]]:
+            res = run("ore-replay", "--columns", outdir, *args)
+            self.assertEqual(res.returncode, 1, args)
+            self.assertIn("ore-replay (--ytp-file FILE | --columns DIR)", res.stderr, args)
+            self.assertNotIn("loaded", res.stdout, args)
+
+    @unittest.skipIf(importlib.util.find_spec("websockets") is None,
+                     "venue-replay needs websockets")
+    def test_feed_parser_rings(self):
+        print("test_feed_parser_rings")
+
+        from tutorials import ore
+
+        frames = "test_feed_parser_rings.jsonl"
+        raw = "test_feed_parser_rings.ytp"
+        ring = "test_feed_parser_rings.ring"
+        output = "test_feed_parser_rings_ore.ytp"
+        fileonly = "test_feed_parser_rings_file_ore.ytp"
+        remove_files(frames, raw, ring, output, fileonly)
+        port = free_port()
+        trades = range(1, 2001)
+        server = None
+        procs = []
+
+        def parse(cfg, fname):
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            procs.append(proc)
+            rd = ore.reader(fname)
+            records = []
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            # the last frame is a trade, so every quote is parsed before it
+            while sum(r['type'] == ore.OFF_BOOK_TRADE for r in records) < len(trades):
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                records.extend(rd.read())
+                sleep(0.1)
+            return [r.tolist() for r in records]
+
+        def quote(t):
+            # the bid price repeats from one quote to the next, and only the
+            # ask price changes, the parser compares them with the previous
+            # quote after its message has left the ring
+            return (f'{{"u":{t},"s":"BTCUSDT","b":"27000.10","B":"{t % 7 + 1}.0",'
+                    f'"a":"{27001 + t % 2}.20","A":"2.0"}}').encode()
+
+        try:
+            with open(frames, "wb") as f:
+                for t in trades:
+                    f.write(b'{"stream":"btcusdt@bookTicker","data":' + quote(t) + b'}\n')
+                    f.write(b'{"stream":"btcusdt@trade","data":' + binance_trade(t) + b'}\n')
+            server = subprocess.Popen([sys.executable, data_file("venue-replay.py"),
+                                       "--frames", frames, "--port", str(port)])
+
+            # the feed handler and the parser share the ring, in their own
+            # processes
+            handlercfg = {
+                "binance" : {
+                    "module" : "feed",
+                    "component" : "binance-feed-handler",
+                    "config" : {
+                        "peer":"binance-feed-handler",
+                        "ytp-file": raw,
+                        "securities": ["btcusdt"],
+                        "endpoint": f"ws://127.0.0.1:{port}",
+                        "ring-file": ring,
+                        "ring-size": 65536
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":handlercfg})
+            proc.start()
+            procs.append(proc)
+            # the feed handler creates the ring with its size
+            sleep(1)
+            ringed = parse({
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-input": raw,
+                        "rings": [ring],
+                        "ytp-output": output
+                    }
+                }
+            }, output)
+
+            # the ORE is the same as parsed from the file alone
+            fromfile = parse({
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-input": raw,
+                        "ytp-output": fileonly
+                    }
+                }
+            }, fileonly)
+            self.assertEqual(ringed, fromfile)
+            typ = ore.dtype.names.index('type')
+            seqno = ore.dtype.names.index('vendor_seqno')
+            self.assertEqual([r[seqno] for r in ringed if r[typ] == ore.OFF_BOOK_TRADE],
+                             list(trades))
+            # the bid, the first order added, is modified on every following
+            # quote
+            oid = ore.dtype.names.index('id')
+            orders = [r for r in ringed if r[typ] in (ore.ORDER_ADD, ore.ORDER_MODIFY)]
+            bids = [r[typ] for r in orders if r[oid] == orders[0][oid]]
+            self.assertEqual(bids, [ore.ORDER_ADD] + [ore.ORDER_MODIFY] * (len(trades) - 1))
+        finally:
+            for proc in procs:
+                proc.terminate()
+                proc.join()
+            if server is not None:
+                server.terminate()
+                server.wait()
+
+
+    @unittest.skipIf(importlib.util.find_spec("websockets") is None,
+                     "venue-replay needs websockets")
+    def test_feed_parser_index(self):
+        print("test_feed_parser_index")
+
+        from tutorials import ore
+
+        frames = "test_feed_parser_index.jsonl"
+        raw = "test_feed_parser_index.ytp"
+        index = "test_feed_parser_index.ytp.idx"
+        output = "test_feed_parser_index_ore.ytp"
+        fileonly = "test_feed_parser_index_file_ore.ytp"
+        remove_files(frames, raw, index, output, fileonly)
+        port = free_port()
+        trades = range(1, 2001)
+        server = None
+        procs = []
+
+        def parse(cfg, fname):
+            proc = Process(target=run_reactor, kwargs={"cfg":cfg})
+            proc.start()
+            procs.append(proc)
+            rd = ore.reader(fname)
+            records = []
+            timeout = timedelta(seconds=60)
+            start = datetime.now()
+            while len(records) < len(trades):
+                self.assertLess(datetime.now(), start + timeout)
+                self.assertTrue(proc.is_alive())
+                records.extend(rd.read())
+                sleep(0.1)
+            return [r.tolist() for r in records]
+
+        try:
+            with open(frames, "wb") as f:
+                for t in trades:
+                    f.write(b'{"stream":"btcusdt@trade","data":' + binance_trade(t) + b'}\n')
+            server = subprocess.Popen([sys.executable, data_file("venue-replay.py"),
+                                       "--frames", frames, "--port", str(port)])
+
+            handlercfg = {
+                "binance" : {
+                    "module" : "feed",
+                    "component" : "binance-feed-handler",
+                    "config" : {
+                        "peer":"binance-feed-handler",
+                        "ytp-file": raw,
+                        "securities": ["btcusdt"],
+                        "endpoint": f"ws://127.0.0.1:{port}",
+                        "index-file": index
+                    }
+                }
+            }
+            proc = Process(target=run_reactor, kwargs={"cfg":handlercfg})
+            proc.start()
+            procs.append(proc)
+            # the feed handler creates the index
+            sleep(1)
+            indexed = parse({
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-input": raw,
+                        "indexes": [index],
+                        "ytp-output": output
+                    }
+                }
+            }, output)
+
+            # the ORE is the same as parsed from the whole file
+            fromfile = parse({
+                "parser" : {
+                    "module" : "feed",
+                    "component" : "feed-parser",
+                    "config" : {
+                        "peer":"feed-parser",
+                        "ytp-input": raw,
+                        "ytp-output": fileonly
+                    }
+                }
+            }, fileonly)
+            self.assertEqual(len(indexed), len(trades))
+            self.assertEqual(indexed, fromfile)
+            self.assertEqual([r[ore.dtype.names.index('vendor_seqno')] for r in indexed],
+                             list(trades))
+        finally:
+            for proc in procs:
+                proc.terminate()
+                proc.join()
+            if server is not None:
+                server.terminate()
+                server.wait()
 
 if __name__ == '__main__':
     unittest.main()